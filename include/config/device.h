@@ -0,0 +1,324 @@
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config/memory.h"
+#include "config/memory_config.h"
+#include "config/scaler_snapshot.h"
+
+namespace ecl {
+
+// selections of signal sources in registers, the same as ConvertSource
+const size_t kSelectFront = 0;
+const size_t kSelectMultiGate = 48;
+const size_t kSelectOrGate = 64;
+const size_t kSelectAndGate = 80;
+const size_t kSelectDivider = 96;
+const size_t kSelectDividerOr = 104;
+const size_t kSelectDividerAnd = 112;
+const size_t kSelectClock = 120;
+const size_t kSelectPrimaryClock = 124;
+const size_t kSelectExternalClock = 128;
+const size_t kSelectBack = 129;
+const size_t kSelectZero = 130;
+const size_t kSelections = 131;
+
+// frequency of the clock divided by clock divisors
+const double kBaseClockHz = 100'000'000.0;
+// maximum count of the 20-bit scaler registers
+const uint32_t kScalerValueMask = 0xfffff;
+
+
+enum DeviceKind {
+	kUioDevice = 0,
+	kFileDevice,
+	kSimulatedDevice
+};
+
+
+const char* const kDeviceKindName[3] = {
+	"uio",
+	"file",
+	"simulated"
+};
+
+
+struct DeviceOption {
+	DeviceKind kind;
+	// UIO device or register file
+	std::string path;
+	// events per second of each front input of the simulated device
+	std::vector<double> rates;
+	// nanoseconds of one pulse, decides the coincidences of gates
+	double width_ns;
+	// seed of the simulated counts, 0 takes a random seed
+	uint32_t seed;
+	// update scalers of the simulated device every second, off if the
+	// registers are written by others
+	bool update;
+
+	DeviceOption() {
+		kind = kUioDevice;
+		path = "/dev/uio0";
+		width_ns = 100.0;
+		seed = 0;
+		update = true;
+	}
+};
+
+
+/**
+ * Device is the backend holding the registers of FPGA. The registers are
+ * always a Memory struct in the address space, so the configuration, the
+ * snapshots, the capture and the I2C engine work the same on all backends,
+ * and only opening, closing and interrupts differ.
+ *
+ */
+class Device {
+public:
+
+	/// @brief default destructor
+	///
+	virtual ~Device() = default;
+
+
+	/// @brief open the backend and map the registers
+	/// @returns 0 on success, -1 on failure
+	///
+	virtual int Open() noexcept = 0;
+
+
+	/// @brief get the registers
+	/// @returns mapped registers, nullptr if not opened
+	///
+	virtual volatile Memory* Registers() noexcept = 0;
+
+
+	/// @brief get the file descriptor to wait for the scaler interrupts
+	/// @returns file descriptor, -1 if the backend has no interrupt
+	///
+	virtual int IrqFd() const noexcept {
+		return -1;
+	}
+
+
+	/// @brief get the description of backend
+	/// @returns kind and path of backend
+	///
+	virtual std::string Name() const noexcept = 0;
+
+
+	/// @brief read all scaler registers at once
+	/// @param[out] snapshot values of all scalers
+	/// @returns 0 on success, -1 if the scalers keep changing
+	///
+	int ReadSnapshot(ScalerSnapshot &snapshot) noexcept;
+
+
+	/// @brief write configuration to registers
+	/// @param[in] config configuration to write
+	/// @param[in] full write all registers instead of the changed ones
+	/// @param[out] result what is written, ignored if nullptr
+	/// @returns 0 on success, -1 on failure
+	///
+	int WriteConfig(
+		const MemoryConfig &config,
+		bool full,
+		MapResult *result = nullptr
+	) noexcept;
+
+
+	/// @brief reset the counters and dividers
+	///
+	void Reset() noexcept;
+};
+
+
+/**
+ * UioDevice maps the registers of FPGA through the UIO driver, and the
+ * interrupts of the device latch the scalers.
+ *
+ */
+class UioDevice final : public Device {
+public:
+
+	/// @brief constructor
+	/// @param[in] path path of UIO device
+	///
+	UioDevice(const std::string &path = "/dev/uio0") noexcept;
+
+
+	/// @brief destructor, unmap and unlock the device
+	///
+	~UioDevice() noexcept;
+
+
+	int Open() noexcept override;
+
+
+	volatile Memory* Registers() noexcept override;
+
+
+	int IrqFd() const noexcept override;
+
+
+	std::string Name() const noexcept override;
+
+private:
+	std::string path_;
+	int fd_;
+	volatile Memory *memory_;
+};
+
+
+/**
+ * FileDevice maps a shared file as registers. Another process maps the same
+ * file to play FPGA, e.g. writes scaler counts and reads the configuration.
+ * The file is locked like the UIO device, the other process should map it
+ * without locking.
+ *
+ */
+class FileDevice final : public Device {
+public:
+
+	/// @brief constructor
+	/// @param[in] path path of register file, created if not exists
+	///
+	FileDevice(const std::string &path) noexcept;
+
+
+	/// @brief destructor, unmap and unlock the file
+	///
+	~FileDevice() noexcept;
+
+
+	int Open() noexcept override;
+
+
+	volatile Memory* Registers() noexcept override;
+
+
+	std::string Name() const noexcept override;
+
+private:
+	std::string path_;
+	int fd_;
+	volatile Memory *memory_;
+};
+
+
+/// @brief estimate rates of all signal sources from configured registers
+/// @details Or gates add up rates of inputs. And gates and multi gates only
+///		fire on coincidences of independent inputs within one pulse width,
+///		so n inputs of rates r give n * w^(n-1) * r1 * ... * rn, and at
+///		least k inputs of multi gates give k * w^(k-1) times the sum of
+///		products of k rates. Dividers divide the rates of sources and clocks
+///		run at kBaseClockHz divided by clock divisors.
+/// @param[in] memory configured registers
+/// @param[in] inputs events per second of front inputs, missing ones are 0
+/// @param[in] size number of inputs
+/// @param[in] width seconds of one pulse
+/// @param[out] rates events per second of kSelections sources
+///
+void SimulateRates(
+	const Memory &memory,
+	const double *inputs,
+	size_t size,
+	double width,
+	double *rates
+) noexcept;
+
+
+/**
+ * SimulatedDevice plays FPGA in process. The registers start like powered
+ * on, scaler i counts front input i, and once per second the scaler
+ * registers are updated to counts of the configured sources drawn from
+ * Poisson distributions of the rates from SimulateRates. The value registers
+ * of front IO and gates are updated to random levels with duty cycles of
+ * the rates.
+ *
+ */
+class SimulatedDevice final : public Device {
+public:
+
+	/// @brief constructor
+	/// @param[in] option input rates, pulse width and seed
+	///
+	SimulatedDevice(const DeviceOption &option) noexcept;
+
+
+	/// @brief destructor, stop updating
+	///
+	~SimulatedDevice() noexcept;
+
+
+	/// @brief start updating scalers in the middle of every second, unless
+	///		updating is off in option
+	/// @returns 0 on success
+	///
+	int Open() noexcept override;
+
+
+	volatile Memory* Registers() noexcept override;
+
+
+	std::string Name() const noexcept override;
+
+
+	/// @brief update registers of one second now
+	///
+	void Update() noexcept;
+
+
+	/// @brief get the seconds updated
+	/// @returns times of Update
+	///
+	uint64_t Updates() const noexcept;
+
+private:
+
+	/// @brief stop the updating thread
+	///
+	void Stop() noexcept;
+
+	std::unique_ptr<Memory> memory_;
+	std::vector<double> inputs_;
+	double width_;
+	bool update_;
+	std::mt19937_64 engine_;
+	std::atomic<uint64_t> updates_;
+
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable stop_condition_;
+	bool stop_;
+};
+
+
+/// @brief parse kind of device
+/// @param[in] name name in kDeviceKindName
+/// @param[out] kind kind of device
+/// @returns 0 on success, -1 on unknown name
+///
+int ParseDeviceKind(const std::string &name, DeviceKind &kind) noexcept;
+
+
+/// @brief create and open the device
+/// @param[in] option kind and parameters of device
+/// @returns opened device, nullptr on failure
+///
+std::unique_ptr<Device> OpenDevice(const DeviceOption &option) noexcept;
+
+}	// namespace ecl
+
+#endif	// __DEVICE_H__
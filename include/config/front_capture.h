@@ -0,0 +1,362 @@
+#ifndef __FRONT_CAPTURE_H__
+#define __FRONT_CAPTURE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+// 16-bit value registers of one sample, front_value[3], multi_gate_value,
+// or_gate_value and and_gate_value
+const size_t kFrontWords = 6;
+// channel i is bit i%16 of word i/16
+const size_t kFrontChannels = kFrontWords * 16;
+// the first channel of each kind
+const size_t kFrontInputChannel = 0;
+const size_t kMultiGateChannel = 48;
+const size_t kOrGateChannel = 64;
+const size_t kAndGateChannel = 80;
+// maximum samples returned by one read of a free running reader
+const size_t kFrontChunkSamples = 4096;
+// times per second the readers are notified
+const int kFrontNotifyRate = 20;
+
+
+struct FrontSample {
+	// unix time in nanoseconds
+	int64_t time;
+	// values of the registers
+	uint16_t words[kFrontWords];
+};
+
+
+/// @brief read the value registers of front IO and gates
+/// @param[in] memory mapped memory of FPGA
+/// @param[out] sample values of registers, time is not changed
+///
+void ReadFrontSample(const volatile Memory *memory, FrontSample &sample) noexcept;
+
+
+/// @brief get level of one channel in sample
+/// @param[in] sample sample to read
+/// @param[in] channel channel index, less than kFrontChannels
+/// @returns true if high
+///
+inline bool FrontLevel(const FrontSample &sample, size_t channel) noexcept {
+	return (sample.words[channel / 16] >> (channel % 16)) & 1;
+}
+
+
+struct FrontStatistics {
+	// samples accumulated
+	uint64_t samples;
+	// samples with the channel high, duty cycle is high/samples
+	uint64_t high[kFrontChannels];
+	// level changes of the channel
+	uint64_t transitions[kFrontChannels];
+	// the last sample, transitions are counted from it if samples > 0
+	FrontSample last;
+
+	FrontStatistics() {
+		Clear();
+		last.time = 0;
+		for (size_t i = 0; i < kFrontWords; ++i) last.words[i] = 0;
+	}
+
+	// clear the counts and keep the last sample
+	void Clear() {
+		samples = 0;
+		for (size_t i = 0; i < kFrontChannels; ++i) {
+			high[i] = 0;
+			transitions[i] = 0;
+		}
+	}
+};
+
+
+/// @brief add samples to statistics
+/// @param[in] samples samples in time order
+/// @param[in] size number of samples
+/// @param[inout] statistics statistics to add to
+/// @param[in] continued count transitions from the last sample of statistics
+///
+void AccumulateFront(
+	const FrontSample *samples,
+	size_t size,
+	FrontStatistics &statistics,
+	bool continued
+) noexcept;
+
+
+enum FrontEdge {
+	kFrontRising = 0,
+	kFrontFalling,
+	kFrontAnyEdge
+};
+
+
+struct FrontTrigger {
+	// capture windows around edges of the channel, otherwise read all samples
+	bool enable;
+	// channel to trigger on
+	size_t channel;
+	FrontEdge edge;
+	// samples kept before and after the trigger sample
+	size_t pre;
+	size_t post;
+
+	FrontTrigger() {
+		enable = false;
+		channel = 0;
+		edge = kFrontRising;
+		pre = 0;
+		post = 0;
+	}
+};
+
+
+struct FrontCaptureOption {
+	// samples per second, 0 samples only by calling SampleOnce
+	int rate;
+	// CPU to pin the polling thread to, -1 runs on any CPU
+	int cpu;
+	// samples kept in ring, rounded up to power of 2
+	size_t capacity;
+
+	FrontCaptureOption() {
+		rate = 1000;
+		cpu = -1;
+		capacity = 65536;
+	}
+};
+
+
+struct FrontCaptureMetrics {
+	// samples taken
+	uint64_t samples;
+	// sampling periods skipped because the thread was late
+	uint64_t missed;
+	// samples overwritten before readers got them
+	uint64_t dropped;
+	// current readers
+	uint64_t readers;
+};
+
+
+class FrontCapture;
+
+
+/**
+ * FrontReader reads samples of the capture in order from its own cursor.
+ * Without trigger, it returns all samples. With trigger, it looks for the
+ * edge of the channel and returns the window of samples around the edge once
+ * all samples after it are taken. Samples overwritten before reading are
+ * skipped and counted as dropped.
+ *
+ * The reader is not thread safe, callers serialize the reading.
+ *
+ */
+class FrontReader {
+public:
+
+	/// @brief read the next samples
+	/// @param[out] samples samples read, cleared first
+	/// @param[out] trigger index of the trigger sample in samples, -1 if
+	///		not triggered
+	/// @returns number of samples read, 0 if nothing to read now
+	///
+	size_t Next(std::vector<FrontSample> &samples, int &trigger) noexcept;
+
+
+	/// @brief get dropped samples of this reader
+	/// @returns dropped samples
+	///
+	uint64_t Dropped() const noexcept;
+
+private:
+	friend class FrontCapture;
+
+	/// @brief constructor
+	/// @param[in] capture capture to read from
+	/// @param[in] trigger trigger of capture windows
+	/// @param[in] cursor sequence of the first sample to read, samples
+	///		before it are never read
+	///
+	FrontReader(
+		const FrontCapture *capture,
+		const FrontTrigger &trigger,
+		uint64_t cursor
+	) noexcept;
+
+
+	/// @brief skip samples overwritten in ring
+	/// @param[in] head sequence after the latest sample
+	///
+	void Skip(uint64_t head) noexcept;
+
+
+	/// @brief count dropped samples
+	/// @param[in] size number of samples dropped
+	///
+	void Drop(uint64_t size) noexcept;
+
+	const FrontCapture *capture_;
+	FrontTrigger trigger_;
+	// sequence of the first sample and the next sample to read
+	uint64_t first_;
+	uint64_t cursor_;
+	uint64_t dropped_;
+	// level of the trigger channel in the last sample, if has_level_
+	bool has_level_;
+	bool level_;
+	// sequence of the trigger sample, if triggered_
+	bool triggered_;
+	uint64_t trigger_sequence_;
+	std::function<void()> notifier_;
+};
+
+
+/**
+ * FrontCapture samples the value registers of front IO and gates at a fixed
+ * rate, like a logic analyzer. A polling thread, optionally pinned to one
+ * CPU, reads the six 16-bit registers at absolute deadlines of the monotonic
+ * clock and writes the samples to a ring. It keeps normal scheduling, so the
+ * real time scaler sampler always runs first, and it only runs while there
+ * are readers.
+ *
+ * The ring has only one writer and readers never lock. Each slot is stamped
+ * with the sequence of its sample, and readers check the stamp before and
+ * after copying. Readers are notified several times per second, from the
+ * polling thread.
+ *
+ */
+class FrontCapture {
+public:
+
+	/// @brief constructor
+	/// @param[in] memory mapped memory of FPGA
+	/// @param[in] option capture options
+	///
+	FrontCapture(
+		const volatile Memory *memory,
+		const FrontCaptureOption &option
+	) noexcept;
+
+
+	/// @brief destructor, stop the polling thread
+	///
+	~FrontCapture() noexcept;
+
+
+	FrontCapture(const FrontCapture&) = delete;
+	FrontCapture& operator=(const FrontCapture&) = delete;
+
+
+	/// @brief add a reader, start the polling thread for the first one
+	/// @param[in] trigger trigger of capture windows, pre and post are
+	///		limited to half of the ring
+	/// @param[in] notifier function called after new samples are taken, it
+	///		is called in the polling thread and must not block, subscribe or
+	///		unsubscribe
+	/// @returns reader starting from the next sample, nullptr if the trigger
+	///		channel is invalid
+	///
+	std::shared_ptr<FrontReader> Subscribe(
+		const FrontTrigger &trigger,
+		std::function<void()> notifier = nullptr
+	) noexcept;
+
+
+	/// @brief remove the reader, stop the polling thread after the last one
+	/// @note After returning, the notifier of the reader is not called any
+	///		more. It must not be called in the notifier.
+	/// @param[in] reader reader to remove
+	///
+	void Unsubscribe(const std::shared_ptr<FrontReader> &reader) noexcept;
+
+
+	/// @brief stop the polling thread and never start it again, readers are
+	///		kept but get no more samples
+	///
+	void Stop() noexcept;
+
+
+	/// @brief take one sample now, used by the polling thread
+	/// @note Only one thread takes samples.
+	///
+	void SampleOnce() noexcept;
+
+
+	/// @brief get the sequence after the latest sample
+	/// @returns number of samples taken
+	///
+	uint64_t Head() const noexcept;
+
+
+	/// @brief read one sample in ring
+	/// @param[in] sequence sequence of the sample
+	/// @param[out] sample the sample
+	/// @returns true on success, false if not in ring
+	///
+	bool Read(uint64_t sequence, FrontSample &sample) const noexcept;
+
+
+	/// @brief get number of samples kept in ring
+	/// @returns capacity of ring
+	///
+	size_t Capacity() const noexcept;
+
+
+	/// @brief get the metrics of capture
+	/// @returns copy of metrics
+	///
+	FrontCaptureMetrics Metrics() const noexcept;
+
+private:
+	friend class FrontReader;
+
+	/// @brief polling thread
+	///
+	void Loop() noexcept;
+
+
+	/// @brief call the notifiers of readers
+	///
+	void Notify() noexcept;
+
+	const volatile Memory *memory_;
+	int rate_;
+	int cpu_;
+
+	// ring of samples, capacity is power of 2
+	size_t capacity_;
+	std::unique_ptr<FrontSample[]> slots_;
+	// sequence+1 of sample in slot, 0 if under writing or never written
+	std::unique_ptr<std::atomic<uint64_t>[]> stamps_;
+	std::atomic<uint64_t> head_;
+
+	// readers, protected by readers_mutex_, which is held in notifying
+	mutable std::mutex readers_mutex_;
+	std::list<std::shared_ptr<FrontReader>> readers_;
+	// starting and stopping the thread, protected by thread_mutex_
+	std::mutex thread_mutex_;
+	std::thread thread_;
+	bool closed_;
+	std::atomic<bool> stop_;
+
+	std::atomic<uint64_t> missed_;
+	mutable std::atomic<uint64_t> dropped_;
+};
+
+}	// namespace ecl
+
+#endif	// __FRONT_CAPTURE_H__
@@ -5,10 +5,26 @@
 
 #include "config/config_parser.h"
 #include "config/memory.h"
-#include "i2c.h"
+#include "i2c_engine.h"
 
 namespace ecl {
 
+struct MapResult {
+	// 32-bit words written
+	size_t words;
+	// RJ45 port groups enabled through I2C
+	size_t rj45_groups;
+	// RJ45 port groups whose I2C transaction failed, e.g. not acknowledged
+	size_t rj45_failures;
+	// nanoseconds of I2C transactions
+	uint64_t i2c_ns;
+	// FPGA is reset
+	bool reset;
+	// all registers are written since the read back image is not reliable
+	bool full;
+};
+
+
 class MemoryConfig {
 public:
 	/// @brief Construct a new Memory Config object
@@ -63,9 +79,31 @@ public:
 
 	/// @brief write register memory to the shared memory
 	/// @param[in] map address of mapped shared memroy
-	/// @returns 0 on success, -1 on failure
+	/// @param[out] result what is written, ignored if nullptr
+	/// @returns 0 on success, -1 if enabling any RJ45 port group failed
+	///
+	int MapMemory(
+		volatile uint32_t *map,
+		MapResult *result = nullptr
+	) const noexcept;
+
+
+	/// @brief write only the changed registers to the shared memory
+	/// @details The current registers are read back and only the 32-bit
+	///		words with different configuration bits are written, live values
+	///		such as front IO, gate values and scaler counts are ignored. RJ45
+	///		port groups are enabled through I2C only if their enable flags
+	///		change, and FPGA is reset only if divider or clock divider
+	///		registers change. If the registers read back after writing still
+	///		differ, it falls back to MapMemory.
+	/// @param[in] map address of mapped shared memory
+	/// @param[out] result what is written, ignored if nullptr
+	/// @returns 0 on success, -1 if enabling any RJ45 port group failed
 	///
-	int MapMemory(volatile uint32_t *map) const noexcept;
+	int MapMemoryDifferential(
+		volatile uint32_t *map,
+		MapResult *result = nullptr
+	) const noexcept;
 
 
 	/// @brief get the const pointer to memroy struct
@@ -83,6 +121,19 @@ public:
 	void EnableRj45(volatile uint32_t *map, uint32_t index) const noexcept;
 
 
+	/// @brief call I2C chips to enable RJ45 input or output
+	/// @param[in] engine I2C engine of FPGA
+	/// @param[in] index index of RJ45 port to enable
+	/// @param[out] timing timing of the I2C transaction, ignored if nullptr
+	/// @returns 0 on success, -1 on failure
+	///
+	int EnableRj45(
+		I2cEngine &engine,
+		uint32_t index,
+		I2cTiming *timing = nullptr
+	) const noexcept;
+
+
 	/// @brief convert source index from ConfigParser to memroy selection
 	/// @param[in] source index of source from parser
 	/// @returns selection index in memroy config
@@ -0,0 +1,41 @@
+#ifndef __SCALER_SNAPSHOT_H__
+#define __SCALER_SNAPSHOT_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+// maximum bursts read for one snapshot
+const int kMaxSnapshotBursts = 4;
+
+
+struct ScalerSnapshot {
+	// values of all scalers, from the same counting interval
+	uint32_t values[kMaxScalers];
+	// bursts read to get this snapshot
+	int bursts;
+};
+
+
+/// @brief read all scaler registers at once
+/// @details The scaler block is copied in one burst of aligned 32-bit words
+///		and the bit fields are decoded from the copy. Registers are latched
+///		by FPGA once per interval, and a burst straddling the latch is
+///		detected by reading again until two consecutive bursts agree.
+/// @param[in] memory mapped memory of FPGA
+/// @param[out] snapshot values of all scalers
+/// @param[in] max_bursts maximum bursts to read, at least 2
+/// @returns 0 on success, -1 if bursts never agree and the last one is kept
+///
+int ReadScalerSnapshot(
+	const volatile Memory *memory,
+	ScalerSnapshot &snapshot,
+	int max_bursts = kMaxSnapshotBursts
+) noexcept;
+
+}	// namespace ecl
+
+#endif	// __SCALER_SNAPSHOT_H__
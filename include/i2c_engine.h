@@ -0,0 +1,185 @@
+#ifndef __I2C_ENGINE_H__
+#define __I2C_ENGINE_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ecl {
+
+// bits of I2C control register, SDA, SCL and master driving SDA
+const uint32_t kI2cSda = 0x1;
+const uint32_t kI2cScl = 0x2;
+const uint32_t kI2cControl = 0x4;
+// bit of SDA in the I2C output register
+const uint32_t kI2cSdaIn = 0x8;
+
+// default nanoseconds between two edges, the same as the old bit-banging
+const uint32_t kI2cEdgeNs = 2000;
+// waits longer than this sleep instead of spinning
+const uint32_t kI2cSleepNs = 100000;
+
+
+/**
+ * I2cPort is the pair of registers to drive I2C bit by bit.
+ *
+ */
+class I2cPort {
+public:
+
+	/// @brief default destructor
+	///
+	virtual ~I2cPort() = default;
+
+
+	/// @brief write the control register, SDA, SCL and control bits
+	/// @param[in] value value to write
+	///
+	virtual void Write(uint32_t value) noexcept = 0;
+
+
+	/// @brief read the output register
+	/// @returns value of register, SDA driven by slave in kI2cSdaIn
+	///
+	virtual uint32_t Read() noexcept = 0;
+};
+
+
+/**
+ * MappedI2cPort drives the I2C registers in mapped memory of FPGA, the
+ * control register is word 0 and the output register is word 1.
+ *
+ */
+class MappedI2cPort final : public I2cPort {
+public:
+
+	/// @brief constructor
+	/// @param[in] map mapped address of FPGA
+	///
+	MappedI2cPort(volatile uint32_t *map) noexcept;
+
+
+	void Write(uint32_t value) noexcept override;
+
+
+	uint32_t Read() noexcept override;
+
+private:
+	volatile uint32_t *map_;
+};
+
+
+struct I2cTiming {
+	// nanoseconds from start to stop
+	uint64_t duration_ns;
+	// writes of control register
+	size_t edges;
+	// bytes not acknowledged by slave
+	size_t nacks;
+};
+
+
+struct I2cEngineMetrics {
+	uint64_t transactions;
+	// bytes not acknowledged by slave
+	uint64_t nacks;
+	// nanoseconds of transactions
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t last_ns;
+};
+
+
+/**
+ * I2cEngine writes whole I2C transactions, the start, address byte, data
+ * bytes and stop, in one call. Edges are spaced by busy waiting on the
+ * monotonic clock instead of sleeping after each edge, since one sleep of
+ * kernel costs tens of microseconds while the edge needs only a few.
+ *
+ * The minimum edge time is measured in constructing, as the cost of one
+ * register access and one clock read, and the edges are never spaced
+ * closer than it.
+ *
+ */
+class I2cEngine {
+public:
+
+	/// @brief constructor, measure the minimum edge time
+	/// @param[in] port registers to drive
+	/// @param[in] edge_ns nanoseconds between two edges
+	///
+	I2cEngine(I2cPort &port, uint32_t edge_ns = kI2cEdgeNs) noexcept;
+
+
+	/// @brief write bytes to slave in one transaction
+	/// @param[in] address 7-bit slave address
+	/// @param[in] data bytes to write
+	/// @param[in] size number of bytes
+	/// @param[out] timing timing of this transaction, ignored if nullptr
+	/// @returns 0 on success, -1 if any byte is not acknowledged
+	///
+	int Write(
+		uint8_t address,
+		const uint8_t *data,
+		size_t size,
+		I2cTiming *timing = nullptr
+	) noexcept;
+
+
+	/// @brief get measured minimum edge time
+	/// @returns nanoseconds of one register access and clock read
+	///
+	uint32_t MinEdgeNs() const noexcept;
+
+
+	/// @brief get nanoseconds between two edges in use
+	/// @returns the larger one of edge_ns and the minimum edge time
+	///
+	uint32_t EdgeNs() const noexcept;
+
+
+	/// @brief get the metrics of all transactions
+	/// @returns copy of metrics
+	///
+	I2cEngineMetrics Metrics() const noexcept;
+
+private:
+
+	/// @brief write control register after the last edge is old enough
+	/// @param[in] value value to write
+	///
+	void Edge(uint32_t value) noexcept;
+
+
+	/// @brief wait until the last edge is old enough
+	///
+	void Wait() noexcept;
+
+
+	/// @brief send start condition
+	///
+	void Start() noexcept;
+
+
+	/// @brief send stop condition
+	///
+	void Stop() noexcept;
+
+
+	/// @brief send one byte and read the acknowledge from slave
+	/// @param[in] data byte to send
+	/// @returns true if acknowledged
+	///
+	bool Send(uint8_t data) noexcept;
+
+	I2cPort &port_;
+	uint32_t min_edge_ns_;
+	uint32_t edge_ns_;
+	// time of the last edge in nanoseconds, and edges in this transaction
+	int64_t last_edge_;
+	size_t edges_;
+	I2cEngineMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __I2C_ENGINE_H__
@@ -0,0 +1,168 @@
+#ifndef __SCALER_ARCHIVE_H__
+#define __SCALER_ARCHIVE_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "scaler/scaler_file.h"
+
+namespace ecl {
+
+// values in one frame of compressed column
+const size_t kArchiveFrameSize = 64;
+// blocks in one day
+const size_t kArchiveBlocks = kDaySeconds / kScalerBlockSeconds;
+
+
+struct ScalerArchiveHeader {
+	uint8_t version;
+	uint8_t number;
+	uint16_t blocks;
+	// bytes of compressed data after the index
+	uint32_t data_size;
+};
+
+
+/// @brief construct archive file name
+/// @param[in] data_path data stored path, ends with '/'
+/// @param[in] device_name device name
+/// @param[in] date c style date
+/// @returns file name
+///
+std::string ScalerArchiveFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept;
+
+
+/**
+ * ScalerArchive is the compressed form of a day file which is no longer
+ * written. The day is split into blocks of kScalerBlockSeconds, and each
+ * scaler in each block is compressed separately. An index of offsets after
+ * the header locates the compressed column of any block and scaler, so
+ * reading a range only decodes the blocks it covers.
+ *
+ * A compressed column is a sequence of frames of kArchiveFrameSize values.
+ * Each frame starts with the bit width of its deltas and the first value in
+ * varint, followed by the zigzag encoded deltas of the other values, packed
+ * in the bit width. Frames are skipped without decoding.
+ *
+ */
+class ScalerArchive {
+public:
+
+	/// @brief constructor
+	///
+	ScalerArchive() noexcept;
+
+
+	/// @brief destructor, unmap and close the file
+	///
+	~ScalerArchive() noexcept;
+
+
+	ScalerArchive(const ScalerArchive&) = delete;
+	ScalerArchive& operator=(const ScalerArchive&) = delete;
+
+
+	/// @brief compress the day file into archive file
+	/// @param[in] day day file to compress
+	/// @param[in] name archive file name, replaced if exists
+	/// @param[in] progress called with bytes read from day file after each
+	///		block is compressed, for throttling
+	/// @returns 0 on success, -1 on failure
+	///
+	static int Create(
+		const ScalerFile &day,
+		const std::string &name,
+		const std::function<void(size_t)> &progress = nullptr
+	) noexcept;
+
+
+	/// @brief decompress the archive file into day file
+	/// @param[in] archive_name archive file name
+	/// @param[in] name day file name, replaced if exists
+	/// @param[in] version layout version of the day file
+	/// @returns 0 on success, -1 on failure, -2 if archive not exists
+	///
+	static int Extract(
+		const std::string &archive_name,
+		const std::string &name,
+		uint8_t version = kScalerFileRowMajor
+	) noexcept;
+
+
+	/// @brief open and map the archive file for reading
+	/// @param[in] name file name
+	/// @returns 0 on success, -1 on failure, -2 if file not exists
+	///
+	int Open(const std::string &name) noexcept;
+
+
+	/// @brief unmap and close the file
+	///
+	void Close() noexcept;
+
+
+	/// @brief check whether the file is open
+	/// @returns true if open, false otherwise
+	///
+	inline bool IsOpen() const noexcept {
+		return map_ != nullptr;
+	}
+
+
+	/// @brief get the file size
+	/// @returns bytes of the whole file
+	///
+	inline size_t Size() const noexcept {
+		return size_;
+	}
+
+
+	/// @brief decode continuous values of one scaler
+	/// @param[in] second first second in this day
+	/// @param[in] size number of values, second + size <= kDaySeconds
+	/// @param[in] index index of scaler
+	/// @param[out] values size values of the scaler
+	///
+	void ReadColumn(
+		size_t second,
+		size_t size,
+		size_t index,
+		uint32_t *values
+	) const noexcept;
+
+
+	/// @brief decode continuous rows of all scalers
+	/// @param[in] second first second in this day
+	/// @param[in] size number of rows, second + size <= kDaySeconds
+	/// @param[out] rows size rows of kMaxScalers values
+	///
+	void ReadRows(size_t second, size_t size, uint32_t *rows) const noexcept;
+
+
+	/// @brief get the name of the file
+	/// @returns file name
+	///
+	inline const std::string& Name() const noexcept {
+		return name_;
+	}
+
+private:
+	std::string name_;
+	int fd_;
+	size_t size_;
+	uint8_t *map_;
+	// offsets of compressed columns from data, block by block
+	const uint32_t *index_;
+	const uint8_t *data_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_ARCHIVE_H__
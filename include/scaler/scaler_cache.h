@@ -0,0 +1,156 @@
+#ifndef __SCALER_CACHE_H__
+#define __SCALER_CACHE_H__
+
+#include <ctime>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace ecl {
+
+struct ScalerCacheKey {
+	// seconds of the query range
+	int seconds;
+	// seconds averaged into one value
+	int average;
+	// the second when the query is computed
+	time_t time;
+	// version of the source data, increased by every new sample
+	uint64_t version;
+
+	/// @brief whether the data of this key is older than other
+	/// @param[in] other key to compare
+	/// @returns true if the second or the version is earlier
+	///
+	bool Before(const ScalerCacheKey &other) const noexcept {
+		if (time != other.time) return time < other.time;
+		return version < other.version;
+	}
+
+
+	bool operator<(const ScalerCacheKey &other) const noexcept {
+		if (time != other.time || version != other.version) {
+			return Before(other);
+		}
+		if (seconds != other.seconds) return seconds < other.seconds;
+		return average < other.average;
+	}
+};
+
+
+struct ScalerCacheValue {
+	// unix time of the first value
+	time_t start_time;
+	// values of each series
+	size_t size;
+	// series one after another, series i is values[i*size, (i+1)*size)
+	std::vector<uint32_t> values;
+};
+
+
+struct ScalerCacheMetrics {
+	// results found in cache
+	uint64_t hits;
+	// results computed
+	uint64_t misses;
+	// results waited for the same computation of another query
+	uint64_t coalesced;
+	// results removed for the memory limit
+	uint64_t evicted;
+	// results removed because a newer second or version is queried
+	uint64_t expired;
+	// results in cache now
+	uint64_t entries;
+	// bytes of results in cache now
+	uint64_t bytes;
+};
+
+
+/**
+ * ScalerCache shares the results of scaler queries among clients. Results
+ * are keyed by the query range and the second when they are computed, so
+ * all clients asking for the same range in the same second get one result.
+ * The first query of a key computes it, and the identical queries arriving
+ * meanwhile wait for the computation instead of repeating it. Once a newer
+ * second is queried, the results of earlier seconds are out of date and
+ * removed. The least recently used results are removed if the cache grows
+ * beyond the memory limit.
+ *
+ */
+class ScalerCache {
+public:
+
+	/// @brief constructor
+	/// @param[in] max_bytes memory limit of results, 0 keeps no result but
+	///		still coalesces identical queries
+	///
+	ScalerCache(size_t max_bytes) noexcept;
+
+
+	ScalerCache(const ScalerCache&) = delete;
+	ScalerCache& operator=(const ScalerCache&) = delete;
+
+
+	/// @brief get result from cache, or compute it
+	/// @param[in] key range and second of query
+	/// @param[in] compute function to compute the result, returns 0 on
+	///		success, failed results are not kept
+	/// @param[out] value the result, nullptr on failure
+	/// @returns 0 on success, or the code returned by compute
+	///
+	int Get(
+		const ScalerCacheKey &key,
+		const std::function<int(ScalerCacheValue&)> &compute,
+		std::shared_ptr<const ScalerCacheValue> &value
+	) noexcept;
+
+
+	/// @brief get the metrics of cache
+	/// @returns copy of metrics
+	///
+	ScalerCacheMetrics Metrics() const noexcept;
+
+private:
+
+	struct Entry {
+		// the computation is finished
+		bool ready;
+		// code returned by compute
+		int result;
+		std::shared_ptr<const ScalerCacheValue> value;
+		size_t bytes;
+		// order of the last use
+		uint64_t used;
+	};
+
+
+	/// @brief remove finished results older than key, with the mutex locked
+	/// @param[in] key the key being queried
+	///
+	void Expire(const ScalerCacheKey &key) noexcept;
+
+
+	/// @brief remove the least recently used results until the memory limit
+	///		is met, with the mutex locked
+	///
+	void Evict() noexcept;
+
+	size_t max_bytes_;
+
+	// entries and metrics, protected by mutex_
+	mutable std::mutex mutex_;
+	std::condition_variable ready_condition_;
+	std::map<ScalerCacheKey, std::shared_ptr<Entry>> entries_;
+	uint64_t uses_;
+	ScalerCacheMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_CACHE_H__
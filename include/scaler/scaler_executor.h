@@ -0,0 +1,129 @@
+#ifndef __SCALER_EXECUTOR_H__
+#define __SCALER_EXECUTOR_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecl {
+
+struct ScalerExecutorOption {
+	// worker threads
+	size_t threads;
+	// maximum tasks waiting for busy workers, more are rejected, 0 only
+	// accepts tasks for idle workers
+	size_t queue;
+
+	ScalerExecutorOption() {
+		threads = 2;
+		queue = 16;
+	}
+};
+
+
+struct ScalerExecutorMetrics {
+	// tasks accepted
+	uint64_t submitted;
+	// tasks rejected because the queue is full or stopped
+	uint64_t rejected;
+	// tasks cancelled before running
+	uint64_t cancelled;
+	// tasks finished, including the cancelled ones
+	uint64_t completed;
+	// tasks waiting now
+	uint64_t queued;
+	// tasks running now
+	uint64_t running;
+	// maximum microseconds waiting in queue
+	uint64_t max_wait_us;
+	// total microseconds waiting in queue
+	uint64_t total_wait_us;
+};
+
+
+/**
+ * ScalerExecutor runs queries reading scaler files in a fixed pool of
+ * worker threads, so slow reads never block the threads of gRPC and other
+ * RPCs keep being served. The queue is bounded, and tasks beyond it are
+ * rejected at once instead of waiting without limit.
+ *
+ * Every accepted task is called exactly once, with the flag cancelled set
+ * if its cancel check is true when a worker picks it up, or if the executor
+ * is stopping. So the task always gets the chance to finish its RPC.
+ *
+ */
+class ScalerExecutor {
+public:
+
+	/// @brief constructor, start worker threads
+	/// @param[in] option threads and queue size
+	///
+	ScalerExecutor(const ScalerExecutorOption &option) noexcept;
+
+
+	/// @brief destructor, stop the workers
+	///
+	~ScalerExecutor() noexcept;
+
+
+	ScalerExecutor(const ScalerExecutor&) = delete;
+	ScalerExecutor& operator=(const ScalerExecutor&) = delete;
+
+
+	/// @brief add task to the queue
+	/// @param[in] task function to run, called with true if cancelled
+	/// @param[in] cancelled returns true if the task is not needed anymore,
+	///		could be nullptr
+	/// @returns 0 on success, -1 if no worker is idle and the queue is full,
+	///		or stopped, and the task is never called
+	///
+	int Submit(
+		std::function<void(bool)> task,
+		std::function<bool()> cancelled = nullptr
+	) noexcept;
+
+
+	/// @brief stop accepting tasks, call the queued ones as cancelled and
+	///		wait for workers
+	///
+	void Stop() noexcept;
+
+
+	/// @brief get the metrics of executor
+	/// @returns copy of metrics
+	///
+	ScalerExecutorMetrics Metrics() const noexcept;
+
+private:
+
+	struct Task {
+		std::function<void(bool)> run;
+		std::function<bool()> cancelled;
+		std::chrono::steady_clock::time_point submit_time;
+	};
+
+
+	/// @brief worker thread
+	///
+	void Work() noexcept;
+
+	size_t queue_size_;
+	std::vector<std::thread> workers_;
+
+	// queue and metrics, protected by mutex_
+	mutable std::mutex mutex_;
+	std::condition_variable condition_;
+	std::deque<Task> tasks_;
+	bool stopping_;
+	ScalerExecutorMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_EXECUTOR_H__
@@ -0,0 +1,285 @@
+#ifndef __SCALER_FILE_H__
+#define __SCALER_FILE_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+// seconds in one day, also rows in one day file
+const size_t kDaySeconds = 86400;
+// bytes of one row, i.e. scalers in one second
+const size_t kScalerRowSize = kMaxScalers * sizeof(uint32_t);
+// version of day file storing all scalers of one second together
+const uint8_t kScalerFileRowMajor = 1;
+// version of day file storing each scaler in a column of one block
+const uint8_t kScalerFileColumnMajor = 2;
+// seconds in one block of column major day file
+const size_t kScalerBlockSeconds = 3600;
+
+
+struct ScalerFileHeader {
+	uint8_t version;
+	uint8_t number;
+	uint16_t reserve1;
+	uint32_t reserve2;
+};
+
+// size of the whole day file
+const size_t kScalerFileSize = sizeof(ScalerFileHeader) + kDaySeconds * kScalerRowSize;
+
+
+/// @brief construct file name
+/// @param[in] data_path data stored path, ends with '/'
+/// @param[in] device_name device name
+/// @param[in] date c style date
+/// @returns file name
+///
+std::string ScalerFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept;
+
+
+/// @brief create a file with header and zero space up to size
+/// @details The file is written under name.tmp and only appears under name
+///		after it has the full size, so a failure, e.g. the disk is full,
+///		never leaves a short file that blocks creating it again. All blocks
+///		are allocated, by writing zeros if the file system can't reserve
+///		them, so writing through shared mapping never runs out of space.
+/// @param[in] name file name
+/// @param[in] header header at the beginning of file
+/// @param[in] header_size bytes of header
+/// @param[in] size bytes of the whole file
+/// @returns 0 on success or if the file exists, -1 on failure
+///
+int CreateSizedFile(
+	const std::string &name,
+	const void *header,
+	size_t header_size,
+	size_t size
+) noexcept;
+
+
+/// @brief allocate the blocks of an existing file, e.g. a sparse one created
+///		by older versions, the content is kept
+/// @param[in] name file name
+/// @returns 0 on success, -1 on failure
+///
+int AllocateFile(const std::string &name) noexcept;
+
+
+/// @brief get the date key of c style date
+/// @param[in] date c style date
+/// @returns date key in form of YYYYMMDD
+///
+inline int DateKey(const tm *date) noexcept {
+	return (date->tm_year + 1900) * 10000 + (date->tm_mon + 1) * 100
+		+ date->tm_mday;
+}
+
+
+/// @brief get the second in day of c style time
+/// @param[in] time c style time
+/// @returns seconds from the start of the day
+///
+inline size_t DaySecond(const tm *time) noexcept {
+	return size_t((time->tm_hour * 60 + time->tm_min) * 60 + time->tm_sec);
+}
+
+
+/**
+ * ScalerFile is a day file of scaler values mapped in memory. The file
+ * includes a header and 86400 * kMaxScalers values. Values are read and
+ * written through the mapping directly.
+ *
+ * The layout depends on the version in header. Version 1 is row major, each
+ * row stores kMaxScalers values of one second. Version 2 is column major,
+ * the day is split into blocks of kScalerBlockSeconds, and each block stores
+ * the values of one scaler continuously, then the next scaler. Reading a few
+ * scalers from version 2 touches only their columns. Both versions have the
+ * same file size.
+ *
+ */
+class ScalerFile {
+public:
+
+	/// @brief constructor
+	///
+	ScalerFile() noexcept;
+
+
+	/// @brief destructor, unmap and close the file
+	///
+	~ScalerFile() noexcept;
+
+
+	ScalerFile(const ScalerFile&) = delete;
+	ScalerFile& operator=(const ScalerFile&) = delete;
+
+
+	/// @brief create a new day file with header and zero values
+	/// @note The blocks of the whole file are allocated, so the disk being
+	///		full fails here instead of writing rows later.
+	/// @param[in] name file name
+	/// @param[in] version layout version of the file
+	/// @returns 0 on success, -1 on failure
+	///
+	static int Create(
+		const std::string &name,
+		uint8_t version = kScalerFileRowMajor
+	) noexcept;
+
+
+	/// @brief convert the layout of a day file, the file should not be
+	///		opened by others
+	/// @param[in] name file name
+	/// @param[in] version layout version to convert to
+	/// @returns 0 on success, -1 on failure, -2 if file not exists
+	///
+	static int Convert(const std::string &name, uint8_t version) noexcept;
+
+
+	/// @brief open and map the day file
+	/// @param[in] name file name
+	/// @param[in] writable whether to map the file writable
+	/// @param[in] create create the file if not exists, only for writable
+	/// @param[in] version layout version when creating the file, existing
+	///		files are opened in their own version
+	/// @returns 0 on success, -1 on failure, -2 if file not exists
+	///
+	int Open(
+		const std::string &name,
+		bool writable,
+		bool create,
+		uint8_t version = kScalerFileRowMajor
+	) noexcept;
+
+
+	/// @brief unmap and close the file
+	///
+	void Close() noexcept;
+
+
+	/// @brief check whether the file is open
+	/// @returns true if open, false otherwise
+	///
+	inline bool IsOpen() const noexcept {
+		return map_ != nullptr;
+	}
+
+
+	/// @brief check whether the file is mapped writable
+	/// @returns true if writable, false otherwise
+	///
+	inline bool Writable() const noexcept {
+		return writable_;
+	}
+
+
+	/// @brief get the layout version
+	/// @returns kScalerFileRowMajor or kScalerFileColumnMajor
+	///
+	inline uint8_t Version() const noexcept {
+		return version_;
+	}
+
+
+	/// @brief get the row of specific second, only for row major file
+	/// @param[in] second second in this day, less than kDaySeconds
+	/// @returns pointer to the kMaxScalers values in this second
+	///
+	inline const uint32_t* Row(size_t second) const noexcept {
+		return rows_ + second * kMaxScalers;
+	}
+
+
+	/// @brief get the writable row of specific second, only for row major file
+	/// @param[in] second second in this day, less than kDaySeconds
+	/// @returns pointer to the kMaxScalers values, only valid when writable
+	///
+	inline uint32_t* MutableRow(size_t second) noexcept {
+		return rows_ + second * kMaxScalers;
+	}
+
+
+	/// @brief get the column of one scaler from specific second, only for
+	///		column major file
+	/// @param[in] second second in this day, less than kDaySeconds
+	/// @param[in] index index of scaler
+	/// @returns pointer to continuous values of the scaler from this second
+	///		to the end of its block
+	///
+	inline const uint32_t* Column(size_t second, size_t index) const noexcept {
+		size_t block = second / kScalerBlockSeconds;
+		return rows_ + (block * kMaxScalers + index) * kScalerBlockSeconds
+			+ second % kScalerBlockSeconds;
+	}
+
+
+	/// @brief copy values of one second in any version
+	/// @param[in] second second in this day, less than kDaySeconds
+	/// @param[out] values kMaxScalers values of this second
+	///
+	inline void ReadRow(size_t second, uint32_t *values) const noexcept {
+		if (version_ == kScalerFileRowMajor) {
+			memcpy(values, Row(second), kScalerRowSize);
+		} else {
+			const uint32_t *column = Column(second, 0);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				values[i] = column[i * kScalerBlockSeconds];
+			}
+		}
+	}
+
+
+	/// @brief write values of one second in any version
+	/// @param[in] second second in this day, less than kDaySeconds
+	/// @param[in] values kMaxScalers values to write, only valid when writable
+	///
+	inline void WriteRow(size_t second, const uint32_t *values) noexcept {
+		if (version_ == kScalerFileRowMajor) {
+			memcpy(MutableRow(second), values, kScalerRowSize);
+		} else {
+			uint32_t *column = const_cast<uint32_t*>(Column(second, 0));
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				column[i * kScalerBlockSeconds] = values[i];
+			}
+		}
+	}
+
+
+	/// @brief flush the rows to file
+	/// @param[in] first first row to flush
+	/// @param[in] last last row to flush (included)
+	/// @param[in] wait wait for the writing finishes
+	/// @returns 0 on success, -1 on failure
+	///
+	int Sync(size_t first, size_t last, bool wait) noexcept;
+
+
+	/// @brief get the file name
+	/// @returns file name
+	///
+	inline const std::string& Name() const noexcept {
+		return name_;
+	}
+
+private:
+	std::string name_;
+	int fd_;
+	bool writable_;
+	uint8_t version_;
+	uint8_t *map_;
+	uint32_t *rows_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_FILE_H__
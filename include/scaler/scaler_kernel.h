@@ -0,0 +1,101 @@
+#ifndef __SCALER_KERNEL_H__
+#define __SCALER_KERNEL_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+struct ScalerReduction {
+	// sums of each scaler
+	uint64_t sum[kMaxScalers];
+	// minimum of each scaler
+	uint32_t min[kMaxScalers];
+	// maximum of each scaler
+	uint32_t max[kMaxScalers];
+	// values in the last row
+	uint32_t last[kMaxScalers];
+	// number of reduced rows
+	size_t count;
+
+	ScalerReduction() noexcept {
+		Reset();
+	}
+
+	/// @brief clear all reduced rows
+	///
+	void Reset() noexcept;
+};
+
+
+/// @brief name of the instruction set used by kernels
+/// @returns "sse4.1", "sse2", "neon" or "scalar"
+///
+const char* ScalerKernelName() noexcept;
+
+
+/// @brief add rows of scalers to sums
+/// @param[in] rows count rows, each has kMaxScalers values, rows are
+///		continuous in memory and need not be aligned
+/// @param[in] count number of rows
+/// @param[inout] sums kMaxScalers sums, the sums of rows are added to it
+///
+void SumRows(const uint32_t *rows, size_t count, uint64_t *sums) noexcept;
+
+
+/// @brief reduce rows of scalers to sum, minimum, maximum and last values
+/// @param[in] rows count rows, each has kMaxScalers values, rows are
+///		continuous in memory and need not be aligned
+/// @param[in] count number of rows
+/// @param[inout] reduction reduction to update
+///
+void ReduceRows(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept;
+
+
+/// @brief reduce continuous values of one scaler
+/// @param[in] values count values of the scaler, need not be aligned
+/// @param[in] count number of values
+/// @param[in] index index of the scaler
+/// @param[inout] reduction reduction to update, only sum, min, max and last
+///		of this scaler are updated, and count is left to caller
+///
+void ReduceColumn(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept;
+
+
+/// @brief the same as SumRows without SIMD, for checking and benchmark
+///
+void SumRowsScalar(const uint32_t *rows, size_t count, uint64_t *sums) noexcept;
+
+
+/// @brief the same as ReduceRows without SIMD, for checking and benchmark
+///
+void ReduceRowsScalar(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept;
+
+
+/// @brief the same as ReduceColumn without SIMD, for checking and benchmark
+///
+void ReduceColumnScalar(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept;
+
+}	// namespace ecl
+
+#endif	// __SCALER_KERNEL_H__
@@ -0,0 +1,185 @@
+#ifndef __SCALER_LOAD_H__
+#define __SCALER_LOAD_H__
+
+#include <ctime>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+enum LoadKind {
+	kConstantLoad = 0,
+	kPoissonLoad,
+	kBurstLoad,
+	kRampLoad,
+	kDropoutLoad
+};
+
+
+const char* const kLoadKindName[5] = {
+	"constant",
+	"poisson",
+	"burst",
+	"ramp",
+	"dropout"
+};
+
+
+struct LoadModel {
+	LoadKind kind;
+	// counts per second
+	double rate;
+	// counts per second in bursts, or at the end of ramps
+	double peak;
+	// seconds of one cycle of bursts, ramps or dropouts
+	uint32_t period;
+	// seconds of each burst or dropout at the beginning of cycles
+	uint32_t length;
+
+	LoadModel() {
+		kind = kPoissonLoad;
+		rate = 1000.0;
+		peak = 10000.0;
+		period = 60;
+		length = 5;
+	}
+};
+
+
+/// @brief parse model of one channel
+/// @details The format is kind:key=value,key=value..., e.g.
+///		"burst:rate=100,peak=5000,period=60,length=5", keys are rate, peak,
+///		period and length, and missing keys keep the defaults.
+/// @param[in] text text to parse
+/// @param[out] model parsed model
+/// @returns 0 on success, -1 on invalid text
+///
+int ParseLoadModel(const std::string &text, LoadModel &model) noexcept;
+
+
+struct ScalerLoadOption {
+	// samples per second
+	double rate;
+	// channel i follows models[i % size], empty for Poisson of 1000 per second
+	std::vector<LoadModel> models;
+	// second of the first sample, 0 for now
+	time_t start;
+	// seed of random counts, 0 takes a random seed
+	uint32_t seed;
+
+	ScalerLoadOption() {
+		rate = 1000.0;
+		start = 0;
+		seed = 0;
+	}
+};
+
+
+struct ScalerLoadMetrics {
+	// samples generated
+	uint64_t samples;
+	// samples started one interval or more after their deadline
+	uint64_t late;
+	// samples skipped after falling behind more than one second
+	uint64_t skipped;
+	// maximum lateness from the deadline in microseconds
+	uint64_t max_lateness_us;
+};
+
+
+/**
+ * ScalerLoad generates scaler values of virtual seconds much faster than
+ * the real time, to find the limits of storage, rollups and subscriptions.
+ * Every sample is the next second after the previous one, so at 1000
+ * samples per second one day of values is written in less than 2 minutes.
+ *
+ * Each channel follows its own model, constant counts, Poisson counts,
+ * periodic bursts of a higher rate, periodic ramps from rate to peak, or
+ * periodic dropouts to zero. The cycles are counted in virtual seconds from
+ * the first sample.
+ *
+ * Samples are taken in a dedicated thread on deadlines of the monotonic
+ * clock. If the sampling function is slower than the rate, the samples run
+ * back to back and are counted late, and falling behind more than one real
+ * second skips the deadlines in between.
+ *
+ */
+class ScalerLoad {
+public:
+
+	/// @brief constructor
+	/// @param[in] option load options
+	/// @param[in] sample function called with the second and values
+	///
+	ScalerLoad(
+		const ScalerLoadOption &option,
+		std::function<void(time_t, const uint32_t*)> sample
+	) noexcept;
+
+
+	/// @brief destructor, stop the thread
+	///
+	~ScalerLoad() noexcept;
+
+
+	ScalerLoad(const ScalerLoad&) = delete;
+	ScalerLoad& operator=(const ScalerLoad&) = delete;
+
+
+	/// @brief start the load thread
+	/// @returns 0 on success, -1 on invalid rate
+	///
+	int Start() noexcept;
+
+
+	/// @brief stop the load thread and wait for it
+	///
+	void Stop() noexcept;
+
+
+	/// @brief generate values of one second
+	/// @param[in] second virtual second of the values
+	/// @param[out] values kMaxScalers values
+	///
+	void Generate(time_t second, uint32_t *values) noexcept;
+
+
+	/// @brief get the metrics of load
+	/// @returns copy of metrics
+	///
+	ScalerLoadMetrics Metrics() const noexcept;
+
+private:
+
+	/// @brief load thread
+	///
+	void Loop() noexcept;
+
+	double rate_;
+	std::vector<LoadModel> models_;
+	time_t start_;
+	std::mt19937_64 engine_;
+	std::function<void(time_t, const uint32_t*)> sample_;
+
+	std::thread thread_;
+	std::mutex stop_mutex_;
+	std::condition_variable stop_condition_;
+	bool stop_;
+
+	// metrics, protected by metrics_mutex_
+	mutable std::mutex metrics_mutex_;
+	ScalerLoadMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_LOAD_H__
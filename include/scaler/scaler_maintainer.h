@@ -0,0 +1,168 @@
+#ifndef __SCALER_MAINTAINER_H__
+#define __SCALER_MAINTAINER_H__
+
+#include <ctime>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ecl {
+
+struct ScalerMaintainerOption {
+	// scaler data stored path
+	std::string data_path;
+	// device name to distinguish different device
+	std::string device_name;
+	// archive day files older than days, 0 disables
+	int archive_days;
+	// remove scaler values older than days and keep the rollups, 0 disables
+	int retention_days;
+	// maximum bytes of all files of the device on disk, 0 disables
+	uint64_t disk_budget;
+	// seconds between two passes, 0 only runs passes by calling RunOnce
+	int interval;
+	// maximum bytes read and written per second, 0 disables throttling
+	uint64_t io_rate;
+	// print every removed or archived file
+	bool verbose;
+
+	ScalerMaintainerOption() {
+		data_path = "./";
+		device_name = "";
+		archive_days = 0;
+		retention_days = 0;
+		disk_budget = 0;
+		interval = 3600;
+		io_rate = 2 * 1024 * 1024;
+		verbose = false;
+	}
+};
+
+
+struct ScalerMaintainerMetrics {
+	// finished passes
+	uint64_t passes;
+	// day files archived
+	uint64_t archived_files;
+	// days whose scaler values are removed for retention
+	uint64_t dropped_days;
+	// files removed to keep within the disk budget
+	uint64_t budget_removed_files;
+	// total bytes freed on disk
+	uint64_t freed_bytes;
+	// bytes of all files on disk after the last pass
+	uint64_t used_bytes;
+	// duration of the last pass in microseconds
+	uint64_t last_pass_us;
+	// total time sleeping for throttling in microseconds
+	uint64_t throttled_us;
+	// failed operations
+	uint64_t failures;
+};
+
+
+/**
+ * ScalerMaintainer keeps the scaler data of one device within limits by
+ * passes in a background thread. Each pass
+ *   1. removes the day files, archives and prefix files older than the
+ *      retention days, while the rollup files are kept, so long range
+ *      averages aligned to rollup buckets are still available,
+ *   2. archives the day files older than the archive days,
+ *   3. removes the oldest files until all files fit in the disk budget,
+ *      scaler values first and then rollups.
+ *
+ * Files of today and yesterday are never touched, so the writer and the
+ * prepared file of the next day are left alone.
+ *
+ * The thread runs with the lowest CPU and idle I/O priority, and reading
+ * and writing are throttled to the I/O rate, so the disk is free for the
+ * writer every second. Readers holding mapped files removed by the pass keep
+ * reading them until unmapped.
+ *
+ */
+class ScalerMaintainer {
+public:
+
+	/// @brief constructor, start the background thread if interval is not 0
+	/// @param[in] option maintainer options
+	///
+	ScalerMaintainer(const ScalerMaintainerOption &option) noexcept;
+
+
+	/// @brief destructor, stop the background thread
+	///
+	~ScalerMaintainer() noexcept;
+
+
+	ScalerMaintainer(const ScalerMaintainer&) = delete;
+	ScalerMaintainer& operator=(const ScalerMaintainer&) = delete;
+
+
+	/// @brief run one pass in the calling thread
+	/// @param[in] now current time, decides the days to keep
+	/// @returns 0 on success, -1 if any operation failed, -3 if stopped
+	///
+	int RunOnce(time_t now) noexcept;
+
+
+	/// @brief get the metrics of maintainer
+	/// @returns copy of metrics
+	///
+	ScalerMaintainerMetrics Metrics() const noexcept;
+
+private:
+
+	/// @brief background thread running passes
+	///
+	void Loop() noexcept;
+
+
+	/// @brief sleep to keep the I/O of this pass under the rate
+	/// @param[in] bytes bytes read or written just now
+	/// @returns true if stopped
+	///
+	bool Throttle(size_t bytes) noexcept;
+
+
+	/// @brief remove one file and count the freed bytes
+	/// @param[in] name file name
+	/// @param[in] bytes bytes of the file on disk
+	/// @returns 0 on success, -1 on failure
+	///
+	int Remove(const std::string &name, uint64_t bytes) noexcept;
+
+
+	/// @brief add failures to metrics
+	///
+	void Fail() noexcept;
+
+	std::string data_path_;
+	std::string device_name_;
+	int archive_days_;
+	int retention_days_;
+	uint64_t disk_budget_;
+	int interval_;
+	uint64_t io_rate_;
+	bool verbose_;
+
+	// I/O of the current pass, only accessed in pass
+	std::chrono::steady_clock::time_point pass_start_;
+	uint64_t pass_bytes_;
+
+	std::thread thread_;
+	std::mutex stop_mutex_;
+	std::condition_variable stop_cond_;
+	bool stop_;
+
+	// metrics, protected by metrics_mutex_
+	mutable std::mutex metrics_mutex_;
+	ScalerMaintainerMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_MAINTAINER_H__
@@ -0,0 +1,168 @@
+#ifndef __SCALER_PREFIX_H__
+#define __SCALER_PREFIX_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "scaler/scaler_file.h"
+
+namespace ecl {
+
+struct ScalerPrefixHeader {
+	uint8_t version;
+	uint8_t number;
+	// set while the file is opened for writing, left set after crash
+	uint8_t dirty;
+	uint8_t reserve;
+	// prefix sums of seconds before this are filled
+	uint32_t filled;
+};
+
+// size of the whole prefix file
+const size_t kScalerPrefixFileSize = sizeof(ScalerPrefixHeader)
+	+ kDaySeconds * kMaxScalers * sizeof(uint64_t);
+
+
+/// @brief construct prefix file name
+/// @param[in] data_path data stored path, ends with '/'
+/// @param[in] device_name device name
+/// @param[in] date c style date
+/// @returns file name
+///
+std::string ScalerPrefixFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept;
+
+
+/**
+ * ScalerPrefix is the companion file of a day file, keeping the cumulative
+ * sums of each scaler from the start of the day. The sum of any range of
+ * seconds is the difference of two prefix sums.
+ *
+ * Only the prefix sums before the filled second are written. Seconds after
+ * it are never written in the day file, so their prefix sums equal the last
+ * filled one. Writing forward in time fills the prefix sums up to the
+ * written second, and rewriting a filled second updates all prefix sums
+ * after it.
+ *
+ * Like the rollup, the dirty flag is left in header if the process stops
+ * without closing the file, and the prefix sums are rebuilt from the day
+ * file when opened for writing next time.
+ *
+ */
+class ScalerPrefix {
+public:
+
+	/// @brief constructor
+	///
+	ScalerPrefix() noexcept;
+
+
+	/// @brief destructor, unmap and close the file
+	///
+	~ScalerPrefix() noexcept;
+
+
+	ScalerPrefix(const ScalerPrefix&) = delete;
+	ScalerPrefix& operator=(const ScalerPrefix&) = delete;
+
+
+	/// @brief create a new prefix file with nothing filled
+	/// @param[in] name file name
+	/// @returns 0 on success, -1 on failure
+	///
+	static int Create(const std::string &name) noexcept;
+
+
+	/// @brief open and map the prefix file
+	/// @param[in] name file name
+	/// @param[in] day the day file of this prefix, rebuild prefix sums from it
+	///		if the prefix file is new or dirty, only for writable
+	/// @param[in] writable whether to map the file writable
+	/// @returns 0 on success, -1 on failure, -2 if file not exists
+	///
+	int Open(
+		const std::string &name,
+		const ScalerFile *day,
+		bool writable
+	) noexcept;
+
+
+	/// @brief flush, clear dirty flag, unmap and close the file
+	///
+	void Close() noexcept;
+
+
+	/// @brief recalculate all prefix sums from the day file
+	/// @param[in] day the day file
+	/// @returns 0 on success, -1 on failure
+	///
+	int Build(const ScalerFile &day) noexcept;
+
+
+	/// @brief check whether prefix sums are consistent with the day file
+	/// @returns true if the file is open and could be read
+	///
+	inline bool Valid() const noexcept {
+		return map_ != nullptr && (writable_ || !Header()->dirty);
+	}
+
+
+	/// @brief get the sums of seconds before the specific second
+	/// @param[in] second end of the seconds (excluded), not larger than
+	///		kDaySeconds
+	/// @param[out] sums kMaxScalers sums of seconds in [0, second)
+	///
+	inline void Before(size_t second, uint64_t *sums) const noexcept {
+		size_t filled = Header()->filled;
+		if (second > filled) second = filled;
+		if (second == 0) {
+			for (size_t i = 0; i < kMaxScalers; ++i) sums[i] = 0;
+		} else {
+			memcpy(sums, prefix_ + (second-1) * kMaxScalers, kMaxScalers * sizeof(uint64_t));
+		}
+	}
+
+
+	/// @brief update the prefix sums with changed row
+	/// @param[in] second second of the changed row
+	/// @param[in] old_row values before changed
+	/// @param[in] new_row values after changed
+	///
+	void Update(
+		size_t second,
+		const uint32_t *old_row,
+		const uint32_t *new_row
+	) noexcept;
+
+
+	/// @brief flush the updated prefix sums to file
+	/// @param[in] wait wait for the writing finishes
+	/// @returns 0 on success, -1 on failure
+	///
+	int Sync(bool wait) noexcept;
+
+private:
+
+	inline ScalerPrefixHeader* Header() const noexcept {
+		return (ScalerPrefixHeader*)map_;
+	}
+
+	std::string name_;
+	int fd_;
+	bool writable_;
+	uint8_t *map_;
+	uint64_t *prefix_;
+	// seconds updated but not synced
+	size_t dirty_first_;
+	size_t dirty_last_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_PREFIX_H__
@@ -0,0 +1,163 @@
+#ifndef __SCALER_PUBLISHER_H__
+#define __SCALER_PUBLISHER_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+
+#include "config/memory.h"
+
+namespace ecl {
+
+struct ScalerUpdate {
+	// unix time of the sample
+	int64_t time;
+	// bit i is set if values include scaler i
+	uint32_t mask;
+	// number of values
+	size_t size;
+	// values of scalers in mask, in order of index
+	uint32_t values[kMaxScalers];
+	// updates dropped for this subscriber before this one
+	uint64_t dropped;
+};
+
+
+/**
+ * ScalerSubscription is the queue of updates for one subscriber. Updates are
+ * pushed by the publisher and popped by the subscriber. If the subscriber is
+ * too slow and the queue is full, new updates are dropped and counted.
+ *
+ */
+class ScalerSubscription {
+public:
+
+	/// @brief constructor
+	/// @param[in] flag bit i is set to subscribe scaler i
+	/// @param[in] period receive one update every period samples
+	/// @param[in] delta only include scalers changed since last update
+	/// @param[in] capacity maximum updates in queue
+	///
+	ScalerSubscription(
+		uint32_t flag,
+		int period,
+		bool delta,
+		size_t capacity
+	) noexcept;
+
+
+	/// @brief pop the first update in queue
+	/// @param[out] update the popped update
+	/// @returns true if popped, false if queue is empty
+	///
+	bool Pop(ScalerUpdate &update) noexcept;
+
+
+	/// @brief get total dropped updates
+	/// @returns dropped updates
+	///
+	uint64_t Dropped() const noexcept;
+
+private:
+	friend class ScalerPublisher;
+
+	/// @brief push the sample to queue
+	/// @param[in] time unix time of sample
+	/// @param[in] scalers kMaxScalers values
+	///
+	void Offer(int64_t time, const uint32_t *scalers) noexcept;
+
+	// options, read only
+	uint32_t flag_;
+	int period_;
+	bool delta_;
+	size_t capacity_;
+
+	// accessed by publisher only
+	int countdown_;
+	bool need_full_;
+	uint32_t last_[kMaxScalers];
+	std::function<void()> notifier_;
+
+	// queue, protected by mutex
+	mutable std::mutex mutex_;
+	std::deque<ScalerUpdate> queue_;
+	uint64_t dropped_;
+};
+
+
+/**
+ * ScalerPublisher delivers every sample of scalers to all subscribers. The
+ * sampler publishes once and never waits for subscribers.
+ *
+ */
+class ScalerPublisher {
+public:
+
+	/// @brief constructor
+	/// @param[in] capacity maximum queued updates of each subscriber
+	///
+	ScalerPublisher(size_t capacity = 16) noexcept;
+
+
+	/// @brief add a subscriber
+	/// @param[in] flag bit i is set to subscribe scaler i
+	/// @param[in] period receive one update every period samples
+	/// @param[in] delta only include scalers changed since last update
+	/// @param[in] notifier function called after update is pushed, it is
+	///		called in the publishing thread and must not block or call the
+	///		publisher
+	/// @returns subscription
+	///
+	std::shared_ptr<ScalerSubscription> Subscribe(
+		uint32_t flag,
+		int period,
+		bool delta,
+		std::function<void()> notifier = nullptr
+	) noexcept;
+
+
+	/// @brief remove the subscriber
+	/// @note After returning, the notifier of the subscription is not called
+	///		any more.
+	/// @param[in] subscription subscription to remove
+	///
+	void Unsubscribe(
+		const std::shared_ptr<ScalerSubscription> &subscription
+	) noexcept;
+
+
+	/// @brief publish sample to all subscribers
+	/// @param[in] time unix time of sample
+	/// @param[in] scalers kMaxScalers values
+	///
+	void Publish(time_t time, const uint32_t *scalers) noexcept;
+
+
+	/// @brief get number of subscribers
+	/// @returns number of subscribers
+	///
+	size_t Subscribers() const noexcept;
+
+
+	/// @brief get dropped updates of all subscribers, including removed ones
+	/// @returns dropped updates
+	///
+	uint64_t Dropped() const noexcept;
+
+private:
+	size_t capacity_;
+	mutable std::mutex mutex_;
+	std::list<std::shared_ptr<ScalerSubscription>> subscriptions_;
+	// dropped updates of removed subscribers
+	uint64_t removed_dropped_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_PUBLISHER_H__
@@ -0,0 +1,82 @@
+#ifndef __SCALER_QUERY_H__
+#define __SCALER_QUERY_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "scaler/scaler_executor.h"
+#include "scaler/scaler_storage.h"
+
+namespace ecl {
+
+enum ScalerAggregation {
+	kAggregateMean = 0,
+	kAggregateMin,
+	kAggregateMax,
+	kAggregateSum,
+	kAggregateLast
+};
+
+// maximum points (buckets times scalers times aggregations) in one query
+const size_t kMaxQueryPoints = 1 << 20;
+// maximum days in one query
+const time_t kMaxQueryDays = 366;
+// maximum threads reading day files in one query
+const size_t kMaxQueryThreads = 4;
+
+
+struct ScalerQueryOption {
+	// unix time of the first second
+	time_t start_time;
+	// unix time after the last second
+	time_t end_time;
+	// seconds of each bucket
+	int step;
+	// bit i is set to query scaler i
+	uint32_t flag;
+	// aggregations of each bucket
+	std::vector<ScalerAggregation> aggregations;
+};
+
+
+struct ScalerQuerySeries {
+	// index of scaler
+	int index;
+	// aggregation function
+	ScalerAggregation aggregation;
+	// value of each bucket, NaN if there is no data in bucket
+	std::vector<double> values;
+};
+
+
+/// @brief query scalers in time range and aggregate in buckets
+/// @details The range is split by days, and day files are read in parallel
+///		by this thread and up to kMaxQueryThreads-1 helpers in executor.
+///		Buckets start from start_time and the last one may be shorter. Seconds
+///		in missing day files and seconds after the last written one are not
+///		counted. Sums and means are read from rollup if possible.
+/// @param[in] storage storage of day files
+/// @param[in] option query range, step, scalers and aggregations
+/// @param[in] cancelled return true to stop querying, could be nullptr,
+///		called by helpers as well
+/// @param[out] series results of each scaler and aggregation, ordered by
+///		scaler index and then by aggregations in option, duplicate
+///		aggregations are returned once
+/// @param[in] executor runs helpers reading day files, nullptr reads them
+///		all in this thread
+/// @returns 0 on success, -1 on invalid option, -3 if cancelled
+///
+int QueryScalers(
+	const ScalerStorage &storage,
+	const ScalerQueryOption &option,
+	const std::function<bool()> &cancelled,
+	std::vector<ScalerQuerySeries> &series,
+	ScalerExecutor *executor = nullptr
+) noexcept;
+
+}	// namespace ecl
+
+#endif	// __SCALER_QUERY_H__
@@ -0,0 +1,85 @@
+#ifndef __SCALER_RING_H__
+#define __SCALER_RING_H__
+
+#include <ctime>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "scaler/scaler_storage.h"
+
+namespace ecl {
+
+/**
+ * ScalerRing keeps the scaler values of the last day in memory. Each slot
+ * holds one second, and the slot of a second is reused one day later.
+ *
+ * There is only one writer. Readers never lock, each slot is stamped with its
+ * second, and readers check the stamp before and after copying the values.
+ * Seconds not in the ring read as zero, the same as unwritten rows in day
+ * files.
+ *
+ */
+class ScalerRing {
+public:
+
+	/// @brief constructor, allocate all slots
+	///
+	ScalerRing() noexcept;
+
+
+	ScalerRing(const ScalerRing&) = delete;
+	ScalerRing& operator=(const ScalerRing&) = delete;
+
+
+	/// @brief write scaler values of one second
+	/// @param[in] time the second to write
+	/// @param[in] scalers kMaxScalers values to write
+	///
+	void Push(time_t time, const uint32_t *scalers) noexcept;
+
+
+	/// @brief read scaler values of one second
+	/// @param[in] time the second to read
+	/// @param[out] scalers kMaxScalers values, zero if not in ring
+	/// @returns true if the second is in ring, false otherwise
+	///
+	bool Read(time_t time, uint32_t *scalers) const noexcept;
+
+
+	/// @brief sum scaler values of continuous seconds
+	/// @param[in] time the first second to sum
+	/// @param[in] size number of seconds to sum
+	/// @param[inout] sums kMaxScalers sums, the sums of values are added to it
+	///
+	void Sum(time_t time, size_t size, uint64_t *sums) const noexcept;
+
+
+	/// @brief fill the ring with values of last day from files
+	/// @param[in] storage storage of day files
+	/// @param[in] now current time, load seconds in (now-kDaySeconds, now)
+	/// @returns number of seconds loaded from files
+	///
+	size_t Load(const ScalerStorage &storage, time_t now) noexcept;
+
+private:
+
+	struct alignas(64) Slot {
+		uint32_t values[kMaxScalers];
+	};
+
+	struct FreeDeleter {
+		void operator()(void *pointer) const noexcept;
+	};
+
+	// stamp of the slot under writing or never written
+	static const int64_t kEmptyStamp = -1;
+
+	std::unique_ptr<Slot[], FreeDeleter> slots_;
+	std::unique_ptr<std::atomic<int64_t>[]> stamps_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_RING_H__
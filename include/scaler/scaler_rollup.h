@@ -0,0 +1,158 @@
+#ifndef __SCALER_ROLLUP_H__
+#define __SCALER_ROLLUP_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <string>
+
+#include "scaler/scaler_file.h"
+
+namespace ecl {
+
+// number of rollup tiers
+const size_t kRollupTiers = 5;
+// seconds of one bucket in each tier, from the finest to the coarsest
+const size_t kRollupTierSeconds[kRollupTiers] = {10, 60, 720, 3600, 86400};
+
+
+struct ScalerRollupHeader {
+	uint8_t version;
+	uint8_t number;
+	uint8_t tiers;
+	// set while the file is opened for writing, left set after crash
+	uint8_t dirty;
+	uint32_t reserve;
+};
+
+// size of the whole rollup file
+const size_t kScalerRollupFileSize = sizeof(ScalerRollupHeader)
+	+ (8640 + 1440 + 120 + 24 + 1) * kMaxScalers * sizeof(uint64_t);
+
+
+/// @brief construct rollup file name
+/// @param[in] data_path data stored path, ends with '/'
+/// @param[in] device_name device name
+/// @param[in] date c style date
+/// @returns file name
+///
+std::string ScalerRollupFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept;
+
+
+/**
+ * ScalerRollup is the companion file of a day file, keeping the sums of
+ * scaler values in buckets of several tiers. Each bucket stores kMaxScalers
+ * sums of the seconds in it. Coarse queries read the buckets instead of
+ * every second of the day.
+ *
+ * The rollup file is updated with the day file. If the process stops without
+ * closing the file, the dirty flag is left in the header, and the rollup is
+ * rebuilt from the day file when opened for writing next time.
+ *
+ */
+class ScalerRollup {
+public:
+
+	/// @brief constructor
+	///
+	ScalerRollup() noexcept;
+
+
+	/// @brief destructor, unmap and close the file
+	///
+	~ScalerRollup() noexcept;
+
+
+	ScalerRollup(const ScalerRollup&) = delete;
+	ScalerRollup& operator=(const ScalerRollup&) = delete;
+
+
+	/// @brief create a new rollup file with all sums zero
+	/// @param[in] name file name
+	/// @returns 0 on success, -1 on failure
+	///
+	static int Create(const std::string &name) noexcept;
+
+
+	/// @brief open and map the rollup file
+	/// @param[in] name file name
+	/// @param[in] day the day file of this rollup, rebuild rollup from it if
+	///		the rollup file is new or dirty, only for writable
+	/// @param[in] writable whether to map the file writable
+	/// @returns 0 on success, -1 on failure, -2 if file not exists
+	///
+	int Open(
+		const std::string &name,
+		const ScalerFile *day,
+		bool writable
+	) noexcept;
+
+
+	/// @brief flush, clear dirty flag, unmap and close the file
+	///
+	void Close() noexcept;
+
+
+	/// @brief recalculate all buckets from the day file
+	/// @param[in] day the day file
+	/// @returns 0 on success, -1 on failure
+	///
+	int Build(const ScalerFile &day) noexcept;
+
+
+	/// @brief check whether sums are consistent with the day file
+	/// @returns true if the file is open and could be read
+	///
+	inline bool Valid() const noexcept {
+		return map_ != nullptr && (writable_ || !Header()->dirty);
+	}
+
+
+	/// @brief get the bucket of tier
+	/// @param[in] tier index of tier
+	/// @param[in] index index of bucket in this tier
+	/// @returns pointer to kMaxScalers sums of this bucket
+	///
+	inline const uint64_t* Bucket(size_t tier, size_t index) const noexcept {
+		return tiers_[tier] + index * kMaxScalers;
+	}
+
+
+	/// @brief update the buckets covering the second with changed row
+	/// @param[in] second second of the changed row
+	/// @param[in] old_row values before changed
+	/// @param[in] new_row values after changed
+	///
+	void Update(
+		size_t second,
+		const uint32_t *old_row,
+		const uint32_t *new_row
+	) noexcept;
+
+
+	/// @brief flush the sums to file
+	/// @param[in] wait wait for the writing finishes
+	/// @returns 0 on success, -1 on failure
+	///
+	int Sync(bool wait) noexcept;
+
+private:
+
+	inline ScalerRollupHeader* Header() const noexcept {
+		return (ScalerRollupHeader*)map_;
+	}
+
+	std::string name_;
+	int fd_;
+	bool writable_;
+	uint8_t *map_;
+	uint64_t *tiers_[kRollupTiers];
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_ROLLUP_H__
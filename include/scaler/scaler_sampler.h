@@ -0,0 +1,191 @@
+#ifndef __SCALER_SAMPLER_H__
+#define __SCALER_SAMPLER_H__
+
+#include <ctime>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace ecl {
+
+// upper bounds of lateness histogram buckets in microseconds, the last
+// bucket counts samples later than all bounds
+const size_t kLatenessBounds = 10;
+const uint64_t kLatenessBoundUs[kLatenessBounds] = {
+	50, 100, 200, 500, 1000, 2000, 5000, 10000, 50000, 100000
+};
+
+
+struct ScalerSamplerOption {
+	// SCHED_FIFO priority of the sampling thread, 0 keeps normal scheduling
+	int priority;
+	// CPU to pin the sampling thread to, -1 runs on any CPU
+	int cpu;
+	// UIO device fd to wait for interrupts, -1 samples by timer
+	int irq_fd;
+	// milliseconds without interrupt before falling back to timer
+	int irq_timeout;
+
+	ScalerSamplerOption() {
+		priority = 0;
+		cpu = -1;
+		irq_fd = -1;
+		irq_timeout = 3000;
+	}
+};
+
+
+struct ScalerSamplerMetrics {
+	// samples taken
+	uint64_t samples;
+	// seconds without sample because the previous sample took too long
+	uint64_t missed;
+	// times the system clock was set and the timer rearmed
+	uint64_t clock_changes;
+	// samples triggered by interrupts
+	uint64_t irq_samples;
+	// times falling back from interrupts to timer
+	uint64_t irq_fallbacks;
+	// maximum lateness from the second boundary in microseconds
+	uint64_t max_lateness_us;
+	// total lateness in microseconds
+	uint64_t total_lateness_us;
+	// samples in each lateness bucket
+	uint64_t lateness[kLatenessBounds + 1];
+};
+
+
+/**
+ * ScalerSampler calls the sampling function at every second boundary of the
+ * system clock, in a dedicated thread waiting on a timerfd with absolute
+ * CLOCK_REALTIME deadlines. The second passed to the function is the
+ * deadline, not the time it is called, so every sample gets its own slot
+ * even if it is late.
+ *
+ * With the UIO device fd, the thread waits for the interrupt raised when
+ * FPGA latches the scalers instead, so samples follow the counting window
+ * of hardware. The interrupt is enabled by writing 1 to the fd, and reading
+ * it returns the total number of interrupts. The second of each sample
+ * continues from the previous one by the interrupts passed, and follows the
+ * system clock again if they drift apart by more than one second, without
+ * going back to the seconds already sampled. Without
+ * any interrupt in the timeout, or if the interrupt could not be enabled,
+ * the sampler falls back to the timer.
+ *
+ * The thread could run with SCHED_FIFO priority and be pinned to one CPU,
+ * so threads serving queries never delay the samples. A sample later than
+ * a whole second, or a skipped interrupt, is counted as missed. The lateness
+ * of every timer sample, or the deviation of the interrupt period from one
+ * second, is recorded in a histogram.
+ *
+ */
+class ScalerSampler {
+public:
+
+	/// @brief constructor
+	/// @param[in] option sampler options
+	/// @param[in] sample function called with the second of each sample
+	///
+	ScalerSampler(
+		const ScalerSamplerOption &option,
+		std::function<void(time_t)> sample
+	) noexcept;
+
+
+	/// @brief destructor, stop the sampling thread
+	///
+	~ScalerSampler() noexcept;
+
+
+	ScalerSampler(const ScalerSampler&) = delete;
+	ScalerSampler& operator=(const ScalerSampler&) = delete;
+
+
+	/// @brief start the sampling thread
+	/// @returns 0 on success, -1 on failure
+	///
+	int Start() noexcept;
+
+
+	/// @brief stop the sampling thread and wait for it
+	///
+	void Stop() noexcept;
+
+
+	/// @brief get the metrics of sampler
+	/// @returns copy of metrics
+	///
+	ScalerSamplerMetrics Metrics() const noexcept;
+
+private:
+
+	/// @brief arm the timer at the next second boundary
+	/// @returns 0 on success, -1 on failure
+	///
+	int Arm() noexcept;
+
+
+	/// @brief enable the interrupt of UIO device
+	/// @returns 0 on success, -1 on failure
+	///
+	int EnableIrq() noexcept;
+
+
+	/// @brief stop waiting for interrupts and sample by timer
+	/// @returns 0 on success, -1 on failure
+	///
+	int FallBack() noexcept;
+
+
+	/// @brief sampling thread
+	///
+	void Loop() noexcept;
+
+
+	/// @brief handle expirations of timer
+	/// @returns 0 on success, -1 on failure
+	///
+	int OnTimer() noexcept;
+
+
+	/// @brief handle interrupt of UIO device
+	/// @returns 0 on success, -1 on failure
+	///
+	int OnIrq() noexcept;
+
+
+	/// @brief record lateness of one sample
+	/// @param[in] lateness lateness in microseconds
+	/// @param[in] missed seconds missed before this sample
+	///
+	void Record(uint64_t lateness, uint64_t missed) noexcept;
+
+	int priority_;
+	int cpu_;
+	std::function<void(time_t)> sample_;
+
+	// UIO device, -1 if sampled by timer
+	int irq_fd_;
+	int irq_timeout_;
+	// interrupt count and second of the last interrupt sample
+	uint32_t irq_count_;
+	time_t irq_second_;
+	timespec irq_time_;
+	// timer of second boundaries
+	int timer_fd_;
+	// event to stop the thread
+	int stop_fd_;
+	// the next deadline, only accessed in sampling thread
+	time_t next_;
+	std::thread thread_;
+
+	// metrics, protected by metrics_mutex_
+	mutable std::mutex metrics_mutex_;
+	ScalerSamplerMetrics metrics_;
+};
+
+}	// namespace ecl
+
+#endif	// __SCALER_SAMPLER_H__
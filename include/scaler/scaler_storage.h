@@ -0,0 +1,452 @@
+#ifndef __SCALER_STORAGE_H__
+#define __SCALER_STORAGE_H__
+
+#include <ctime>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "scaler/scaler_archive.h"
+#include "scaler/scaler_file.h"
+#include "scaler/scaler_kernel.h"
+#include "scaler/scaler_prefix.h"
+#include "scaler/scaler_rollup.h"
+
+namespace ecl {
+
+struct ScalerStorageOption {
+	// scaler data stored path
+	std::string data_path;
+	// device name to distinguish different device
+	std::string device_name;
+	// seconds between two msync of the written rows, 0 leaves it to kernel
+	int sync_interval;
+	// number of past day files kept mapped for reading
+	size_t cache_days;
+	// seconds before midnight to create the next day file in background,
+	// 0 creates the file when the day begins
+	int prepare_ahead;
+	// layout version of new day files, existing files keep their own
+	uint8_t file_version;
+	// keep prefix sums of every second beside day files, 22 MB each day
+	bool prefix_index;
+
+	ScalerStorageOption() {
+		data_path = "./";
+		device_name = "";
+		sync_interval = 10;
+		cache_days = 2;
+		prepare_ahead = 600;
+		file_version = kScalerFileRowMajor;
+		prefix_index = false;
+	}
+};
+
+
+struct ScalerStorageMetrics {
+	// times switching to the file of a new day
+	uint64_t rollovers;
+	// duration of the last rollover in microseconds
+	uint64_t last_rollover_us;
+	// maximum duration of rollovers in microseconds
+	uint64_t max_rollover_us;
+	// total duration of rollovers in microseconds
+	uint64_t total_rollover_us;
+	// day files created in background before the day begins
+	uint64_t prepared_files;
+	// day files failed to create or allocate in background, the day will
+	// begin without file if the disk is not freed meanwhile
+	uint64_t prepare_failures;
+};
+
+
+// mapped files of one day
+struct ScalerDayFiles {
+	// scaler values of every second
+	ScalerFile data;
+	// compressed values of archived day, open instead of data
+	ScalerArchive archive;
+	// sums in tiers
+	ScalerRollup rollup;
+	// sums from the start of day, only with prefix index
+	ScalerPrefix prefix;
+
+	/// @brief check whether values of every second could be read
+	/// @returns false if only the rollup is kept
+	///
+	inline bool HasValues() const noexcept {
+		return data.IsOpen() || archive.IsOpen();
+	}
+};
+
+
+/**
+ * ScalerStorage stores the scaler values in day files. The file of the
+ * current day and recently read past days are kept memory-mapped, so writing
+ * a second is one store into the mapping, and reading scans the mapping
+ * directly.
+ *
+ * Each day file has a rollup file of sums in coarser tiers, which is updated
+ * with every write. Summing a range of seconds reads the coarsest buckets
+ * fitting in the range, and only the unaligned ends from the day file. With
+ * prefix index, each day file also has a prefix file, and summing any range
+ * reads two prefix sums.
+ *
+ * The file of the next day is created by a background thread some time
+ * before midnight, so switching to the new day only maps an existing file.
+ *
+ * Day files could be row major or column major. Reducing selected scalers
+ * of column major files reads only their columns. Days no longer written
+ * could be archived in compressed files, which are read when the day file
+ * is missing, and only the blocks in range are decoded. Days past the
+ * retention may only keep the rollup, and only sums of whole buckets are
+ * read from them.
+ *
+ * There is only one writer and it writes forward in time. Readers can run
+ * concurrently with the writer in other threads. Rows from the writing one
+ * on are read with a sequence lock, so readers never see a half-written row.
+ *
+ */
+class ScalerStorage {
+public:
+
+	/// @brief constructor
+	/// @param[in] option storage options
+	///
+	ScalerStorage(const ScalerStorageOption &option) noexcept;
+
+
+	/// @brief destructor, stop background thread, flush and unmap all files
+	///
+	~ScalerStorage() noexcept;
+
+
+	ScalerStorage(const ScalerStorage&) = delete;
+	ScalerStorage& operator=(const ScalerStorage&) = delete;
+
+
+	/// @brief write scaler values of one second
+	/// @param[in] time the second to write
+	/// @param[in] scalers kMaxScalers values to write
+	/// @returns 0 on success, -1 on failure
+	///
+	int Write(time_t time, const uint32_t *scalers) noexcept;
+
+
+	/// @brief read rows of one day
+	/// @param[in] date date to read
+	/// @param[in] second first second to read in this day
+	/// @param[in] size number of rows to read
+	/// @param[in] visitor function called for each row in order, with the
+	///		pointer to kMaxScalers values of the row
+	/// @returns 0 on success, -1 on invalid parameters, -2 on file error
+	///
+	template<typename Visitor>
+	int Scan(
+		const tm *date,
+		size_t second,
+		size_t size,
+		Visitor &&visitor
+	) const noexcept;
+
+
+	/// @brief sum the rows of one day
+	/// @param[in] date date to read
+	/// @param[in] second first second to sum in this day
+	/// @param[in] size number of rows to sum
+	/// @param[inout] sums kMaxScalers sums, the sums of rows are added to it
+	/// @returns 0 on success, -1 on invalid parameters, -2 on file error or
+	///		range not in whole buckets of the day only keeping rollup
+	///
+	int Sum(
+		const tm *date,
+		size_t second,
+		size_t size,
+		uint64_t *sums
+	) const noexcept;
+
+
+	/// @brief reduce the rows of one day to sum, minimum, maximum and last
+	/// @param[in] date date to read
+	/// @param[in] second first second to reduce in this day
+	/// @param[in] size number of rows to reduce
+	/// @param[inout] reduction reduction to update
+	/// @param[in] flag bit i is set to reduce scaler i, others may be left
+	///		unchanged
+	/// @returns 0 on success, -1 on invalid parameters, -2 on file error
+	///
+	int Reduce(
+		const tm *date,
+		size_t second,
+		size_t size,
+		ScalerReduction &reduction,
+		uint32_t flag = 0xffffffff
+	) const noexcept;
+
+
+	/// @brief flush the written rows to file
+	/// @param[in] wait wait until the writing finishes
+	/// @returns 0 on success, -1 on failure
+	///
+	int Sync(bool wait = false) noexcept;
+
+
+	/// @brief get the end of the written seconds
+	/// @returns unix time after the last second written, 0 if nothing is
+	///		written since constructed
+	///
+	time_t WrittenEnd() const noexcept;
+
+
+	/// @brief get the metrics of storage
+	/// @returns copy of metrics
+	///
+	ScalerStorageMetrics Metrics() const noexcept;
+
+
+	/// @brief get the data path
+	/// @returns data path, ends with '/'
+	///
+	inline const std::string& DataPath() const noexcept {
+		return data_path_;
+	}
+
+
+	/// @brief get the device name
+	/// @returns device name
+	///
+	inline const std::string& DeviceName() const noexcept {
+		return device_name_;
+	}
+
+private:
+
+	/// @brief get the mapped files of the day, open them if not mapped
+	/// @param[in] date_key date key of the day
+	/// @param[in] date c style date of the day
+	/// @param[in] writable get writable mapping and create file if necessary
+	/// @returns shared pointer to files, nullptr on failure
+	///
+	std::shared_ptr<ScalerDayFiles> Acquire(
+		int date_key,
+		const tm *date,
+		bool writable
+	) const noexcept;
+
+
+	/// @brief open and map the files of the day, without files_mutex_
+	/// @param[in] date c style date of the day
+	/// @param[in] writable get writable mapping and create file if necessary
+	/// @returns shared pointer to files, nullptr on failure
+	///
+	std::shared_ptr<ScalerDayFiles> Open(
+		const tm *date,
+		bool writable
+	) const noexcept;
+
+
+	/// @brief ask the background thread to create the day file
+	/// @param[in] date c style date of the day
+	///
+	void Prepare(const tm *date) noexcept;
+
+
+	/// @brief background thread creating day files
+	///
+	void PrepareLoop() noexcept;
+
+
+	/// @brief pass continuous rows to kernel, rows may under writing are
+	///		copied and passed one by one
+	/// @param[in] files files of the day
+	/// @param[in] date_key date key of the day
+	/// @param[in] second first second of rows
+	/// @param[in] size number of rows
+	/// @param[in] kernel function called with pointer to rows and count
+	///
+	template<typename Kernel>
+	void ForRows(
+		const ScalerDayFiles &files,
+		int date_key,
+		size_t second,
+		size_t size,
+		Kernel &&kernel
+	) const noexcept;
+
+
+	/// @brief read prefix sums, with sequence lock if may under writing
+	/// @param[in] files files of the day, with valid prefix
+	/// @param[in] date_key date key of the day
+	/// @param[in] second end of the seconds (excluded)
+	/// @param[out] sums kMaxScalers sums of seconds before it
+	///
+	void ReadPrefix(
+		const ScalerDayFiles &files,
+		int date_key,
+		size_t second,
+		uint64_t *sums
+	) const noexcept;
+
+
+	/// @brief read one row under writing with sequence lock
+	/// @param[in] data day file to read
+	/// @param[in] second second of the row
+	/// @param[out] values kMaxScalers values of the row
+	///
+	void ReadRowLocked(
+		const ScalerFile &data,
+		size_t second,
+		uint32_t *values
+	) const noexcept;
+
+
+	/// @brief copy data under writing with sequence lock
+	/// @param[out] destination copy to
+	/// @param[in] source copy from
+	/// @param[in] size bytes to copy
+	///
+	void CopyLocked(
+		void *destination,
+		const void *source,
+		size_t size
+	) const noexcept;
+
+
+	/// @brief check whether the rows may be under writing
+	/// @param[in] date_key date key of the rows
+	/// @param[in] last last second of the rows
+	/// @returns true if the rows should be read with sequence lock
+	///
+	inline bool MayWriting(int date_key, size_t last) const noexcept {
+		// Time only goes forward, so rows before the writing one are stable
+		// and read directly from the mapping. Others may be changing.
+		return RowKey(date_key, last)
+			>= writing_row_.load(std::memory_order_acquire) - 1;
+	}
+
+
+	/// @brief count the rows not under writing
+	/// @param[in] date_key date key of the rows
+	/// @param[in] second first second of the rows
+	/// @param[in] size number of rows
+	/// @returns number of stable rows from the first one
+	///
+	inline size_t StableRows(int date_key, size_t second, size_t size) const noexcept {
+		int64_t first_writing =
+			writing_row_.load(std::memory_order_acquire) - 1 - RowKey(date_key, 0);
+		if (first_writing <= int64_t(second)) return 0;
+		return std::min(size, size_t(first_writing - int64_t(second)));
+	}
+
+
+	// global row index of the day and second
+	static inline int64_t RowKey(int date_key, size_t second) noexcept {
+		return int64_t(date_key) * kDaySeconds + second;
+	}
+
+	std::string data_path_;
+	std::string device_name_;
+	int sync_interval_;
+	size_t cache_days_;
+	int prepare_ahead_;
+	uint8_t file_version_;
+	bool prefix_index_;
+
+	// mapped files, protected by mutex
+	mutable std::mutex files_mutex_;
+	struct FileEntry {
+		std::shared_ptr<ScalerDayFiles> files;
+		uint64_t last_use;
+	};
+	mutable std::map<int, FileEntry> files_;
+	mutable uint64_t use_count_;
+	// date keys being opened without lock, others wait for them
+	mutable std::set<int> opening_;
+	mutable std::condition_variable opened_cond_;
+
+	// current writing files, only accessed by writer
+	std::shared_ptr<ScalerDayFiles> write_file_;
+	// date key of the writing file, also read when evicting files
+	std::atomic<int> write_date_;
+	// rows written but not synced
+	size_t dirty_first_;
+	size_t dirty_last_;
+	int unsynced_writes_;
+
+	// sequence lock of the writing row, odd when writing
+	std::atomic<uint32_t> sequence_;
+	// key of the last writing row
+	std::atomic<int64_t> writing_row_;
+	// unix time after the last written second
+	std::atomic<time_t> written_end_;
+
+	// creating and opening new day files are exclusive
+	std::mutex create_mutex_;
+	// background thread creating the day file in advance
+	std::thread prepare_thread_;
+	std::mutex prepare_mutex_;
+	std::condition_variable prepare_cond_;
+	bool prepare_stop_;
+	// date waiting to be created, protected by prepare_mutex_
+	bool prepare_pending_;
+	tm prepare_date_;
+	// last date asked to prepare, only accessed by writer
+	int prepared_key_;
+
+	// metrics, protected by metrics_mutex_
+	mutable std::mutex metrics_mutex_;
+	ScalerStorageMetrics metrics_;
+};
+
+
+template<typename Visitor>
+int ScalerStorage::Scan(
+	const tm *date,
+	size_t second,
+	size_t size,
+	Visitor &&visitor
+) const noexcept {
+	if (second + size > kDaySeconds) return -1;
+	int date_key = DateKey(date);
+	std::shared_ptr<ScalerDayFiles> files = Acquire(date_key, date, false);
+	if (!files || !files->HasValues()) return -2;
+
+	if (files->archive.IsOpen()) {
+		const size_t chunk_rows = 64;
+		uint32_t rows[chunk_rows * kMaxScalers];
+		for (size_t begin = 0; begin < size; begin += chunk_rows) {
+			const size_t count = std::min(chunk_rows, size - begin);
+			files->archive.ReadRows(second + begin, count, rows);
+			for (size_t i = 0; i < count; ++i) {
+				visitor((const uint32_t*)(rows + i * kMaxScalers));
+			}
+		}
+		return 0;
+	}
+	const ScalerFile &data = files->data;
+	uint32_t copied[kMaxScalers];
+	for (size_t i = second; i < second + size; ++i) {
+		if (MayWriting(date_key, i)) {
+			ReadRowLocked(data, i, copied);
+			visitor((const uint32_t*)copied);
+		} else if (data.Version() == kScalerFileRowMajor) {
+			visitor(data.Row(i));
+		} else {
+			data.ReadRow(i, copied);
+			visitor((const uint32_t*)copied);
+		}
+	}
+	return 0;
+}
+
+}	// namespace ecl
+
+#endif	// __SCALER_STORAGE_H__
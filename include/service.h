@@ -3,11 +3,26 @@
 
 #include <unistd.h>
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "config/device.h"
+#include "config/front_capture.h"
 #include "config/memory.h"
+#include "config/scaler_snapshot.h"
+#include "scaler/scaler_cache.h"
+#include "scaler/scaler_executor.h"
+#include "scaler/scaler_load.h"
+#include "scaler/scaler_maintainer.h"
+#include "scaler/scaler_publisher.h"
+#include "scaler/scaler_ring.h"
+#include "scaler/scaler_sampler.h"
+#include "scaler/scaler_storage.h"
 #include "ecl.grpc.pb.h"
 
 namespace ecl {
@@ -28,32 +43,103 @@ const char* const kLogLevelName[4] = {
 };
 
 
-struct ScalerFileHeader {
-	uint8_t version;
-	uint8_t number;
-	uint16_t reserve1;
-	uint32_t reserve2;
-};
-
-
 struct ServiceOption {
 	// gRPC port, server listen at localhost:port
 	int port;
 	// log level, error, warn, info, debug
 	LogLevel log_level;
-	// run in test mode, 0 normal mode, >0 different test mode
+	// run in test mode, 0 normal mode, >0 simulated device with scaler i
+	// counting i*100*test per second
 	int test;
+	// backend of registers, uio, file or simulated
+	DeviceKind device;
+	// UIO device or register file
+	std::string device_path;
+	// events per second of front inputs of the simulated device
+	std::vector<double> simulated_rates;
+	// nanoseconds of one pulse of the simulated device
+	double simulated_width;
 	// scaler data stored path
 	std::string data_path;
 	// device name to distinguish different device
 	std::string device_name;
+	// seconds between two flushes of scaler file, 0 leaves it to kernel
+	int sync_interval;
+	// seconds before midnight to create the next scaler file
+	int prepare_ahead;
+	// maximum queued samples of each subscriber
+	int subscription_queue;
+	// layout version of new scaler file, 1 row major, 2 column major
+	int file_version;
+	// keep prefix sums of each scaler file for averages of any range
+	bool prefix_index;
+	// archive scaler files older than days, 0 disables
+	int archive_days;
+	// remove scaler values older than days and keep rollups, 0 disables
+	int retention_days;
+	// maximum megabytes of scaler files, 0 disables
+	int disk_budget_mb;
+	// seconds between two maintenance passes
+	int maintenance_interval;
+	// maximum kilobytes per second read and written in maintenance
+	int maintenance_io_rate;
+	// SCHED_FIFO priority of sampling thread, 0 keeps normal scheduling
+	int sampler_priority;
+	// CPU to pin the sampling thread, -1 runs on any CPU
+	int sampler_cpu;
+	// sample on interrupts of the UIO device instead of timer
+	bool sampler_irq;
+	// milliseconds without interrupt before falling back to timer
+	int sampler_irq_timeout;
+	// samples per second of front IO and gate values, 0 disables capture
+	int capture_rate;
+	// CPU to pin the capture thread, -1 runs on any CPU
+	int capture_cpu;
+	// virtual seconds generated per second instead of sampling the device,
+	// 0 disables the load generator
+	double load_rate;
+	// models of load channels, empty for default models
+	std::vector<LoadModel> load_models;
+	// seed of load generator, 0 takes a random seed
+	uint32_t load_seed;
+	// threads reading files for queries
+	int query_threads;
+	// maximum queries waiting for busy threads, more are rejected, 0 only
+	// runs queries on idle threads
+	int query_queue;
+	// KB of recent query results shared by clients, 0 keeps no result
+	int query_cache_kb;
 
 	ServiceOption() {
 		port = 2233;
 		log_level = kWarn;
 		test = 0;
+		device = kUioDevice;
+		device_path = "/dev/uio0";
+		simulated_width = 100.0;
 		data_path = "./";
 		device_name = "";
+		sync_interval = 10;
+		prepare_ahead = 600;
+		subscription_queue = 16;
+		file_version = 1;
+		prefix_index = false;
+		archive_days = 0;
+		retention_days = 0;
+		disk_budget_mb = 0;
+		maintenance_interval = 3600;
+		maintenance_io_rate = 2048;
+		sampler_priority = 0;
+		sampler_cpu = -1;
+		sampler_irq = false;
+		sampler_irq_timeout = 3000;
+		capture_rate = 1000;
+		capture_cpu = -1;
+		load_rate = 0.0;
+		load_seed = 0;
+		query_threads = 2;
+		query_queue = 16;
+		query_cache_kb = 1024;
 	}
 };
 
@@ -72,9 +158,10 @@ public:
 
 
 	/// @brief write scaler value to file
+	/// @param[in] now the second of this sample
 	/// @returns 0 on success, -1 on failure
 	///
-	int WriteScaler() const noexcept;
+	int WriteScaler(time_t now) noexcept;
 
 
 	/// @brief read scaler value for one date
@@ -96,17 +183,19 @@ public:
 	) const noexcept;
 
 
-	/// @brief read recent scaler values
+	/// @brief read recent scaler values from memory
 	/// @param[in] index index of scaler to read
 	/// @param[in] seconds time in seconds to read before now
 	/// @param[in] average get average value from [average] numbers
 	/// @param[out] value read value from file
-	/// @returns 0 if successful, -1 on invalid parameters, -2 on file error
+	/// @param[out] start_time unix time of the first value, ignored if nullptr
+	/// @returns 0 if successful, -1 on invalid parameters
 	int ReadRecentScaler(
 		int32_t flag,
 		int seconds,
 		int average,
-		std::vector<std::vector<uint32_t>> &value
+		std::vector<std::vector<uint32_t>> &value,
+		time_t *start_time = nullptr
 	) const noexcept;
 
 
@@ -119,6 +208,12 @@ public:
 	///
 	void PrintScaler() const noexcept;
 
+
+	/// @brief print duty cycles and transitions of front IO and gates on
+	///		screen
+	///
+	void PrintCapture() const noexcept;
+
 	// ------------------------------------------------------------------------
 	//                              gRPC interface
 	// ------------------------------------------------------------------------
@@ -195,11 +290,121 @@ public:
 	) override;
 
 
+	/// @brief get metrics of service
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request request content, empty now
+	/// @returns reactor to write metrics
+	///
+	grpc::ServerWriteReactor<Metric>* GetMetrics(
+		grpc::CallbackServerContext *context,
+		const Request *request
+	) override;
+
+
+	/// @brief get recent scaler values packed in one message
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request request content, the same as GetScalerRecent
+	/// @param[out] response values of each scaler and the time axis
+	/// @returns default reactor
+	///
+	grpc::ServerUnaryReactor* GetScalerRecentPacked(
+		grpc::CallbackServerContext *context,
+		const RecentRequest *request,
+		ScalerBlock *response
+	) override;
+
+
+	/// @brief get scaler values of date packed in one message
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request request content, the same as GetScalerDate
+	/// @param[out] response values of each scaler and the time axis
+	/// @returns default reactor
+	///
+	grpc::ServerUnaryReactor* GetScalerDatePacked(
+		grpc::CallbackServerContext *context,
+		const DateRequest *request,
+		ScalerBlock *response
+	) override;
+
+
+	/// @brief subscribe scaler values of every sample
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request request content, flag, period and delta
+	/// @returns reactor to write samples until cancelled
+	///
+	grpc::ServerWriteReactor<ScalerSample>* SubscribeScalers(
+		grpc::CallbackServerContext *context,
+		const SubscribeRequest *request
+	) override;
+
+
+	/// @brief query scalers in time range with aggregations
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request time range, step, flag and aggregations
+	/// @param[out] response aggregated values of each scaler
+	/// @returns default reactor
+	///
+	grpc::ServerUnaryReactor* QueryScalers(
+		grpc::CallbackServerContext *context,
+		const QueryRequest *request,
+		QueryResponse *response
+	) override;
+
+
+	/// @brief capture levels of front IO and gates at high rate
+	/// @param[in] context server context, handled by gRPC
+	/// @param[in] request request content, trigger of capture windows
+	/// @returns reactor to write chunks of samples until cancelled
+	///
+	grpc::ServerWriteReactor<CaptureChunk>* CaptureFront(
+		grpc::CallbackServerContext *context,
+		const CaptureRequest *request
+	) override;
+
+
 	// keep running until get SIGINT
 	static bool keep_running;
 
 private:
 
+	/// @brief read all scaler registers at once and keep them as the current
+	///		values
+	/// @param[out] values kMaxScalers values of the snapshot
+	///
+	void TakeSnapshot(uint32_t *values) noexcept;
+
+
+	/// @brief get the scaler values of the latest snapshot
+	/// @param[out] values kMaxScalers values
+	///
+	void CurrentScalers(uint32_t *values) const noexcept;
+
+
+	/// @brief average recent values of all scalers
+	/// @param[in] now the current second
+	/// @param[in] seconds time in seconds to read before now
+	/// @param[in] average get average value from [average] numbers
+	/// @param[out] value averages of all scalers
+	/// @returns 0 if successful
+	///
+	int AverageRecentScalers(
+		time_t now,
+		int seconds,
+		int average,
+		ScalerCacheValue &value
+	) const noexcept;
+
+
+	/// @brief run query in executor instead of the thread of gRPC
+	/// @param[in] task function to run, called with true if cancelled
+	/// @param[in] cancelled returns true if the client is gone
+	/// @returns 0 on success, -1 if too many queries are waiting
+	///
+	int Execute(
+		std::function<void(bool)> task,
+		std::function<bool()> cancelled
+	) noexcept;
+
 	// service options
 	int port_;
 	LogLevel log_level_;
@@ -207,15 +412,42 @@ private:
 	std::string data_path_;
 	std::string device_name_;
 
-	// mapped file
-	int xillybus_lite_fd_;
+	// backend of registers
+	std::unique_ptr<Device> device_;
 	// maped memory
 	volatile Memory *memory_;
 
-	// write scaler thread
-	std::unique_ptr<std::thread> write_thread_;
-	// test scaler thread
-	std::unique_ptr<std::thread> test_thread_;
+	// latest snapshot of scaler registers, shared by all readers
+	mutable std::mutex snapshot_mutex_;
+	uint32_t snapshot_[kMaxScalers];
+	// bursts read for snapshots
+	std::atomic<uint64_t> snapshot_bursts_;
+	// snapshots whose bursts never agree
+	std::atomic<uint64_t> torn_snapshots_;
+	// seconds pushed to ring, new ones expire the cached recent results
+	std::atomic<uint64_t> pushed_seconds_;
+
+	// scaler storage
+	std::unique_ptr<ScalerStorage> storage_;
+	// rollovers have been reported in log
+	uint64_t reported_rollovers_;
+	// deliver samples to subscribers
+	ScalerPublisher publisher_;
+	// scaler values of last day in memory
+	ScalerRing ring_;
+	// archive and remove old scaler files in background, nullptr if disabled
+	std::unique_ptr<ScalerMaintainer> maintainer_;
+
+	// sample scalers at every second boundary
+	std::unique_ptr<ScalerSampler> sampler_;
+	// capture front IO and gate values, nullptr if disabled
+	std::unique_ptr<FrontCapture> capture_;
+	// generate load instead of sampling, nullptr if disabled
+	std::unique_ptr<ScalerLoad> load_;
+	// run queries reading files
+	std::unique_ptr<ScalerExecutor> executor_;
+	// recent query results shared by clients
+	std::unique_ptr<ScalerCache> recent_cache_;
 };
 
 }	// namespace ecl
@@ -37,6 +37,12 @@ public:
 	/// @exceptsafe Shall not throw exceptions.
 	///
 	ArithmeticGrammar() noexcept;
+
+	/// @brief get the action table generated at build time
+	/// @returns pointer to the generated action table
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	const GeneratedActionTable* GeneratedTable() const noexcept override;
 };
 
 }			// namespace ecl
@@ -0,0 +1,79 @@
+// This file is generated by generate_action_table, don't edit it manually.
+// Run `make update_action_table` after changing any grammar.
+
+#ifndef __GENERATED_ACTION_TABLE_H__
+#define __GENERATED_ACTION_TABLE_H__
+
+#include "syntax/parser/grammar.h"
+
+namespace ecl {
+
+// LogicalGrammar, 11 collections, 9 symbols (include terminating symbol), 6 productions
+constexpr uint16_t kLogicalGrammarCells[] = {
+	0x0000, 0x000b, 0x0000, 0x0013, 0x0000, 0x001a, 0x0000, 0x0022, 0x0000,
+	0x0000, 0x0000, 0x002a, 0x0000, 0x0032, 0x0000, 0x0000, 0x0000, 0x0001,
+	0x0000, 0x0000, 0x001c, 0x0000, 0x001c, 0x0000, 0x001c, 0x0000, 0x001c,
+	0x0000, 0x003b, 0x0000, 0x0013, 0x0000, 0x001a, 0x0000, 0x0022, 0x0000,
+	0x0000, 0x0000, 0x002c, 0x0000, 0x002c, 0x0000, 0x002c, 0x0000, 0x002c,
+	0x0000, 0x0000, 0x0000, 0x0043, 0x0000, 0x001a, 0x0000, 0x0022, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x004b, 0x0000, 0x001a, 0x0000, 0x0022, 0x0000,
+	0x0000, 0x0000, 0x002a, 0x0000, 0x0032, 0x0000, 0x0052, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x000c, 0x0000, 0x000c, 0x0000, 0x000c, 0x0000, 0x000c,
+	0x0000, 0x0000, 0x0014, 0x0000, 0x0014, 0x0000, 0x0014, 0x0000, 0x0014,
+	0x0000, 0x0000, 0x0024, 0x0000, 0x0024, 0x0000, 0x0024, 0x0000, 0x0024,
+};
+constexpr GeneratedActionTable kLogicalGrammarTable = {
+	11, 9, 6, kLogicalGrammarCells
+};
+
+// LogicDownscaleGrammar, 18 collections, 14 symbols (include terminating symbol), 10 productions
+constexpr uint16_t kLogicDownscaleGrammarCells[] = {
+	0x0000, 0x000b, 0x0012, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001,
+	0x0000, 0x0000, 0x0000, 0x001a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x003a, 0x0000, 0x0023, 0x0000, 0x002b, 0x0000, 0x0033, 0x0000, 0x0042, 0x004a, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0052, 0x0000, 0x005a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x000c,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0024, 0x0000, 0x0024, 0x0000, 0x0000, 0x0000, 0x0000, 0x0024, 0x0024,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0034, 0x0000, 0x0034, 0x0000, 0x0062, 0x0000, 0x0000, 0x0034, 0x0034,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x003c, 0x0000, 0x003c, 0x0000, 0x003c, 0x0000, 0x0000, 0x003c, 0x003c,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0044, 0x0000, 0x0044, 0x0000, 0x0044, 0x0000, 0x0000, 0x0044, 0x0044,
+	0x0000, 0x0000, 0x003a, 0x0000, 0x006b, 0x0000, 0x002b, 0x0000, 0x0033, 0x0000, 0x0042, 0x004a, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x003a, 0x0000, 0x0000, 0x0000, 0x0073, 0x0000, 0x0033, 0x0000, 0x0042, 0x004a, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x003a, 0x0000, 0x0000, 0x0000, 0x007b, 0x0000, 0x0033, 0x0000, 0x0042, 0x004a, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0082, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0052, 0x0000, 0x005a, 0x0000, 0x0000, 0x0000, 0x0000, 0x008a, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0014, 0x0000, 0x0014, 0x0000, 0x0000, 0x0000, 0x0000, 0x0014, 0x0014,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x001c, 0x0000, 0x001c, 0x0000, 0x0000, 0x0000, 0x0000, 0x001c, 0x001c,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x002c, 0x0000, 0x002c, 0x0000, 0x0000, 0x0000, 0x0000, 0x002c, 0x002c,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x004c, 0x0000, 0x004c, 0x0000, 0x004c, 0x0000, 0x0000, 0x004c, 0x004c,
+};
+constexpr GeneratedActionTable kLogicDownscaleGrammarTable = {
+	18, 14, 10, kLogicDownscaleGrammarCells
+};
+
+// ArithmeticGrammar, 16 collections, 12 symbols (include terminating symbol), 9 productions
+constexpr uint16_t kArithmeticGrammarCells[] = {
+	0x0000, 0x000b, 0x0000, 0x0013, 0x0000, 0x0000, 0x001b, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0032, 0x0000, 0x003a, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0001,
+	0x0000, 0x0000, 0x001c, 0x0000, 0x001c, 0x0042, 0x0000, 0x004a, 0x0000, 0x001c, 0x0000, 0x001c,
+	0x0000, 0x0000, 0x0034, 0x0000, 0x0034, 0x0034, 0x0000, 0x0034, 0x0000, 0x0034, 0x0000, 0x0034,
+	0x0000, 0x0053, 0x0000, 0x0013, 0x0000, 0x0000, 0x001b, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0044, 0x0000, 0x0044, 0x0044, 0x0000, 0x0044, 0x0000, 0x0044, 0x0000, 0x0044,
+	0x0000, 0x0000, 0x0000, 0x005b, 0x0000, 0x0000, 0x001b, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0063, 0x0000, 0x0000, 0x001b, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x006b, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0073, 0x0000, 0x0022, 0x0000, 0x002a, 0x0000,
+	0x0000, 0x0000, 0x0032, 0x0000, 0x003a, 0x0000, 0x0000, 0x0000, 0x0000, 0x007a, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x000c, 0x0000, 0x000c, 0x0042, 0x0000, 0x004a, 0x0000, 0x000c, 0x0000, 0x000c,
+	0x0000, 0x0000, 0x0014, 0x0000, 0x0014, 0x0042, 0x0000, 0x004a, 0x0000, 0x0014, 0x0000, 0x0014,
+	0x0000, 0x0000, 0x0024, 0x0000, 0x0024, 0x0024, 0x0000, 0x0024, 0x0000, 0x0024, 0x0000, 0x0024,
+	0x0000, 0x0000, 0x002c, 0x0000, 0x002c, 0x002c, 0x0000, 0x002c, 0x0000, 0x002c, 0x0000, 0x002c,
+	0x0000, 0x0000, 0x003c, 0x0000, 0x003c, 0x003c, 0x0000, 0x003c, 0x0000, 0x003c, 0x0000, 0x003c,
+};
+constexpr GeneratedActionTable kArithmeticGrammarTable = {
+	16, 12, 9, kArithmeticGrammarCells
+};
+
+}				// namespace ecl
+
+#endif			// __GENERATED_ACTION_TABLE_H__
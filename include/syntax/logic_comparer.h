@@ -127,7 +127,6 @@ private:
 
 
 	Lexer lexer_[2];
-	LogicalGrammar grammar_[2];
 	SLRSyntaxParser<bool> parser_[2];
 	std::vector<bool> is_irrelevant_[2];
 
@@ -6,6 +6,7 @@
 #ifndef __GRAMMAR_H__
 #define __GRAMMAR_H__
 
+#include <cstdint>
 #include <map>
 #include <set>
 #include <string>
@@ -16,6 +17,60 @@
 
 namespace ecl {
 
+/**
+ * PackedAction packs an action of the SLR action table into 16 bits. The
+ * lowest 3 bits store the action type plus one, so the error action is 0.
+ * The higher 13 bits store the next collection for shift and goto actions, or
+ * the global index of the production for the reduce action. The global index
+ * counts the productions in the order of production sets.
+ *
+ */
+struct PackedAction {
+	static const int kTypeBits = 3;
+	static const uint16_t kTypeMask = (1u << kTypeBits) - 1;
+
+	/// @brief pack action type and value
+	/// @param[in] type action type, see Action
+	/// @param[in] value next collection or production index
+	/// @returns packed action
+	///
+	static constexpr uint16_t Pack(int type, int value) noexcept {
+		return uint16_t((value << kTypeBits) | (type + 1));
+	}
+
+	/// @brief get action type from the packed action
+	/// @param[in] cell packed action
+	/// @returns action type, see Action
+	///
+	static constexpr int Type(uint16_t cell) noexcept {
+		return int(cell & kTypeMask) - 1;
+	}
+
+	/// @brief get action value from the packed action
+	/// @param[in] cell packed action
+	/// @returns next collection or production index
+	///
+	static constexpr int Value(uint16_t cell) noexcept {
+		return int(cell >> kTypeBits);
+	}
+};
+
+
+/**
+ * GeneratedActionTable is the SLR action table of a grammar generated at build
+ * time by the tool generate_action_table. The cells are packed actions stored
+ * row by row, one row for each collection. The symbol size includes the
+ * terminating symbol.
+ *
+ */
+struct GeneratedActionTable {
+	int collection_size;
+	int symbol_size;
+	int production_size;
+	const uint16_t *cells;
+};
+
+
 template<typename VarType>
 class Grammar {
 public:
@@ -40,6 +95,18 @@ public:
 
 
 
+	/// @brief get the action table generated at build time
+	///
+	/// @returns pointer to the generated action table, or nullptr if the
+	/// 	grammar doesn't have one and the table is generated at runtime
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	virtual const GeneratedActionTable* GeneratedTable() const noexcept {
+		return nullptr;
+	}
+
+
 	/// @brief check the completion of the grammar
 	///
 	/// @returns true if this is complete, false incomplete
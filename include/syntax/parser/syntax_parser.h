@@ -6,6 +6,7 @@
 #define __SYNTAX_PARSER_H__
 
 #include <map>
+#include <mutex>
 #include <vector>
 
 #include "syntax/parser/grammar.h"
@@ -106,6 +107,19 @@ public:
 	///
 	Action* GetAction(int collection, int symbol) noexcept;
 
+
+	/// @brief get the action through collection and symbol
+	///
+	/// @param[in] collection present collection before action
+	/// @param[in] symbol next symbol meets
+	/// @returns const pointer to the action
+	///
+	/// @overload
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	const Action* GetAction(int collection, int symbol) const noexcept;
+
 private:
 
 	struct Action* table_;
@@ -116,6 +130,195 @@ private:
 
 
 
+/**
+ * CompiledGrammar holds a grammar and the SLR action table of it. The action
+ * table is taken from the table generated at build time if the grammar has
+ * one, otherwise the item collections and the action table are generated in
+ * the constructor. The table never changes afterwards, so one compiled
+ * grammar can be shared by many parsers, even by parsers running in different
+ * threads. The grammar is not owned and should live longer than the compiled
+ * grammar.
+ *
+ * The parser looks up actions in the packed form (see PackedAction), and the
+ * unpacked ActionTable is kept for inspecting.
+ *
+ * @tparam VarType the return type of the Evaluate function
+ */
+template<typename VarType>
+class CompiledGrammar {
+public:
+
+	/// @brief constructor
+	/// @note This function firstly gernerates the grammar item and collection,
+	/// 	and generates the action table secondly. These steps are skipped if
+	/// 	the grammar has an action table generated at build time and it's
+	/// 	allowed to use it.
+	///
+	/// @param[in] grammar pointer to the grammar to compile
+	/// @param[in] use_generated use the action table generated at build time
+	/// 	if it exists, default is true
+	///
+	CompiledGrammar(Grammar<VarType> *grammar, bool use_generated = true);
+
+
+	/// @brief destructor
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	~CompiledGrammar() noexcept;
+
+
+	/// @brief get the compiled grammar
+	///
+	/// @returns pointer to the grammar
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline Grammar<VarType>* GetGrammar() const noexcept {
+		return grammar_;
+	}
+
+
+	/// @brief get action table
+	/// @note Parsing only reads the packed cells, so the action table of the
+	/// 	generated grammar is unpacked at the first call of this function.
+	///
+	/// @returns the pointer to the action table
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	ActionTable* GetActionTable() const noexcept;
+
+
+	/// @brief whether the action table was generated at build time
+	///
+	/// @returns true if the table is generated at build time, false if
+	/// 	generated at runtime
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline bool IsGenerated() const noexcept {
+		return cells_ != packed_cells_.data();
+	}
+
+
+	/// @brief get the size of collections, i.e. rows of the action table
+	///
+	/// @returns size of collections
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline int CollectionSize() const noexcept {
+		return collection_size_;
+	}
+
+
+	/// @brief get the size of symbols, i.e. columns of the action table
+	/// @note The terminating symbol is included.
+	///
+	/// @returns size of symbols
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline int SymbolSize() const noexcept {
+		return symbol_size_;
+	}
+
+
+	/// @brief get the size of productions
+	///
+	/// @returns size of productions in all production sets
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline int ProductionSize() const noexcept {
+		return int(productions_.size());
+	}
+
+
+	/// @brief get the packed action through collection and symbol
+	///
+	/// @param[in] collection present collection before action
+	/// @param[in] symbol next symbol meets
+	/// @returns packed action
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline uint16_t Cell(int collection, int symbol) const noexcept {
+		return cells_[collection * symbol_size_ + symbol];
+	}
+
+
+	/// @brief get the production through the global index
+	///
+	/// @param[in] index global index of the production
+	/// @returns pointer to the production factory
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline ProductionFactory<VarType>* Production(int index) const noexcept {
+		return productions_[index];
+	}
+
+
+	/// @brief get the symbol that the production reduces to
+	///
+	/// @param[in] index global index of the production
+	/// @returns symbol index of the production set of the production
+	///
+	/// @exceptsafe Shall not throw exceptions.
+	///
+	inline int ReduceSymbol(int index) const noexcept {
+		return reduce_symbols_[index];
+	}
+
+private:
+
+	/// @brief generate the collections and action table and pack it
+	///
+	void GenerateTable();
+
+
+	/// @brief unpack the generated cells to action table
+	///
+	void UnpackTable() const noexcept;
+
+
+	Grammar<VarType> *grammar_;
+	// built with the grammar at runtime, or unpacked on demand
+	mutable ActionTable *action_table_;
+	mutable std::once_flag unpack_flag_;
+	int collection_size_;
+	int symbol_size_;
+	// packed actions, point to generated table or packed_cells_
+	const uint16_t *cells_;
+	// packed actions generated at runtime
+	std::vector<uint16_t> packed_cells_;
+	// production factories in the order of global index
+	std::vector<ProductionFactory<VarType>*> productions_;
+	// symbol index of the production set that the production reduces to
+	std::vector<int> reduce_symbols_;
+};
+
+
+/// @brief get the compiled grammar shared in the whole process
+/// @note The grammar and its action table are built on the first call only,
+/// 	and the initialization is thread-safe. Later calls return the same
+/// 	compiled grammar.
+///
+/// @tparam VarType the return type of the Evaluate function
+/// @tparam GrammarType the grammar class, derived from Grammar<VarType>
+/// @returns pointer to the shared compiled grammar
+///
+template<typename VarType, typename GrammarType>
+const CompiledGrammar<VarType>* SharedGrammar() {
+	static GrammarType grammar;
+	static const CompiledGrammar<VarType> compiled(&grammar);
+	return &compiled;
+}
+
+
+
 /**
  * The SyntaxParser class is the abstract base class of the syntax parser.
  * The syntax parser is attached with a kind of grammar, and then parse the
@@ -275,14 +478,25 @@ class SLRSyntaxParser final : public SyntaxParser<VarType> {
 public:
 
 	/// @brief constructor
-	/// @note This function firstly gernerates the grammar item and collection,
-	/// 	and generates the action table secondly.
+	/// @note This function compiles the grammar and owns the compiled result.
 	///
 	/// @param[in] grammar pointer to the parsing grammar
 	///
 	SLRSyntaxParser(Grammar<VarType> *grammar);
 
 
+	/// @brief constructor
+	/// @note The parser shares the compiled grammar and doesn't generate any
+	/// 	table. It only keeps the state of parsing, i.e. the variables,
+	/// 	literals and the syntax tree.
+	///
+	/// @param[in] compiled pointer to the shared compiled grammar
+	///
+	/// @overload
+	///
+	SLRSyntaxParser(const CompiledGrammar<VarType> *compiled);
+
+
 	/// @brief destructor
 	///
 	/// @exceptsafe Shall not throw exceptions.
@@ -297,7 +511,7 @@ public:
 	/// @exceptsafe Shall not throw exceptions.
 	///
 	inline ActionTable* GetActionTable() const {
-		return action_table_;
+		return compiled_->GetActionTable();
 	}
 
 
@@ -316,7 +530,10 @@ public:
 
 private:
 
-	ActionTable *action_table_;
+	// compiled grammar, owned or shared
+	const CompiledGrammar<VarType> *compiled_;
+	// compiled grammar owned by this parser, nullptr if shared
+	CompiledGrammar<VarType> *own_compiled_;
 };
 
 }				// namespace ecl
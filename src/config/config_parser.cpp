@@ -127,10 +127,8 @@ ParseResult ConfigParser::Parse(const std::string &expr) noexcept {
 		tokens.push_back(right_tokens[i]);
 	}
 
-	// grammar
-	LogicDownscaleGrammar grammar;
-	// parser
-	SLRSyntaxParser<int> parser(&grammar);
+	// parser, shares the grammar and action table built once in process
+	SLRSyntaxParser<int> parser(SharedGrammar<int, LogicDownscaleGrammar>());
 	// parse tokens
 	ParseResult syntax_result = parser.Parse(tokens);
 	if (!syntax_result.Ok()) {
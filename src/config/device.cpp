@@ -0,0 +1,492 @@
+#include "config/device.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace ecl {
+
+namespace {
+
+/// @brief map the registers in file and lock it
+/// @param[in] path path of file
+/// @param[in] flags flags to open
+/// @param[out] fd opened file descriptor
+/// @returns mapped registers, nullptr on failure
+///
+volatile Memory* MapFile(
+	const std::string &path,
+	int flags,
+	int &fd
+) noexcept {
+	fd = open(path.c_str(), flags, 0644);
+	if (fd < 0) {
+		std::cerr << "Error: Failed to open " << path << ": "
+			<< strerror(errno) << "\n";
+		return nullptr;
+	}
+	// only one process configures and samples the registers
+	if (flock(fd, LOCK_EX | LOCK_NB)) {
+		std::cerr << "Error: Failed to get the file lock on " << path << ": "
+			<< strerror(errno) << "\n";
+		close(fd);
+		fd = -1;
+		return nullptr;
+	}
+	void *map_addr = mmap(
+		NULL, sizeof(Memory),
+		PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0
+	);
+	if (map_addr == MAP_FAILED) {
+		std::cerr << "Error: Failed to mmap " << path << ": "
+			<< strerror(errno) << "\n";
+		flock(fd, LOCK_UN);
+		close(fd);
+		fd = -1;
+		return nullptr;
+	}
+	return (volatile Memory*)map_addr;
+}
+
+
+/// @brief unmap and unlock the file
+/// @param[in] memory mapped registers
+/// @param[in] fd file descriptor
+///
+void UnmapFile(volatile Memory *memory, int fd) noexcept {
+	if (fd < 0) return;
+	munmap((void*)memory, sizeof(Memory));
+	flock(fd, LOCK_UN);
+	close(fd);
+}
+
+
+/// @brief rate of signal at least k of the inputs are high
+/// @param[in] inputs rates of inputs
+/// @param[in] k number of coincident inputs
+/// @param[in] width seconds of one pulse
+/// @returns events per second
+///
+double Coincidence(
+	const std::vector<double> &inputs,
+	size_t k,
+	double width
+) noexcept {
+	if (k == 0 || inputs.size() < k) return 0.0;
+	// sums of products of j rates
+	std::vector<double> sums(k+1, 0.0);
+	sums[0] = 1.0;
+	for (double rate : inputs) {
+		for (size_t j = k; j > 0; --j) sums[j] += sums[j-1] * rate;
+	}
+	double result = double(k) * std::pow(width, double(k-1)) * sums[k];
+	// never faster than pulses of the slowest coincident input
+	std::vector<double> sorted(inputs);
+	std::sort(sorted.begin(), sorted.end());
+	return std::min(result, sorted[inputs.size() - k]);
+}
+
+
+/// @brief collect rates of sources selected by mask
+/// @param[in] mask bits of sources
+/// @param[in] bits number of bits in mask
+/// @param[in] rates rates of the first source
+/// @param[out] inputs appended rates
+///
+void Select(
+	uint32_t mask,
+	size_t bits,
+	const double *rates,
+	std::vector<double> &inputs
+) noexcept {
+	for (size_t i = 0; i < bits; ++i) {
+		if ((mask >> i) & 1) inputs.push_back(rates[i]);
+	}
+}
+
+
+/// @brief collect rates of front inputs selected by mask
+/// @param[in] front masks of three front groups
+/// @param[in] rates rates of all sources
+/// @param[out] inputs appended rates
+///
+void SelectFront(
+	const uint16_t *front,
+	const double *rates,
+	std::vector<double> &inputs
+) noexcept {
+	for (size_t i = 0; i < kFrontIoGroupNum; ++i) {
+		Select(
+			front[i], kFrontIoGroupSize,
+			rates + kSelectFront + i * kFrontIoGroupSize,
+			inputs
+		);
+	}
+}
+
+
+/// @brief sum of rates limited by the pulse width
+double Sum(const std::vector<double> &inputs, double width) noexcept {
+	double sum = 0.0;
+	for (double rate : inputs) sum += rate;
+	return width > 0.0 ? std::min(sum, 1.0 / width) : sum;
+}
+
+}	// namespace
+
+
+int Device::ReadSnapshot(ScalerSnapshot &snapshot) noexcept {
+	return ReadScalerSnapshot(Registers(), snapshot);
+}
+
+
+int Device::WriteConfig(
+	const MemoryConfig &config,
+	bool full,
+	MapResult *result
+) noexcept {
+	volatile uint32_t *map = (volatile uint32_t*)Registers();
+	if (!map) return -1;
+	if (!full) return config.MapMemoryDifferential(map, result);
+	return config.MapMemory(map, result);
+}
+
+
+void Device::Reset() noexcept {
+	volatile Memory *memory = Registers();
+	if (!memory) return;
+	memory->i2c.reset = 1;
+	usleep(1000);
+	memory->i2c.reset = 0;
+}
+
+
+UioDevice::UioDevice(const std::string &path) noexcept
+: path_(path)
+, fd_(-1)
+, memory_(nullptr) {
+}
+
+
+UioDevice::~UioDevice() noexcept {
+	UnmapFile(memory_, fd_);
+}
+
+
+int UioDevice::Open() noexcept {
+	if (memory_) return 0;
+	memory_ = MapFile(path_, O_RDWR, fd_);
+	return memory_ ? 0 : -1;
+}
+
+
+volatile Memory* UioDevice::Registers() noexcept {
+	return memory_;
+}
+
+
+int UioDevice::IrqFd() const noexcept {
+	return fd_;
+}
+
+
+std::string UioDevice::Name() const noexcept {
+	return "uio " + path_;
+}
+
+
+FileDevice::FileDevice(const std::string &path) noexcept
+: path_(path)
+, fd_(-1)
+, memory_(nullptr) {
+}
+
+
+FileDevice::~FileDevice() noexcept {
+	UnmapFile(memory_, fd_);
+}
+
+
+int FileDevice::Open() noexcept {
+	if (memory_) return 0;
+	int fd = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		std::cerr << "Error: Failed to open " << path_ << ": "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	// a new file is zero registers
+	struct stat status;
+	bool short_file = fstat(fd, &status) == 0
+		&& status.st_size < off_t(sizeof(Memory));
+	if (short_file && ftruncate(fd, sizeof(Memory))) {
+		std::cerr << "Error: Failed to resize " << path_ << ": "
+			<< strerror(errno) << "\n";
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	memory_ = MapFile(path_, O_RDWR, fd_);
+	return memory_ ? 0 : -1;
+}
+
+
+volatile Memory* FileDevice::Registers() noexcept {
+	return memory_;
+}
+
+
+std::string FileDevice::Name() const noexcept {
+	return "file " + path_;
+}
+
+
+void SimulateRates(
+	const Memory &memory,
+	const double *inputs,
+	size_t size,
+	double width,
+	double *rates
+) noexcept {
+	for (size_t i = 0; i < kSelections; ++i) rates[i] = 0.0;
+	for (size_t i = 0; i < kFrontIoNum && i < size; ++i) {
+		rates[kSelectFront + i] = std::max(inputs[i], 0.0);
+	}
+
+	std::vector<double> selected;
+	// multi gates, at least threshold inputs
+	for (size_t i = 0; i < kMaxMultiGates; ++i) {
+		selected.clear();
+		SelectFront(memory.multi_gates[i].front, rates, selected);
+		rates[kSelectMultiGate + i] =
+			Coincidence(selected, memory.multi_gates[i].threshold, width);
+	}
+	// or gates
+	for (size_t i = 0; i < kMaxOrGates; ++i) {
+		selected.clear();
+		SelectFront(memory.or_gates[i].front, rates, selected);
+		Select(
+			memory.or_gates[i].multi, kMaxMultiGates,
+			rates + kSelectMultiGate, selected
+		);
+		rates[kSelectOrGate + i] = Sum(selected, width);
+	}
+	// and gates
+	for (size_t i = 0; i < kMaxAndGates; ++i) {
+		selected.clear();
+		SelectFront(memory.and_gates[i].front, rates, selected);
+		Select(
+			memory.and_gates[i].multi, kMaxMultiGates,
+			rates + kSelectMultiGate, selected
+		);
+		Select(
+			memory.and_gates[i].or_gates, kMaxOrGates,
+			rates + kSelectOrGate, selected
+		);
+		rates[kSelectAndGate + i] = Coincidence(selected, selected.size(), width);
+	}
+	// clocks, the primary clocks are not simulated
+	for (size_t i = 0; i < kMaxClocks; ++i) {
+		if (memory.clock_divisor[i]) {
+			rates[kSelectClock + i] = kBaseClockHz / memory.clock_divisor[i];
+		}
+	}
+	// dividers of the sources above
+	for (size_t i = 0; i < kMaxDividers; ++i) {
+		size_t source = memory.divider_source[i];
+		if (source < kSelections && memory.divisor[i]) {
+			rates[kSelectDivider + i] = rates[source] / memory.divisor[i];
+		}
+	}
+	// divider-or gates
+	for (size_t i = 0; i < kMaxDividerOrGates; ++i) {
+		const DividerOrGateMask &mask = memory.divider_or[i];
+		selected.clear();
+		SelectFront(mask.front, rates, selected);
+		Select(mask.or_gates, kMaxOrGates, rates + kSelectOrGate, selected);
+		Select(mask.and_gates, kMaxAndGates, rates + kSelectAndGate, selected);
+		Select(mask.divider, kMaxDividers, rates + kSelectDivider, selected);
+		rates[kSelectDividerOr + i] = Sum(selected, width);
+	}
+	// divider-and gates
+	for (size_t i = 0; i < kMaxDividerAndGates; ++i) {
+		const DividerAndGateMask &mask = memory.divider_and[i];
+		selected.clear();
+		SelectFront(mask.front, rates, selected);
+		Select(mask.or_gates, kMaxOrGates, rates + kSelectOrGate, selected);
+		Select(mask.and_gates, kMaxAndGates, rates + kSelectAndGate, selected);
+		Select(mask.divider, kMaxDividers, rates + kSelectDivider, selected);
+		Select(
+			mask.divider_or, kMaxDividerOrGates,
+			rates + kSelectDividerOr, selected
+		);
+		rates[kSelectDividerAnd + i] =
+			Coincidence(selected, selected.size(), width);
+	}
+}
+
+
+SimulatedDevice::SimulatedDevice(const DeviceOption &option) noexcept
+: memory_(new Memory())
+, inputs_(option.rates)
+, width_(option.width_ns * 1e-9)
+, update_(option.update)
+, engine_(option.seed ? option.seed : std::random_device()())
+, updates_(0)
+, stop_(false) {
+
+	// registers after powered on, scaler i counts front input i
+	MemoryConfig config;
+	config.Clear();
+	memcpy(memory_.get(), config.GetMemory(), sizeof(Memory));
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		memory_->scaler[i].source = uint8_t(kSelectFront + i);
+	}
+}
+
+
+SimulatedDevice::~SimulatedDevice() noexcept {
+	Stop();
+}
+
+
+int SimulatedDevice::Open() noexcept {
+	if (!update_ || thread_.joinable()) return 0;
+	stop_ = false;
+	thread_ = std::thread([this]() {
+		using namespace std::chrono;
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!stop_) {
+			// in the middle of seconds, away from sampling at the boundary
+			auto now = system_clock::now();
+			auto next = time_point_cast<seconds>(now) + milliseconds(500);
+			if (next <= now) next += seconds(1);
+			if (stop_condition_.wait_until(lock, next, [this]() {
+				return stop_;
+			})) {
+				break;
+			}
+			Update();
+		}
+	});
+	return 0;
+}
+
+
+void SimulatedDevice::Stop() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	stop_condition_.notify_all();
+	if (thread_.joinable()) thread_.join();
+}
+
+
+volatile Memory* SimulatedDevice::Registers() noexcept {
+	return memory_.get();
+}
+
+
+std::string SimulatedDevice::Name() const noexcept {
+	return "simulated";
+}
+
+
+void SimulatedDevice::Update() noexcept {
+	// the configuration written by others in this second
+	Memory memory;
+	memcpy(&memory, (const void*)memory_.get(), sizeof(Memory));
+	double rates[kSelections];
+	SimulateRates(memory, inputs_.data(), inputs_.size(), width_, rates);
+
+	// counts of clocks are exact, others are random
+	volatile uint32_t *words = (volatile uint32_t*)(memory_->scaler);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		size_t source = memory.scaler[i].source;
+		uint32_t count = 0;
+		if (source >= kSelectClock && source < kSelectExternalClock) {
+			count = uint32_t(std::llround(rates[source]));
+		} else if (source < kSelections && rates[source] > 0.0) {
+			std::poisson_distribution<uint64_t> distribution(rates[source]);
+			count = uint32_t(distribution(engine_));
+		}
+		// Only the value bits are latched, like FPGA. The source may be
+		// written by others since the copy above, so the word is replaced
+		// only if unchanged, otherwise the value goes into the new word.
+		uint32_t old_word = words[i];
+		uint32_t word;
+		do {
+			Scaler scaler;
+			memcpy(&scaler, &old_word, sizeof(scaler));
+			scaler.value = count & kScalerValueMask;
+			memcpy(&word, &scaler, sizeof(word));
+		} while (!__atomic_compare_exchange_n(
+			words + i, &old_word, word, false,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED
+		));
+	}
+
+	// levels of front IO and gates, high for the duty cycle
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	auto levels = [&](size_t offset, size_t size) {
+		uint16_t value = 0;
+		for (size_t i = 0; i < size; ++i) {
+			if (uniform(engine_) < rates[offset + i] * width_) {
+				value |= uint16_t(1u << i);
+			}
+		}
+		return value;
+	};
+	for (size_t i = 0; i < kFrontIoGroupNum; ++i) {
+		memory_->front_value[i] =
+			levels(kSelectFront + i * kFrontIoGroupSize, kFrontIoGroupSize);
+	}
+	memory_->multi_gate_value = levels(kSelectMultiGate, kMaxMultiGates);
+	memory_->or_gate_value = levels(kSelectOrGate, kMaxOrGates);
+	memory_->and_gate_value = levels(kSelectAndGate, kMaxAndGates);
+
+	updates_.fetch_add(1);
+}
+
+
+uint64_t SimulatedDevice::Updates() const noexcept {
+	return updates_.load();
+}
+
+
+int ParseDeviceKind(const std::string &name, DeviceKind &kind) noexcept {
+	for (int i = 0; i < 3; ++i) {
+		if (name == kDeviceKindName[i]) {
+			kind = DeviceKind(i);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+
+std::unique_ptr<Device> OpenDevice(const DeviceOption &option) noexcept {
+	std::unique_ptr<Device> device;
+	if (option.kind == kUioDevice) {
+		device = std::make_unique<UioDevice>(option.path);
+	} else if (option.kind == kFileDevice) {
+		device = std::make_unique<FileDevice>(option.path);
+	} else {
+		device = std::make_unique<SimulatedDevice>(option);
+	}
+	if (device->Open()) return nullptr;
+	return device;
+}
+
+}	// namespace ecl
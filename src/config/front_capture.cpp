@@ -0,0 +1,355 @@
+#include "config/front_capture.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace ecl {
+
+namespace {
+
+/// @brief convert time to nanoseconds
+int64_t Nanoseconds(const timespec &time) noexcept {
+	return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+}	// namespace
+
+
+void ReadFrontSample(const volatile Memory *memory, FrontSample &sample) noexcept {
+	// six 16-bit reads, the registers are independent inputs and need no
+	// consistency check
+	sample.words[0] = memory->front_value[0];
+	sample.words[1] = memory->front_value[1];
+	sample.words[2] = memory->front_value[2];
+	sample.words[3] = memory->multi_gate_value;
+	sample.words[4] = memory->or_gate_value;
+	sample.words[5] = memory->and_gate_value;
+}
+
+
+void AccumulateFront(
+	const FrontSample *samples,
+	size_t size,
+	FrontStatistics &statistics,
+	bool continued
+) noexcept {
+	const FrontSample *previous = continued ? &statistics.last : nullptr;
+	for (size_t i = 0; i < size; ++i) {
+		for (size_t word = 0; word < kFrontWords; ++word) {
+			// only visit the set bits, most channels are idle
+			uint32_t bits = samples[i].words[word];
+			while (bits) {
+				++statistics.high[word * 16 + __builtin_ctz(bits)];
+				bits &= bits - 1;
+			}
+			if (!previous) continue;
+			bits = uint32_t(samples[i].words[word] ^ previous->words[word]);
+			while (bits) {
+				++statistics.transitions[word * 16 + __builtin_ctz(bits)];
+				bits &= bits - 1;
+			}
+		}
+		previous = samples + i;
+	}
+	statistics.samples += size;
+	if (size) statistics.last = samples[size - 1];
+}
+
+
+FrontReader::FrontReader(
+	const FrontCapture *capture,
+	const FrontTrigger &trigger,
+	uint64_t cursor
+) noexcept
+: capture_(capture)
+, trigger_(trigger)
+, first_(cursor)
+, cursor_(cursor)
+, dropped_(0)
+, has_level_(false)
+, level_(false)
+, triggered_(false)
+, trigger_sequence_(0) {
+}
+
+
+size_t FrontReader::Next(std::vector<FrontSample> &samples, int &trigger) noexcept {
+	samples.clear();
+	trigger = -1;
+	const uint64_t head = capture_->Head();
+	Skip(head);
+	FrontSample sample;
+
+	if (!trigger_.enable) {
+		const uint64_t end = std::min(head, cursor_ + kFrontChunkSamples);
+		for (; cursor_ < end; ++cursor_) {
+			if (capture_->Read(cursor_, sample)) {
+				samples.push_back(sample);
+			} else {
+				Drop(1);
+			}
+		}
+		return samples.size();
+	}
+
+	// look for the edge
+	while (!triggered_ && cursor_ < head) {
+		if (!capture_->Read(cursor_, sample)) {
+			Drop(1);
+			has_level_ = false;
+			++cursor_;
+			continue;
+		}
+		bool level = FrontLevel(sample, trigger_.channel);
+		if (
+			has_level_ && level != level_
+			&& (
+				trigger_.edge == kFrontAnyEdge
+				|| (trigger_.edge == kFrontRising && level)
+				|| (trigger_.edge == kFrontFalling && !level)
+			)
+		) {
+			triggered_ = true;
+			trigger_sequence_ = cursor_;
+		}
+		has_level_ = true;
+		level_ = level;
+		++cursor_;
+	}
+	// wait for the samples after trigger
+	if (!triggered_ || head <= trigger_sequence_ + trigger_.post) return 0;
+
+	uint64_t begin = trigger_sequence_ - std::min(
+		uint64_t(trigger_.pre), trigger_sequence_ - first_
+	);
+	uint64_t end = trigger_sequence_ + trigger_.post + 1;
+	has_level_ = false;
+	for (uint64_t sequence = begin; sequence < end; ++sequence) {
+		if (!capture_->Read(sequence, sample)) {
+			Drop(1);
+			continue;
+		}
+		if (sequence == trigger_sequence_) trigger = int(samples.size());
+		samples.push_back(sample);
+		// the next edge is looked for after this window
+		if (sequence + 1 == end) {
+			has_level_ = true;
+			level_ = FrontLevel(sample, trigger_.channel);
+		}
+	}
+	cursor_ = end;
+	triggered_ = false;
+	return samples.size();
+}
+
+
+uint64_t FrontReader::Dropped() const noexcept {
+	return dropped_;
+}
+
+
+void FrontReader::Skip(uint64_t head) noexcept {
+	const uint64_t capacity = capture_->Capacity();
+	if (head <= capacity) return;
+	const uint64_t oldest = head - capacity;
+	if (cursor_ >= oldest) return;
+	Drop(oldest - cursor_);
+	cursor_ = oldest;
+	has_level_ = false;
+}
+
+
+void FrontReader::Drop(uint64_t size) noexcept {
+	dropped_ += size;
+	capture_->dropped_.fetch_add(size, std::memory_order_relaxed);
+}
+
+
+FrontCapture::FrontCapture(
+	const volatile Memory *memory,
+	const FrontCaptureOption &option
+) noexcept
+: memory_(memory)
+, rate_(option.rate)
+, cpu_(option.cpu)
+, capacity_(1)
+, head_(0)
+, closed_(false)
+, stop_(false)
+, missed_(0)
+, dropped_(0) {
+
+	if (rate_ < 0) rate_ = 0;
+	// sequences map to slots by mask
+	while (capacity_ < option.capacity) capacity_ <<= 1;
+	slots_.reset(new FrontSample[capacity_]);
+	stamps_.reset(new std::atomic<uint64_t>[capacity_]);
+	for (size_t i = 0; i < capacity_; ++i) {
+		stamps_[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+
+FrontCapture::~FrontCapture() noexcept {
+	Stop();
+}
+
+
+std::shared_ptr<FrontReader> FrontCapture::Subscribe(
+	const FrontTrigger &trigger,
+	std::function<void()> notifier
+) noexcept {
+	if (trigger.enable && trigger.channel >= kFrontChannels) return nullptr;
+	FrontTrigger limited = trigger;
+	limited.pre = std::min(limited.pre, capacity_ / 2);
+	limited.post = std::min(limited.post, capacity_ / 2);
+
+	std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+	std::shared_ptr<FrontReader> reader(new FrontReader(this, limited, Head()));
+	reader->notifier_ = notifier;
+	{
+		std::lock_guard<std::mutex> lock(readers_mutex_);
+		readers_.push_back(reader);
+	}
+	if (!closed_ && rate_ > 0 && !thread_.joinable()) {
+		stop_.store(false);
+		thread_ = std::thread(&FrontCapture::Loop, this);
+	}
+	return reader;
+}
+
+
+void FrontCapture::Unsubscribe(
+	const std::shared_ptr<FrontReader> &reader
+) noexcept {
+	std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+	bool empty = false;
+	{
+		std::lock_guard<std::mutex> lock(readers_mutex_);
+		readers_.remove(reader);
+		empty = readers_.empty();
+	}
+	// the thread may be notifying, so join without holding readers_mutex_
+	if (empty && thread_.joinable()) {
+		stop_.store(true);
+		thread_.join();
+	}
+}
+
+
+void FrontCapture::Stop() noexcept {
+	std::lock_guard<std::mutex> thread_lock(thread_mutex_);
+	closed_ = true;
+	if (thread_.joinable()) {
+		stop_.store(true);
+		thread_.join();
+	}
+}
+
+
+void FrontCapture::SampleOnce() noexcept {
+	const uint64_t sequence = head_.load(std::memory_order_relaxed);
+	const size_t slot = size_t(sequence) & (capacity_ - 1);
+	FrontSample sample;
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	sample.time = Nanoseconds(now);
+	ReadFrontSample(memory_, sample);
+
+	stamps_[slot].store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slots_[slot] = sample;
+	stamps_[slot].store(sequence + 1, std::memory_order_release);
+	head_.store(sequence + 1, std::memory_order_release);
+}
+
+
+uint64_t FrontCapture::Head() const noexcept {
+	return head_.load(std::memory_order_acquire);
+}
+
+
+bool FrontCapture::Read(uint64_t sequence, FrontSample &sample) const noexcept {
+	const size_t slot = size_t(sequence) & (capacity_ - 1);
+	uint64_t begin = stamps_[slot].load(std::memory_order_acquire);
+	if (begin != sequence + 1) return false;
+	sample = slots_[slot];
+	std::atomic_thread_fence(std::memory_order_acquire);
+	// not overwritten during copying
+	return stamps_[slot].load(std::memory_order_relaxed) == begin;
+}
+
+
+size_t FrontCapture::Capacity() const noexcept {
+	return capacity_;
+}
+
+
+FrontCaptureMetrics FrontCapture::Metrics() const noexcept {
+	FrontCaptureMetrics metrics;
+	metrics.samples = Head();
+	metrics.missed = missed_.load(std::memory_order_relaxed);
+	metrics.dropped = dropped_.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(readers_mutex_);
+	metrics.readers = readers_.size();
+	return metrics;
+}
+
+
+void FrontCapture::Loop() noexcept {
+	if (cpu_ >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu_, &cpus);
+		int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (result) {
+			std::cout << "[Error] Pin front capture to CPU " << cpu_
+				<< " failed: " << strerror(result) << "\n";
+		}
+	}
+
+	const int64_t period = 1000000000 / rate_;
+	const int notify_period = std::max(1, rate_ / kFrontNotifyRate);
+	int countdown = notify_period;
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t next = Nanoseconds(now);
+	while (!stop_.load(std::memory_order_relaxed)) {
+		next += period;
+		timespec deadline;
+		deadline.tv_sec = time_t(next / 1000000000);
+		deadline.tv_nsec = long(next % 1000000000);
+		while (
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr)
+			== EINTR
+		);
+		// skip the periods passed, instead of sampling in a burst
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t late = Nanoseconds(now) - next;
+		if (late >= period) {
+			missed_.fetch_add(uint64_t(late / period), std::memory_order_relaxed);
+			next += late / period * period;
+		}
+		SampleOnce();
+		if (--countdown == 0) {
+			countdown = notify_period;
+			Notify();
+		}
+	}
+}
+
+
+void FrontCapture::Notify() noexcept {
+	std::lock_guard<std::mutex> lock(readers_mutex_);
+	for (const auto &reader : readers_) {
+		if (reader->notifier_) reader->notifier_();
+	}
+}
+
+}	// namespace ecl
@@ -1,5 +1,8 @@
 #include "config/memory_config.h"
 
+#include <unistd.h>
+
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iomanip>
@@ -8,6 +11,92 @@
 
 namespace ecl {
 
+namespace {
+
+const size_t kMemoryWords = sizeof(Memory) / sizeof(uint32_t);
+
+static_assert(
+	sizeof(Memory) % sizeof(uint32_t) == 0,
+	"Memory should be made of 32-bit words"
+);
+static_assert(
+	offsetof(Memory, multi_gate_value) % sizeof(uint32_t) == 0
+		&& offsetof(Memory, or_gate_value) % sizeof(uint32_t) == 0
+		&& offsetof(Memory, and_gate_value) % sizeof(uint32_t) == 0,
+	"Gate values should not share words with configuration"
+);
+
+
+/// @brief clear mask of bytes in range
+/// @param[in] begin offset of the first byte
+/// @param[in] end offset after the last byte
+/// @param[inout] masks masks of each word
+///
+void ClearMask(size_t begin, size_t end, uint32_t *masks) noexcept {
+	uint8_t *bytes = (uint8_t*)masks;
+	for (size_t i = begin; i < end; ++i) bytes[i] = 0;
+}
+
+
+/// @brief masks of configuration bits in each word
+/// @param[out] masks kMemoryWords masks, bits of live values are cleared
+///
+void ConfigMasks(uint32_t *masks) noexcept {
+	for (size_t i = 0; i < kMemoryWords; ++i) masks[i] = 0xffffffff;
+	// I2C is driven bit by bit, and the adder is for test
+	ClearMask(offsetof(Memory, i2c), offsetof(Memory, rj45_enable), masks);
+	// values of front IO and gates
+	ClearMask(
+		offsetof(Memory, front_value), offsetof(Memory, multi_gates), masks
+	);
+	ClearMask(
+		offsetof(Memory, multi_gate_value), offsetof(Memory, or_gates), masks
+	);
+	ClearMask(
+		offsetof(Memory, or_gate_value), offsetof(Memory, and_gates), masks
+	);
+	ClearMask(
+		offsetof(Memory, and_gate_value), offsetof(Memory, divider_source), masks
+	);
+	// counts of scalers
+	Scaler scaler;
+	memset(&scaler, 0, sizeof(scaler));
+	scaler.value = 0xfffff;
+	uint32_t value_mask;
+	memcpy(&value_mask, &scaler, sizeof(value_mask));
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		masks[offsetof(Memory, scaler) / sizeof(uint32_t) + i] &= ~value_mask;
+	}
+}
+
+
+/// @brief check whether changing the word needs reset
+/// @param[in] word index of word
+/// @returns true if the word holds divider or clock divider registers
+///
+bool NeedReset(size_t word) noexcept {
+	const size_t offset = word * sizeof(uint32_t);
+	return (
+		offset + sizeof(uint32_t) > offsetof(Memory, divider_source)
+		&& offset < offsetof(Memory, divider_or)
+	) || (
+		offset + sizeof(uint32_t) > offsetof(Memory, clock_divider_source)
+		&& offset < offsetof(Memory, scaler)
+	);
+}
+
+
+/// @brief read all registers
+/// @param[in] map address of mapped shared memory
+/// @param[out] words kMemoryWords words
+///
+void ReadImage(const volatile uint32_t *map, uint32_t *words) noexcept {
+	for (size_t i = 0; i < kMemoryWords; ++i) words[i] = map[i];
+}
+
+}	// namespace
+
+
 MemoryConfig::MemoryConfig() noexcept {
 }
 
@@ -741,11 +830,92 @@ void MemoryConfig::Print(std::ostream &os, bool print_tips) const noexcept {
 
 
 
-int MemoryConfig::MapMemory(volatile uint32_t *map) const noexcept {
+int MemoryConfig::MapMemory(
+	volatile uint32_t *map,
+	MapResult *result
+) const noexcept {
+	MapResult local;
+	if (!result) result = &local;
+	result->words = kMemoryWords;
+	result->rj45_groups = 6;
+	result->rj45_failures = 0;
+	result->i2c_ns = 0;
+	result->reset = true;
+	result->full = true;
+
 	memcpy((void*)map, &memory_, sizeof(memory_));
-	for (size_t i = 0; i < 6; ++i) EnableRj45(map, i);
+	MappedI2cPort port(map);
+	I2cEngine engine(port);
+	for (size_t i = 0; i < 6; ++i) {
+		I2cTiming timing = {};
+		if (EnableRj45(engine, i, &timing)) {
+			fprintf(stderr, "Error: Enable RJ45 port group %zu failed.\n", i);
+			++result->rj45_failures;
+		}
+		result->i2c_ns += timing.duration_ns;
+	}
 	Reset(map);
-	return 0;
+	return result->rj45_failures ? -1 : 0;
+}
+
+
+int MemoryConfig::MapMemoryDifferential(
+	volatile uint32_t *map,
+	MapResult *result
+) const noexcept {
+	uint32_t masks[kMemoryWords];
+	ConfigMasks(masks);
+
+	MapResult local;
+	if (!result) result = &local;
+	result->words = 0;
+	result->rj45_groups = 0;
+	result->rj45_failures = 0;
+	result->i2c_ns = 0;
+	result->reset = false;
+	result->full = false;
+
+	uint32_t target[kMemoryWords];
+	memcpy(target, &memory_, sizeof(target));
+	uint32_t current[kMemoryWords];
+	ReadImage(map, current);
+	Memory current_memory;
+	memcpy(&current_memory, current, sizeof(current_memory));
+
+	bool reset = false;
+	for (size_t i = 0; i < kMemoryWords; ++i) {
+		if (((current[i] ^ target[i]) & masks[i]) == 0) continue;
+		map[i] = target[i];
+		++result->words;
+		if (NeedReset(i)) reset = true;
+	}
+	// registers not read back as written, so the image can't be trusted
+	ReadImage(map, current);
+	for (size_t i = 0; i < kMemoryWords; ++i) {
+		if (((current[i] ^ target[i]) & masks[i]) == 0) continue;
+		return MapMemory(map, result);
+	}
+
+	MappedI2cPort port(map);
+	I2cEngine engine(port);
+	for (size_t i = 0; i < 6; ++i) {
+		uint8_t enable = uint8_t(
+			current_memory.rj45_enable[i/2] >> (i % 2 * 8)
+		);
+		if (enable == Rj45Enable(i)) continue;
+		I2cTiming timing = {};
+		if (EnableRj45(engine, i, &timing)) {
+			fprintf(stderr, "Error: Enable RJ45 port group %zu failed.\n", i);
+			++result->rj45_failures;
+		}
+		++result->rj45_groups;
+		result->i2c_ns += timing.duration_ns;
+	}
+	if (reset) {
+		Reset(map);
+		result->reset = true;
+	}
+	return result->rj45_failures ? -1 : 0;
 }
 
 
@@ -753,39 +923,44 @@ void MemoryConfig::EnableRj45(
 	volatile uint32_t *map,
 	uint32_t index
 ) const noexcept {
-	I2C_Start(map);
+	MappedI2cPort port(map);
+	I2cEngine engine(port);
+	EnableRj45(engine, index);
+}
+
 
+int MemoryConfig::EnableRj45(
+	I2cEngine &engine,
+	uint32_t index,
+	I2cTiming *timing
+) const noexcept {
+	// 7-bit addresses of I/O expanders
 	uint8_t address;
 	switch (index) {
 		case 0:
-			address = 0b01001000;
+			address = 0b0100100;
 			break;
 		case 1:
-			address = 0b01000000;
+			address = 0b0100000;
 			break;
 		case 2:
-			address = 0b01001010;
+			address = 0b0100101;
 			break;
 		case 3:
-			address = 0b01000010;
+			address = 0b0100001;
 			break;
 		case 4:
-			address = 0b01001100;
+			address = 0b0100110;
 			break;
 		case 5:
-			address = 0b01000100;
+			address = 0b0100010;
 			break;
 		default:
 			fprintf(stderr, "Error: Invalid index %u\n", index);
-			return;
+			return -1;
 	}
-	I2C_Byte_Send(map, address);
-	I2C_Slave_Ack(map);
-
-	I2C_Byte_Send(map, Rj45Enable(index));
-	I2C_Slave_Ack(map);
-
-	I2C_Stop(map);
+	uint8_t enable = Rj45Enable(index);
+	return engine.Write(address, &enable, 1, timing);
 }
 
 
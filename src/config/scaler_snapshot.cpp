@@ -0,0 +1,58 @@
+#include "config/scaler_snapshot.h"
+
+#include <cstring>
+
+namespace ecl {
+
+static_assert(
+	sizeof(Scaler) == sizeof(uint32_t),
+	"Scaler register should be one 32-bit word"
+);
+static_assert(
+	offsetof(Memory, scaler) % sizeof(uint32_t) == 0,
+	"Scaler registers should be aligned to 32-bit words"
+);
+
+
+namespace {
+
+/// @brief copy all scaler registers in consecutive word reads
+inline void ReadBurst(const volatile uint32_t *registers, uint32_t *words) noexcept {
+	for (size_t i = 0; i < kMaxScalers; ++i) words[i] = registers[i];
+}
+
+}	// namespace
+
+
+int ReadScalerSnapshot(
+	const volatile Memory *memory,
+	ScalerSnapshot &snapshot,
+	int max_bursts
+) noexcept {
+	const volatile uint32_t *registers =
+		(const volatile uint32_t*)(memory->scaler);
+	uint32_t words[2][kMaxScalers];
+	ReadBurst(registers, words[0]);
+	int bursts = 1;
+	int last = 0;
+	bool agreed = false;
+	while (bursts < max_bursts || bursts < 2) {
+		last = bursts % 2;
+		ReadBurst(registers, words[last]);
+		++bursts;
+		if (memcmp(words[0], words[1], sizeof(words[0])) == 0) {
+			agreed = true;
+			break;
+		}
+	}
+	// decode bit fields from the copy in memory
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		Scaler scaler;
+		memcpy(&scaler, words[last] + i, sizeof(scaler));
+		snapshot.values[i] = scaler.value;
+	}
+	snapshot.bursts = bursts;
+	return agreed ? 0 : -1;
+}
+
+}	// namespace ecl
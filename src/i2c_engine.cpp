@@ -0,0 +1,166 @@
+#include "i2c_engine.h"
+
+#include <time.h>
+
+#include <algorithm>
+
+namespace ecl {
+
+namespace {
+
+// accesses measured to get the minimum edge time
+const int kCalibrateRounds = 64;
+
+
+inline int64_t Now() noexcept {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+}	// namespace
+
+
+MappedI2cPort::MappedI2cPort(volatile uint32_t *map) noexcept
+: map_(map) {
+}
+
+
+void MappedI2cPort::Write(uint32_t value) noexcept {
+	map_[0] = value;
+}
+
+
+uint32_t MappedI2cPort::Read() noexcept {
+	return map_[1];
+}
+
+
+I2cEngine::I2cEngine(I2cPort &port, uint32_t edge_ns) noexcept
+: port_(port)
+, min_edge_ns_(0)
+, edge_ns_(edge_ns)
+, last_edge_(0)
+, edges_(0)
+, metrics_() {
+
+	// reading the output register never changes the bus
+	int64_t start = Now();
+	for (int i = 0; i < kCalibrateRounds; ++i) {
+		port_.Read();
+		Now();
+	}
+	min_edge_ns_ = uint32_t((Now() - start) / kCalibrateRounds);
+	edge_ns_ = std::max(edge_ns_, min_edge_ns_);
+}
+
+
+uint32_t I2cEngine::MinEdgeNs() const noexcept {
+	return min_edge_ns_;
+}
+
+
+uint32_t I2cEngine::EdgeNs() const noexcept {
+	return edge_ns_;
+}
+
+
+I2cEngineMetrics I2cEngine::Metrics() const noexcept {
+	return metrics_;
+}
+
+
+void I2cEngine::Wait() noexcept {
+	const int64_t deadline = last_edge_ + edge_ns_;
+	int64_t now = Now();
+	// sleep only for long waits, the kernel wakes up late
+	if (deadline - now > int64_t(kI2cSleepNs)) {
+		timespec time;
+		time.tv_sec = time_t((deadline - kI2cSleepNs) / 1000000000);
+		time.tv_nsec = long((deadline - kI2cSleepNs) % 1000000000);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr);
+	}
+	while (now < deadline) now = Now();
+}
+
+
+void I2cEngine::Edge(uint32_t value) noexcept {
+	Wait();
+	port_.Write(value);
+	last_edge_ = Now();
+	++edges_;
+}
+
+
+void I2cEngine::Start() noexcept {
+	// SDA falls while SCL is high
+	Edge(kI2cControl | kI2cScl | kI2cSda);
+	Edge(kI2cControl | kI2cScl);
+}
+
+
+void I2cEngine::Stop() noexcept {
+	// SDA rises while SCL is high
+	Edge(kI2cControl);
+	Edge(kI2cControl | kI2cScl);
+	Edge(kI2cControl | kI2cScl | kI2cSda);
+	Wait();
+}
+
+
+bool I2cEngine::Send(uint8_t data) noexcept {
+	// SDA is captured during the low to high transition of SCL
+	uint32_t value = kI2cControl;
+	for (size_t i = 0; i < 8; ++i) {
+		value &= ~kI2cScl;
+		Edge(value);
+		value = kI2cControl | ((data >> (7 - i)) & 1 ? kI2cSda : 0);
+		Edge(value);
+		value |= kI2cScl;
+		Edge(value);
+	}
+	Edge(value & ~kI2cScl);
+
+	// release SDA and clock the acknowledge from slave
+	Edge(0);
+	Edge(kI2cScl);
+	Wait();
+	bool ack = (port_.Read() & kI2cSdaIn) == 0;
+	Edge(0);
+	return ack;
+}
+
+
+int I2cEngine::Write(
+	uint8_t address,
+	const uint8_t *data,
+	size_t size,
+	I2cTiming *timing
+) noexcept {
+	edges_ = 0;
+	last_edge_ = 0;
+	const int64_t start = Now();
+	size_t nacks = 0;
+	Start();
+	// R/W bit 0 to write
+	if (!Send(uint8_t(address << 1))) ++nacks;
+	for (size_t i = 0; i < size; ++i) {
+		if (!Send(data[i])) ++nacks;
+	}
+	Stop();
+	const uint64_t duration = uint64_t(Now() - start);
+
+	++metrics_.transactions;
+	metrics_.nacks += nacks;
+	metrics_.total_ns += duration;
+	metrics_.max_ns = std::max(metrics_.max_ns, duration);
+	metrics_.last_ns = duration;
+	if (timing) {
+		timing->duration_ns = duration;
+		timing->edges = edges_;
+		timing->nacks = nacks;
+	}
+	return nacks ? -1 : 0;
+}
+
+}	// namespace ecl
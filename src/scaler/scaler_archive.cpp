@@ -0,0 +1,377 @@
+#include "scaler/scaler_archive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace ecl {
+
+namespace {
+
+// entries in index, the last one is the end of data
+const size_t kArchiveIndexSize = kArchiveBlocks * kMaxScalers + 1;
+
+
+inline uint32_t ZigZag(uint32_t delta) noexcept {
+	return (delta << 1) ^ ((delta & 0x80000000u) ? 0xffffffffu : 0);
+}
+
+
+inline uint32_t UnZigZag(uint32_t value) noexcept {
+	return (value >> 1) ^ ((value & 1) ? 0xffffffffu : 0);
+}
+
+
+/// @brief compress values of one column into frames
+void EncodeColumn(
+	const uint32_t *values,
+	size_t size,
+	std::vector<uint8_t> &output
+) {
+	uint32_t deltas[kArchiveFrameSize];
+	for (size_t begin = 0; begin < size; begin += kArchiveFrameSize) {
+		const size_t count = std::min(kArchiveFrameSize, size - begin);
+		const uint32_t *frame = values + begin;
+		// bit width of the largest delta
+		uint32_t bits = 0;
+		for (size_t i = 1; i < count; ++i) {
+			deltas[i] = ZigZag(frame[i] - frame[i-1]);
+			bits |= deltas[i];
+		}
+		uint8_t width = 0;
+		while (width < 32 && (bits >> width)) ++width;
+		output.push_back(width);
+		// first value in varint
+		uint32_t first = frame[0];
+		while (first >= 0x80) {
+			output.push_back(uint8_t(first | 0x80));
+			first >>= 7;
+		}
+		output.push_back(uint8_t(first));
+		// pack deltas from the lowest bit
+		uint64_t buffer = 0;
+		int filled = 0;
+		for (size_t i = 1; i < count; ++i) {
+			buffer |= uint64_t(deltas[i]) << filled;
+			filled += width;
+			while (filled >= 8) {
+				output.push_back(uint8_t(buffer));
+				buffer >>= 8;
+				filled -= 8;
+			}
+		}
+		if (filled > 0) output.push_back(uint8_t(buffer));
+	}
+}
+
+
+/// @brief skip one frame without decoding
+/// @returns pointer to the next frame
+inline const uint8_t* SkipFrame(const uint8_t *frame, size_t count) noexcept {
+	const size_t width = *frame++;
+	while (*frame & 0x80) ++frame;
+	++frame;
+	return frame + ((count - 1) * width + 7) / 8;
+}
+
+
+/// @brief decode one frame
+/// @returns pointer to the next frame
+const uint8_t* DecodeFrame(
+	const uint8_t *frame,
+	size_t count,
+	uint32_t *values
+) noexcept {
+	// width is never larger than 32 in valid file
+	const int width = std::min(int(*frame++), 32);
+	uint32_t value = 0;
+	for (int shift = 0; ; shift += 7) {
+		value |= uint32_t(*frame & 0x7f) << shift;
+		if (!(*frame++ & 0x80)) break;
+	}
+	values[0] = value;
+	const uint64_t mask = (uint64_t(1) << width) - 1;
+	uint64_t buffer = 0;
+	int filled = 0;
+	for (size_t i = 1; i < count; ++i) {
+		while (filled < width) {
+			buffer |= uint64_t(*frame++) << filled;
+			filled += 8;
+		}
+		value += UnZigZag(uint32_t(buffer & mask));
+		buffer >>= width;
+		filled -= width;
+		values[i] = value;
+	}
+	return frame;
+}
+
+
+/// @brief write all bytes to file
+/// @returns 0 on success, -1 on failure
+int WriteAll(int fd, const void *buffer, size_t size) {
+	const uint8_t *data = (const uint8_t*)buffer;
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		data += written;
+		size -= written;
+	}
+	return 0;
+}
+
+}	// namespace
+
+
+std::string ScalerArchiveFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept {
+	std::string name = ScalerFileName(data_path, device_name, date);
+	// replace the extension .bin
+	return name.substr(0, name.length()-4) + ".sca";
+}
+
+
+ScalerArchive::ScalerArchive() noexcept
+: fd_(-1)
+, size_(0)
+, map_(nullptr)
+, index_(nullptr)
+, data_(nullptr) {
+}
+
+
+ScalerArchive::~ScalerArchive() noexcept {
+	Close();
+}
+
+
+int ScalerArchive::Create(
+	const ScalerFile &day,
+	const std::string &name,
+	const std::function<void(size_t)> &progress
+) noexcept {
+	if (!day.IsOpen()) return -1;
+	std::vector<uint32_t> index(kArchiveIndexSize);
+	std::vector<uint8_t> data;
+	// columns of one block
+	std::vector<uint32_t> columns(kScalerBlockSeconds * kMaxScalers);
+	uint32_t row[kMaxScalers];
+	for (size_t block = 0; block < kArchiveBlocks; ++block) {
+		for (size_t second = 0; second < kScalerBlockSeconds; ++second) {
+			day.ReadRow(block * kScalerBlockSeconds + second, row);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				columns[i * kScalerBlockSeconds + second] = row[i];
+			}
+		}
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			index[block * kMaxScalers + i] = uint32_t(data.size());
+			EncodeColumn(
+				columns.data() + i * kScalerBlockSeconds, kScalerBlockSeconds, data
+			);
+		}
+		if (progress) progress(kScalerBlockSeconds * kMaxScalers * sizeof(uint32_t));
+	}
+	index[kArchiveIndexSize-1] = uint32_t(data.size());
+
+	ScalerArchiveHeader header;
+	header.version = 1;
+	header.number = kMaxScalers;
+	header.blocks = kArchiveBlocks;
+	header.data_size = uint32_t(data.size());
+
+	// write to temporary file and replace
+	std::string temporary = name + ".tmp";
+	int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		std::cout << "[Error] Create file " << temporary << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	if (
+		WriteAll(fd, &header, sizeof(header))
+		|| WriteAll(fd, index.data(), index.size() * sizeof(uint32_t))
+		|| WriteAll(fd, data.data(), data.size())
+		|| fsync(fd)
+	) {
+		std::cout << "[Error] Write file " << temporary << " failed: "
+			<< strerror(errno) << "\n";
+		close(fd);
+		unlink(temporary.c_str());
+		return -1;
+	}
+	close(fd);
+	if (rename(temporary.c_str(), name.c_str())) {
+		std::cout << "[Error] Replace file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		unlink(temporary.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+
+int ScalerArchive::Extract(
+	const std::string &archive_name,
+	const std::string &name,
+	uint8_t version
+) noexcept {
+	ScalerArchive archive;
+	int result = archive.Open(archive_name);
+	if (result) return result;
+
+	std::string temporary = name + ".tmp";
+	unlink(temporary.c_str());
+	ScalerFile day;
+	if (day.Open(temporary, true, true, version)) return -1;
+	std::vector<uint32_t> rows(kScalerBlockSeconds * kMaxScalers);
+	for (size_t block = 0; block < kArchiveBlocks; ++block) {
+		const size_t first = block * kScalerBlockSeconds;
+		archive.ReadRows(first, kScalerBlockSeconds, rows.data());
+		for (size_t second = 0; second < kScalerBlockSeconds; ++second) {
+			day.WriteRow(first + second, rows.data() + second * kMaxScalers);
+		}
+	}
+	day.Close();
+	if (rename(temporary.c_str(), name.c_str())) {
+		std::cout << "[Error] Replace file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		unlink(temporary.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+
+int ScalerArchive::Open(const std::string &name) noexcept {
+	Close();
+	if (access(name.c_str(), F_OK)) return -2;
+
+	fd_ = open(name.c_str(), O_RDONLY);
+	if (fd_ < 0) {
+		std::cout << "[Error] Open file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	// check size
+	const size_t data_offset =
+		sizeof(ScalerArchiveHeader) + kArchiveIndexSize * sizeof(uint32_t);
+	struct stat file_stat;
+	if (fstat(fd_, &file_stat) || size_t(file_stat.st_size) < data_offset) {
+		std::cout << "[Error] Invalid size of archive file " << name << "\n";
+		Close();
+		return -1;
+	}
+	size_ = file_stat.st_size;
+	// map
+	void *map = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+	if (map == MAP_FAILED) {
+		std::cout << "[Error] Map file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		Close();
+		return -1;
+	}
+	map_ = (uint8_t*)map;
+	// check header and index
+	const ScalerArchiveHeader *header = (const ScalerArchiveHeader*)map_;
+	index_ = (const uint32_t*)(map_ + sizeof(ScalerArchiveHeader));
+	data_ = map_ + data_offset;
+	bool valid = header->version == 1
+		&& header->number == kMaxScalers
+		&& header->blocks == kArchiveBlocks
+		&& data_offset + header->data_size == size_
+		&& index_[0] == 0
+		&& index_[kArchiveIndexSize-1] == header->data_size;
+	for (size_t i = 1; valid && i < kArchiveIndexSize; ++i) {
+		if (index_[i] < index_[i-1]) valid = false;
+	}
+	if (!valid) {
+		std::cout << "[Error] Invalid header of archive file " << name << "\n";
+		Close();
+		return -1;
+	}
+	name_ = name;
+	return 0;
+}
+
+
+void ScalerArchive::Close() noexcept {
+	if (map_) munmap(map_, size_);
+	if (fd_ >= 0) close(fd_);
+	fd_ = -1;
+	size_ = 0;
+	map_ = nullptr;
+	index_ = nullptr;
+	data_ = nullptr;
+}
+
+
+void ScalerArchive::ReadColumn(
+	size_t second,
+	size_t size,
+	size_t index,
+	uint32_t *values
+) const noexcept {
+	uint32_t decoded[kArchiveFrameSize];
+	while (size > 0) {
+		const size_t block = second / kScalerBlockSeconds;
+		const size_t offset = second % kScalerBlockSeconds;
+		const size_t count = std::min(size, kScalerBlockSeconds - offset);
+		// skip frames before the first second
+		const uint8_t *frame = data_ + index_[block * kMaxScalers + index];
+		size_t frame_index = offset / kArchiveFrameSize;
+		for (size_t i = 0; i < frame_index; ++i) {
+			frame = SkipFrame(frame, kArchiveFrameSize);
+		}
+		// decode frames covering the seconds
+		for (size_t done = 0; done < count; ++frame_index) {
+			const size_t frame_begin = frame_index * kArchiveFrameSize;
+			const size_t frame_size =
+				std::min(kArchiveFrameSize, kScalerBlockSeconds - frame_begin);
+			frame = DecodeFrame(frame, frame_size, decoded);
+			const size_t from = offset + done - frame_begin;
+			const size_t copy = std::min(frame_size - from, count - done);
+			memcpy(values + done, decoded + from, copy * sizeof(uint32_t));
+			done += copy;
+		}
+		second += count;
+		size -= count;
+		values += count;
+	}
+}
+
+
+void ScalerArchive::ReadRows(
+	size_t second,
+	size_t size,
+	uint32_t *rows
+) const noexcept {
+	// decode columns in chunks and scatter to rows
+	const size_t chunk_size = 256;
+	uint32_t column[chunk_size];
+	for (size_t begin = 0; begin < size; begin += chunk_size) {
+		const size_t count = std::min(chunk_size, size - begin);
+		uint32_t *chunk_rows = rows + begin * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			ReadColumn(second + begin, count, i, column);
+			for (size_t row = 0; row < count; ++row) {
+				chunk_rows[row * kMaxScalers + i] = column[row];
+			}
+		}
+	}
+}
+
+}	// namespace ecl
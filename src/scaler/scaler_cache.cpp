@@ -0,0 +1,113 @@
+#include "scaler/scaler_cache.h"
+
+namespace ecl {
+
+ScalerCache::ScalerCache(size_t max_bytes) noexcept
+: max_bytes_(max_bytes)
+, uses_(0)
+, metrics_() {
+
+}
+
+
+int ScalerCache::Get(
+	const ScalerCacheKey &key,
+	const std::function<int(ScalerCacheValue&)> &compute,
+	std::shared_ptr<const ScalerCacheValue> &value
+) noexcept {
+	std::unique_lock<std::mutex> lock(mutex_);
+	Expire(key);
+	auto search = entries_.find(key);
+	if (search != entries_.end()) {
+		// keep the entry even if it is removed while waiting
+		std::shared_ptr<Entry> entry = search->second;
+		if (entry->ready) {
+			++metrics_.hits;
+		} else {
+			++metrics_.coalesced;
+			ready_condition_.wait(lock, [&entry]() { return entry->ready; });
+		}
+		entry->used = ++uses_;
+		value = entry->value;
+		return entry->result;
+	}
+
+	++metrics_.misses;
+	std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+	entry->ready = false;
+	entry->result = 0;
+	entry->bytes = 0;
+	entry->used = ++uses_;
+	entries_.emplace(key, entry);
+	lock.unlock();
+
+	// compute without lock, other keys are served meanwhile
+	std::shared_ptr<ScalerCacheValue> computed =
+		std::make_shared<ScalerCacheValue>();
+	int result = compute(*computed);
+
+	lock.lock();
+	entry->ready = true;
+	entry->result = result;
+	if (result) {
+		entries_.erase(key);
+	} else {
+		entry->value = computed;
+		entry->bytes = sizeof(Entry) + sizeof(ScalerCacheValue)
+			+ computed->values.size() * sizeof(uint32_t);
+		++metrics_.entries;
+		metrics_.bytes += entry->bytes;
+		Evict();
+	}
+	ready_condition_.notify_all();
+	value = entry->value;
+	return result;
+}
+
+
+ScalerCacheMetrics ScalerCache::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return metrics_;
+}
+
+
+void ScalerCache::Expire(const ScalerCacheKey &key) noexcept {
+	// keys are ordered by time and version first
+	for (
+		auto iter = entries_.begin();
+		iter != entries_.end() && iter->first.Before(key);
+	) {
+		// the computing entries are removed by their computation
+		if (!iter->second->ready) {
+			++iter;
+			continue;
+		}
+		--metrics_.entries;
+		metrics_.bytes -= iter->second->bytes;
+		++metrics_.expired;
+		iter = entries_.erase(iter);
+	}
+}
+
+
+void ScalerCache::Evict() noexcept {
+	while (metrics_.bytes > max_bytes_) {
+		auto oldest = entries_.end();
+		for (auto iter = entries_.begin(); iter != entries_.end(); ++iter) {
+			if (!iter->second->ready) continue;
+			if (
+				oldest == entries_.end()
+				|| iter->second->used < oldest->second->used
+			) {
+				oldest = iter;
+			}
+		}
+		if (oldest == entries_.end()) return;
+		--metrics_.entries;
+		metrics_.bytes -= oldest->second->bytes;
+		++metrics_.evicted;
+		entries_.erase(oldest);
+	}
+}
+
+}	// namespace ecl
@@ -0,0 +1,98 @@
+#include "scaler/scaler_executor.h"
+
+#include <algorithm>
+
+namespace ecl {
+
+ScalerExecutor::ScalerExecutor(const ScalerExecutorOption &option) noexcept
+: queue_size_(option.queue)
+, stopping_(false)
+, metrics_() {
+
+	const size_t threads = std::max(option.threads, size_t(1));
+	for (size_t i = 0; i < threads; ++i) {
+		workers_.emplace_back(&ScalerExecutor::Work, this);
+	}
+}
+
+
+ScalerExecutor::~ScalerExecutor() noexcept {
+	Stop();
+}
+
+
+int ScalerExecutor::Submit(
+	std::function<void(bool)> task,
+	std::function<bool()> cancelled
+) noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		// tasks taken by idle workers soon are not waiting in the queue
+		const size_t idle = workers_.size() - size_t(metrics_.running);
+		if (stopping_ || tasks_.size() >= queue_size_ + idle) {
+			++metrics_.rejected;
+			return -1;
+		}
+		tasks_.push_back(Task{
+			std::move(task), std::move(cancelled),
+			std::chrono::steady_clock::now()
+		});
+		++metrics_.submitted;
+		metrics_.queued = tasks_.size();
+	}
+	condition_.notify_one();
+	return 0;
+}
+
+
+void ScalerExecutor::Stop() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	condition_.notify_all();
+	// the workers call all queued tasks as cancelled before leaving
+	for (std::thread &worker : workers_) {
+		if (worker.joinable()) worker.join();
+	}
+}
+
+
+ScalerExecutorMetrics ScalerExecutor::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return metrics_;
+}
+
+
+void ScalerExecutor::Work() noexcept {
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		condition_.wait(lock, [this]() {
+			return stopping_ || !tasks_.empty();
+		});
+		if (tasks_.empty()) return;
+		Task task = std::move(tasks_.front());
+		tasks_.pop_front();
+		const bool stopping = stopping_;
+		const uint64_t wait = uint64_t(
+			std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - task.submit_time
+			).count()
+		);
+		metrics_.queued = tasks_.size();
+		++metrics_.running;
+		metrics_.max_wait_us = std::max(metrics_.max_wait_us, wait);
+		metrics_.total_wait_us += wait;
+		lock.unlock();
+
+		bool cancelled = stopping || (task.cancelled && task.cancelled());
+		task.run(cancelled);
+
+		lock.lock();
+		--metrics_.running;
+		++metrics_.completed;
+		if (cancelled) ++metrics_.cancelled;
+	}
+}
+
+}	// namespace ecl
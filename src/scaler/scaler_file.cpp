@@ -0,0 +1,326 @@
+#include "scaler/scaler_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace ecl {
+
+namespace {
+
+/// @brief write zeros to the file
+/// @param[in] fd file descriptor
+/// @param[in] offset offset to write from
+/// @param[in] size bytes of the whole file
+/// @returns 0 on success, or the errno on failure
+///
+int WriteZeros(int fd, size_t offset, size_t size) noexcept {
+	static const char zeros[65536] = {};
+	while (offset < size) {
+		size_t length = std::min(sizeof(zeros), size - offset);
+		ssize_t written = pwrite(fd, zeros, length, off_t(offset));
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return errno;
+		}
+		offset += size_t(written);
+	}
+	return 0;
+}
+
+
+/// @brief write the content back to the file to allocate its blocks
+/// @param[in] fd file descriptor
+/// @param[in] size bytes of the whole file
+/// @returns 0 on success, or the errno on failure
+///
+int Rewrite(int fd, size_t size) noexcept {
+	char buffer[65536];
+	size_t offset = 0;
+	while (offset < size) {
+		size_t length = std::min(sizeof(buffer), size - offset);
+		ssize_t got = pread(fd, buffer, length, off_t(offset));
+		if (got < 0 && errno == EINTR) continue;
+		if (got <= 0) return got < 0 ? errno : EIO;
+		for (size_t done = 0; done < size_t(got);) {
+			ssize_t written = pwrite(
+				fd, buffer + done, size_t(got) - done, off_t(offset + done)
+			);
+			if (written < 0) {
+				if (errno == EINTR) continue;
+				return errno;
+			}
+			done += size_t(written);
+		}
+		offset += size_t(got);
+	}
+	return 0;
+}
+
+}	// namespace
+
+
+std::string ScalerFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept {
+	std::stringstream file_name("");
+	file_name << data_path << date->tm_year+1900
+		<< std::setw(2) << std::setfill('0') << date->tm_mon+1
+		<< std::setw(2) << std::setfill('0') << date->tm_mday
+		<< (device_name.empty() ? "" : "-"+device_name)
+		<< ".bin";
+	return file_name.str();
+}
+
+
+int CreateSizedFile(
+	const std::string &name,
+	const void *header,
+	size_t header_size,
+	size_t size
+) noexcept {
+	// created by others
+	if (!access(name.c_str(), F_OK)) return 0;
+	std::string temporary = name + ".tmp";
+	int fd = open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		std::cout << "[Error] Create file " << temporary << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	bool failed = false;
+	// write header
+	if (write(fd, header, header_size) != ssize_t(header_size)) {
+		std::cout << "[Error] Write header of " << name << " failed: "
+			<< strerror(errno) << "\n";
+		failed = true;
+	}
+	// Reserve all blocks, the file is written through shared mapping later
+	// and a page without block raises SIGBUS on full disk instead of error.
+	// Write zeros if the file system does not support allocation.
+	if (!failed) {
+		int result = posix_fallocate(fd, 0, size);
+		if (result == EOPNOTSUPP || result == EINVAL) {
+			result = WriteZeros(fd, header_size, size);
+		}
+		if (result) {
+			std::cout << "[Error] Allocate file " << name << " failed: "
+				<< strerror(result) << "\n";
+			failed = true;
+		}
+	}
+	close(fd);
+	if (failed) {
+		unlink(temporary.c_str());
+		return -1;
+	}
+
+	// link never replaces the file created by others meanwhile, and rename
+	// is the fallback for file systems without hard links
+	if (link(temporary.c_str(), name.c_str())) {
+		if (errno == EEXIST) {
+			unlink(temporary.c_str());
+			return 0;
+		}
+		if (rename(temporary.c_str(), name.c_str())) {
+			std::cout << "[Error] Rename file " << temporary << " failed: "
+				<< strerror(errno) << "\n";
+			unlink(temporary.c_str());
+			return -1;
+		}
+		return 0;
+	}
+	unlink(temporary.c_str());
+	return 0;
+}
+
+
+int AllocateFile(const std::string &name) noexcept {
+	int fd = open(name.c_str(), O_RDWR);
+	if (fd < 0) {
+		std::cout << "[Error] Open file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	int result = 0;
+	struct stat file_stat;
+	if (fstat(fd, &file_stat)) {
+		result = errno;
+	} else if (size_t(file_stat.st_blocks) * 512 < size_t(file_stat.st_size)) {
+		// sparse, the holes get blocks and the data is kept
+		size_t size = size_t(file_stat.st_size);
+		result = posix_fallocate(fd, 0, size);
+		if (result == EOPNOTSUPP || result == EINVAL) {
+			result = Rewrite(fd, size);
+		}
+	}
+	close(fd);
+	if (result) {
+		std::cout << "[Error] Allocate file " << name << " failed: "
+			<< strerror(result) << "\n";
+		return -1;
+	}
+	return 0;
+}
+
+
+ScalerFile::ScalerFile() noexcept
+: fd_(-1)
+, writable_(false)
+, version_(kScalerFileRowMajor)
+, map_(nullptr)
+, rows_(nullptr) {
+}
+
+
+ScalerFile::~ScalerFile() noexcept {
+	Close();
+}
+
+
+int ScalerFile::Create(const std::string &name, uint8_t version) noexcept {
+	if (version != kScalerFileRowMajor && version != kScalerFileColumnMajor) {
+		std::cout << "[Error] Invalid version " << int(version)
+			<< " of scaler file " << name << "\n";
+		return -1;
+	}
+	ScalerFileHeader header;
+	header.version = version;
+	header.number = kMaxScalers;
+	header.reserve1 = header.reserve2 = 0;
+	return CreateSizedFile(name, &header, sizeof(header), kScalerFileSize);
+}
+
+
+int ScalerFile::Convert(const std::string &name, uint8_t version) noexcept {
+	ScalerFile source;
+	int result = source.Open(name, false, false);
+	if (result) return result;
+	if (source.Version() == version) return 0;
+
+	// write to temporary file and replace the original one
+	std::string temporary = name + ".tmp";
+	unlink(temporary.c_str());
+	ScalerFile destination;
+	if (destination.Open(temporary, true, true, version)) return -1;
+	uint32_t values[kMaxScalers];
+	for (size_t second = 0; second < kDaySeconds; ++second) {
+		source.ReadRow(second, values);
+		destination.WriteRow(second, values);
+	}
+	destination.Close();
+	source.Close();
+	if (rename(temporary.c_str(), name.c_str())) {
+		std::cout << "[Error] Replace file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		unlink(temporary.c_str());
+		return -1;
+	}
+	return 0;
+}
+
+
+int ScalerFile::Open(
+	const std::string &name,
+	bool writable,
+	bool create,
+	uint8_t version
+) noexcept {
+	Close();
+	if (access(name.c_str(), F_OK)) {
+		if (!writable || !create) return -2;
+		if (Create(name, version)) return -1;
+	}
+
+	fd_ = open(name.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (fd_ < 0) {
+		std::cout << "[Error] Open file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	// check size
+	struct stat file_stat;
+	if (fstat(fd_, &file_stat) || size_t(file_stat.st_size) < kScalerFileSize) {
+		std::cout << "[Error] Invalid size of scaler file " << name << "\n";
+		Close();
+		return -1;
+	}
+	// map
+	void *map = mmap(
+		NULL, kScalerFileSize,
+		writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+		fd_, 0
+	);
+	if (map == MAP_FAILED) {
+		std::cout << "[Error] Map file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		Close();
+		return -1;
+	}
+	map_ = (uint8_t*)map;
+	// check header
+	const ScalerFileHeader *header = (const ScalerFileHeader*)map_;
+	if (
+		(header->version != kScalerFileRowMajor && header->version != kScalerFileColumnMajor)
+		|| header->number != kMaxScalers
+	) {
+		std::cout << "[Error] Invalid header of scaler file " << name << "\n";
+		Close();
+		return -1;
+	}
+	version_ = header->version;
+	rows_ = (uint32_t*)(map_ + sizeof(ScalerFileHeader));
+	writable_ = writable;
+	name_ = name;
+	return 0;
+}
+
+
+void ScalerFile::Close() noexcept {
+	if (map_) {
+		if (writable_) msync(map_, kScalerFileSize, MS_SYNC);
+		munmap(map_, kScalerFileSize);
+	}
+	if (fd_ >= 0) close(fd_);
+	fd_ = -1;
+	writable_ = false;
+	version_ = kScalerFileRowMajor;
+	map_ = nullptr;
+	rows_ = nullptr;
+}
+
+
+int ScalerFile::Sync(size_t first, size_t last, bool wait) noexcept {
+	if (!map_ || !writable_) return -1;
+	// msync requires address aligned to page
+	const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+	size_t begin = (uint8_t*)Row(first) - map_;
+	size_t end = (uint8_t*)Row(last+1) - map_;
+	if (version_ == kScalerFileColumnMajor) {
+		// the whole blocks of these seconds
+		begin = (uint8_t*)Column(first - first % kScalerBlockSeconds, 0) - map_;
+		end = (uint8_t*)Column(
+			last - last % kScalerBlockSeconds + kScalerBlockSeconds - 1, kMaxScalers - 1
+		) + sizeof(uint32_t) - map_;
+	}
+	begin -= begin % page_size;
+	if (msync(map_ + begin, end - begin, wait ? MS_SYNC : MS_ASYNC)) {
+		std::cout << "[Error] Sync file " << name_ << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	return 0;
+}
+
+}	// namespace ecl
@@ -0,0 +1,398 @@
+#include "scaler/scaler_kernel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ecl {
+
+namespace {
+
+// Rows are reduced in tiles small enough to stay in L1 cache, so each block
+// of 8 scalers is read from cache and memory is read only once. Sums alone
+// fit in registers and do not need tiles, but tiles do not hurt either.
+const size_t kTileRows = 64;
+
+}	// namespace
+
+
+void ScalerReduction::Reset() noexcept {
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		sum[i] = 0;
+		min[i] = std::numeric_limits<uint32_t>::max();
+		max[i] = 0;
+		last[i] = 0;
+	}
+	count = 0;
+}
+
+
+const char* ScalerKernelName() noexcept {
+#if defined(__SSE4_1__)
+	return "sse4.1";
+#elif defined(__SSE2__)
+	return "sse2";
+#elif defined(__ARM_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+
+void SumRowsScalar(const uint32_t *rows, size_t count, uint64_t *sums) noexcept {
+	for (size_t row = 0; row < count; ++row) {
+		const uint32_t *values = rows + row * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) sums[i] += values[i];
+	}
+}
+
+
+void ReduceRowsScalar(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept {
+	if (count == 0) return;
+	for (size_t row = 0; row < count; ++row) {
+		const uint32_t *values = rows + row * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			reduction.sum[i] += values[i];
+			if (values[i] < reduction.min[i]) reduction.min[i] = values[i];
+			if (values[i] > reduction.max[i]) reduction.max[i] = values[i];
+		}
+	}
+	memcpy(reduction.last, rows + (count-1) * kMaxScalers, sizeof(reduction.last));
+	reduction.count += count;
+}
+
+
+void ReduceColumnScalar(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept {
+	if (count == 0) return;
+	uint64_t sum = reduction.sum[index];
+	uint32_t min = reduction.min[index];
+	uint32_t max = reduction.max[index];
+	for (size_t i = 0; i < count; ++i) {
+		sum += values[i];
+		if (values[i] < min) min = values[i];
+		if (values[i] > max) max = values[i];
+	}
+	reduction.sum[index] = sum;
+	reduction.min[index] = min;
+	reduction.max[index] = max;
+	reduction.last[index] = values[count-1];
+}
+
+
+#if defined(__SSE2__)
+
+namespace {
+
+// Four 32-bit lanes are widened to two pairs of 64-bit lanes for summing.
+// Unsigned min and max are native in SSE4.1, and emulated with signed
+// compare after flipping the sign bit in SSE2.
+
+inline __m128i MinU32(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+	return _mm_min_epu32(a, b);
+#else
+	const __m128i sign = _mm_set1_epi32(int(0x80000000u));
+	__m128i greater = _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+	return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+#endif
+}
+
+inline __m128i MaxU32(__m128i a, __m128i b) {
+#if defined(__SSE4_1__)
+	return _mm_max_epu32(a, b);
+#else
+	const __m128i sign = _mm_set1_epi32(int(0x80000000u));
+	__m128i greater = _mm_cmpgt_epi32(_mm_xor_si128(a, sign), _mm_xor_si128(b, sign));
+	return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+#endif
+}
+
+
+void SumTile(const uint32_t *rows, size_t count, uint64_t *sums) noexcept {
+	// 32 sums fill all 16 registers, so rows are read in order
+	const __m128i zero = _mm_setzero_si128();
+	__m128i accumulators[kMaxScalers / 2];
+	for (size_t i = 0; i < kMaxScalers / 2; ++i) {
+		accumulators[i] = _mm_loadu_si128((const __m128i*)(sums + i*2));
+	}
+	for (size_t row = 0; row < count; ++row, rows += kMaxScalers) {
+		for (size_t i = 0; i < kMaxScalers / 4; ++i) {
+			__m128i values = _mm_loadu_si128((const __m128i*)(rows + i*4));
+			accumulators[i*2] = _mm_add_epi64(
+				accumulators[i*2], _mm_unpacklo_epi32(values, zero)
+			);
+			accumulators[i*2+1] = _mm_add_epi64(
+				accumulators[i*2+1], _mm_unpackhi_epi32(values, zero)
+			);
+		}
+	}
+	for (size_t i = 0; i < kMaxScalers / 2; ++i) {
+		_mm_storeu_si128((__m128i*)(sums + i*2), accumulators[i]);
+	}
+}
+
+
+void ReduceTile(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept {
+	const __m128i zero = _mm_setzero_si128();
+	uint64_t *sums = reduction.sum;
+	for (size_t block = 0; block < kMaxScalers; block += 8) {
+		__m128i sum0 = _mm_loadu_si128((const __m128i*)(sums + block));
+		__m128i sum1 = _mm_loadu_si128((const __m128i*)(sums + block + 2));
+		__m128i sum2 = _mm_loadu_si128((const __m128i*)(sums + block + 4));
+		__m128i sum3 = _mm_loadu_si128((const __m128i*)(sums + block + 6));
+		__m128i min0 = _mm_loadu_si128((const __m128i*)(reduction.min + block));
+		__m128i min1 = _mm_loadu_si128((const __m128i*)(reduction.min + block + 4));
+		__m128i max0 = _mm_loadu_si128((const __m128i*)(reduction.max + block));
+		__m128i max1 = _mm_loadu_si128((const __m128i*)(reduction.max + block + 4));
+		const uint32_t *values = rows + block;
+		for (size_t row = 0; row < count; ++row, values += kMaxScalers) {
+			__m128i low = _mm_loadu_si128((const __m128i*)values);
+			__m128i high = _mm_loadu_si128((const __m128i*)(values + 4));
+			sum0 = _mm_add_epi64(sum0, _mm_unpacklo_epi32(low, zero));
+			sum1 = _mm_add_epi64(sum1, _mm_unpackhi_epi32(low, zero));
+			sum2 = _mm_add_epi64(sum2, _mm_unpacklo_epi32(high, zero));
+			sum3 = _mm_add_epi64(sum3, _mm_unpackhi_epi32(high, zero));
+			min0 = MinU32(min0, low);
+			min1 = MinU32(min1, high);
+			max0 = MaxU32(max0, low);
+			max1 = MaxU32(max1, high);
+		}
+		_mm_storeu_si128((__m128i*)(sums + block), sum0);
+		_mm_storeu_si128((__m128i*)(sums + block + 2), sum1);
+		_mm_storeu_si128((__m128i*)(sums + block + 4), sum2);
+		_mm_storeu_si128((__m128i*)(sums + block + 6), sum3);
+		_mm_storeu_si128((__m128i*)(reduction.min + block), min0);
+		_mm_storeu_si128((__m128i*)(reduction.min + block + 4), min1);
+		_mm_storeu_si128((__m128i*)(reduction.max + block), max0);
+		_mm_storeu_si128((__m128i*)(reduction.max + block + 4), max1);
+	}
+}
+
+
+void ReduceColumnTile(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept {
+	// 4 values in each step, and the left ones in scalar
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum0 = zero;
+	__m128i sum1 = zero;
+	__m128i min = _mm_set1_epi32(int(reduction.min[index]));
+	__m128i max = _mm_set1_epi32(int(reduction.max[index]));
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i data = _mm_loadu_si128((const __m128i*)(values + i));
+		sum0 = _mm_add_epi64(sum0, _mm_unpacklo_epi32(data, zero));
+		sum1 = _mm_add_epi64(sum1, _mm_unpackhi_epi32(data, zero));
+		min = MinU32(min, data);
+		max = MaxU32(max, data);
+	}
+	uint64_t sums[4];
+	uint32_t mins[4];
+	uint32_t maxs[4];
+	_mm_storeu_si128((__m128i*)sums, sum0);
+	_mm_storeu_si128((__m128i*)(sums + 2), sum1);
+	_mm_storeu_si128((__m128i*)mins, min);
+	_mm_storeu_si128((__m128i*)maxs, max);
+	for (size_t j = 0; j < 4; ++j) {
+		reduction.sum[index] += sums[j];
+		if (mins[j] < reduction.min[index]) reduction.min[index] = mins[j];
+		if (maxs[j] > reduction.max[index]) reduction.max[index] = maxs[j];
+	}
+	ReduceColumnScalar(values + i, count - i, index, reduction);
+	reduction.last[index] = values[count-1];
+}
+
+}	// namespace
+
+#elif defined(__ARM_NEON)
+
+namespace {
+
+void SumTile(const uint32_t *rows, size_t count, uint64_t *sums) noexcept {
+	// 32 sums take half of the 32 registers, so rows are read in order
+	uint64x2_t accumulators[kMaxScalers / 2];
+	for (size_t i = 0; i < kMaxScalers / 2; ++i) {
+		accumulators[i] = vld1q_u64(sums + i*2);
+	}
+	for (size_t row = 0; row < count; ++row, rows += kMaxScalers) {
+		for (size_t i = 0; i < kMaxScalers / 4; ++i) {
+			uint32x4_t values = vld1q_u32(rows + i*4);
+			accumulators[i*2] = vaddw_u32(accumulators[i*2], vget_low_u32(values));
+			accumulators[i*2+1] = vaddw_u32(accumulators[i*2+1], vget_high_u32(values));
+		}
+	}
+	for (size_t i = 0; i < kMaxScalers / 2; ++i) {
+		vst1q_u64(sums + i*2, accumulators[i]);
+	}
+}
+
+
+void ReduceTile(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept {
+	uint64_t *sums = reduction.sum;
+	for (size_t block = 0; block < kMaxScalers; block += 8) {
+		uint64x2_t sum0 = vld1q_u64(sums + block);
+		uint64x2_t sum1 = vld1q_u64(sums + block + 2);
+		uint64x2_t sum2 = vld1q_u64(sums + block + 4);
+		uint64x2_t sum3 = vld1q_u64(sums + block + 6);
+		uint32x4_t min0 = vld1q_u32(reduction.min + block);
+		uint32x4_t min1 = vld1q_u32(reduction.min + block + 4);
+		uint32x4_t max0 = vld1q_u32(reduction.max + block);
+		uint32x4_t max1 = vld1q_u32(reduction.max + block + 4);
+		const uint32_t *values = rows + block;
+		for (size_t row = 0; row < count; ++row, values += kMaxScalers) {
+			uint32x4_t low = vld1q_u32(values);
+			uint32x4_t high = vld1q_u32(values + 4);
+			sum0 = vaddw_u32(sum0, vget_low_u32(low));
+			sum1 = vaddw_u32(sum1, vget_high_u32(low));
+			sum2 = vaddw_u32(sum2, vget_low_u32(high));
+			sum3 = vaddw_u32(sum3, vget_high_u32(high));
+			min0 = vminq_u32(min0, low);
+			min1 = vminq_u32(min1, high);
+			max0 = vmaxq_u32(max0, low);
+			max1 = vmaxq_u32(max1, high);
+		}
+		vst1q_u64(sums + block, sum0);
+		vst1q_u64(sums + block + 2, sum1);
+		vst1q_u64(sums + block + 4, sum2);
+		vst1q_u64(sums + block + 6, sum3);
+		vst1q_u32(reduction.min + block, min0);
+		vst1q_u32(reduction.min + block + 4, min1);
+		vst1q_u32(reduction.max + block, max0);
+		vst1q_u32(reduction.max + block + 4, max1);
+	}
+}
+
+
+void ReduceColumnTile(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept {
+	// 4 values in each step, and the left ones in scalar
+	uint64x2_t sum0 = vdupq_n_u64(0);
+	uint64x2_t sum1 = vdupq_n_u64(0);
+	uint32x4_t min = vdupq_n_u32(reduction.min[index]);
+	uint32x4_t max = vdupq_n_u32(reduction.max[index]);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		uint32x4_t data = vld1q_u32(values + i);
+		sum0 = vaddw_u32(sum0, vget_low_u32(data));
+		sum1 = vaddw_u32(sum1, vget_high_u32(data));
+		min = vminq_u32(min, data);
+		max = vmaxq_u32(max, data);
+	}
+	uint64_t sums[4];
+	uint32_t mins[4];
+	uint32_t maxs[4];
+	vst1q_u64(sums, sum0);
+	vst1q_u64(sums + 2, sum1);
+	vst1q_u32(mins, min);
+	vst1q_u32(maxs, max);
+	for (size_t j = 0; j < 4; ++j) {
+		reduction.sum[index] += sums[j];
+		if (mins[j] < reduction.min[index]) reduction.min[index] = mins[j];
+		if (maxs[j] > reduction.max[index]) reduction.max[index] = maxs[j];
+	}
+	ReduceColumnScalar(values + i, count - i, index, reduction);
+	reduction.last[index] = values[count-1];
+}
+
+}	// namespace
+
+#endif
+
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+
+void SumRows(const uint32_t *rows, size_t count, uint64_t *sums) noexcept {
+	for (size_t row = 0; row < count; row += kTileRows) {
+		SumTile(rows + row * kMaxScalers, std::min(kTileRows, count - row), sums);
+	}
+}
+
+
+void ReduceRows(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept {
+	if (count == 0) return;
+	for (size_t row = 0; row < count; row += kTileRows) {
+		ReduceTile(
+			rows + row * kMaxScalers, std::min(kTileRows, count - row), reduction
+		);
+	}
+	memcpy(reduction.last, rows + (count-1) * kMaxScalers, sizeof(reduction.last));
+	reduction.count += count;
+}
+
+
+void ReduceColumn(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept {
+	if (count == 0) return;
+	ReduceColumnTile(values, count, index, reduction);
+}
+
+#else
+
+void SumRows(const uint32_t *rows, size_t count, uint64_t *sums) noexcept {
+	SumRowsScalar(rows, count, sums);
+}
+
+
+void ReduceRows(
+	const uint32_t *rows,
+	size_t count,
+	ScalerReduction &reduction
+) noexcept {
+	ReduceRowsScalar(rows, count, reduction);
+}
+
+
+void ReduceColumn(
+	const uint32_t *values,
+	size_t count,
+	size_t index,
+	ScalerReduction &reduction
+) noexcept {
+	ReduceColumnScalar(values, count, index, reduction);
+}
+
+#endif
+
+}	// namespace ecl
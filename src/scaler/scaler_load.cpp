@@ -0,0 +1,176 @@
+#include "scaler/scaler_load.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace ecl {
+
+int ParseLoadModel(const std::string &text, LoadModel &model) noexcept {
+	size_t colon = text.find(':');
+	std::string kind = text.substr(0, colon);
+	LoadModel result;
+	bool found = false;
+	for (int i = 0; i < 5; ++i) {
+		if (kind == kLoadKindName[i]) {
+			result.kind = LoadKind(i);
+			found = true;
+		}
+	}
+	if (!found) return -1;
+
+	if (colon != std::string::npos) {
+		std::stringstream stream(text.substr(colon + 1));
+		std::string item;
+		while (std::getline(stream, item, ',')) {
+			size_t equal = item.find('=');
+			if (equal == std::string::npos) return -1;
+			std::string key = item.substr(0, equal);
+			std::string value = item.substr(equal + 1);
+			char *end = nullptr;
+			double number = strtod(value.c_str(), &end);
+			if (value.empty() || *end != '\0' || number < 0.0) return -1;
+			if (key == "rate") {
+				result.rate = number;
+			} else if (key == "peak") {
+				result.peak = number;
+			} else if (key == "period") {
+				result.period = uint32_t(number);
+			} else if (key == "length") {
+				result.length = uint32_t(number);
+			} else {
+				return -1;
+			}
+		}
+	}
+	if (result.period == 0) return -1;
+	model = result;
+	return 0;
+}
+
+
+ScalerLoad::ScalerLoad(
+	const ScalerLoadOption &option,
+	std::function<void(time_t, const uint32_t*)> sample
+) noexcept
+: rate_(option.rate)
+, models_(option.models)
+, start_(option.start ? option.start : time(NULL))
+, engine_(option.seed ? option.seed : std::random_device()())
+, sample_(sample)
+, stop_(false)
+, metrics_() {
+
+	if (models_.empty()) models_.push_back(LoadModel());
+}
+
+
+ScalerLoad::~ScalerLoad() noexcept {
+	Stop();
+}
+
+
+int ScalerLoad::Start() noexcept {
+	if (thread_.joinable()) return 0;
+	if (!(rate_ > 0.0)) return -1;
+	stop_ = false;
+	thread_ = std::thread(&ScalerLoad::Loop, this);
+	return 0;
+}
+
+
+void ScalerLoad::Stop() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(stop_mutex_);
+		stop_ = true;
+	}
+	stop_condition_.notify_all();
+	if (thread_.joinable()) thread_.join();
+}
+
+
+void ScalerLoad::Generate(time_t second, uint32_t *values) noexcept {
+	const uint64_t elapsed = second > start_ ? uint64_t(second - start_) : 0;
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		const LoadModel &model = models_[i % models_.size()];
+		if (model.kind == kConstantLoad) {
+			values[i] = uint32_t(std::llround(model.rate));
+			continue;
+		}
+		const uint64_t phase = elapsed % model.period;
+		double mean = model.rate;
+		if (model.kind == kBurstLoad) {
+			if (phase < model.length) mean = model.peak;
+		} else if (model.kind == kRampLoad) {
+			mean += (model.peak - model.rate) * double(phase) / model.period;
+		} else if (model.kind == kDropoutLoad) {
+			if (phase < model.length) mean = 0.0;
+		}
+		if (mean > 0.0) {
+			std::poisson_distribution<uint64_t> distribution(mean);
+			values[i] = uint32_t(std::min(
+				distribution(engine_), uint64_t(UINT32_MAX)
+			));
+		} else {
+			values[i] = 0;
+		}
+	}
+}
+
+
+ScalerLoadMetrics ScalerLoad::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	return metrics_;
+}
+
+
+void ScalerLoad::Loop() noexcept {
+	using namespace std::chrono;
+	const nanoseconds interval(int64_t(1e9 / rate_));
+	uint32_t values[kMaxScalers];
+	time_t second = start_;
+	auto deadline = steady_clock::now();
+	std::unique_lock<std::mutex> lock(stop_mutex_);
+	while (!stop_) {
+		auto now = steady_clock::now();
+		if (now < deadline) {
+			if (stop_condition_.wait_until(lock, deadline, [this]() {
+				return stop_;
+			})) {
+				break;
+			}
+			now = steady_clock::now();
+		}
+		lock.unlock();
+
+		const uint64_t lateness =
+			uint64_t(duration_cast<microseconds>(now - deadline).count());
+		// waking up always takes a little, only a whole interval behind
+		// means the sample could not keep the rate
+		const bool late = now - deadline >= interval;
+		uint64_t skipped = 0;
+		if (now - deadline > seconds(1)) {
+			// too far behind, start over from now
+			skipped = uint64_t((now - deadline) / interval);
+			deadline = now;
+		}
+		Generate(second, values);
+		sample_(second, values);
+		++second;
+		deadline += interval;
+
+		{
+			std::lock_guard<std::mutex> metrics_lock(metrics_mutex_);
+			++metrics_.samples;
+			if (late) ++metrics_.late;
+			metrics_.skipped += skipped;
+			metrics_.max_lateness_us =
+				std::max(metrics_.max_lateness_us, lateness);
+		}
+		lock.lock();
+	}
+}
+
+}	// namespace ecl
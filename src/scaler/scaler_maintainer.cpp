@@ -0,0 +1,374 @@
+#include "scaler/scaler_maintainer.h"
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <map>
+
+#include "scaler/scaler_archive.h"
+#include "scaler/scaler_file.h"
+
+namespace ecl {
+
+namespace {
+
+// kinds of files of one day, scaler values before the rollup
+enum FileKind {
+	kDayFile = 0,
+	kArchiveFile,
+	kPrefixFile,
+	kRollupFile,
+	kFileKinds
+};
+
+const char* const kFileExtension[kFileKinds] = {
+	".bin", ".sca", ".prefix", ".rollup"
+};
+
+
+// files of one day found in data path
+struct MaintainedDay {
+	std::string names[kFileKinds];
+	uint64_t bytes[kFileKinds];
+
+	MaintainedDay() {
+		for (size_t i = 0; i < kFileKinds; ++i) bytes[i] = 0;
+	}
+
+	bool HasValues() const {
+		return !names[kDayFile].empty()
+			|| !names[kArchiveFile].empty()
+			|| !names[kPrefixFile].empty();
+	}
+};
+
+
+/// @brief get the date key of some days before
+/// @param[in] now current time
+/// @param[in] days number of days before
+/// @returns date key of the day
+int KeyBefore(time_t now, int days) noexcept {
+	time_t time = now - time_t(days) * time_t(kDaySeconds);
+	tm date;
+	localtime_r(&time, &date);
+	return DateKey(&date);
+}
+
+
+/// @brief bytes of file on disk, day files may be sparse
+/// @returns bytes of the allocated blocks, 0 on failure
+uint64_t DiskBytes(const std::string &name) noexcept {
+	struct stat file_stat;
+	if (stat(name.c_str(), &file_stat)) return 0;
+	return uint64_t(file_stat.st_blocks) * 512;
+}
+
+
+/// @brief list the files of the device in data path
+/// @param[in] data_path data stored path, ends with '/'
+/// @param[in] device_name device name
+/// @param[out] days files of each day, by date key
+/// @returns 0 on success, -1 on failure
+int ListFiles(
+	const std::string &data_path,
+	const std::string &device_name,
+	std::map<int, MaintainedDay> &days
+) noexcept {
+	DIR *directory = opendir(data_path.c_str());
+	if (!directory) {
+		std::cout << "[Error] Open directory " << data_path << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	const std::string suffix = device_name.empty() ? "" : "-" + device_name;
+	for (dirent *entry = readdir(directory); entry; entry = readdir(directory)) {
+		// name in form of YYYYMMDD[-device].ext
+		const std::string name = entry->d_name;
+		if (name.length() < 8) continue;
+		bool digits = true;
+		for (size_t i = 0; i < 8; ++i) {
+			if (name[i] < '0' || name[i] > '9') digits = false;
+		}
+		if (!digits) continue;
+		for (size_t kind = 0; kind < kFileKinds; ++kind) {
+			if (name.substr(8) != suffix + kFileExtension[kind]) continue;
+			MaintainedDay &day = days[std::stoi(name.substr(0, 8))];
+			day.names[kind] = data_path + name;
+			day.bytes[kind] = DiskBytes(day.names[kind]);
+		}
+	}
+	closedir(directory);
+	return 0;
+}
+
+}	// namespace
+
+
+ScalerMaintainer::ScalerMaintainer(const ScalerMaintainerOption &option) noexcept
+: data_path_(option.data_path)
+, device_name_(option.device_name)
+, archive_days_(option.archive_days)
+, retention_days_(option.retention_days)
+, disk_budget_(option.disk_budget)
+, interval_(option.interval)
+, io_rate_(option.io_rate)
+, verbose_(option.verbose)
+, pass_bytes_(0)
+, stop_(false)
+, metrics_() {
+
+	if (data_path_.empty()) data_path_ = "./";
+	if (data_path_[data_path_.length()-1] != '/') data_path_ += "/";
+	// negative days disable the step
+	if (archive_days_ < 0) archive_days_ = 0;
+	if (retention_days_ < 0) retention_days_ = 0;
+	if (interval_ > 0) {
+		thread_ = std::thread(&ScalerMaintainer::Loop, this);
+	}
+}
+
+
+ScalerMaintainer::~ScalerMaintainer() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(stop_mutex_);
+		stop_ = true;
+	}
+	stop_cond_.notify_all();
+	if (thread_.joinable()) thread_.join();
+}
+
+
+ScalerMaintainerMetrics ScalerMaintainer::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	return metrics_;
+}
+
+
+void ScalerMaintainer::Loop() noexcept {
+	// The lowest CPU priority and idle I/O class only apply to this thread,
+	// so the writer always gets the disk first.
+	pid_t tid = pid_t(syscall(SYS_gettid));
+	setpriority(PRIO_PROCESS, tid, 19);
+#ifdef SYS_ioprio_set
+	// IOPRIO_WHO_PROCESS and IOPRIO_CLASS_IDLE
+	syscall(SYS_ioprio_set, 1, tid, 3 << 13);
+#endif
+
+	std::unique_lock<std::mutex> lock(stop_mutex_);
+	while (!stop_) {
+		lock.unlock();
+		RunOnce(time(NULL));
+		lock.lock();
+		stop_cond_.wait_for(lock, std::chrono::seconds(interval_), [this]() {
+			return stop_;
+		});
+	}
+}
+
+
+bool ScalerMaintainer::Throttle(size_t bytes) noexcept {
+	std::unique_lock<std::mutex> lock(stop_mutex_);
+	if (stop_ || io_rate_ == 0) return stop_;
+	// sleep until the average rate of this pass is under limit
+	pass_bytes_ += bytes;
+	auto start = std::chrono::steady_clock::now();
+	auto until = pass_start_
+		+ std::chrono::microseconds(pass_bytes_ * 1000000 / io_rate_);
+	if (until <= start) return false;
+	bool stopped = stop_cond_.wait_until(lock, until, [this]() {
+		return stop_;
+	});
+	uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start
+	).count();
+	std::lock_guard<std::mutex> metrics_lock(metrics_mutex_);
+	metrics_.throttled_us += duration;
+	return stopped;
+}
+
+
+int ScalerMaintainer::Remove(const std::string &name, uint64_t bytes) noexcept {
+	if (unlink(name.c_str()) && errno != ENOENT) {
+		std::cout << "[Error] Remove file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		Fail();
+		return -1;
+	}
+	if (verbose_) {
+		std::cout << "[Info] Remove " << name << ", " << bytes << " bytes.\n";
+	}
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	metrics_.freed_bytes += bytes;
+	return 0;
+}
+
+
+void ScalerMaintainer::Fail() noexcept {
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	++metrics_.failures;
+}
+
+
+int ScalerMaintainer::RunOnce(time_t now) noexcept {
+	pass_start_ = std::chrono::steady_clock::now();
+	pass_bytes_ = 0;
+	const ScalerMaintainerMetrics before = Metrics();
+
+	std::map<int, MaintainedDay> days;
+	if (ListFiles(data_path_, device_name_, days)) {
+		Fail();
+		return -1;
+	}
+	int result = 0;
+	const int protected_key = KeyBefore(now, 1);
+
+	// remove scaler values older than retention days, keep the rollup
+	if (retention_days_ > 0) {
+		const int retention_key =
+			std::min(KeyBefore(now, retention_days_), protected_key);
+		for (auto &item : days) {
+			if (item.first >= retention_key) break;
+			MaintainedDay &day = item.second;
+			if (!day.HasValues()) continue;
+			for (size_t kind = kDayFile; kind < kRollupFile; ++kind) {
+				if (day.names[kind].empty()) continue;
+				if (Remove(day.names[kind], day.bytes[kind])) {
+					result = -1;
+					continue;
+				}
+				day.names[kind].clear();
+				day.bytes[kind] = 0;
+			}
+			std::lock_guard<std::mutex> lock(metrics_mutex_);
+			++metrics_.dropped_days;
+		}
+	}
+
+	// archive day files older than archive days
+	if (archive_days_ > 0) {
+		const int archive_key =
+			std::min(KeyBefore(now, archive_days_), protected_key);
+		for (auto &item : days) {
+			if (item.first >= archive_key) break;
+			MaintainedDay &day = item.second;
+			if (day.names[kDayFile].empty()) continue;
+
+			ScalerFile data;
+			if (data.Open(day.names[kDayFile], false, false)) {
+				std::cout << "[Error] Open scaler file " << day.names[kDayFile]
+					<< " failed.\n";
+				Fail();
+				result = -1;
+				continue;
+			}
+			std::string archive_name = day.names[kDayFile].substr(
+				0, day.names[kDayFile].length()-4
+			) + kFileExtension[kArchiveFile];
+			bool stopped = false;
+			int create_result = ScalerArchive::Create(
+				data, archive_name,
+				[&](size_t bytes) {
+					stopped = Throttle(bytes) || stopped;
+				}
+			);
+			data.Close();
+			if (create_result) {
+				std::cout << "[Error] Archive scaler file " << day.names[kDayFile]
+					<< " failed.\n";
+				Fail();
+				result = -1;
+				continue;
+			}
+			day.names[kArchiveFile] = archive_name;
+			day.bytes[kArchiveFile] = DiskBytes(archive_name);
+			if (verbose_) {
+				std::cout << "[Info] Archive " << day.names[kDayFile] << " to "
+					<< archive_name << ", " << day.bytes[kArchiveFile]
+					<< " bytes.\n";
+			}
+			{
+				std::lock_guard<std::mutex> lock(metrics_mutex_);
+				++metrics_.archived_files;
+			}
+			// the archive is read only if the day file is missing, and the
+			// prefix file is larger than the day file
+			for (size_t kind : {size_t(kDayFile), size_t(kPrefixFile)}) {
+				if (day.names[kind].empty()) continue;
+				if (Remove(day.names[kind], day.bytes[kind])) {
+					result = -1;
+					continue;
+				}
+				day.names[kind].clear();
+				day.bytes[kind] = 0;
+			}
+			if (stopped || Throttle(day.bytes[kArchiveFile])) {
+				result = -3;
+				break;
+			}
+		}
+	}
+
+	// remove the oldest files until all fit in the budget
+	uint64_t used = 0;
+	for (const auto &item : days) {
+		for (size_t kind = 0; kind < kFileKinds; ++kind) {
+			used += item.second.bytes[kind];
+		}
+	}
+	if (disk_budget_ > 0 && result != -3) {
+		// scaler values first, then the rollups
+		for (size_t last_kind : {size_t(kPrefixFile), size_t(kRollupFile)}) {
+			for (auto &item : days) {
+				if (used <= disk_budget_ || item.first >= protected_key) break;
+				MaintainedDay &day = item.second;
+				for (size_t kind = kDayFile; kind <= last_kind; ++kind) {
+					if (day.names[kind].empty()) continue;
+					if (Remove(day.names[kind], day.bytes[kind])) {
+						result = -1;
+						continue;
+					}
+					used -= day.bytes[kind];
+					day.names[kind].clear();
+					day.bytes[kind] = 0;
+					std::lock_guard<std::mutex> lock(metrics_mutex_);
+					++metrics_.budget_removed_files;
+				}
+			}
+		}
+		if (used > disk_budget_) {
+			std::cout << "[Warn] Scaler files of today and yesterday use "
+				<< used << " bytes, over the disk budget " << disk_budget_
+				<< " bytes.\n";
+		}
+	}
+
+	uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - pass_start_
+	).count();
+	ScalerMaintainerMetrics after;
+	{
+		std::lock_guard<std::mutex> lock(metrics_mutex_);
+		++metrics_.passes;
+		metrics_.used_bytes = used;
+		metrics_.last_pass_us = duration;
+		after = metrics_;
+	}
+	if (verbose_) {
+		std::cout << "[Info] Maintain scaler files in " << duration / 1000
+			<< " ms, archive " << after.archived_files - before.archived_files
+			<< ", drop " << after.dropped_days - before.dropped_days
+			<< " days, remove " << after.budget_removed_files - before.budget_removed_files
+			<< " over budget, free " << after.freed_bytes - before.freed_bytes
+			<< " bytes, use " << used << " bytes.\n";
+	}
+	return result;
+}
+
+}	// namespace ecl
@@ -0,0 +1,222 @@
+#include "scaler/scaler_prefix.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace ecl {
+
+std::string ScalerPrefixFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept {
+	std::string name = ScalerFileName(data_path, device_name, date);
+	// replace the extension .bin
+	return name.substr(0, name.length()-4) + ".prefix";
+}
+
+
+ScalerPrefix::ScalerPrefix() noexcept
+: fd_(-1)
+, writable_(false)
+, map_(nullptr)
+, prefix_(nullptr)
+, dirty_first_(kDaySeconds)
+, dirty_last_(0) {
+}
+
+
+ScalerPrefix::~ScalerPrefix() noexcept {
+	Close();
+}
+
+
+int ScalerPrefix::Create(const std::string &name) noexcept {
+	ScalerPrefixHeader header;
+	header.version = 1;
+	header.number = kMaxScalers;
+	header.dirty = 0;
+	header.reserve = 0;
+	header.filled = 0;
+	return CreateSizedFile(name, &header, sizeof(header), kScalerPrefixFileSize);
+}
+
+
+int ScalerPrefix::Open(
+	const std::string &name,
+	const ScalerFile *day,
+	bool writable
+) noexcept {
+	Close();
+	// rebuild if the prefix file is created for existing day file
+	bool rebuild = false;
+	if (access(name.c_str(), F_OK)) {
+		if (!writable || !day) return -2;
+		if (Create(name)) return -1;
+		rebuild = true;
+	}
+
+	fd_ = open(name.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (fd_ < 0) {
+		std::cout << "[Error] Open file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	// check size
+	struct stat file_stat;
+	if (
+		fstat(fd_, &file_stat)
+		|| size_t(file_stat.st_size) < kScalerPrefixFileSize
+	) {
+		std::cout << "[Error] Invalid size of prefix file " << name << "\n";
+		Close();
+		return -1;
+	}
+	// map
+	void *map = mmap(
+		NULL, kScalerPrefixFileSize,
+		writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+		fd_, 0
+	);
+	if (map == MAP_FAILED) {
+		std::cout << "[Error] Map file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		Close();
+		return -1;
+	}
+	map_ = (uint8_t*)map;
+	// check header
+	if (
+		Header()->version != 1
+		|| Header()->number != kMaxScalers
+		|| Header()->filled > kDaySeconds
+	) {
+		std::cout << "[Error] Invalid header of prefix file " << name << "\n";
+		Close();
+		return -1;
+	}
+	prefix_ = (uint64_t*)(map_ + sizeof(ScalerPrefixHeader));
+	name_ = name;
+
+	if (writable) {
+		writable_ = true;
+		if ((rebuild || Header()->dirty) && day) {
+			if (Build(*day)) {
+				Close();
+				return -1;
+			}
+		}
+		// mark dirty until closed
+		Header()->dirty = 1;
+		msync(map_, sizeof(ScalerPrefixHeader), MS_SYNC);
+	}
+	return 0;
+}
+
+
+void ScalerPrefix::Close() noexcept {
+	if (map_) {
+		if (writable_) {
+			msync(map_, kScalerPrefixFileSize, MS_SYNC);
+			Header()->dirty = 0;
+			msync(map_, sizeof(ScalerPrefixHeader), MS_SYNC);
+		}
+		munmap(map_, kScalerPrefixFileSize);
+	}
+	if (fd_ >= 0) close(fd_);
+	fd_ = -1;
+	writable_ = false;
+	map_ = nullptr;
+	prefix_ = nullptr;
+	dirty_first_ = kDaySeconds;
+	dirty_last_ = 0;
+}
+
+
+int ScalerPrefix::Build(const ScalerFile &day) noexcept {
+	if (!map_ || !writable_ || !day.IsOpen()) return -1;
+	uint64_t sums[kMaxScalers] = {};
+	uint32_t row[kMaxScalers];
+	// seconds after the last non-zero row are left unfilled, so the writer
+	// continues by appending
+	size_t filled = 0;
+	for (size_t second = 0; second < kDaySeconds; ++second) {
+		day.ReadRow(second, row);
+		bool zero = true;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			sums[i] += row[i];
+			if (row[i]) zero = false;
+		}
+		memcpy(prefix_ + second * kMaxScalers, sums, sizeof(sums));
+		if (!zero) filled = second + 1;
+	}
+	Header()->filled = uint32_t(filled);
+	dirty_first_ = 0;
+	dirty_last_ = kDaySeconds - 1;
+	return 0;
+}
+
+
+void ScalerPrefix::Update(
+	size_t second,
+	const uint32_t *old_row,
+	const uint32_t *new_row
+) noexcept {
+	const size_t filled = Header()->filled;
+	if (second >= filled) {
+		// seconds never written have the last prefix sums
+		uint64_t sums[kMaxScalers] = {};
+		if (filled) memcpy(sums, prefix_ + (filled-1) * kMaxScalers, sizeof(sums));
+		for (size_t i = filled; i < second; ++i) {
+			memcpy(prefix_ + i * kMaxScalers, sums, sizeof(sums));
+		}
+		uint64_t *last = prefix_ + second * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) last[i] = sums[i] + new_row[i];
+		Header()->filled = uint32_t(second + 1);
+		if (filled < dirty_first_) dirty_first_ = filled;
+		if (second > dirty_last_) dirty_last_ = second;
+		return;
+	}
+	// rewrite a filled second, change all filled prefix sums after it
+	for (size_t i = second; i < filled; ++i) {
+		uint64_t *sums = prefix_ + i * kMaxScalers;
+		for (size_t j = 0; j < kMaxScalers; ++j) {
+			// unsigned wrap-around gives the right result when decreasing
+			sums[j] += uint64_t(new_row[j]) - uint64_t(old_row[j]);
+		}
+	}
+	if (second < dirty_first_) dirty_first_ = second;
+	if (filled - 1 > dirty_last_) dirty_last_ = filled - 1;
+}
+
+
+int ScalerPrefix::Sync(bool wait) noexcept {
+	if (!map_ || !writable_) return -1;
+	if (dirty_first_ > dirty_last_) return 0;
+	// msync requires address aligned to page
+	const size_t page_size = size_t(sysconf(_SC_PAGESIZE));
+	size_t begin = (uint8_t*)(prefix_ + dirty_first_ * kMaxScalers) - map_;
+	size_t end = (uint8_t*)(prefix_ + (dirty_last_+1) * kMaxScalers) - map_;
+	begin -= begin % page_size;
+	const int flag = wait ? MS_SYNC : MS_ASYNC;
+	// header with filled seconds is in the first page
+	if (
+		msync(map_ + begin, end - begin, flag)
+		|| (begin > 0 && msync(map_, sizeof(ScalerPrefixHeader), flag))
+	) {
+		std::cout << "[Error] Sync file " << name_ << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	dirty_first_ = kDaySeconds;
+	dirty_last_ = 0;
+	return 0;
+}
+
+}	// namespace ecl
@@ -0,0 +1,136 @@
+#include "scaler/scaler_publisher.h"
+
+namespace ecl {
+
+ScalerSubscription::ScalerSubscription(
+	uint32_t flag,
+	int period,
+	bool delta,
+	size_t capacity
+) noexcept
+: flag_(flag)
+, period_(period > 0 ? period : 1)
+, delta_(delta)
+, capacity_(capacity > 0 ? capacity : 1)
+, countdown_(0)
+, need_full_(true)
+, dropped_(0) {
+
+	for (size_t i = 0; i < kMaxScalers; ++i) last_[i] = 0;
+}
+
+
+bool ScalerSubscription::Pop(ScalerUpdate &update) noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (queue_.empty()) return false;
+	update = queue_.front();
+	queue_.pop_front();
+	return true;
+}
+
+
+uint64_t ScalerSubscription::Dropped() const noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return dropped_;
+}
+
+
+void ScalerSubscription::Offer(int64_t time, const uint32_t *scalers) noexcept {
+	// skip samples in period
+	if (countdown_ > 0) {
+		--countdown_;
+		return;
+	}
+	countdown_ = period_ - 1;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (queue_.size() >= capacity_) {
+			// The subscriber misses this update, so the next one should
+			// include all scalers for delta encoding.
+			++dropped_;
+			need_full_ = true;
+			return;
+		}
+
+		ScalerUpdate update;
+		update.time = time;
+		update.mask = 0;
+		update.size = 0;
+		update.dropped = dropped_;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			if (!(flag_ & (1u << i))) continue;
+			if (delta_ && !need_full_ && scalers[i] == last_[i]) continue;
+			update.mask |= 1u << i;
+			update.values[update.size++] = scalers[i];
+			last_[i] = scalers[i];
+		}
+		need_full_ = false;
+		queue_.push_back(update);
+	}
+
+	if (notifier_) notifier_();
+}
+
+
+ScalerPublisher::ScalerPublisher(size_t capacity) noexcept
+: capacity_(capacity)
+, removed_dropped_(0) {
+}
+
+
+std::shared_ptr<ScalerSubscription> ScalerPublisher::Subscribe(
+	uint32_t flag,
+	int period,
+	bool delta,
+	std::function<void()> notifier
+) noexcept {
+	std::shared_ptr<ScalerSubscription> subscription =
+		std::make_shared<ScalerSubscription>(flag, period, delta, capacity_);
+	subscription->notifier_ = notifier;
+	std::lock_guard<std::mutex> lock(mutex_);
+	subscriptions_.push_back(subscription);
+	return subscription;
+}
+
+
+void ScalerPublisher::Unsubscribe(
+	const std::shared_ptr<ScalerSubscription> &subscription
+) noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto iter = subscriptions_.begin(); iter != subscriptions_.end(); ++iter) {
+		if (*iter == subscription) {
+			removed_dropped_ += subscription->Dropped();
+			subscriptions_.erase(iter);
+			return;
+		}
+	}
+}
+
+
+void ScalerPublisher::Publish(time_t time, const uint32_t *scalers) noexcept {
+	// Notifiers are called under the lock, so they are never called after
+	// unsubscribing.
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto &subscription : subscriptions_) {
+		subscription->Offer(int64_t(time), scalers);
+	}
+}
+
+
+size_t ScalerPublisher::Subscribers() const noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return subscriptions_.size();
+}
+
+
+uint64_t ScalerPublisher::Dropped() const noexcept {
+	std::lock_guard<std::mutex> lock(mutex_);
+	uint64_t dropped = removed_dropped_;
+	for (const auto &subscription : subscriptions_) {
+		dropped += subscription->Dropped();
+	}
+	return dropped;
+}
+
+}	// namespace ecl
@@ -0,0 +1,329 @@
+#include "scaler/scaler_query.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+
+namespace ecl {
+
+namespace {
+
+// seconds read between checking cancellation
+const size_t kQueryChunkSeconds = 3600;
+// buckets shorter than this are read row by row
+const int kQueryRowStep = 60;
+
+
+struct Accumulator {
+	uint64_t sum;
+	uint32_t min;
+	uint32_t max;
+	uint32_t last;
+	uint32_t count;
+};
+
+
+// seconds of one day file in query range
+struct Segment {
+	tm date;
+	// unix time of the first second
+	time_t time;
+	// second in day of the first second
+	size_t second;
+	size_t size;
+	// first bucket covered by this segment
+	size_t first_bucket;
+	// accumulators of covered buckets and scalers
+	std::vector<Accumulator> accumulators;
+	// day file exists
+	bool found;
+};
+
+
+/// @brief read one segment
+/// @returns 0 on success, -3 if cancelled
+int ReadSegment(
+	const ScalerStorage &storage,
+	const ScalerQueryOption &option,
+	const std::vector<int> &indexes,
+	bool need_rows,
+	bool need_last,
+	const std::function<bool()> &cancelled,
+	Segment &segment
+) {
+	const size_t scalers = indexes.size();
+	const time_t step = option.step;
+	segment.first_bucket = (segment.time - option.start_time) / step;
+	size_t last_bucket =
+		(segment.time + segment.size - 1 - option.start_time) / step;
+	Accumulator initial = {0, std::numeric_limits<uint32_t>::max(), 0, 0, 0};
+	segment.accumulators.assign(
+		(last_bucket - segment.first_bucket + 1) * scalers, initial
+	);
+	segment.found = true;
+
+	ScalerReduction reduction;
+	uint64_t sums[kMaxScalers];
+	for (size_t bucket = 0; bucket <= last_bucket - segment.first_bucket; ++bucket) {
+		if (cancelled && cancelled()) return -3;
+		// seconds of bucket in this segment
+		time_t begin = option.start_time + (segment.first_bucket + bucket) * step;
+		time_t end = std::min(begin + step, option.end_time);
+		begin = std::max(begin, segment.time);
+		end = std::min(end, time_t(segment.time + segment.size));
+		size_t second = segment.second + (begin - segment.time);
+		size_t size = end - begin;
+		Accumulator *accumulators = segment.accumulators.data() + bucket*scalers;
+
+		if (need_rows) {
+			// reduce every row
+			reduction.Reset();
+			for (size_t offset = 0; offset < size; offset += kQueryChunkSeconds) {
+				if (offset && cancelled && cancelled()) return -3;
+				size_t chunk = std::min(kQueryChunkSeconds, size - offset);
+				int result = storage.Reduce(
+					&segment.date, second + offset, chunk, reduction, option.flag
+				);
+				if (result) {
+					segment.found = false;
+					return 0;
+				}
+			}
+			for (size_t i = 0; i < scalers; ++i) {
+				accumulators[i].sum = reduction.sum[indexes[i]];
+				accumulators[i].min = reduction.min[indexes[i]];
+				accumulators[i].max = reduction.max[indexes[i]];
+				accumulators[i].last = reduction.last[indexes[i]];
+				accumulators[i].count = size;
+			}
+			continue;
+		}
+
+		// read sums, from rollup if possible
+		for (size_t i = 0; i < kMaxScalers; ++i) sums[i] = 0;
+		if (storage.Sum(&segment.date, second, size, sums)) {
+			segment.found = false;
+			return 0;
+		}
+		for (size_t i = 0; i < scalers; ++i) {
+			accumulators[i].sum = sums[indexes[i]];
+			accumulators[i].count = size;
+		}
+		if (need_last) {
+			storage.Scan(
+				&segment.date, second + size - 1, 1,
+				[&](const uint32_t *row) {
+					for (size_t i = 0; i < scalers; ++i) {
+						accumulators[i].last = row[indexes[i]];
+					}
+				}
+			);
+		}
+	}
+	return 0;
+}
+
+
+// segments shared by the querying thread and helpers in executor, helpers
+// may start after the query returns and find nothing left
+struct SegmentReading {
+	const ScalerStorage *storage;
+	ScalerQueryOption option;
+	std::vector<int> indexes;
+	bool need_rows;
+	bool need_last;
+	std::function<bool()> cancelled;
+	std::vector<Segment> segments;
+
+	// protect the states below and the segments being read
+	std::mutex mutex;
+	std::condition_variable condition;
+	// next segment to read
+	size_t next;
+	// segments being read
+	size_t reading;
+	// cancelled
+	bool stopped;
+};
+
+
+/// @brief read segments until none is left
+void ReadSegments(SegmentReading &reading) {
+	std::unique_lock<std::mutex> lock(reading.mutex);
+	while (!reading.stopped && reading.next < reading.segments.size()) {
+		Segment &segment = reading.segments[reading.next++];
+		++reading.reading;
+		lock.unlock();
+		int result = ReadSegment(
+			*reading.storage, reading.option, reading.indexes,
+			reading.need_rows, reading.need_last, reading.cancelled, segment
+		);
+		lock.lock();
+		--reading.reading;
+		if (result) reading.stopped = true;
+	}
+	reading.condition.notify_all();
+}
+
+}	// namespace
+
+
+int QueryScalers(
+	const ScalerStorage &storage,
+	const ScalerQueryOption &option,
+	const std::function<bool()> &cancelled,
+	std::vector<ScalerQuerySeries> &series,
+	ScalerExecutor *executor
+) noexcept {
+	series.clear();
+	// check option
+	if (option.step <= 0 || option.flag == 0) return -1;
+	if (option.end_time <= option.start_time) return -1;
+	if (option.end_time - option.start_time > kMaxQueryDays * time_t(kDaySeconds)) {
+		return -1;
+	}
+	// each kind of aggregation once, in order of first appearance
+	std::vector<ScalerAggregation> aggregations;
+	for (ScalerAggregation aggregation : option.aggregations) {
+		if (aggregation < kAggregateMean || aggregation > kAggregateLast) {
+			return -1;
+		}
+		if (
+			std::find(aggregations.begin(), aggregations.end(), aggregation)
+			== aggregations.end()
+		) {
+			aggregations.push_back(aggregation);
+		}
+	}
+	if (aggregations.empty()) return -1;
+	std::vector<int> indexes;
+	for (int i = 0; i < int(kMaxScalers); ++i) {
+		if (option.flag & (1u << i)) indexes.push_back(i);
+	}
+	const size_t buckets =
+		(option.end_time - option.start_time + option.step - 1) / option.step;
+	if (buckets * indexes.size() * aggregations.size() > kMaxQueryPoints) {
+		return -1;
+	}
+
+	bool need_rows = option.step < kQueryRowStep;
+	bool need_last = false;
+	for (ScalerAggregation aggregation : aggregations) {
+		if (aggregation == kAggregateMin || aggregation == kAggregateMax) {
+			need_rows = true;
+		} else if (aggregation == kAggregateLast) {
+			need_last = true;
+		}
+	}
+
+	// Seconds not written yet read as zero in day files, leave them out so
+	// the buckets beyond are NaN. Without writer, nothing after now is
+	// written.
+	time_t end_time = storage.WrittenEnd();
+	if (end_time == 0) end_time = time(NULL);
+	end_time = std::min(end_time, option.end_time);
+
+	// split range by days
+	auto reading = std::make_shared<SegmentReading>();
+	std::vector<Segment> &segments = reading->segments;
+	for (time_t time = option.start_time; time < end_time;) {
+		Segment segment;
+		localtime_r(&time, &segment.date);
+		segment.time = time;
+		segment.second = DaySecond(&segment.date);
+		segment.size = std::min(
+			kDaySeconds - segment.second, size_t(end_time - time)
+		);
+		segments.push_back(segment);
+		time += segment.size;
+	}
+
+	// Read segments in parallel with helpers in executor, bounded by its
+	// threads. Helpers are only added while no query is waiting, so they
+	// never push queries out of the queue. This thread reads the segments
+	// no helper takes, so it never waits for helpers not started.
+	reading->storage = &storage;
+	reading->option = option;
+	reading->indexes = indexes;
+	reading->need_rows = need_rows;
+	reading->need_last = need_last;
+	reading->cancelled = cancelled;
+	reading->next = 0;
+	reading->reading = 0;
+	reading->stopped = false;
+	if (executor && segments.size() > 1 && executor->Metrics().queued == 0) {
+		size_t helpers = std::min(kMaxQueryThreads, segments.size()) - 1;
+		for (size_t i = 0; i < helpers; ++i) {
+			executor->Submit([reading](bool stopping) {
+				if (!stopping) ReadSegments(*reading);
+			});
+		}
+	}
+	ReadSegments(*reading);
+	{
+		std::unique_lock<std::mutex> lock(reading->mutex);
+		reading->condition.wait(lock, [&reading]() {
+			return reading->reading == 0;
+		});
+		if (reading->stopped) return -3;
+	}
+
+	// merge segments in time order
+	Accumulator initial = {0, std::numeric_limits<uint32_t>::max(), 0, 0, 0};
+	std::vector<Accumulator> accumulators(buckets * indexes.size(), initial);
+	for (const Segment &segment : segments) {
+		if (!segment.found) continue;
+		size_t size = segment.accumulators.size() / indexes.size();
+		for (size_t bucket = 0; bucket < size; ++bucket) {
+			for (size_t i = 0; i < indexes.size(); ++i) {
+				const Accumulator &from =
+					segment.accumulators[bucket*indexes.size() + i];
+				if (from.count == 0) continue;
+				Accumulator &to = accumulators[
+					(segment.first_bucket + bucket) * indexes.size() + i
+				];
+				to.sum += from.sum;
+				to.min = std::min(to.min, from.min);
+				to.max = std::max(to.max, from.max);
+				to.last = from.last;
+				to.count += from.count;
+			}
+		}
+	}
+
+	// fill results
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		for (ScalerAggregation aggregation : aggregations) {
+			ScalerQuerySeries result;
+			result.index = indexes[i];
+			result.aggregation = aggregation;
+			result.values.reserve(buckets);
+			for (size_t bucket = 0; bucket < buckets; ++bucket) {
+				const Accumulator &accumulator =
+					accumulators[bucket*indexes.size() + i];
+				double value = std::nan("");
+				if (accumulator.count) {
+					if (aggregation == kAggregateMean) {
+						value = double(accumulator.sum) / accumulator.count;
+					} else if (aggregation == kAggregateMin) {
+						value = accumulator.min;
+					} else if (aggregation == kAggregateMax) {
+						value = accumulator.max;
+					} else if (aggregation == kAggregateSum) {
+						value = double(accumulator.sum);
+					} else {
+						value = accumulator.last;
+					}
+				}
+				result.values.push_back(value);
+			}
+			series.push_back(result);
+		}
+	}
+	return 0;
+}
+
+}	// namespace ecl
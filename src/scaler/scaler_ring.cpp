@@ -0,0 +1,92 @@
+#include "scaler/scaler_ring.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include "scaler/scaler_kernel.h"
+
+namespace ecl {
+
+void ScalerRing::FreeDeleter::operator()(void *pointer) const noexcept {
+	free(pointer);
+}
+
+
+ScalerRing::ScalerRing() noexcept
+: stamps_(new std::atomic<int64_t>[kDaySeconds]) {
+
+	// aligned to cache line, new doesn't respect alignment before C++17
+	void *memory = nullptr;
+	if (posix_memalign(&memory, alignof(Slot), sizeof(Slot) * kDaySeconds)) {
+		memory = nullptr;
+	}
+	slots_.reset((Slot*)memory);
+	for (size_t i = 0; i < kDaySeconds; ++i) {
+		stamps_[i].store(kEmptyStamp, std::memory_order_relaxed);
+	}
+}
+
+
+void ScalerRing::Push(time_t time, const uint32_t *scalers) noexcept {
+	if (!slots_ || time < 0) return;
+	size_t slot = size_t(time) % kDaySeconds;
+	stamps_[slot].store(kEmptyStamp, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(slots_[slot].values, scalers, sizeof(Slot::values));
+	stamps_[slot].store(int64_t(time), std::memory_order_release);
+}
+
+
+bool ScalerRing::Read(time_t time, uint32_t *scalers) const noexcept {
+	if (slots_ && time >= 0) {
+		size_t slot = size_t(time) % kDaySeconds;
+		while (true) {
+			int64_t begin = stamps_[slot].load(std::memory_order_acquire);
+			if (begin != int64_t(time)) break;
+			memcpy(scalers, slots_[slot].values, sizeof(Slot::values));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			// not changed during copying
+			if (stamps_[slot].load(std::memory_order_relaxed) == begin) {
+				return true;
+			}
+		}
+	}
+	memset(scalers, 0, sizeof(Slot::values));
+	return false;
+}
+
+
+void ScalerRing::Sum(time_t time, size_t size, uint64_t *sums) const noexcept {
+	uint32_t values[kMaxScalers];
+	for (size_t i = 0; i < size; ++i) {
+		if (!Read(time + time_t(i), values)) continue;
+		SumRows(values, 1, sums);
+	}
+}
+
+
+size_t ScalerRing::Load(const ScalerStorage &storage, time_t now) noexcept {
+	size_t loaded = 0;
+	time_t time = now - time_t(kDaySeconds) + 1;
+	while (time < now) {
+		// read the rest of the day, or until now
+		tm date;
+		localtime_r(&time, &date);
+		size_t second = DaySecond(&date);
+		size_t size = kDaySeconds - second;
+		if (time_t(size) > now - time) size = size_t(now - time);
+		time_t next = time;
+		int result = storage.Scan(
+			&date, second, size,
+			[&](const uint32_t *row) {
+				Push(next, row);
+				++next;
+			}
+		);
+		if (result == 0) loaded += size;
+		time += time_t(size);
+	}
+	return loaded;
+}
+
+}	// namespace ecl
@@ -0,0 +1,207 @@
+#include "scaler/scaler_rollup.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#include "scaler/scaler_kernel.h"
+
+namespace ecl {
+
+std::string ScalerRollupFileName(
+	const std::string &data_path,
+	const std::string &device_name,
+	const tm *date
+) noexcept {
+	std::string name = ScalerFileName(data_path, device_name, date);
+	// replace the extension .bin
+	return name.substr(0, name.length()-4) + ".rollup";
+}
+
+
+ScalerRollup::ScalerRollup() noexcept
+: fd_(-1)
+, writable_(false)
+, map_(nullptr) {
+
+	for (size_t i = 0; i < kRollupTiers; ++i) tiers_[i] = nullptr;
+}
+
+
+ScalerRollup::~ScalerRollup() noexcept {
+	Close();
+}
+
+
+int ScalerRollup::Create(const std::string &name) noexcept {
+	ScalerRollupHeader header;
+	header.version = 1;
+	header.number = kMaxScalers;
+	header.tiers = kRollupTiers;
+	header.dirty = 0;
+	header.reserve = 0;
+	return CreateSizedFile(name, &header, sizeof(header), kScalerRollupFileSize);
+}
+
+
+int ScalerRollup::Open(
+	const std::string &name,
+	const ScalerFile *day,
+	bool writable
+) noexcept {
+	Close();
+	// rebuild if the rollup file is created for existing day file
+	bool rebuild = false;
+	if (access(name.c_str(), F_OK)) {
+		if (!writable || !day) return -2;
+		if (Create(name)) return -1;
+		rebuild = true;
+	}
+
+	fd_ = open(name.c_str(), writable ? O_RDWR : O_RDONLY);
+	if (fd_ < 0) {
+		std::cout << "[Error] Open file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	// check size
+	struct stat file_stat;
+	if (
+		fstat(fd_, &file_stat)
+		|| size_t(file_stat.st_size) < kScalerRollupFileSize
+	) {
+		std::cout << "[Error] Invalid size of rollup file " << name << "\n";
+		Close();
+		return -1;
+	}
+	// map
+	void *map = mmap(
+		NULL, kScalerRollupFileSize,
+		writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+		fd_, 0
+	);
+	if (map == MAP_FAILED) {
+		std::cout << "[Error] Map file " << name << " failed: "
+			<< strerror(errno) << "\n";
+		Close();
+		return -1;
+	}
+	map_ = (uint8_t*)map;
+	// check header
+	if (
+		Header()->version != 1
+		|| Header()->number != kMaxScalers
+		|| Header()->tiers != kRollupTiers
+	) {
+		std::cout << "[Error] Invalid header of rollup file " << name << "\n";
+		Close();
+		return -1;
+	}
+	tiers_[0] = (uint64_t*)(map_ + sizeof(ScalerRollupHeader));
+	for (size_t i = 1; i < kRollupTiers; ++i) {
+		tiers_[i] = tiers_[i-1]
+			+ kDaySeconds / kRollupTierSeconds[i-1] * kMaxScalers;
+	}
+	name_ = name;
+
+	if (writable) {
+		writable_ = true;
+		if ((rebuild || Header()->dirty) && day) {
+			if (Build(*day)) {
+				Close();
+				return -1;
+			}
+		}
+		// mark dirty until closed
+		Header()->dirty = 1;
+		msync(map_, sizeof(ScalerRollupHeader), MS_SYNC);
+	}
+	return 0;
+}
+
+
+void ScalerRollup::Close() noexcept {
+	if (map_) {
+		if (writable_) {
+			msync(map_, kScalerRollupFileSize, MS_SYNC);
+			Header()->dirty = 0;
+			msync(map_, sizeof(ScalerRollupHeader), MS_SYNC);
+		}
+		munmap(map_, kScalerRollupFileSize);
+	}
+	if (fd_ >= 0) close(fd_);
+	fd_ = -1;
+	writable_ = false;
+	map_ = nullptr;
+	for (size_t i = 0; i < kRollupTiers; ++i) tiers_[i] = nullptr;
+}
+
+
+int ScalerRollup::Build(const ScalerFile &day) noexcept {
+	if (!map_ || !writable_ || !day.IsOpen()) return -1;
+	// the finest tier from rows
+	const size_t first_width = kRollupTierSeconds[0];
+	for (size_t bucket = 0; bucket < kDaySeconds / first_width; ++bucket) {
+		uint64_t *sums = tiers_[0] + bucket * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) sums[i] = 0;
+		if (day.Version() == kScalerFileRowMajor) {
+			SumRows(day.Row(bucket * first_width), first_width, sums);
+			continue;
+		}
+		// buckets never cross blocks of column major file
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			const uint32_t *column = day.Column(bucket * first_width, i);
+			for (size_t second = 0; second < first_width; ++second) {
+				sums[i] += column[second];
+			}
+		}
+	}
+	// coarser tiers from the finer one
+	for (size_t tier = 1; tier < kRollupTiers; ++tier) {
+		const size_t width = kRollupTierSeconds[tier];
+		const size_t ratio = width / kRollupTierSeconds[tier-1];
+		for (size_t bucket = 0; bucket < kDaySeconds / width; ++bucket) {
+			uint64_t *sums = tiers_[tier] + bucket * kMaxScalers;
+			for (size_t i = 0; i < kMaxScalers; ++i) sums[i] = 0;
+			for (size_t j = 0; j < ratio; ++j) {
+				const uint64_t *fine = Bucket(tier-1, bucket * ratio + j);
+				for (size_t i = 0; i < kMaxScalers; ++i) sums[i] += fine[i];
+			}
+		}
+	}
+	return 0;
+}
+
+
+void ScalerRollup::Update(
+	size_t second,
+	const uint32_t *old_row,
+	const uint32_t *new_row
+) noexcept {
+	for (size_t tier = 0; tier < kRollupTiers; ++tier) {
+		uint64_t *sums = tiers_[tier]
+			+ second / kRollupTierSeconds[tier] * kMaxScalers;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			// unsigned wrap-around gives the right result when decreasing
+			sums[i] += uint64_t(new_row[i]) - uint64_t(old_row[i]);
+		}
+	}
+}
+
+
+int ScalerRollup::Sync(bool wait) noexcept {
+	if (!map_ || !writable_) return -1;
+	if (msync(map_, kScalerRollupFileSize, wait ? MS_SYNC : MS_ASYNC)) {
+		std::cout << "[Error] Sync file " << name_ << " failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	return 0;
+}
+
+}	// namespace ecl
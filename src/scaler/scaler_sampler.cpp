@@ -0,0 +1,266 @@
+#include "scaler/scaler_sampler.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace ecl {
+
+ScalerSampler::ScalerSampler(
+	const ScalerSamplerOption &option,
+	std::function<void(time_t)> sample
+) noexcept
+: priority_(option.priority)
+, cpu_(option.cpu)
+, sample_(sample)
+, irq_fd_(option.irq_fd)
+, irq_timeout_(option.irq_timeout)
+, irq_count_(0)
+, irq_second_(0)
+, irq_time_()
+, timer_fd_(-1)
+, stop_fd_(-1)
+, next_(0)
+, metrics_() {
+}
+
+
+ScalerSampler::~ScalerSampler() noexcept {
+	Stop();
+}
+
+
+int ScalerSampler::Start() noexcept {
+	if (thread_.joinable()) return 0;
+	timer_fd_ = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+	stop_fd_ = eventfd(0, EFD_CLOEXEC);
+	if (timer_fd_ < 0 || stop_fd_ < 0) {
+		std::cout << "[Error] Create sampler timer failed: "
+			<< strerror(errno) << "\n";
+		Stop();
+		return -1;
+	}
+	int result = 0;
+	if (irq_fd_ < 0) {
+		result = Arm();
+	} else if (EnableIrq()) {
+		std::cout << "[Error] No interrupt from scaler device, sample by timer.\n";
+		result = FallBack();
+	}
+	if (result) {
+		Stop();
+		return -1;
+	}
+	thread_ = std::thread(&ScalerSampler::Loop, this);
+	return 0;
+}
+
+
+void ScalerSampler::Stop() noexcept {
+	if (thread_.joinable()) {
+		uint64_t value = 1;
+		if (write(stop_fd_, &value, sizeof(value)) != sizeof(value)) {
+			std::cout << "[Error] Stop sampler failed: " << strerror(errno) << "\n";
+		}
+		thread_.join();
+	}
+	if (timer_fd_ >= 0) close(timer_fd_);
+	if (stop_fd_ >= 0) close(stop_fd_);
+	timer_fd_ = -1;
+	stop_fd_ = -1;
+}
+
+
+ScalerSamplerMetrics ScalerSampler::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	return metrics_;
+}
+
+
+int ScalerSampler::Arm() noexcept {
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	next_ = now.tv_sec + 1;
+	itimerspec spec;
+	spec.it_value.tv_sec = next_;
+	spec.it_value.tv_nsec = 0;
+	spec.it_interval.tv_sec = 1;
+	spec.it_interval.tv_nsec = 0;
+	// reading the timer fails with ECANCELED if the clock is set
+	if (timerfd_settime(
+		timer_fd_, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, nullptr
+	)) {
+		std::cout << "[Error] Arm sampler timer failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	return 0;
+}
+
+
+int ScalerSampler::EnableIrq() noexcept {
+	// UIO devices without interrupt control fail in writing
+	uint32_t enable = 1;
+	if (write(irq_fd_, &enable, sizeof(enable)) != ssize_t(sizeof(enable))) {
+		std::cout << "[Error] Enable interrupt failed: "
+			<< strerror(errno) << "\n";
+		return -1;
+	}
+	return 0;
+}
+
+
+void ScalerSampler::Loop() noexcept {
+	// Failing to get real time scheduling only loses the guarantee, so keep
+	// sampling in normal scheduling.
+	if (priority_ > 0) {
+		sched_param param;
+		param.sched_priority = priority_;
+		int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+		if (result) {
+			std::cout << "[Error] Set sampler priority " << priority_
+				<< " failed: " << strerror(result) << "\n";
+		}
+	}
+	if (cpu_ >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu_, &cpus);
+		int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		if (result) {
+			std::cout << "[Error] Pin sampler to CPU " << cpu_
+				<< " failed: " << strerror(result) << "\n";
+		}
+	}
+
+	pollfd fds[2];
+	fds[1].fd = stop_fd_;
+	fds[1].events = POLLIN;
+	while (true) {
+		const bool irq = irq_fd_ >= 0;
+		fds[0].fd = irq ? irq_fd_ : timer_fd_;
+		fds[0].events = POLLIN;
+		int ready = poll(fds, 2, irq ? irq_timeout_ : -1);
+		if (ready < 0) {
+			if (errno == EINTR) continue;
+			std::cout << "[Error] Wait for sampling failed: "
+				<< strerror(errno) << "\n";
+			return;
+		}
+		if (fds[1].revents) return;
+		if (irq) {
+			if (
+				ready == 0
+				|| (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+				|| (fds[0].revents && OnIrq())
+			) {
+				// interrupts stop, keep sampling by timer
+				std::cout << "[Error] No interrupt from scaler device in "
+					<< irq_timeout_ << " ms, sample by timer.\n";
+				if (FallBack()) return;
+			}
+		} else if (fds[0].revents && OnTimer()) {
+			return;
+		}
+	}
+}
+
+
+int ScalerSampler::FallBack() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(metrics_mutex_);
+		++metrics_.irq_fallbacks;
+	}
+	irq_fd_ = -1;
+	return Arm();
+}
+
+
+int ScalerSampler::OnTimer() noexcept {
+	uint64_t expirations = 0;
+	if (read(timer_fd_, &expirations, sizeof(expirations)) < 0) {
+		if (errno == ECANCELED) {
+			// clock set, align to the new second boundaries
+			{
+				std::lock_guard<std::mutex> lock(metrics_mutex_);
+				++metrics_.clock_changes;
+			}
+			return Arm();
+		}
+		return 0;
+	}
+	if (expirations == 0) return 0;
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	// the latest expired deadline, the earlier ones are missed
+	time_t deadline = next_ + time_t(expirations) - 1;
+	next_ += time_t(expirations);
+	int64_t lateness = (int64_t(now.tv_sec) - int64_t(deadline)) * 1000000
+		+ now.tv_nsec / 1000;
+	if (lateness < 0) lateness = 0;
+	sample_(deadline);
+	Record(uint64_t(lateness), expirations - 1);
+	return 0;
+}
+
+
+int ScalerSampler::OnIrq() noexcept {
+	uint32_t count = 0;
+	ssize_t size = read(irq_fd_, &count, sizeof(count));
+	if (size != ssize_t(sizeof(count))) {
+		if (size < 0 && (errno == EINTR || errno == EAGAIN)) return 0;
+		std::cout << "[Error] Read interrupt failed.\n";
+		return -1;
+	}
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	// sample first, the interrupt is enabled again after it
+	uint64_t passed = 1;
+	uint64_t jitter = 0;
+	time_t second = now.tv_sec;
+	if (irq_second_) {
+		passed = count - irq_count_;
+		if (passed == 0) passed = 1;
+		// follow the system clock if drifted apart, but never go back
+		time_t expected = irq_second_ + time_t(passed);
+		if (expected >= second - 1 && expected <= second + 1) second = expected;
+		if (second <= irq_second_) second = irq_second_ + 1;
+		int64_t period = (int64_t(now.tv_sec) - int64_t(irq_time_.tv_sec)) * 1000000
+			+ (now.tv_nsec - irq_time_.tv_nsec) / 1000;
+		int64_t deviation = period - int64_t(passed) * 1000000;
+		jitter = uint64_t(deviation < 0 ? -deviation : deviation);
+	}
+	irq_count_ = count;
+	irq_second_ = second;
+	irq_time_ = now;
+	sample_(second);
+	{
+		std::lock_guard<std::mutex> lock(metrics_mutex_);
+		++metrics_.irq_samples;
+	}
+	Record(jitter, passed - 1);
+	return EnableIrq();
+}
+
+
+void ScalerSampler::Record(uint64_t lateness, uint64_t missed) noexcept {
+	size_t bucket = 0;
+	while (bucket < kLatenessBounds && lateness > kLatenessBoundUs[bucket]) {
+		++bucket;
+	}
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	++metrics_.samples;
+	metrics_.missed += missed;
+	metrics_.total_lateness_us += lateness;
+	if (lateness > metrics_.max_lateness_us) metrics_.max_lateness_us = lateness;
+	++metrics_.lateness[bucket];
+}
+
+}	// namespace ecl
@@ -0,0 +1,556 @@
+#include "scaler/scaler_storage.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace ecl {
+
+ScalerStorage::ScalerStorage(const ScalerStorageOption &option) noexcept
+: data_path_(option.data_path)
+, device_name_(option.device_name)
+, sync_interval_(option.sync_interval)
+, cache_days_(option.cache_days)
+, use_count_(0)
+, write_date_(0)
+, dirty_first_(kDaySeconds)
+, dirty_last_(0)
+, unsynced_writes_(0)
+, sequence_(0)
+, writing_row_(-2)
+, written_end_(0)
+, prepare_stop_(false)
+, prepare_pending_(false)
+, prepared_key_(0)
+, metrics_() {
+
+	if (data_path_.empty()) data_path_ = "./";
+	if (data_path_[data_path_.length()-1] != '/') data_path_ += "/";
+	prepare_ahead_ = option.prepare_ahead;
+	file_version_ = option.file_version;
+	prefix_index_ = option.prefix_index;
+	if (prepare_ahead_ > 0) {
+		prepare_thread_ = std::thread(&ScalerStorage::PrepareLoop, this);
+	}
+}
+
+
+ScalerStorage::~ScalerStorage() noexcept {
+	if (prepare_thread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(prepare_mutex_);
+			prepare_stop_ = true;
+		}
+		prepare_cond_.notify_one();
+		prepare_thread_.join();
+	}
+	Sync(true);
+}
+
+
+std::shared_ptr<ScalerDayFiles> ScalerStorage::Acquire(
+	int date_key,
+	const tm *date,
+	bool writable
+) const noexcept {
+	std::unique_lock<std::mutex> lock(files_mutex_);
+	while (true) {
+		++use_count_;
+		auto search = files_.find(date_key);
+		if (search != files_.end()) {
+			if (!writable || search->second.files->data.Writable()) {
+				search->second.last_use = use_count_;
+				return search->second.files;
+			}
+		}
+		if (!opening_.count(date_key)) break;
+		// opened by others, look again after that
+		opened_cond_.wait(lock, [this, date_key]() {
+			return !opening_.count(date_key);
+		});
+	}
+
+	// open without lock, other days are served meanwhile
+	opening_.insert(date_key);
+	lock.unlock();
+	std::shared_ptr<ScalerDayFiles> files = Open(date, writable);
+	// evicted files are unmapped after unlock
+	std::vector<std::shared_ptr<ScalerDayFiles>> evicted;
+	lock.lock();
+	opening_.erase(date_key);
+	opened_cond_.notify_all();
+	if (!files) return nullptr;
+	// Readers holding the old read-only mapping can still use it, since the
+	// mappings are shared.
+	files_[date_key] = FileEntry{files, use_count_};
+
+	// evict the least recently used past days
+	while (files_.size() > cache_days_ + 1) {
+		auto evict = files_.end();
+		for (auto iter = files_.begin(); iter != files_.end(); ++iter) {
+			// never evict the writing file
+			if (iter->first == write_date_.load()) continue;
+			if (evict == files_.end() || iter->second.last_use < evict->second.last_use) {
+				evict = iter;
+			}
+		}
+		if (evict == files_.end()) break;
+		evicted.push_back(evict->second.files);
+		files_.erase(evict);
+	}
+	lock.unlock();
+
+	return files;
+}
+
+
+std::shared_ptr<ScalerDayFiles> ScalerStorage::Open(
+	const tm *date,
+	bool writable
+) const noexcept {
+	std::shared_ptr<ScalerDayFiles> files = std::make_shared<ScalerDayFiles>();
+	std::string name = ScalerFileName(data_path_, device_name_, date);
+	std::string rollup_name =
+		ScalerRollupFileName(data_path_, device_name_, date);
+	std::string archive_name =
+		ScalerArchiveFileName(data_path_, device_name_, date);
+	std::string prefix_name =
+		ScalerPrefixFileName(data_path_, device_name_, date);
+	const bool has_data = access(name.c_str(), F_OK) == 0;
+	const bool has_archive = access(archive_name.c_str(), F_OK) == 0;
+	if (has_data || (writable && !has_archive)) {
+		// rollup and prefix left by removed day file are useless
+		if (!has_data) {
+			unlink(rollup_name.c_str());
+			unlink(prefix_name.c_str());
+		}
+		int result = files->data.Open(
+			name, writable, writable, file_version_
+		);
+		if (result == -2) return nullptr;
+		if (result) {
+			std::cout << "[Error] Open scaler file " << name << " failed.\n";
+			return nullptr;
+		}
+	} else if (writable) {
+		std::cout << "[Error] Scaler file " << name << " is archived.\n";
+		return nullptr;
+	} else if (has_archive && files->archive.Open(archive_name)) {
+		std::cout << "[Error] Open archive file " << archive_name << " failed.\n";
+		return nullptr;
+	}
+	// Without rollup, the sums are read from the day file. Days past the
+	// retention only keep the rollup.
+	files->rollup.Open(
+		rollup_name, writable ? &files->data : nullptr, writable
+	);
+	if (!files->HasValues() && !files->rollup.Valid()) return nullptr;
+	if (prefix_index_) {
+		files->prefix.Open(
+			prefix_name, writable ? &files->data : nullptr, writable
+		);
+	} else if (writable) {
+		// prefix not updated with the day file is useless
+		unlink(prefix_name.c_str());
+	}
+	return files;
+}
+
+
+int ScalerStorage::Write(time_t time, const uint32_t *scalers) noexcept {
+	tm date;
+	localtime_r(&time, &date);
+	int date_key = DateKey(&date);
+	size_t second = DaySecond(&date);
+
+	// switch to the file of new day
+	if (date_key != write_date_ || !write_file_) {
+		auto start = std::chrono::steady_clock::now();
+		bool rollover = write_file_ != nullptr;
+		Sync(true);
+		write_date_ = date_key;
+		{
+			std::lock_guard<std::mutex> lock(create_mutex_);
+			write_file_ = Acquire(date_key, &date, true);
+		}
+		if (!write_file_) {
+			write_date_ = 0;
+			return -1;
+		}
+		if (rollover) {
+			uint64_t duration = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - start
+			).count();
+			std::lock_guard<std::mutex> lock(metrics_mutex_);
+			++metrics_.rollovers;
+			metrics_.last_rollover_us = duration;
+			if (duration > metrics_.max_rollover_us) {
+				metrics_.max_rollover_us = duration;
+			}
+			metrics_.total_rollover_us += duration;
+		}
+	}
+
+	// create the next day file before midnight
+	if (prepare_ahead_ > 0 && second + prepare_ahead_ >= kDaySeconds) {
+		tm next = date;
+		next.tm_mday++;
+		next.tm_hour = next.tm_min = next.tm_sec = 0;
+		next.tm_isdst = -1;
+		mktime(&next);
+		int next_key = DateKey(&next);
+		if (next_key != prepared_key_) {
+			prepared_key_ = next_key;
+			Prepare(&next);
+		}
+	}
+
+	// write the row and rollup in sequence lock
+	writing_row_.store(RowKey(date_key, second), std::memory_order_seq_cst);
+	sequence_.fetch_add(1, std::memory_order_acq_rel);
+	std::atomic_thread_fence(std::memory_order_release);
+	if (write_file_->rollup.Valid() || write_file_->prefix.Valid()) {
+		uint32_t old[kMaxScalers];
+		write_file_->data.ReadRow(second, old);
+		if (write_file_->rollup.Valid()) {
+			write_file_->rollup.Update(second, old, scalers);
+		}
+		if (write_file_->prefix.Valid()) {
+			write_file_->prefix.Update(second, old, scalers);
+		}
+	}
+	write_file_->data.WriteRow(second, scalers);
+	sequence_.fetch_add(1, std::memory_order_release);
+	written_end_.store(time + 1, std::memory_order_release);
+
+	// record the dirty rows
+	if (second < dirty_first_) dirty_first_ = second;
+	if (second > dirty_last_) dirty_last_ = second;
+	++unsynced_writes_;
+	if (sync_interval_ > 0 && unsynced_writes_ >= sync_interval_) {
+		return Sync(false);
+	}
+	return 0;
+}
+
+
+int ScalerStorage::Sync(bool wait) noexcept {
+	if (!write_file_ || dirty_first_ > dirty_last_) return 0;
+	int result = write_file_->data.Sync(dirty_first_, dirty_last_, wait);
+	if (write_file_->rollup.Valid()) {
+		if (write_file_->rollup.Sync(wait)) result = -1;
+	}
+	if (write_file_->prefix.Valid()) {
+		if (write_file_->prefix.Sync(wait)) result = -1;
+	}
+	dirty_first_ = kDaySeconds;
+	dirty_last_ = 0;
+	unsynced_writes_ = 0;
+	return result;
+}
+
+
+time_t ScalerStorage::WrittenEnd() const noexcept {
+	return written_end_.load(std::memory_order_acquire);
+}
+
+
+ScalerStorageMetrics ScalerStorage::Metrics() const noexcept {
+	std::lock_guard<std::mutex> lock(metrics_mutex_);
+	return metrics_;
+}
+
+
+void ScalerStorage::Prepare(const tm *date) noexcept {
+	{
+		std::lock_guard<std::mutex> lock(prepare_mutex_);
+		prepare_date_ = *date;
+		prepare_pending_ = true;
+	}
+	prepare_cond_.notify_one();
+}
+
+
+void ScalerStorage::PrepareLoop() noexcept {
+	std::unique_lock<std::mutex> lock(prepare_mutex_);
+	while (true) {
+		prepare_cond_.wait(lock, [this]() {
+			return prepare_stop_ || prepare_pending_;
+		});
+		if (prepare_stop_) return;
+		tm date = prepare_date_;
+		prepare_pending_ = false;
+		lock.unlock();
+
+		std::string name = ScalerFileName(data_path_, device_name_, &date);
+		std::string rollup_name =
+			ScalerRollupFileName(data_path_, device_name_, &date);
+		std::string prefix_name =
+			ScalerPrefixFileName(data_path_, device_name_, &date);
+		int result = 0;
+		bool created = false;
+		{
+			std::lock_guard<std::mutex> create_lock(create_mutex_);
+			if (access(name.c_str(), F_OK)) {
+				// new day file comes with new rollup of zero sums
+				unlink(rollup_name.c_str());
+				unlink(prefix_name.c_str());
+				result = ScalerFile::Create(name, file_version_);
+				if (!result) {
+					result = ScalerRollup::Create(rollup_name);
+				}
+				if (!result && prefix_index_) {
+					result = ScalerPrefix::Create(prefix_name);
+				}
+				created = result == 0;
+			} else {
+				// existing files may be sparse, allocate them now so a full
+				// disk is found before the day begins instead of in writing
+				result = AllocateFile(name);
+				if (!result && !access(rollup_name.c_str(), F_OK)) {
+					result = AllocateFile(rollup_name);
+				}
+				if (
+					!result && prefix_index_
+					&& !access(prefix_name.c_str(), F_OK)
+				) {
+					result = AllocateFile(prefix_name);
+				}
+			}
+		}
+		if (result) {
+			std::cout << "[Error] Prepare scaler file " << name << " failed.\n";
+			std::lock_guard<std::mutex> metrics_lock(metrics_mutex_);
+			++metrics_.prepare_failures;
+		} else if (created) {
+			std::lock_guard<std::mutex> metrics_lock(metrics_mutex_);
+			++metrics_.prepared_files;
+		}
+
+		lock.lock();
+	}
+}
+
+
+int ScalerStorage::Sum(
+	const tm *date,
+	size_t second,
+	size_t size,
+	uint64_t *sums
+) const noexcept {
+	if (second + size > kDaySeconds) return -1;
+	int date_key = DateKey(date);
+	std::shared_ptr<ScalerDayFiles> files = Acquire(date_key, date, false);
+	if (!files) return -2;
+	if (files->prefix.Valid()) {
+		// difference of two prefix sums
+		uint64_t before[kMaxScalers];
+		uint64_t after[kMaxScalers];
+		ReadPrefix(*files, date_key, second, before);
+		ReadPrefix(*files, date_key, second + size, after);
+		for (size_t i = 0; i < kMaxScalers; ++i) sums[i] += after[i] - before[i];
+		return 0;
+	}
+	const bool rollup = files->rollup.Valid();
+	if (!files->HasValues()) {
+		// only sums of whole buckets are kept
+		const size_t width = kRollupTierSeconds[0];
+		if (second % width || size % width) return -2;
+	}
+
+	uint64_t copied[kMaxScalers];
+	while (size > 0) {
+		// find the coarsest bucket starting here and fitting in the range
+		size_t tier = kRollupTiers;
+		if (rollup) {
+			for (size_t i = kRollupTiers; i > 0; --i) {
+				size_t width = kRollupTierSeconds[i-1];
+				if (second % width == 0 && width <= size) {
+					tier = i - 1;
+					break;
+				}
+			}
+		}
+
+		if (tier < kRollupTiers) {
+			size_t width = kRollupTierSeconds[tier];
+			const uint64_t *bucket = files->rollup.Bucket(tier, second / width);
+			if (MayWriting(date_key, second + width - 1)) {
+				CopyLocked(copied, bucket, sizeof(copied));
+				bucket = copied;
+			}
+			for (size_t i = 0; i < kMaxScalers; ++i) sums[i] += bucket[i];
+			second += width;
+			size -= width;
+		} else {
+			// rows until the next bucket of the finest tier
+			size_t rows = size;
+			if (rollup) {
+				size_t width = kRollupTierSeconds[0];
+				rows = std::min(size, width - second % width);
+			}
+			ForRows(
+				*files, date_key, second, rows,
+				[sums](const uint32_t *row, size_t count) {
+					SumRows(row, count, sums);
+				}
+			);
+			second += rows;
+			size -= rows;
+		}
+	}
+	return 0;
+}
+
+
+int ScalerStorage::Reduce(
+	const tm *date,
+	size_t second,
+	size_t size,
+	ScalerReduction &reduction,
+	uint32_t flag
+) const noexcept {
+	if (second + size > kDaySeconds) return -1;
+	int date_key = DateKey(date);
+	std::shared_ptr<ScalerDayFiles> files = Acquire(date_key, date, false);
+	if (!files || !files->HasValues()) return -2;
+	if (files->archive.IsOpen()) {
+		// decode columns of selected scalers only
+		const size_t chunk_size = 1024;
+		uint32_t column[chunk_size];
+		for (size_t begin = 0; begin < size; begin += chunk_size) {
+			const size_t count = std::min(chunk_size, size - begin);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				if (!(flag & (1u << i))) continue;
+				files->archive.ReadColumn(second + begin, count, i, column);
+				ReduceColumn(column, count, i, reduction);
+			}
+		}
+		reduction.count += size;
+		return 0;
+	}
+	const ScalerFile &data = files->data;
+	if (data.Version() == kScalerFileColumnMajor) {
+		// read columns of selected scalers in stable rows
+		size_t stable = StableRows(date_key, second, size);
+		for (size_t begin = second; begin < second + stable;) {
+			size_t end = std::min(
+				second + stable,
+				begin - begin % kScalerBlockSeconds + kScalerBlockSeconds
+			);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				if (!(flag & (1u << i))) continue;
+				ReduceColumn(data.Column(begin, i), end - begin, i, reduction);
+			}
+			begin = end;
+		}
+		reduction.count += stable;
+		second += stable;
+		size -= stable;
+	}
+	ForRows(
+		*files, date_key, second, size,
+		[&reduction](const uint32_t *row, size_t count) {
+			ReduceRows(row, count, reduction);
+		}
+	);
+	return 0;
+}
+
+
+template<typename Kernel>
+void ScalerStorage::ForRows(
+	const ScalerDayFiles &files,
+	int date_key,
+	size_t second,
+	size_t size,
+	Kernel &&kernel
+) const noexcept {
+	const size_t tile_rows = 64;
+	uint32_t tile[tile_rows * kMaxScalers];
+	if (files.archive.IsOpen()) {
+		// archived day is never written, decode only the blocks in range
+		for (size_t begin = 0; begin < size; begin += tile_rows) {
+			size_t rows = std::min(tile_rows, size - begin);
+			files.archive.ReadRows(second + begin, rows, tile);
+			kernel((const uint32_t*)tile, rows);
+		}
+		return;
+	}
+	const ScalerFile &data = files.data;
+	size_t stable = StableRows(date_key, second, size);
+	if (data.Version() == kScalerFileRowMajor) {
+		// stable rows are passed to kernel directly in one block
+		if (stable) kernel(data.Row(second), stable);
+	} else {
+		// stable rows are gathered in tiles
+		for (size_t begin = 0; begin < stable; begin += tile_rows) {
+			size_t rows = std::min(tile_rows, stable - begin);
+			for (size_t i = 0; i < rows; ++i) {
+				data.ReadRow(second + begin + i, tile + i * kMaxScalers);
+			}
+			kernel((const uint32_t*)tile, rows);
+		}
+	}
+	// the others are copied with sequence lock
+	uint32_t copied[kMaxScalers];
+	for (size_t i = second + stable; i < second + size; ++i) {
+		ReadRowLocked(data, i, copied);
+		kernel((const uint32_t*)copied, 1);
+	}
+}
+
+
+void ScalerStorage::ReadPrefix(
+	const ScalerDayFiles &files,
+	int date_key,
+	size_t second,
+	uint64_t *sums
+) const noexcept {
+	if (second == 0 || !MayWriting(date_key, second - 1)) {
+		files.prefix.Before(second, sums);
+		return;
+	}
+	while (true) {
+		uint32_t begin = sequence_.load(std::memory_order_acquire);
+		if (begin & 1) continue;
+		files.prefix.Before(second, sums);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence_.load(std::memory_order_relaxed) == begin) return;
+	}
+}
+
+
+void ScalerStorage::ReadRowLocked(
+	const ScalerFile &data,
+	size_t second,
+	uint32_t *values
+) const noexcept {
+	while (true) {
+		uint32_t begin = sequence_.load(std::memory_order_acquire);
+		if (begin & 1) continue;
+		data.ReadRow(second, values);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence_.load(std::memory_order_relaxed) == begin) return;
+	}
+}
+
+
+void ScalerStorage::CopyLocked(
+	void *destination,
+	const void *source,
+	size_t size
+) const noexcept {
+	while (true) {
+		uint32_t begin = sequence_.load(std::memory_order_acquire);
+		if (begin & 1) continue;
+		memcpy(destination, source, size);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence_.load(std::memory_order_relaxed) == begin) return;
+	}
+}
+
+}	// namespace ecl
@@ -1,24 +1,21 @@
 #include "service.h"
 
-#include <cerrno>
+#include <cmath>
 #include <cstring>
 #include <cstdlib>
 #include <csignal>
 #include <ctime>
 
-#include <sys/file.h>
-#include <sys/mman.h>
-
+#include <algorithm>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
-#include <random>
 
 #include <grpcpp/grpcpp.h>
 
 #include "config/config_parser.h"
 #include "config/memory_config.h"
-#include "i2c.h"
+#include "scaler/scaler_query.h"
 
 namespace ecl {
 
@@ -30,8 +27,12 @@ Service::Service(const ServiceOption &option) noexcept
 , test_(option.test)
 , data_path_(option.data_path)
 , device_name_(option.device_name)
-, xillybus_lite_fd_(-1)
-, memory_(nullptr) {
+, memory_(nullptr)
+, snapshot_bursts_(0)
+, torn_snapshots_(0)
+, pushed_seconds_(0)
+, reported_rollovers_(0)
+, publisher_(option.subscription_queue) {
 
 	keep_running = true;
 
@@ -40,100 +41,159 @@ Service::Service(const ServiceOption &option) noexcept
 			<< "  port: " << port_ << "\n"
 			<< "  data path: " << data_path_ << "\n"
 			<< "  device name: " << device_name_ << "\n"
+			<< "  device: " << kDeviceKindName[option.device]
+			<< " " << option.device_path << "\n"
 			<< "  log level: " << kLogLevelName[log_level_] << "\n"
 			<< "  test: " << test_ << "\n";
 	}
 
+	DeviceOption device_option;
+	device_option.kind = option.device;
+	device_option.path = option.device_path;
+	device_option.rates = option.simulated_rates;
+	device_option.width_ns = option.simulated_width;
 	if (test_) {
-		memory_ = new Memory;
-		for (size_t i = 0; i < kMaxScalers; ++i) {
-			memory_->scaler[i].value = i*100*test_;
+		// scaler i counts front input i at i*100*test per second
+		device_option.kind = kSimulatedDevice;
+		device_option.rates.clear();
+		for (size_t i = 0; i < kFrontIoNum; ++i) {
+			device_option.rates.push_back(double(i * 100 * test_));
 		}
-	} else {
-		xillybus_lite_fd_ = open("/dev/uio0", O_RDWR);
-		if (xillybus_lite_fd_ < 0) {
-			if (log_level_ >= kError) {
-				std::cout << "[Error] Failed to open /dev/uio0: "
-					<< strerror(errno) << "\n";
-			}
-			exit(-1);
-		}
-		// lock the address space
-		if (flock(xillybus_lite_fd_, LOCK_EX | LOCK_NB)) {
-			if (log_level_ >= kError) {
-				std::cout << "[Error] Failed to get file lock on /dev/ui0: "
-					<< strerror(errno) << "\n";
-			}
-			exit(-1);
-		}
-		// get mapped adderess
-		void *map_addr = mmap(
-			NULL, sizeof(Memory),
-			PROT_READ | PROT_WRITE, MAP_SHARED,
-			xillybus_lite_fd_, 0
-		);
-		if (map_addr == MAP_FAILED) {
-			if (log_level_ >= kError) {
-				std::cout << "[Error] Failed to mmap: "
-					<< strerror(errno) << "\n";
-			}
-			exit(-1);
+	}
+	if (option.load_rate > 0.0) {
+		// scaler registers are written by the load generator
+		device_option.kind = kSimulatedDevice;
+		device_option.update = false;
+	}
+	device_ = OpenDevice(device_option);
+	if (!device_) {
+		if (log_level_ >= kError) {
+			std::cout << "[Error] Failed to open "
+				<< kDeviceKindName[device_option.kind] << " device "
+				<< device_option.path << "\n";
 		}
-		// convert pointer
-		memory_ = (Memory*)map_addr;
+		exit(-1);
+	}
+	memory_ = device_->Registers();
+	if (log_level_ >= kInfo) {
+		std::cout << "[Info] Open device " << device_->Name() << ".\n";
 	}
+	// values before the first second
+	uint32_t initial[kMaxScalers];
+	TakeSnapshot(initial);
 	// check data path
 	if (data_path_[data_path_.length()-1] != '/') {
 		data_path_ += "/";
 	}
+	// scaler storage
+	ScalerStorageOption storage_option;
+	storage_option.data_path = data_path_;
+	storage_option.device_name = device_name_;
+	storage_option.sync_interval = option.sync_interval;
+	storage_option.prepare_ahead = option.prepare_ahead;
+	storage_option.file_version = uint8_t(option.file_version);
+	storage_option.prefix_index = option.prefix_index;
+	storage_ = std::make_unique<ScalerStorage>(storage_option);
+	// fill recent scalers from files
+	size_t loaded = ring_.Load(*storage_, time(NULL));
+	if (log_level_ >= kInfo) {
+		std::cout << "[Info] Load " << loaded
+			<< " seconds of recent scalers from files.\n";
+	}
 
-	if (test_) {
-		test_thread_ = std::make_unique<std::thread>(
-			[&]() {
-				auto next = std::chrono::steady_clock::now();
-				while (keep_running) {
-					std::random_device r;
-					std::mt19937 engine(r());
-					for (size_t i = 0; i < kMaxScalers; ++i) {
-						std::normal_distribution<double> distribution(
-							0.0, i*10*test_
-						);
-						memory_->scaler[i].value =
-							i*100*test_ + std::round(distribution(engine));
-					}
-					next += std::chrono::seconds(1);
-					std::this_thread::sleep_until(next);
+	// maintain old scaler files in background
+	if (
+		option.archive_days > 0
+		|| option.retention_days > 0
+		|| option.disk_budget_mb > 0
+	) {
+		ScalerMaintainerOption maintainer_option;
+		maintainer_option.data_path = data_path_;
+		maintainer_option.device_name = device_name_;
+		maintainer_option.archive_days = option.archive_days;
+		maintainer_option.retention_days = option.retention_days;
+		maintainer_option.disk_budget =
+			uint64_t(option.disk_budget_mb) * 1024 * 1024;
+		maintainer_option.interval = option.maintenance_interval;
+		maintainer_option.io_rate = uint64_t(option.maintenance_io_rate) * 1024;
+		maintainer_option.verbose = log_level_ >= kInfo;
+		maintainer_ = std::make_unique<ScalerMaintainer>(maintainer_option);
+	}
+
+	// queries reading files run out of the threads of gRPC
+	ScalerExecutorOption executor_option;
+	executor_option.threads = size_t(std::max(option.query_threads, 1));
+	executor_option.queue = size_t(std::max(option.query_queue, 0));
+	executor_ = std::make_unique<ScalerExecutor>(executor_option);
+	recent_cache_ = std::make_unique<ScalerCache>(
+		size_t(std::max(option.query_cache_kb, 0)) * 1024
+	);
+
+	// sample at second boundaries, the second decides the slot in file
+	ScalerSamplerOption sampler_option;
+	sampler_option.priority = option.sampler_priority;
+	sampler_option.cpu = option.sampler_cpu;
+	// the scalers are latched with interrupt of the mapped device
+	if (option.sampler_irq && device_->IrqFd() >= 0) {
+		sampler_option.irq_fd = device_->IrqFd();
+		sampler_option.irq_timeout = option.sampler_irq_timeout;
+	}
+	sampler_ = std::make_unique<ScalerSampler>(
+		sampler_option,
+		[this](time_t second) {
+			if (keep_running) WriteScaler(second);
+		}
+	);
+	if (option.load_rate > 0.0) {
+		// virtual seconds through the same path as samples of device
+		ScalerLoadOption load_option;
+		load_option.rate = option.load_rate;
+		load_option.models = option.load_models;
+		load_option.seed = option.load_seed;
+		load_ = std::make_unique<ScalerLoad>(
+			load_option,
+			[this](time_t second, const uint32_t *values) {
+				for (size_t i = 0; i < kMaxScalers; ++i) {
+					memory_->scaler[i].value = values[i];
 				}
+				if (keep_running) WriteScaler(second);
 			}
 		);
-	}
-
-	write_thread_ = std::make_unique<std::thread>(
-		[&]() {
-			auto next = std::chrono::steady_clock::now();
-			while (keep_running) {
-				WriteScaler();
-				next += std::chrono::seconds(1);
-				std::this_thread::sleep_until(next);
+		if (load_->Start()) {
+			if (log_level_ >= kError) {
+				std::cout << "[Error] Failed to start load generator.\n";
 			}
+			exit(-1);
 		}
-	);
+		if (log_level_ >= kInfo) {
+			std::cout << "[Info] Generate " << option.load_rate
+				<< " seconds of scalers per second.\n";
+		}
+	} else if (sampler_->Start()) {
+		if (log_level_ >= kError) {
+			std::cout << "[Error] Failed to start scaler sampler.\n";
+		}
+		exit(-1);
+	}
+
+	// the capture thread runs only while someone reads
+	if (option.capture_rate > 0) {
+		FrontCaptureOption capture_option;
+		capture_option.rate = option.capture_rate;
+		capture_option.cpu = option.capture_cpu;
+		capture_ = std::make_unique<FrontCapture>(memory_, capture_option);
+	}
 }
 
 
 Service::~Service() {
-	if (test_) {
-		if (memory_) delete memory_;
-	} else {
-		if (xillybus_lite_fd_ >= 0) {
-			// clean up
-			flock(xillybus_lite_fd_, LOCK_UN);
-			munmap((void*)memory_, sizeof(Memory));
-			close(xillybus_lite_fd_);
-		}
-	}
-	if (test_) test_thread_->join();
-	write_thread_->join();
+	// finish waiting queries before releasing storage
+	executor_->Stop();
+	// stop sampling before unmapping the memory
+	if (load_) load_->Stop();
+	sampler_->Stop();
+	if (capture_) capture_->Stop();
+	device_.reset();
 	if (log_level_ >= kDebug) {
 		std::cout << "[Debug] Clear scaler service successfully.\n";
 	}
@@ -157,8 +217,10 @@ void Service::PrintScaler() const noexcept {
 			exit(-1);
 		}
 		std::cout << "scaler      counts\n";
+		uint32_t scalers[kMaxScalers];
+		CurrentScalers(scalers);
 		for (uint32_t i = 0; i < kMaxScalers; ++i) {
-			printf("%2d%15d\n", i, memory_->scaler[i].value);
+			printf("%2d%15u\n", i, scalers[i]);
 		}
 		usleep(1000000);
 	}
@@ -171,23 +233,68 @@ void Service::PrintScaler() const noexcept {
 }
 
 
-/// @brief construct file name
-/// @param[in] data_path data stored path
-/// @param[in] device_name device name
-/// @param[in] t c style time
-/// @returns file name
-std::string GetFileName(
-	std::string data_path,
-	std::string device_name,
-	tm *t
-) {
-	std::stringstream file_name("");
-	file_name << data_path << t->tm_year+1900
-		<< std::setw(2) << std::setfill('0') << t->tm_mon+1
-		<< std::setw(2) << std::setfill('0') << t->tm_mday
-		<< (device_name.empty() ? "" : "-"+device_name)
-		<< ".bin";
-	return file_name.str();
+void Service::PrintCapture() const noexcept {
+	if (!capture_) {
+		std::cout << "[Error] Front capture is disabled.\n";
+		return;
+	}
+	signal(SIGINT, SigIntHandler);
+	if (system("tput smcup")) {
+		std::cout << "[Error] Use bash command tput smcup failed.\n";
+		exit(-1);
+	}
+	auto reader = capture_->Subscribe(FrontTrigger());
+	FrontStatistics statistics;
+	bool continued = false;
+	std::vector<FrontSample> samples;
+	int trigger;
+	while (keep_running) {
+		usleep(1000000);
+		// statistics of the last second
+		statistics.Clear();
+		while (reader->Next(samples, trigger)) {
+			AccumulateFront(samples.data(), samples.size(), statistics, continued);
+			continued = true;
+		}
+		if (system("clear")) {
+			std::cout << "[Error] Use bash command clear failed.\n";
+			exit(-1);
+		}
+		printf(
+			"samples %llu, dropped %llu, duty cycle(%%) and transitions\n",
+			(unsigned long long)statistics.samples,
+			(unsigned long long)reader->Dropped()
+		);
+		printf(
+			"  %-16s%-16s%-16s%-16s%-16s%-16s\n",
+			"input 0-15", "input 16-31", "input 32-47", "multi", "or", "and"
+		);
+		const size_t groups[6] = {
+			kFrontInputChannel, kFrontInputChannel + 16, kFrontInputChannel + 32,
+			kMultiGateChannel, kOrGateChannel, kAndGateChannel
+		};
+		for (size_t i = 0; i < 16; ++i) {
+			printf("%2d", int(i));
+			for (size_t group : groups) {
+				size_t channel = group + i;
+				double duty = statistics.samples
+					? 100.0 * statistics.high[channel] / statistics.samples
+					: 0.0;
+				printf(
+					"%6.1f %8llu ",
+					duty, (unsigned long long)statistics.transitions[channel]
+				);
+			}
+			printf("\n");
+		}
+	}
+	capture_->Unsubscribe(reader);
+	if (system("tput rmcup")) {
+		std::cout << "[Error] tput rmcup failed.\n";
+		std::cout << "[Info] Please type `tput rmcup` or printf '\e[2J\e[?47l\e8'`"
+			<< " by yourself to switch back to the primary screen if you are in"
+			<< " the secondary screen.\n";
+	}
 }
 
 
@@ -211,41 +318,20 @@ int Service::ReadDateScaler(
 			indexes.push_back(i);
 		}
 	}
-	double sum[32];
-	for (size_t i = 0; i < 32; ++i) sum[i] = 0.0;
-	int sum_number = 0;
-
-	// get file name
-	std::string file_name = GetFileName(data_path_, device_name_, date);
-	// open file
-	std::ifstream fin(file_name, std::ios::binary);
-	if (!fin.good()) {
-		std::cout << "[Error] Could not open file " << file_name << "\n";
-		return -2;
-	}
-	// get offset
-	size_t offset = sizeof(ScalerFileHeader)
-		+ seconds * kMaxScalers * sizeof(uint32_t);
-	// set start position for reading
-	fin.seekg(offset);
-	// read
-	uint32_t read_value[kMaxScalers];
-	for (size_t i = 0; i < size*average; ++i) {
-		fin.read((char*)read_value, sizeof(uint32_t)*kMaxScalers);
-		++sum_number;
-		for (size_t j = 0; j < indexes.size(); ++j) {
-			sum[j] += read_value[indexes[j]];
-			if (sum_number == average) {
-				scalers[j].push_back(std::round(sum[j] / average));
-				sum[j] = 0.0;
-			}
+
+	// read sums of each average range, from rollup if possible
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t sums[kMaxScalers] = {};
+		int result = storage_->Sum(date, seconds + i*average, average, sums);
+		if (result) {
+			std::cout << "[Error] Could not read scaler file of "
+				<< DateKey(date) << "\n";
+			return result;
 		}
-		if (sum_number == average) {
-			sum_number = 0;
+		for (size_t j = 0; j < indexes.size(); ++j) {
+			scalers[j].push_back(std::round(double(sums[indexes[j]]) / average));
 		}
 	}
-	// close file
-	fin.close();
 
 	return 0;
 }
@@ -255,15 +341,13 @@ int Service::ReadRecentScaler(
 	int32_t flag,
 	int seconds,
 	int average,
-	std::vector<std::vector<uint32_t>> &scalers
+	std::vector<std::vector<uint32_t>> &scalers,
+	time_t *start_time
 ) const noexcept {
 	// initialize
 	scalers.clear();
 	if (seconds <= 0) return 0;
 	if (seconds % average) return -1;
-	double sum[32];
-	for (size_t i = 0; i < 32; ++i) sum[i] = 0.0;
-	int sum_number = 0;
 	std::vector<int> indexes;
 	for (int32_t i = 0; i < 32; ++i) {
 		if (flag & (1 << i)) {
@@ -272,168 +356,122 @@ int Service::ReadRecentScaler(
 		}
 	}
 
-	// get current time
-	time_t now = time(NULL);
-	tm *now_tm = localtime(&now);
-	int now_second = (now_tm->tm_hour*60 + now_tm->tm_min)*60 + now_tm->tm_sec;
-
-	if (now_second+1 < seconds) {
-		// read yesterday's file data
-		// construct file name
-		time_t yesterday = time(NULL);
-		tm *yesterday_tm = localtime(&yesterday);
-		yesterday_tm->tm_mday--;
-		mktime(yesterday_tm);
-		std::string file_name = GetFileName(data_path_, device_name_, yesterday_tm);
-		// open file
-		std::ifstream fin(file_name, std::ios::binary);
-		if (!fin.good()) {
-			std::cout << "[Error] Could not open file " << file_name << "\n";
-			return -2;
-		}
-		// read data
-		int start = 86400 - seconds + now_second + 1;
-		// get offset
-		size_t offset = sizeof(ScalerFileHeader)
-			+ start * kMaxScalers * sizeof(uint32_t);
-		// goto start position
-		fin.seekg(offset);
-		// read
-		uint32_t read_value[kMaxScalers];
-		for (int i = 0; i < seconds-now_second-1; ++i) {
-			fin.read((char*)read_value, sizeof(uint32_t)*kMaxScalers);
-			++sum_number;
-			for (size_t j = 0; j < indexes.size(); ++j) {
-				sum[j] += read_value[indexes[j]];
-				if (sum_number == average) {
-					scalers[j].push_back(std::round(sum[j] / average));
-					sum[j] = 0.0;
-				}
-			}
-			if (sum_number == average) {
-				sum_number = 0;
-			}
-		}
-		// change seconds
-		seconds = now_second+1;
-		// close file
-		fin.close();
-	}
-
-	// read today's data
-	// get file name
-	std::string file_name = GetFileName(data_path_, device_name_, now_tm);
-	// open file
-	std::ifstream fin(file_name, std::ios::binary);
-	if (!fin.good()) {
-		std::cout << "[Error] Could not open file " << file_name << "\n";
-		return -2;
-	}
-	// start position to read, the exact poisiton to avoid less than 0
-	int start = now_second + 1 - seconds;
-	// get offset
-	size_t offset = sizeof(ScalerFileHeader)
-	 	+ start * kMaxScalers * sizeof(uint32_t);
-	fin.seekg(offset);
-	// read value
-	uint32_t read_value[kMaxScalers];
-	// read loop
-	for (int i = 0; i < seconds-1; ++i) {
-		fin.read((char*)read_value, sizeof(uint32_t)*kMaxScalers);
-		++sum_number;
-		for (size_t j = 0; j < indexes.size(); ++j) {
-			sum[j] += read_value[indexes[j]];
-			if (sum_number == average) {
-				scalers[j].push_back(std::round(sum[j] / average));
-				sum[j] = 0.0;
+	// All clients asking for the same range before the next sample share
+	// the averages, which are kept for all scalers and selected by flag here.
+	ScalerCacheKey key;
+	key.seconds = seconds;
+	key.average = average;
+	key.time = time(NULL);
+	key.version = pushed_seconds_.load(std::memory_order_acquire);
+	std::shared_ptr<const ScalerCacheValue> value;
+	int result = recent_cache_->Get(
+		key,
+		[&](ScalerCacheValue &value) {
+			return AverageRecentScalers(key.time, seconds, average, value);
+		},
+		value
+	);
+	if (result) return result;
+	if (start_time) *start_time = value->start_time;
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		auto begin = value->values.begin() + indexes[i] * value->size;
+		scalers[i].assign(begin, begin + value->size);
+	}
+
+	return 0;
+}
+
+
+int Service::AverageRecentScalers(
+	time_t now,
+	int seconds,
+	int average,
+	ScalerCacheValue &value
+) const noexcept {
+	// Read seconds in (now-seconds, now) from ring, and the current value
+	// from memory.
+	time_t start = now + 1 - seconds;
+	value.start_time = start;
+	value.size = size_t(seconds / average);
+	value.values.assign(kMaxScalers * value.size, 0);
+	size_t index = 0;
+	for (time_t begin = start; begin <= now; begin += average, ++index) {
+		time_t end = std::min(begin + average, now);
+		uint64_t sums[kMaxScalers] = {};
+		ring_.Sum(begin, size_t(end - begin), sums);
+		// add the current scaler value
+		if (begin + average > now) {
+			uint32_t current[kMaxScalers];
+			CurrentScalers(current);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				sums[i] += current[i];
 			}
 		}
-		if (sum_number == average) {
-			sum_number = 0;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			value.values[i * value.size + index] =
+				std::round(double(sums[i]) / average);
 		}
 	}
-	// close file
-	fin.close();
 
-	// add the current scaler value
-	for (size_t i = 0; i < indexes.size(); ++i) {
-		sum[i] += memory_->scaler[indexes[i]].value;
-		scalers[i].push_back(std::round(sum[i] / average));
+	return 0;
+}
+
+
+void Service::TakeSnapshot(uint32_t *values) noexcept {
+	ScalerSnapshot snapshot;
+	if (device_->ReadSnapshot(snapshot)) {
+		torn_snapshots_.fetch_add(1, std::memory_order_relaxed);
+		if (log_level_ >= kWarn) {
+			std::cout << "[Warn] Scaler registers changed in all "
+				<< snapshot.bursts << " bursts, keep the last one.\n";
+		}
 	}
+	snapshot_bursts_.fetch_add(snapshot.bursts, std::memory_order_relaxed);
+	memcpy(values, snapshot.values, sizeof(snapshot.values));
+	std::lock_guard<std::mutex> lock(snapshot_mutex_);
+	memcpy(snapshot_, snapshot.values, sizeof(snapshot_));
+}
 
-	// std::cout << "\nRead recent scaler index " << index
-	// 	<< ", range " << seconds << ", average " << average << "\n";
-	// for (size_t i = 0; i < 6; ++i) {
-	// 	for (size_t j = 0; j < 20; ++j) {
-	// 		std::cout << value[i*20+j] << ", ";
-	// 	}
-	// 	std::cout << "\n";
-	// }
 
-	return 0;
+void Service::CurrentScalers(uint32_t *values) const noexcept {
+	std::lock_guard<std::mutex> lock(snapshot_mutex_);
+	memcpy(values, snapshot_, sizeof(snapshot_));
 }
 
 
-/// @brief get file stream, create a new file if not exist
-/// @param[in] file_name file name
-/// @param[out] fout output file stream
-/// @returns 0 if successful, -1 otherwise
-///
-int GetFileStream(const char *file_name, std::fstream &fout) {
-	// check file existence
-	if (access(file_name, F_OK)) {
-		// open file
-		fout.open(file_name, std::ios::binary | std::ios::out);
-		if (!fout.good()) return -1;
-		// write header
-		ScalerFileHeader header;
-		header.version = 1;
-		header.number = kMaxScalers;
-		header.reserve1 = header.reserve2 = 0;
-		fout.write((char*)&header, sizeof(ScalerFileHeader));
-		uint32_t scalers[kMaxScalers];
-		memset(scalers, 0, sizeof(uint32_t)*kMaxScalers);
-		for (size_t i = 0; i < 86400; ++i) {
-			fout.write((char*)scalers, sizeof(uint32_t)*kMaxScalers);
+int Service::Execute(
+	std::function<void(bool)> task,
+	std::function<bool()> cancelled
+) noexcept {
+	if (executor_->Submit(task, cancelled)) {
+		if (log_level_ >= kWarn) {
+			std::cout << "[Warn] Reject query, too many queries are waiting.\n";
 		}
-	} else {
-		fout.open(file_name, std::ios::binary | std::ios::in | std::ios::out);
-		if (!fout.good()) return -1;
+		return -1;
 	}
 	return 0;
 }
 
 
-int Service::WriteScaler() const noexcept {
-	// generate file name according to the date
-	time_t current_time = time(NULL);
-	tm *current_tm = localtime(&current_time);
-	int current_hour = current_tm->tm_hour;
-	int current_min = current_tm->tm_min;
-	int current_sec = current_tm->tm_sec;
-	size_t seconds = ((current_hour * 60 + current_min) * 60) + current_sec;
-
-	// file name
-	std::string file_name = GetFileName(data_path_, device_name_, current_tm);
-	// open file
-	std::fstream fout;
-	if (GetFileStream(file_name.c_str(), fout)) {
-		std::cout << "[Error] Open file " << file_name << " failed.\n";
+int Service::WriteScaler(time_t now) noexcept {
+	// all consumers use the same snapshot of this second
+	uint32_t scalers[kMaxScalers];
+	TakeSnapshot(scalers);
+	ring_.Push(now, scalers);
+	pushed_seconds_.fetch_add(1, std::memory_order_release);
+	publisher_.Publish(now, scalers);
+	if (storage_->Write(now, scalers)) {
+		std::cout << "[Error] Write scaler to file failed.\n";
 		return -1;
 	}
-
-	// write data
-	size_t offset = sizeof(ScalerFileHeader)
-		+ seconds*kMaxScalers*sizeof(uint32_t);
-	fout.seekp(offset);
-	uint32_t scalers[kMaxScalers];
-	for (size_t i = 0; i < kMaxScalers; ++i) {
-		scalers[i] = memory_->scaler[i].value;
+	if (log_level_ >= kInfo) {
+		ScalerStorageMetrics metrics = storage_->Metrics();
+		if (metrics.rollovers != reported_rollovers_) {
+			reported_rollovers_ = metrics.rollovers;
+			std::cout << "[Info] Switch to new scaler file in "
+				<< metrics.last_rollover_us << " us.\n";
+		}
 	}
-	fout.write((char*)scalers, sizeof(uint32_t)*kMaxScalers);
-	// clos file
-	fout.close();
-
 	return 0;
 }
 
@@ -514,9 +552,11 @@ grpc::ServerWriteReactor<Response>* Service::GetScaler(
 	};
 
 	std::vector<Response> responses;
+	uint32_t scalers[kMaxScalers];
+	CurrentScalers(scalers);
 	for (size_t i = 0; i < kMaxScalers; ++i) {
 		Response response;
-		response.set_value(memory_->scaler[i].value);
+		response.set_value(scalers[i]);
 		responses.push_back(response);
 	}
 
@@ -524,12 +564,29 @@ grpc::ServerWriteReactor<Response>* Service::GetScaler(
 }
 
 
-class ScalerWriter : public grpc::ServerWriteReactor<Response> {
+// status of queries rejected by the full queue
+const grpc::Status kQueueFullStatus(
+	grpc::StatusCode::RESOURCE_EXHAUSTED, "Too many queries"
+);
+
+
+/**
+ * StreamWriter writes messages prepared later in the query executor. A
+ * cancel before the messages are ready only marks the writer, since the
+ * task still holds it, and the task finishes it.
+ *
+ */
+template<typename Message>
+class StreamWriter : public grpc::ServerWriteReactor<Message> {
 public:
-	ScalerWriter(const std::vector<Response> &responses)
-	: index_(0), responses_(responses) {
-		if (responses.empty()) {
-			Finish(grpc::Status(
+	StreamWriter(): index_(0), cancelled_(false) {
+	}
+
+	/// @brief start writing messages, finish with DATA_LOSS if empty
+	void Write(std::vector<Message> &&messages) {
+		messages_ = std::move(messages);
+		if (messages_.empty()) {
+			this->Finish(grpc::Status(
 				grpc::StatusCode::DATA_LOSS, "Read data failure"
 			));
 		} else {
@@ -537,9 +594,18 @@ public:
 		}
 	}
 
-	virtual void OnWriteDone(bool ok) override {
+	/// @brief finish without any message
+	void Fail(const grpc::Status &status) {
+		this->Finish(status);
+	}
+
+	bool Cancelled() const {
+		return cancelled_.load();
+	}
+
+	void OnWriteDone(bool ok) override {
 		if (!ok) {
-			Finish(grpc::Status(
+			this->Finish(grpc::Status(
 				grpc::StatusCode::UNKNOWN, "Unexpected failure"
 			));
 		} else {
@@ -547,147 +613,180 @@ public:
 		}
 	}
 
+	void OnCancel() override {
+		cancelled_.store(true);
+	}
+
 	void OnDone() override {
 		delete this;
 	}
 
 private:
 	void NextWrite() {
-		if (index_ < responses_.size()) {
+		if (index_ < messages_.size()) {
 			const size_t index = index_;
 			index_++;
-			StartWrite(responses_.data() + index);
+			this->StartWrite(messages_.data() + index);
 			return;
 		}
-		Finish(grpc::Status::OK);
+		this->Finish(grpc::Status::OK);
 	}
 
 	size_t index_;
-	std::vector<Response> responses_;
+	std::vector<Message> messages_;
+	std::atomic<bool> cancelled_;
 };
 
 
-grpc::ServerWriteReactor<Response>* Service::GetScalerRecent(
-	grpc::CallbackServerContext*,
-	const RecentRequest* request
-) {
-	int range = 120;
-	int average = 1;
-	if (request->type() == 0) {
+/// @brief get range and average seconds of recent scaler request
+/// @param[in] type request type
+/// @param[out] range seconds to read before now
+/// @param[out] average seconds to average
+///
+void RecentScalerRange(int type, int &range, int &average) {
+	range = 120;
+	average = 1;
+	if (type == 0) {
 		range = 120;
 		average = 1;
-	} else if (request->type() == 1) {
+	} else if (type == 1) {
 		range = 1200;
 		average = 10;
-	} else if (request->type() == 2) {
+	} else if (type == 2) {
 		range = 7200;
 		average = 60;
-	} else if (request->type() == 3) {
+	} else if (type == 3) {
 		range = 86400;
 		average = 720;
 	}
-	std::vector<std::vector<uint32_t>> scalers;
-	std::vector<Response> responses;
-	// get recent scalers from file
-	int result = ReadRecentScaler(request->flag(), range, average, scalers);
-	if (result) {
-		if (log_level_ >= kWarn) {
-			std::cout << "[Warn] Read recent scalers from file faied, "
-				<< "code: " << result << ".\n";
-		}
-		return new ScalerWriter(responses);
-	}
-
-	for (const auto &scaler : scalers) {
-		for (const auto &value : scaler) {
-			Response response;
-			response.set_value(value);
-			responses.push_back(response);
-		}
-	}
-
-	return new ScalerWriter(responses);
 }
 
 
-grpc::ServerWriteReactor<Response>* Service::GetScalerDate(
-	grpc::CallbackServerContext*,
-	const DateRequest *request
+/// @brief fill scaler values to packed block
+/// @param[in] flag flag of scalers
+/// @param[in] scalers values of each scaler in flag
+/// @param[in] start_time unix time of the first value
+/// @param[in] step seconds between values
+/// @param[out] block block to fill
+///
+void FillScalerBlock(
+	int32_t flag,
+	const std::vector<std::vector<uint32_t>> &scalers,
+	time_t start_time,
+	int step,
+	ScalerBlock *block
 ) {
-	time_t t = time(NULL);
-	tm *date = localtime(&t);
-	date->tm_year = request->year() - 1900;
-	date->tm_mon = request->month() - 1;
-	date->tm_mday = request->day();
-	mktime(date);
-
-	std::vector<Response> responses;
-	std::vector<std::vector<uint32_t>> scalers;
-	int result = ReadDateScaler(date, request->flag(), 0, 120, 720, scalers);
-	if (result) {
-		if (log_level_ >= kWarn) {
-			std::cout << "[Warn] Read date scaler from file failed, "
-				<< "code: " << result << "\n";
-		}
-		return new ScalerWriter(responses);
-	}
-
-	for (const auto &scaler : scalers) {
-		for (const auto &value : scaler) {
-			Response response;
-			response.set_value(value);
-			responses.push_back(response);
-		}
+	block->set_start_time(start_time);
+	block->set_step(step);
+	block->set_size(scalers.empty() ? 0 : scalers[0].size());
+	size_t index = 0;
+	for (int32_t i = 0; i < 32; ++i) {
+		if (!(flag & (1 << i))) continue;
+		ScalerSeries *series = block->add_series();
+		series->set_index(i);
+		series->mutable_values()->Add(
+			scalers[index].begin(), scalers[index].end()
+		);
+		++index;
 	}
-
-	return new ScalerWriter(responses);
 }
 
 
-grpc::ServerWriteReactor<Expression>* Service::GetConfig(
+grpc::ServerWriteReactor<Response>* Service::GetScalerRecent(
 	grpc::CallbackServerContext*,
-	const Request*
+	const RecentRequest* request
 ) {
-	class ExpressionWriter : public grpc::ServerWriteReactor<Expression> {
-	public:
-		ExpressionWriter(const std::vector<Expression> &expressions)
-		: expressions_(expressions), index_(0) {
-			NextWrite();
-		}
-
-		void OnWriteDone(bool ok) override {
-			if (!ok) Finish(
-				grpc::Status(grpc::StatusCode::UNKNOWN, "Unexpected Failure")
-			);
-			NextWrite();
-		}
-
-		void OnDone() override {
-			delete this;
-		}
-
-	private:
-		void NextWrite() {
-			if (index_ < expressions_.size()) {
-				const size_t index = index_;
-				index_++;
-				StartWrite(expressions_.data()+index);
+	auto *writer = new StreamWriter<Response>();
+	const int32_t flag = request->flag();
+	const int type = request->type();
+	int result = Execute(
+		[this, writer, flag, type](bool cancelled) {
+			if (cancelled) {
+				writer->Fail(grpc::Status::CANCELLED);
 				return;
 			}
-			Finish(grpc::Status::OK);
-		}
+			int range, average;
+			RecentScalerRange(type, range, average);
+			std::vector<std::vector<uint32_t>> scalers;
+			std::vector<Response> responses;
+			// get recent scalers from file
+			int result = ReadRecentScaler(flag, range, average, scalers);
+			if (result) {
+				if (log_level_ >= kWarn) {
+					std::cout << "[Warn] Read recent scalers from file faied, "
+						<< "code: " << result << ".\n";
+				}
+				writer->Write(std::move(responses));
+				return;
+			}
+			for (const auto &scaler : scalers) {
+				for (const auto &value : scaler) {
+					Response response;
+					response.set_value(value);
+					responses.push_back(response);
+				}
+			}
+			writer->Write(std::move(responses));
+		},
+		[writer]() { return writer->Cancelled(); }
+	);
+	if (result) writer->Fail(kQueueFullStatus);
+	return writer;
+}
 
-		std::vector<Expression> expressions_;
-		size_t index_;
-	};
 
-	if (log_level_ >= kDebug) {
-		std::cout << "[Debug] GetConfig().\n";
-	}
+grpc::ServerWriteReactor<Response>* Service::GetScalerDate(
+	grpc::CallbackServerContext*,
+	const DateRequest *request
+) {
+	time_t t = time(NULL);
+	tm date;
+	localtime_r(&t, &date);
+	date.tm_year = request->year() - 1900;
+	date.tm_mon = request->month() - 1;
+	date.tm_mday = request->day();
+	mktime(&date);
+	const int32_t flag = request->flag();
+
+	auto *writer = new StreamWriter<Response>();
+	int result = Execute(
+		[this, writer, date, flag](bool cancelled) mutable {
+			if (cancelled) {
+				writer->Fail(grpc::Status::CANCELLED);
+				return;
+			}
+			std::vector<Response> responses;
+			std::vector<std::vector<uint32_t>> scalers;
+			int result = ReadDateScaler(&date, flag, 0, 120, 720, scalers);
+			if (result) {
+				if (log_level_ >= kWarn) {
+					std::cout << "[Warn] Read date scaler from file failed, "
+						<< "code: " << result << "\n";
+				}
+				writer->Write(std::move(responses));
+				return;
+			}
+			for (const auto &scaler : scalers) {
+				for (const auto &value : scaler) {
+					Response response;
+					response.set_value(value);
+					responses.push_back(response);
+				}
+			}
+			writer->Write(std::move(responses));
+		},
+		[writer]() { return writer->Cancelled(); }
+	);
+	if (result) writer->Fail(kQueueFullStatus);
+	return writer;
+}
 
-	// expressions
-	std::vector<Expression> expressions;
 
+/// @brief read expressions of the last config
+/// @param[in] log_level log level
+/// @param[out] expressions time of config and the expressions
+///
+void ReadLastConfig(LogLevel log_level, std::vector<Expression> &expressions) {
 	// config or log path
 	std::string path = std::string(getenv("HOME")) + "/.easy-config-logic";
 
@@ -702,7 +801,7 @@ grpc::ServerWriteReactor<Expression>* Service::GetConfig(
 	// last config file name
 	std::string file_name = line + ".txt";
 	std::ifstream fin(file_name);
-	if (log_level_ >= kDebug) {
+	if (log_level >= kDebug) {
 		std::cout << "[Debug] Try to read " << file_name << "\n";
 	}
 
@@ -714,7 +813,7 @@ grpc::ServerWriteReactor<Expression>* Service::GetConfig(
 	Expression config_time;
 	config_time.set_value(line);
 	expressions.push_back(config_time);
-	if (log_level_ >= kDebug) {
+	if (log_level >= kDebug) {
 		std::cout << "[Debug] Read config time "
 			<< line << "\n";
 	}
@@ -725,14 +824,38 @@ grpc::ServerWriteReactor<Expression>* Service::GetConfig(
 		Expression expr;
 		expr.set_value(line);
 		expressions.push_back(expr);
-		if (log_level_ >= kInfo) {
+		if (log_level >= kInfo) {
 			std::cout << "[Info] Read expression from file "
 				<< expr.value() << "\n";
 		}
 	}
 	fin.close();
+}
+
 
-	return new ExpressionWriter(expressions);
+grpc::ServerWriteReactor<Expression>* Service::GetConfig(
+	grpc::CallbackServerContext*,
+	const Request*
+) {
+	if (log_level_ >= kDebug) {
+		std::cout << "[Debug] GetConfig().\n";
+	}
+
+	auto *writer = new StreamWriter<Expression>();
+	int result = Execute(
+		[this, writer](bool cancelled) {
+			if (cancelled) {
+				writer->Fail(grpc::Status::CANCELLED);
+				return;
+			}
+			std::vector<Expression> expressions;
+			ReadLastConfig(log_level_, expressions);
+			writer->Write(std::move(expressions));
+		},
+		[writer]() { return writer->Cancelled(); }
+	);
+	if (result) writer->Fail(kQueueFullStatus);
+	return writer;
 }
 
 
@@ -744,10 +867,9 @@ grpc::ServerReadReactor<Expression>* Service::SetConfig(
 	public:
 		Recorder(
 			ParseResponse *response,
-			volatile Memory* memory,
-			bool test,
+			Device *device,
 			LogLevel log_level
-		): response_(response), memory_(memory), test_(test), log_level_(log_level) {
+		): response_(response), device_(device), log_level_(log_level) {
 			// initialize
 			response_->set_value(0);
 			if (log_level_ >= kDebug) {
@@ -784,9 +906,21 @@ grpc::ServerReadReactor<Expression>* Service::SetConfig(
 				}
 				// read config from parser
 				memory_config_.Read(&config_parser_);
-				if (!test_) {
-					// write config to memory
-					memory_config_.MapMemory((uint32_t*)memory_);
+				// write changed registers to device
+				MapResult result;
+				int write_result =
+					device_->WriteConfig(memory_config_, false, &result);
+				if (write_result && log_level_ >= kError) {
+					std::cout << "[Error] Failed to enable "
+						<< result.rj45_failures << " RJ45 port groups.\n";
+				}
+				if (log_level_ >= kInfo) {
+					std::cout << "[Info] Write " << result.words
+						<< " register words, enable " << result.rj45_groups
+						<< " RJ45 port groups in "
+						<< result.i2c_ns / 1000 << " us"
+						<< (result.reset ? ", reset" : "")
+						<< (result.full ? ", all registers" : "") << ".\n";
 				}
 
 				// save backup
@@ -797,6 +931,12 @@ grpc::ServerReadReactor<Expression>* Service::SetConfig(
 				memory_config_.Print(backup_file);
 				backup_file.close();
 
+				if (write_result) {
+					Finish(grpc::Status(
+						grpc::StatusCode::INTERNAL, "Enable RJ45 ports failed"
+					));
+					return;
+				}
 				Finish(grpc::Status::OK);
 			}
 		}
@@ -807,8 +947,7 @@ grpc::ServerReadReactor<Expression>* Service::SetConfig(
 
 	private:
 		ParseResponse *response_;
-		volatile Memory *memory_;
-		bool test_;
+		Device *device_;
 		LogLevel log_level_;
 		Expression expression_;
 		MemoryConfig memory_config_;
@@ -821,7 +960,526 @@ grpc::ServerReadReactor<Expression>* Service::SetConfig(
 		std::cout << "[Debug] SetConfig().\n";
 	}
 
-	return new Recorder(response, memory_, test_, log_level_);
+	return new Recorder(response, device_.get(), log_level_);
+}
+
+
+grpc::ServerWriteReactor<Metric>* Service::GetMetrics(
+	grpc::CallbackServerContext*,
+	const Request*
+) {
+	class MetricWriter : public grpc::ServerWriteReactor<Metric> {
+	public:
+		MetricWriter(const std::vector<Metric> &metrics)
+		: metrics_(metrics), index_(0) {
+			NextWrite();
+		}
+
+		void OnWriteDone(bool ok) override {
+			if (!ok) {
+				Finish(grpc::Status(
+					grpc::StatusCode::UNKNOWN, "Unexpected failure"
+				));
+			} else {
+				NextWrite();
+			}
+		}
+
+		void OnDone() override {
+			delete this;
+		}
+
+	private:
+		void NextWrite() {
+			if (index_ < metrics_.size()) {
+				const size_t index = index_;
+				index_++;
+				StartWrite(metrics_.data()+index);
+				return;
+			}
+			Finish(grpc::Status::OK);
+		}
+
+		std::vector<Metric> metrics_;
+		size_t index_;
+	};
+
+	if (log_level_ >= kDebug) {
+		std::cout << "[Debug] GetMetrics().\n";
+	}
+
+	std::vector<Metric> metrics;
+	auto add_metric = [&](const char *name, int64_t value) {
+		Metric metric;
+		metric.set_name(name);
+		metric.set_value(value);
+		metrics.push_back(metric);
+	};
+	ScalerStorageMetrics storage_metrics = storage_->Metrics();
+	add_metric("scaler_rollovers", storage_metrics.rollovers);
+	add_metric("scaler_rollover_last_us", storage_metrics.last_rollover_us);
+	add_metric("scaler_rollover_max_us", storage_metrics.max_rollover_us);
+	add_metric("scaler_rollover_total_us", storage_metrics.total_rollover_us);
+	add_metric("scaler_prepared_files", storage_metrics.prepared_files);
+	add_metric("scaler_prepare_failures", storage_metrics.prepare_failures);
+	ScalerMaintainerMetrics maintainer_metrics =
+		maintainer_ ? maintainer_->Metrics() : ScalerMaintainerMetrics();
+	add_metric("maintenance_passes", maintainer_metrics.passes);
+	add_metric("maintenance_archived_files", maintainer_metrics.archived_files);
+	add_metric("maintenance_dropped_days", maintainer_metrics.dropped_days);
+	add_metric(
+		"maintenance_budget_removed_files",
+		maintainer_metrics.budget_removed_files
+	);
+	add_metric("maintenance_freed_bytes", maintainer_metrics.freed_bytes);
+	add_metric("maintenance_used_bytes", maintainer_metrics.used_bytes);
+	add_metric("maintenance_last_pass_us", maintainer_metrics.last_pass_us);
+	add_metric("maintenance_throttled_us", maintainer_metrics.throttled_us);
+	add_metric("maintenance_failures", maintainer_metrics.failures);
+	add_metric("scaler_snapshot_bursts", snapshot_bursts_.load());
+	add_metric("scaler_snapshot_torn", torn_snapshots_.load());
+	ScalerSamplerMetrics sampler_metrics = sampler_->Metrics();
+	add_metric("sampler_samples", sampler_metrics.samples);
+	add_metric("sampler_missed", sampler_metrics.missed);
+	add_metric("sampler_clock_changes", sampler_metrics.clock_changes);
+	add_metric("sampler_irq_samples", sampler_metrics.irq_samples);
+	add_metric("sampler_irq_fallbacks", sampler_metrics.irq_fallbacks);
+	add_metric("sampler_lateness_max_us", sampler_metrics.max_lateness_us);
+	add_metric("sampler_lateness_total_us", sampler_metrics.total_lateness_us);
+	for (size_t i = 0; i < kLatenessBounds; ++i) {
+		std::string name = "sampler_lateness_le_"
+			+ std::to_string(kLatenessBoundUs[i]) + "us";
+		add_metric(name.c_str(), sampler_metrics.lateness[i]);
+	}
+	add_metric(
+		("sampler_lateness_gt_"
+			+ std::to_string(kLatenessBoundUs[kLatenessBounds-1]) + "us").c_str(),
+		sampler_metrics.lateness[kLatenessBounds]
+	);
+	if (load_) {
+		ScalerLoadMetrics load_metrics = load_->Metrics();
+		add_metric("load_samples", load_metrics.samples);
+		add_metric("load_late", load_metrics.late);
+		add_metric("load_skipped", load_metrics.skipped);
+		add_metric("load_lateness_max_us", load_metrics.max_lateness_us);
+	}
+	add_metric("scaler_subscribers", publisher_.Subscribers());
+	add_metric("scaler_subscription_dropped", publisher_.Dropped());
+	FrontCaptureMetrics capture_metrics =
+		capture_ ? capture_->Metrics() : FrontCaptureMetrics();
+	add_metric("capture_samples", capture_metrics.samples);
+	add_metric("capture_missed", capture_metrics.missed);
+	add_metric("capture_dropped", capture_metrics.dropped);
+	add_metric("capture_readers", capture_metrics.readers);
+	ScalerExecutorMetrics query_metrics = executor_->Metrics();
+	add_metric("query_submitted", query_metrics.submitted);
+	add_metric("query_rejected", query_metrics.rejected);
+	add_metric("query_cancelled", query_metrics.cancelled);
+	add_metric("query_completed", query_metrics.completed);
+	add_metric("query_queued", query_metrics.queued);
+	add_metric("query_running", query_metrics.running);
+	add_metric("query_wait_max_us", query_metrics.max_wait_us);
+	add_metric("query_wait_total_us", query_metrics.total_wait_us);
+	ScalerCacheMetrics cache_metrics = recent_cache_->Metrics();
+	add_metric("query_cache_hits", cache_metrics.hits);
+	add_metric("query_cache_misses", cache_metrics.misses);
+	add_metric("query_cache_coalesced", cache_metrics.coalesced);
+	add_metric("query_cache_evicted", cache_metrics.evicted);
+	add_metric("query_cache_expired", cache_metrics.expired);
+	add_metric("query_cache_entries", cache_metrics.entries);
+	add_metric("query_cache_bytes", cache_metrics.bytes);
+
+	return new MetricWriter(metrics);
+}
+
+grpc::ServerUnaryReactor* Service::GetScalerRecentPacked(
+	grpc::CallbackServerContext *context,
+	const RecentRequest *request,
+	ScalerBlock *response
+) {
+	auto *reactor = context->DefaultReactor();
+	const int32_t flag = request->flag();
+	const int type = request->type();
+	int result = Execute(
+		[this, reactor, response, flag, type](bool cancelled) {
+			if (cancelled) {
+				reactor->Finish(grpc::Status::CANCELLED);
+				return;
+			}
+			int range, average;
+			RecentScalerRange(type, range, average);
+			std::vector<std::vector<uint32_t>> scalers;
+			time_t start_time;
+			int result = ReadRecentScaler(
+				flag, range, average, scalers, &start_time
+			);
+			if (result) {
+				if (log_level_ >= kWarn) {
+					std::cout << "[Warn] Read recent scalers from file faied, "
+						<< "code: " << result << ".\n";
+				}
+				reactor->Finish(grpc::Status(
+					grpc::StatusCode::DATA_LOSS, "Read data failure"
+				));
+				return;
+			}
+			FillScalerBlock(flag, scalers, start_time, average, response);
+			reactor->Finish(grpc::Status::OK);
+		},
+		[context]() { return context->IsCancelled(); }
+	);
+	if (result) reactor->Finish(kQueueFullStatus);
+	return reactor;
+}
+
+
+grpc::ServerUnaryReactor* Service::GetScalerDatePacked(
+	grpc::CallbackServerContext *context,
+	const DateRequest *request,
+	ScalerBlock *response
+) {
+	auto *reactor = context->DefaultReactor();
+	time_t t = time(NULL);
+	tm date;
+	localtime_r(&t, &date);
+	date.tm_year = request->year() - 1900;
+	date.tm_mon = request->month() - 1;
+	date.tm_mday = request->day();
+	date.tm_hour = date.tm_min = date.tm_sec = 0;
+	date.tm_isdst = -1;
+	time_t start_time = mktime(&date);
+	const int32_t flag = request->flag();
+
+	int result = Execute(
+		[this, reactor, response, date, start_time, flag](
+			bool cancelled
+		) mutable {
+			if (cancelled) {
+				reactor->Finish(grpc::Status::CANCELLED);
+				return;
+			}
+			std::vector<std::vector<uint32_t>> scalers;
+			int result = ReadDateScaler(&date, flag, 0, 120, 720, scalers);
+			if (result) {
+				if (log_level_ >= kWarn) {
+					std::cout << "[Warn] Read date scaler from file failed, "
+						<< "code: " << result << "\n";
+				}
+				reactor->Finish(grpc::Status(
+					grpc::StatusCode::DATA_LOSS, "Read data failure"
+				));
+				return;
+			}
+			FillScalerBlock(flag, scalers, start_time, 720, response);
+			reactor->Finish(grpc::Status::OK);
+		},
+		[context]() { return context->IsCancelled(); }
+	);
+	if (result) reactor->Finish(kQueueFullStatus);
+	return reactor;
+}
+
+grpc::ServerWriteReactor<ScalerSample>* Service::SubscribeScalers(
+	grpc::CallbackServerContext*,
+	const SubscribeRequest *request
+) {
+	class SampleWriter : public grpc::ServerWriteReactor<ScalerSample> {
+	public:
+		SampleWriter(ScalerPublisher *publisher, const SubscribeRequest *request)
+		: publisher_(publisher), writing_(false), stopping_(false) {
+			// Woken up by the sampling thread, which may publish before
+			// Subscribe returns. The publisher calls notifiers under its lock,
+			// so mutex_ can't be held here, and samples published meanwhile
+			// wait in queue until the subscription is set.
+			std::shared_ptr<ScalerSubscription> subscription =
+				publisher_->Subscribe(
+					request->flag(), request->period(), request->delta(),
+					[this]() { NextWrite(); }
+				);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				subscription_ = subscription;
+			}
+			NextWrite();
+		}
+
+		void OnWriteDone(bool ok) override {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				writing_ = false;
+				if (!ok) stopping_ = true;
+			}
+			NextWrite();
+		}
+
+		void OnCancel() override {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			NextWrite();
+		}
+
+		void OnDone() override {
+			publisher_->Unsubscribe(subscription_);
+			delete this;
+		}
+
+	private:
+		void NextWrite() {
+			ScalerUpdate update;
+			bool finish = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (writing_ || !subscription_) return;
+				if (stopping_) {
+					// finish only once, after the last write is done
+					finish = true;
+				} else if (!subscription_->Pop(update)) {
+					return;
+				}
+				writing_ = true;
+			}
+			if (finish) {
+				Finish(grpc::Status::CANCELLED);
+				return;
+			}
+			sample_.Clear();
+			sample_.set_time(update.time);
+			sample_.set_mask(update.mask);
+			sample_.mutable_values()->Add(
+				update.values, update.values + update.size
+			);
+			sample_.set_dropped(update.dropped);
+			StartWrite(&sample_);
+		}
+
+		ScalerPublisher *publisher_;
+		std::shared_ptr<ScalerSubscription> subscription_;
+		std::mutex mutex_;
+		bool writing_;
+		bool stopping_;
+		ScalerSample sample_;
+	};
+
+	if (log_level_ >= kDebug) {
+		std::cout << "[Debug] SubscribeScalers(" << request->flag()
+			<< ", " << request->period() << ").\n";
+	}
+
+	return new SampleWriter(&publisher_, request);
+}
+
+grpc::ServerUnaryReactor* Service::QueryScalers(
+	grpc::CallbackServerContext *context,
+	const QueryRequest *request,
+	QueryResponse *response
+) {
+	auto *reactor = context->DefaultReactor();
+	if (log_level_ >= kDebug) {
+		std::cout << "[Debug] QueryScalers(" << request->start_time()
+			<< ", " << request->end_time() << ", " << request->step()
+			<< ", " << request->flag() << ").\n";
+	}
+
+	ScalerQueryOption option;
+	option.start_time = request->start_time();
+	option.end_time = request->end_time();
+	option.step = request->step();
+	option.flag = request->flag();
+	// repeated aggregations are queried once
+	for (int aggregation : request->aggregations()) {
+		auto &aggregations = option.aggregations;
+		if (
+			std::find(aggregations.begin(), aggregations.end(), aggregation)
+			== aggregations.end()
+		) {
+			aggregations.push_back(ScalerAggregation(aggregation));
+		}
+	}
+	// mean by default
+	if (option.aggregations.empty()) {
+		option.aggregations.push_back(kAggregateMean);
+	}
+
+	int result = Execute(
+		[this, context, reactor, response, option](bool cancelled) {
+			if (cancelled) {
+				reactor->Finish(grpc::Status::CANCELLED);
+				return;
+			}
+			std::vector<ScalerQuerySeries> series;
+			int result = ecl::QueryScalers(
+				*storage_, option,
+				[context]() { return context->IsCancelled(); },
+				series, executor_.get()
+			);
+			if (result == -1) {
+				reactor->Finish(grpc::Status(
+					grpc::StatusCode::INVALID_ARGUMENT, "Invalid query"
+				));
+				return;
+			} else if (result) {
+				reactor->Finish(grpc::Status::CANCELLED);
+				return;
+			}
+
+			response->set_start_time(option.start_time);
+			response->set_step(option.step);
+			response->set_size(series.empty() ? 0 : series[0].values.size());
+			for (const auto &from : series) {
+				QuerySeries *to = response->add_series();
+				to->set_index(from.index);
+				to->set_aggregation(Aggregation(from.aggregation));
+				to->mutable_values()->Add(from.values.begin(), from.values.end());
+			}
+			reactor->Finish(grpc::Status::OK);
+		},
+		[context]() { return context->IsCancelled(); }
+	);
+	if (result) reactor->Finish(kQueueFullStatus);
+	return reactor;
+}
+
+grpc::ServerWriteReactor<CaptureChunk>* Service::CaptureFront(
+	grpc::CallbackServerContext*,
+	const CaptureRequest *request
+) {
+	class CaptureWriter : public grpc::ServerWriteReactor<CaptureChunk> {
+	public:
+		CaptureWriter(FrontCapture *capture, const CaptureRequest *request)
+		: capture_(capture)
+		, repeat_(!request->triggered() || request->repeat())
+		, writing_(false)
+		, stopping_(false)
+		, done_(false)
+		, continued_(false) {
+
+			if (!capture_) {
+				Finish(grpc::Status(
+					grpc::StatusCode::UNAVAILABLE, "Front capture is disabled"
+				));
+				return;
+			}
+			FrontTrigger trigger;
+			trigger.enable = request->triggered();
+			trigger.channel = request->channel() < 0
+				? kFrontChannels : size_t(request->channel());
+			// values of Edge are the same as FrontEdge
+			int edge = int(request->edge());
+			trigger.edge = FrontEdge(edge);
+			if (edge < int(kFrontRising) || edge > int(kFrontAnyEdge)) {
+				trigger.channel = kFrontChannels;
+			}
+			trigger.pre = size_t(std::max(request->pre(), 0));
+			trigger.post = size_t(std::max(request->post(), 0));
+			// woken up by the capture thread, which waits for the reader
+			std::lock_guard<std::mutex> lock(mutex_);
+			reader_ = capture_->Subscribe(trigger, [this]() { NextWrite(); });
+			if (!reader_) {
+				Finish(grpc::Status(
+					grpc::StatusCode::INVALID_ARGUMENT, "Invalid trigger"
+				));
+			}
+		}
+
+		void OnWriteDone(bool ok) override {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				writing_ = false;
+				if (!ok) stopping_ = true;
+			}
+			NextWrite();
+		}
+
+		void OnCancel() override {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stopping_ = true;
+			}
+			NextWrite();
+		}
+
+		void OnDone() override {
+			if (reader_) capture_->Unsubscribe(reader_);
+			delete this;
+		}
+
+	private:
+		void NextWrite() {
+			grpc::Status status = grpc::Status::OK;
+			bool finish = false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (writing_ || !reader_) return;
+				if (stopping_) {
+					// finish only once, after the last write is done
+					finish = true;
+					status = grpc::Status::CANCELLED;
+				} else if (done_) {
+					finish = true;
+				} else {
+					int trigger;
+					if (!reader_->Next(samples_, trigger)) return;
+					Fill(trigger);
+					if (!repeat_) done_ = true;
+				}
+				writing_ = true;
+			}
+			if (finish) {
+				Finish(status);
+				return;
+			}
+			StartWrite(&chunk_);
+		}
+
+		void Fill(int trigger) {
+			// windows are not continuous, count transitions in each one
+			statistics_.Clear();
+			AccumulateFront(
+				samples_.data(), samples_.size(), statistics_,
+				continued_ && trigger < 0
+			);
+			continued_ = trigger < 0;
+			chunk_.Clear();
+			for (const FrontSample &sample : samples_) {
+				chunk_.add_times(sample.time);
+				chunk_.mutable_words()->Add(
+					sample.words, sample.words + kFrontWords
+				);
+			}
+			chunk_.set_trigger(trigger);
+			chunk_.mutable_high()->Add(
+				statistics_.high, statistics_.high + kFrontChannels
+			);
+			chunk_.mutable_transitions()->Add(
+				statistics_.transitions, statistics_.transitions + kFrontChannels
+			);
+			chunk_.set_dropped(reader_->Dropped());
+		}
+
+		FrontCapture *capture_;
+		std::shared_ptr<FrontReader> reader_;
+		// keep capturing after the first window
+		bool repeat_;
+		std::mutex mutex_;
+		bool writing_;
+		bool stopping_;
+		bool done_;
+		// transitions are counted from the previous chunk
+		bool continued_;
+		std::vector<FrontSample> samples_;
+		FrontStatistics statistics_;
+		CaptureChunk chunk_;
+	};
+
+	if (log_level_ >= kDebug) {
+		std::cout << "[Debug] CaptureFront(" << request->triggered()
+			<< ", " << request->channel() << ", " << request->edge()
+			<< ", " << request->pre() << ", " << request->post() << ").\n";
+	}
+
+	return new CaptureWriter(capture_.get(), request);
 }
 
-}
\ No newline at end of file
+}
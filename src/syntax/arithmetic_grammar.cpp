@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "syntax/generated_action_table.h"
 #include "syntax/parser/grammar.h"
 #include "syntax/parser/production.h"
 #include "syntax/parser/token.h"
@@ -274,4 +275,9 @@ ArithmeticGrammar::ArithmeticGrammar() noexcept
 }
 
 
+const GeneratedActionTable* ArithmeticGrammar::GeneratedTable() const noexcept {
+	return &kArithmeticGrammarTable;
+}
+
+
 }					// namespace ecl
\ No newline at end of file
@@ -6,7 +6,11 @@
 namespace ecl {
 
 LogicComparer::LogicComparer() noexcept
-: parser_{grammar_, grammar_+1}, tree_root_{nullptr, nullptr} {
+: parser_{
+	SharedGrammar<bool, LogicalGrammar>(),
+	SharedGrammar<bool, LogicalGrammar>()
+}
+, tree_root_{nullptr, nullptr} {
 }
 
 
@@ -1,5 +1,7 @@
 #include "syntax/logic_downscale_grammar.h"
 
+#include "syntax/generated_action_table.h"
+
 namespace ecl {
 
 inline int Max(int a, int b) {
@@ -169,4 +171,9 @@ LogicDownscaleGrammar::LogicDownscaleGrammar() noexcept
 	AddProductionSet(production_set_f);
 }
 
+
+const GeneratedActionTable* LogicDownscaleGrammar::GeneratedTable() const noexcept {
+	return &kLogicDownscaleGrammarTable;
+}
+
 };
\ No newline at end of file
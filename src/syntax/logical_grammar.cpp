@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "syntax/generated_action_table.h"
 #include "syntax/parser/production.h"
 #include "syntax/parser/token.h"
 
@@ -113,4 +114,9 @@ LogicalGrammar::LogicalGrammar() noexcept
 	symbols_.push_back(production_set_t);
 }
 
+
+const GeneratedActionTable* LogicalGrammar::GeneratedTable() const noexcept {
+	return &kLogicalGrammarTable;
+}
+
 }					// namespace ecl
\ No newline at end of file
@@ -55,6 +55,13 @@ Action* ActionTable::GetAction(int collection, int symbol) noexcept {
 }
 
 
+const Action* ActionTable::GetAction(int collection, int symbol) const noexcept {
+	int index = collection * symbol_size_ + symbol;
+	if (index >= size_) return nullptr;
+	return table_ + index;
+}
+
+
 
 
 //-----------------------------------------------------------------------------
@@ -188,24 +195,66 @@ int SyntaxParser<VarType>::PrintTree(Symbol *symbol, std::string prefix) const n
 
 
 //-----------------------------------------------------------------------------
-// 								SLRSyntaxParser
+// 								CompiledGrammar
 //-----------------------------------------------------------------------------
 
 template<typename VarType>
-SLRSyntaxParser<VarType>::SLRSyntaxParser(Grammar<VarType> *grammar)
-: SyntaxParser<VarType>(grammar) {
+CompiledGrammar<VarType>::CompiledGrammar(
+	Grammar<VarType> *grammar,
+	bool use_generated
+)
+: grammar_(grammar)
+, action_table_(nullptr)
+, collection_size_(0)
+, cells_(nullptr) {
+	if (!grammar->IsComplete()) {
+		throw std::runtime_error("grammar not complete");
+	}
+	symbol_size_ = int(grammar->SymbolList().size()) + 1;
+
+	// list productions in global index order
+	for (int i = 0; i < grammar->ProductionSetSize(); ++i) {
+		ProductionFactorySet<VarType> *set = grammar->ProductionSet(i);
+		int symbol = grammar->FindSymbol(set);
+		for (auto factory : *set) {
+			productions_.push_back(factory);
+			reduce_symbols_.push_back(symbol);
+		}
+	}
+
+	// use the table generated at build time if it matches this grammar
+	const GeneratedActionTable *table = grammar->GeneratedTable();
+	if (
+		use_generated && table
+		&& table->symbol_size == symbol_size_
+		&& table->production_size == int(productions_.size())
+	) {
+		collection_size_ = table->collection_size;
+		cells_ = table->cells;
+	} else {
+		GenerateTable();
+	}
+}
+
+
+template<typename VarType>
+void CompiledGrammar<VarType>::GenerateTable() {
+	Grammar<VarType> *grammar = grammar_;
+	std::vector<Symbol*> symbol_list = grammar->SymbolList();
+
 
 	// inititalize collection
 	int collection_size = grammar->GenerateCollections(0);
+	collection_size_ = collection_size;
 
 	// initialize action table
-	action_table_ = new ActionTable(collection_size, this->symbol_list_.size()+1);
+	action_table_ = new ActionTable(collection_size, symbol_list.size()+1);
 
 
 // std::cout << "start add goto and shift action" << std::endl;
 	// add goto and shift action
 	for (int c = 0; c < collection_size; ++c) {
-		for (size_t s = 0; s != this->symbol_list_.size(); ++s) {
+		for (size_t s = 0; s != symbol_list.size(); ++s) {
 
 			// get action value
 			int collection = grammar->CollectionGoto(c, s);
@@ -222,7 +271,7 @@ SLRSyntaxParser<VarType>::SLRSyntaxParser(Grammar<VarType> *grammar)
 
 			} else {
 				// check symbol type
-				int stype = this->symbol_list_[s]->Type();
+				int stype = symbol_list[s]->Type();
 				if (
 					stype == kSymbolType_Variable
 					|| stype == kSymbolType_Operator
@@ -267,7 +316,7 @@ SLRSyntaxParser<VarType>::SLRSyntaxParser(Grammar<VarType> *grammar)
 				if (set == 0) {	// start production
 
 					// supossed that the last symbol is terminating symbol '$'
-					action_table_->SetAction(c, this->symbol_list_.size(), Action::kTypeAccept, nullptr);
+					action_table_->SetAction(c, symbol_list.size(), Action::kTypeAccept, nullptr);
 
 				} else {
 
@@ -299,7 +348,93 @@ SLRSyntaxParser<VarType>::SLRSyntaxParser(Grammar<VarType> *grammar)
 		}
 	}
 
-// std::cout << "end of SLRSyntaxParser constructor" << std::endl;
+// std::cout << "end of CompiledGrammar constructor" << std::endl;
+
+	// pack the action table
+	packed_cells_.resize(collection_size_ * symbol_size_);
+	for (int c = 0; c < collection_size_; ++c) {
+		for (int s = 0; s < symbol_size_; ++s) {
+			const Action *action = action_table_->GetAction(c, s);
+			int value = 0;
+			if (
+				action->type == Action::kTypeShift
+				|| action->type == Action::kTypeGoto
+			) {
+				value = action->collection;
+			} else if (action->type == Action::kTypeReduce) {
+				for (size_t i = 0; i < productions_.size(); ++i) {
+					if (productions_[i] == action->production) {
+						value = int(i);
+						break;
+					}
+				}
+			}
+			packed_cells_[c * symbol_size_ + s] =
+				PackedAction::Pack(action->type, value);
+		}
+	}
+	cells_ = packed_cells_.data();
+}
+
+
+
+template<typename VarType>
+ActionTable* CompiledGrammar<VarType>::GetActionTable() const noexcept {
+	if (IsGenerated()) {
+		std::call_once(unpack_flag_, [this]() { UnpackTable(); });
+	}
+	return action_table_;
+}
+
+
+template<typename VarType>
+void CompiledGrammar<VarType>::UnpackTable() const noexcept {
+	action_table_ = new ActionTable(collection_size_, symbol_size_);
+	for (int c = 0; c < collection_size_; ++c) {
+		for (int s = 0; s < symbol_size_; ++s) {
+			uint16_t cell = Cell(c, s);
+			int type = PackedAction::Type(cell);
+			if (type == Action::kTypeReduce) {
+				action_table_->SetAction(
+					c, s, type, productions_[PackedAction::Value(cell)]
+				);
+			} else if (type == Action::kTypeAccept) {
+				action_table_->SetAction(c, s, type, nullptr);
+			} else {
+				action_table_->SetAction(c, s, type, PackedAction::Value(cell));
+			}
+		}
+	}
+}
+
+
+template<typename VarType>
+CompiledGrammar<VarType>::~CompiledGrammar() noexcept {
+	delete action_table_;
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+// 								SLRSyntaxParser
+//-----------------------------------------------------------------------------
+
+template<typename VarType>
+SLRSyntaxParser<VarType>::SLRSyntaxParser(Grammar<VarType> *grammar)
+: SyntaxParser<VarType>(grammar) {
+	own_compiled_ = new CompiledGrammar<VarType>(grammar);
+	compiled_ = own_compiled_;
+}
+
+
+template<typename VarType>
+SLRSyntaxParser<VarType>::SLRSyntaxParser(
+	const CompiledGrammar<VarType> *compiled
+)
+: SyntaxParser<VarType>(compiled->GetGrammar())
+, compiled_(compiled)
+, own_compiled_(nullptr) {
 }
 
 
@@ -307,6 +442,7 @@ template<typename VarType>
 SLRSyntaxParser<VarType>::~SLRSyntaxParser() noexcept {
 	for (auto &var : this->variable_list_) delete var;
 	for (auto &literal : this->literal_list_) delete literal;
+	if (own_compiled_) delete own_compiled_;
 }
 
 
@@ -347,12 +483,13 @@ ParseResult SLRSyntaxParser<VarType>::Parse(
 // 	<< ", looking symbol is " << look_symbol << std::endl;
 
 		int top = collection_stack.top();
-		Action *action = action_table_->GetAction(top, look_symbol);
+		uint16_t cell = compiled_->Cell(top, look_symbol);
+		int action_type = PackedAction::Type(cell);
 
 
 		if (
-			action->type == Action::kTypeShift
-			|| action->type == Action::kTypeGoto
+			action_type == Action::kTypeShift
+			|| action_type == Action::kTypeGoto
 		) {
 
 
@@ -360,11 +497,11 @@ ParseResult SLRSyntaxParser<VarType>::Parse(
 // 	<< action->collection << " symbol " << look_symbol << std::endl;
 
 
-			collection_stack.push(action->collection);
+			collection_stack.push(PackedAction::Value(cell));
 
 
 			// shift
-			if (action->type == Action::kTypeShift) {
+			if (action_type == Action::kTypeShift) {
 				// shift the looking symbol into the processing stack
 				if (tokens[itoken]->Type() == kSymbolType_Variable) {
 					// shift an identifier, find it in the identifier list
@@ -466,16 +603,17 @@ ParseResult SLRSyntaxParser<VarType>::Parse(
 			}
 
 
-		} else if (action->type == Action::kTypeReduce) {
+		} else if (action_type == Action::kTypeReduce) {
 
+			int production_index = PackedAction::Value(cell);
 			ProductionFactory<VarType> *factory =
-				(ProductionFactory<VarType>*)(action->production);
+				compiled_->Production(production_index);
 
 			// pop several collections
 			for (size_t i = 0; i < factory->size(); ++i) {
 				collection_stack.pop();
 			}
-			look_symbol = this->grammar_->FindSymbol(factory->Parent());
+			look_symbol = compiled_->ReduceSymbol(production_index);
 
 
 
@@ -504,7 +642,7 @@ ParseResult SLRSyntaxParser<VarType>::Parse(
 			}
 			processing_symbols.push(production);
 
-		} else if (action->type == Action::kTypeAccept) {
+		} else if (action_type == Action::kTypeAccept) {
 
 // std::cout << "  Action ACCETP! Break the loop." << std::endl;
 
@@ -516,7 +654,7 @@ ParseResult SLRSyntaxParser<VarType>::Parse(
 		} else {
 			std::string name =
 				itoken == tokens.size() ? "&" : tokens[itoken]->Name();
-			std::cerr << "Error: Invalid action type: " << action->type
+			std::cerr << "Error: Invalid action type: " << action_type
 				<< ", stack top symbol is " << top << ", next symbol is "
 				<< name << "\n";
 			if (itoken == tokens.size()) {
@@ -544,6 +682,10 @@ template class SyntaxParser<bool>;
 template class SyntaxParser<int>;
 template class SyntaxParser<double>;
 
+template class CompiledGrammar<bool>;
+template class CompiledGrammar<int>;
+template class CompiledGrammar<double>;
+
 template class SLRSyntaxParser<bool>;
 template class SLRSyntaxParser<int>;
 template class SLRSyntaxParser<double>;
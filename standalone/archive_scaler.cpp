@@ -0,0 +1,78 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+
+#include "scaler/scaler_archive.h"
+#include "scaler/scaler_file.h"
+
+int main(int argc, char **argv) {
+	bool extract = argc > 1 && std::string(argv[1]) == "-x";
+	bool keep = argc > 1 && std::string(argv[1]) == "-k";
+	int first = (extract || keep) ? 2 : 1;
+	if (argc <= first) {
+		std::cerr << "Error: " << argv[0] << " needs at least 1 file." << std::endl;
+		std::cout << "Usage: " << argv[0] << " [-k | -x] [file] ..." << std::endl;
+		std::cout << "  -k                -- keep the day file after archiving" << std::endl;
+		std::cout << "  -x                -- extract archive files to day files" << std::endl;
+		std::cout << "  file              -- scaler day file, e.g. 20230307-dev.bin," << std::endl;
+		std::cout << "                       or archive file, e.g. 20230307-dev.sca" << std::endl;
+		std::cout << "Only archive day files no longer written." << std::endl;
+		return -1;
+	}
+
+	const std::string input_extension = extract ? ".sca" : ".bin";
+	const std::string output_extension = extract ? ".bin" : ".sca";
+	int failed = 0;
+	for (int i = first; i < argc; ++i) {
+		std::string name = argv[i];
+		if (
+			name.length() < 4
+			|| name.substr(name.length()-4) != input_extension
+		) {
+			std::cerr << "Error: " << name << " is not a "
+				<< (extract ? "scaler archive" : "scaler day") << " file." << std::endl;
+			++failed;
+			continue;
+		}
+		std::string output = name.substr(0, name.length()-4) + output_extension;
+
+		if (extract) {
+			if (ecl::ScalerArchive::Extract(name, output) != 0) {
+				std::cerr << "Error: Extract archive file " << name << " failed." << std::endl;
+				++failed;
+				continue;
+			}
+			// the server reads the day file first
+			unlink(name.c_str());
+			std::cout << "Extracted " << output << std::endl;
+			continue;
+		}
+
+		ecl::ScalerFile day;
+		if (day.Open(name, false, false) != 0) {
+			std::cerr << "Error: Open scaler file " << name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		if (ecl::ScalerArchive::Create(day, output) != 0) {
+			std::cerr << "Error: Archive scaler file " << name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		day.Close();
+		// the archive is read only if the day file is missing
+		if (!keep) {
+			unlink(name.c_str());
+			// the prefix file is larger than the day file
+			std::string prefix_name = name.substr(0, name.length()-4) + ".prefix";
+			unlink(prefix_name.c_str());
+		}
+		ecl::ScalerArchive archive;
+		archive.Open(output);
+		std::cout << "Archived " << output << ", " << archive.Size()
+			<< " bytes (" << archive.Size() * 100 / ecl::kScalerFileSize << "%)" << std::endl;
+	}
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,285 @@
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config/device.h"
+#include "config/memory.h"
+#include "external/cxxopts.hpp"
+
+using namespace ecl;
+
+// maximum reads of add_sum waiting for the new sum
+const int kMaxPolls = 1000000;
+
+
+inline int64_t Now() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+
+struct Result {
+	std::string name;
+	// bytes accessed in one operation
+	size_t bytes;
+	// nanoseconds of each operation
+	std::vector<int64_t> durations;
+	// stopped since the sum never appeared, e.g. nothing plays the adder
+	bool timeout;
+};
+
+
+/// @brief measure the operation many times
+/// @param[in] name name of operation
+/// @param[in] bytes bytes accessed in one operation
+/// @param[in] rounds times to measure
+/// @param[in] overhead nanoseconds of reading the clock, subtracted
+/// @param[in] operation function to measure, returns false on timeout
+/// @returns durations of operation, stopped at the first timeout
+///
+template<typename Operation>
+Result Measure(
+	const std::string &name,
+	size_t bytes,
+	int rounds,
+	int64_t overhead,
+	Operation &&operation
+) {
+	Result result;
+	result.name = name;
+	result.bytes = bytes;
+	result.durations.reserve(rounds);
+	result.timeout = false;
+	for (int i = 0; i < rounds; ++i) {
+		int64_t start = Now();
+		bool ok = operation(i);
+		int64_t duration = Now() - start - overhead;
+		// one timeout takes kMaxPolls reads, don't repeat it every round
+		if (!ok) {
+			result.timeout = true;
+			break;
+		}
+		result.durations.push_back(std::max(duration, int64_t(0)));
+	}
+	return result;
+}
+
+
+/// @brief get percentile of sorted durations
+int64_t Percentile(const std::vector<int64_t> &sorted, double percent) {
+	if (sorted.empty()) return 0;
+	size_t index = size_t(percent / 100.0 * double(sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+void Print(Result &result) {
+	std::sort(result.durations.begin(), result.durations.end());
+	int64_t total = 0;
+	for (int64_t duration : result.durations) total += duration;
+	double mean = result.durations.empty()
+		? 0.0 : double(total) / double(result.durations.size());
+	printf(
+		"%-20s%9lld%9lld%9lld%9lld%9lld%10.1f",
+		result.name.c_str(),
+		(long long)Percentile(result.durations, 50.0),
+		(long long)Percentile(result.durations, 90.0),
+		(long long)Percentile(result.durations, 99.0),
+		(long long)Percentile(result.durations, 99.9),
+		(long long)(result.durations.empty() ? 0 : result.durations.back()),
+		mean > 0.0 ? double(result.bytes) * 1e3 / mean : 0.0
+	);
+	if (result.timeout) {
+		printf("  no answer, stopped after %zu rounds", result.durations.size());
+	}
+	printf("\n");
+}
+
+
+int main(int argc, char **argv) {
+	int rounds = 100000;
+	int burst = 32;
+	int cpu = -1;
+	bool test = false;
+	DeviceOption device_option;
+
+	cxxopts::Options args(
+		"bus_benchmark", "measure register access of FPGA through /dev/uio0"
+	);
+	args.add_options()
+		("h,help", "Print usage")
+		("t,test", "Simulate the device in ordinary memory")
+		(
+			"d,device", "Device to measure, uio, file or simulated",
+			cxxopts::value<std::string>()->default_value("uio"), "device"
+		)
+		(
+			"p,path", "Path of UIO device or register file",
+			cxxopts::value<std::string>()->default_value("/dev/uio0"), "path"
+		)
+		(
+			"r,rounds", "Times to measure each operation",
+			cxxopts::value<int>()->default_value("100000"), "rounds"
+		)
+		(
+			"b,burst", "Words written in one write burst",
+			cxxopts::value<int>()->default_value("32"), "words"
+		)
+		(
+			"c,cpu", "Pin to CPU, -1 runs on any CPU",
+			cxxopts::value<int>()->default_value("-1"), "cpu"
+		);
+
+	try {
+		auto result = args.parse(argc, argv);
+		if (result.count("help")) {
+			std::cout << args.help() << std::endl;
+			return 0;
+		}
+		test = result["test"].as<bool>();
+		rounds = result["rounds"].as<int>();
+		burst = result["burst"].as<int>();
+		cpu = result["cpu"].as<int>();
+		std::string device = result["device"].as<std::string>();
+		if (ParseDeviceKind(device, device_option.kind)) {
+			std::cerr << "Error: Invalid device " << device << "\n";
+			return -1;
+		}
+		device_option.path = result["path"].as<std::string>();
+		if (test) device_option.kind = kSimulatedDevice;
+	} catch (const cxxopts::exceptions::exception &e) {
+		std::cerr << "Error: Parse failed: " << e.what() << "\n";
+		return -1;
+	}
+	if (rounds <= 0 || burst <= 0) {
+		std::cerr << "Error: Invalid rounds " << rounds
+			<< " or burst " << burst << "\n";
+		return -1;
+	}
+
+	if (cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+			std::cerr << "Error: Failed to pin to CPU " << cpu << "\n";
+			return -1;
+		}
+	}
+
+	// The adder registers are shared, stop the server first. The simulated
+	// device only plays the adder, without a thread updating scalers.
+	device_option.update = false;
+	std::unique_ptr<Device> device = OpenDevice(device_option);
+	if (!device) {
+		std::cerr << "Error: Failed to open device "
+			<< device_option.path << ".\n";
+		return -1;
+	}
+	volatile Memory *memory = device->Registers();
+	test = device_option.kind == kSimulatedDevice;
+
+	// the adder of FPGA is simulated by a thread in test mode
+	std::atomic<bool> stop(false);
+	std::thread adder;
+	if (test) {
+		adder = std::thread([&]() {
+			while (!stop.load(std::memory_order_relaxed)) {
+				memory->add_sum = memory->addends[0] + memory->addends[1];
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	// cost of reading the clock twice, taken off every duration
+	std::vector<int64_t> empty;
+	for (int i = 0; i < 10000; ++i) {
+		int64_t start = Now();
+		empty.push_back(Now() - start);
+	}
+	std::sort(empty.begin(), empty.end());
+	const int64_t overhead = Percentile(empty, 50.0);
+
+	const volatile uint32_t *scalers =
+		(const volatile uint32_t*)(memory->scaler);
+	// keep the values read alive
+	uint32_t check = 0;
+	std::vector<Result> results;
+
+	results.push_back(Measure(
+		"read", sizeof(uint32_t), rounds, overhead,
+		[&](int) {
+			check += memory->add_sum;
+			return true;
+		}
+	));
+	// the same burst as scaler snapshots
+	results.push_back(Measure(
+		"read burst " + std::to_string(kMaxScalers),
+		sizeof(uint32_t) * kMaxScalers, rounds, overhead,
+		[&](int) {
+			for (size_t i = 0; i < kMaxScalers; ++i) check += scalers[i];
+			return true;
+		}
+	));
+	results.push_back(Measure(
+		"write", sizeof(uint32_t), rounds, overhead,
+		[&](int round) {
+			memory->addends[0] = uint32_t(round);
+			return true;
+		}
+	));
+	// the adder has only two addends, so the burst alternates them
+	results.push_back(Measure(
+		"write burst " + std::to_string(burst),
+		sizeof(uint32_t) * burst, rounds, overhead,
+		[&](int round) {
+			for (int i = 0; i < burst; ++i) {
+				memory->addends[i % 2] = uint32_t(round + i);
+			}
+			return true;
+		}
+	));
+	// write both addends and poll the sum until FPGA updates it
+	results.push_back(Measure(
+		"read after write", sizeof(uint32_t) * 3, rounds, overhead,
+		[&](int round) {
+			uint32_t a = uint32_t(round) * 2654435761u;
+			uint32_t b = ~uint32_t(round);
+			memory->addends[0] = a;
+			memory->addends[1] = b;
+			for (int i = 0; i < kMaxPolls; ++i) {
+				if (memory->add_sum == a + b) return true;
+				// let the simulated adder run on a single CPU, the adder of
+				// FPGA never needs this many reads
+				if (i % 64 == 63) sched_yield();
+			}
+			return false;
+		}
+	));
+
+	stop.store(true);
+	if (adder.joinable()) adder.join();
+
+	std::cout << "device: " << device->Name()
+		<< ", rounds: " << rounds
+		<< ", clock overhead: " << overhead << " ns\n";
+	printf(
+		"%-20s%9s%9s%9s%9s%9s%10s\n",
+		"operation(ns)", "p50", "p90", "p99", "p99.9", "max", "MB/s"
+	);
+	for (Result &result : results) Print(result);
+	std::cout << "check: " << check << std::endl;
+	return 0;
+}
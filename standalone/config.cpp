@@ -1,22 +1,18 @@
-#include <fcntl.h>
-#include <sys/file.h>
-#include <sys/mman.h>
-
 #include <fstream>
 #include <iostream>
 
 #include "config/config_parser.h"
+#include "config/device.h"
 #include "config/memory_config.h"
-#include "i2c.h"
 #include "external/cxxopts.hpp"
 
-const size_t kMemorySize = 4096;
-
 
 int main(int argc, char **argv) {
 	bool register_flag = false;
 	bool no_map = false;
+	bool full = false;
 	std::string file_name;
+	ecl::DeviceOption device_option;
 
 	cxxopts::Options args("config", "config FPGA");
 	args.add_options()
@@ -26,7 +22,19 @@ int main(int argc, char **argv) {
 			cxxopts::value<bool>()
 		)
 		(
-			"n,nomap", "Do not mmap to /dev/uio0, for test",
+			"n,nomap", "Do not write to device, for test",
+			cxxopts::value<bool>()
+		)
+		(
+			"d,device", "Device to write, uio, file or simulated",
+			cxxopts::value<std::string>()->default_value("uio"), "device"
+		)
+		(
+			"p,path", "Path of UIO device or register file",
+			cxxopts::value<std::string>()->default_value("/dev/uio0"), "path"
+		)
+		(
+			"f,full", "Write all registers, enable all RJ45 ports and reset",
 			cxxopts::value<bool>()
 		)
 		(
@@ -44,6 +52,13 @@ int main(int argc, char **argv) {
 		}
 		register_flag = result["register"].as<bool>();
 		no_map = result["nomap"].as<bool>();
+		full = result["full"].as<bool>();
+		std::string device = result["device"].as<std::string>();
+		if (ecl::ParseDeviceKind(device, device_option.kind)) {
+			std::cerr << "[Error] Invalid device " << device << "\n";
+			return -1;
+		}
+		device_option.path = result["path"].as<std::string>();
 		if (!result.count("file")) {
 			std::cerr << "[Error] Require [file] parameter.\n";
 			return -1;
@@ -91,40 +106,27 @@ int main(int argc, char **argv) {
 	// show configuration
 	config.Print(std::cout, true);
 
+	int write_result = 0;
 	if (!no_map) {
-		// open memory file
-		int fd = open("/dev/uio0", O_RDWR);
-		if (fd < 0) {
-			std::cerr << "Error: Failed to open dev file /dev/uio0.\n";
+		auto device = ecl::OpenDevice(device_option);
+		if (!device) {
+			std::cerr << "Error: Failed to open device "
+				<< device_option.path << ".\n";
 			return -1;
 		}
-		// lock the address space
-		if (flock(fd, LOCK_EX | LOCK_NB)) {
-			std::cerr << "Error: Failed to get the file lock on /dev/uio0.\n";
-			return -1;
-		}
-		// map memory
-		void *map_addr = mmap(
-			NULL,
-			kMemorySize,
-			PROT_READ | PROT_WRITE,
-			MAP_SHARED,
-			fd,
-			0
-		);
-		if (map_addr == MAP_FAILED) {
-			std::cerr << "Error: Failed to mmap.\n";
-			return -1;
-		}
-		volatile uint32_t *map = (uint32_t*)map_addr;
 
-		// write config to memory
-		config.MapMemory(map);
-
-		// clean up
-		flock(fd, LOCK_UN);
-		munmap(map_addr, kMemorySize);
-		close(fd);
+		// write config to memory, only the changed registers unless full
+		ecl::MapResult result;
+		write_result = device->WriteConfig(config, full, &result);
+		std::cout << "Write " << result.words << " register words, enable "
+			<< result.rj45_groups << " RJ45 port groups in "
+			<< result.i2c_ns / 1000 << " us"
+			<< (result.reset ? ", reset" : "")
+			<< (result.full ? ", all registers" : "") << ".\n";
+		if (write_result) {
+			std::cerr << "Error: Failed to enable " << result.rj45_failures
+				<< " RJ45 port groups.\n";
+		}
 	}
 
 	// save backup
@@ -134,5 +136,5 @@ int main(int argc, char **argv) {
 	config.Print(backup_file);
 	backup_file.close();
 
-	return 0;
+	return write_result;
 }
@@ -0,0 +1,41 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "scaler/scaler_file.h"
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		std::cerr << "Error: " << argv[0] << " needs at least 2 parameters." << std::endl;
+		std::cout << "Usage: " << argv[0] << " [version] [file] ..." << std::endl;
+		std::cout << "  version           -- 1 for row major, 2 for column major" << std::endl;
+		std::cout << "  file              -- scaler day file, e.g. 20230307-dev.bin" << std::endl;
+		std::cout << "Do not convert the file of today while the server is running." << std::endl;
+		return -1;
+	}
+
+	int version = atoi(argv[1]);
+	if (version != ecl::kScalerFileRowMajor && version != ecl::kScalerFileColumnMajor) {
+		std::cerr << "Error: Invalid version " << argv[1] << std::endl;
+		return -1;
+	}
+
+	int failed = 0;
+	for (int i = 2; i < argc; ++i) {
+		std::string name = argv[i];
+		if (name.length() < 4 || name.substr(name.length()-4) != ".bin") {
+			std::cerr << "Error: " << name << " is not a scaler day file." << std::endl;
+			++failed;
+			continue;
+		}
+		// the rollup keeps the same sums, no need to rebuild
+		if (ecl::ScalerFile::Convert(name, uint8_t(version)) != 0) {
+			std::cerr << "Error: Convert scaler file " << name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		std::cout << "Converted " << name << std::endl;
+	}
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * This tool generates the SLR action tables of the grammars used in this
+ * project, so that the parsers don't need to generate them at runtime.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "syntax/parser/syntax_parser.h"
+#include "syntax/logical_grammar.h"
+#include "syntax/logic_downscale_grammar.h"
+#include "syntax/arithmetic_grammar.h"
+
+
+/// @brief generate action table of a grammar and write it in C++ form
+/// @tparam VarType the return type of the Evaluate function
+/// @param[in] grammar pointer to the grammar
+/// @param[in] name name of the grammar
+/// @param[in] os output stream
+/// @returns 0 on success, -1 on failure
+///
+template<typename VarType>
+int WriteTable(
+	ecl::Grammar<VarType> *grammar,
+	const std::string &name,
+	std::ostream &os
+) {
+	// always generate the table at runtime here
+	ecl::CompiledGrammar<VarType> compiled(grammar, false);
+
+	// check the value range of packed action
+	const int max_value = 0xffff >> ecl::PackedAction::kTypeBits;
+	if (
+		compiled.CollectionSize() > max_value
+		|| compiled.ProductionSize() > max_value
+	) {
+		std::cerr << "Error: Grammar " << name << " is too large to pack.\n";
+		return -1;
+	}
+
+	os << "// " << name << ", " << compiled.CollectionSize() << " collections, "
+		<< compiled.SymbolSize() << " symbols (include terminating symbol), "
+		<< compiled.ProductionSize() << " productions\n"
+		<< "constexpr uint16_t k" << name << "Cells[] = {";
+	for (int c = 0; c < compiled.CollectionSize(); ++c) {
+		os << "\n\t";
+		for (int s = 0; s < compiled.SymbolSize(); ++s) {
+			os << "0x" << std::hex << std::setw(4) << std::setfill('0')
+				<< compiled.Cell(c, s) << std::dec << ",";
+			if (s != compiled.SymbolSize()-1) os << " ";
+		}
+	}
+	os << "\n};\n"
+		<< "constexpr GeneratedActionTable k" << name << "Table = {\n"
+		<< "\t" << compiled.CollectionSize()
+		<< ", " << compiled.SymbolSize()
+		<< ", " << compiled.ProductionSize()
+		<< ", k" << name << "Cells\n"
+		<< "};\n\n";
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+	if (argc > 2 || (argc == 2 && std::string(argv[1]) == "-h")) {
+		std::cout << "Usage: " << argv[0] << " [output_file]\n"
+			<< "  output_file       -- output header, default is stdout\n";
+		return 0;
+	}
+
+	std::ofstream fout;
+	if (argc == 2) {
+		fout.open(argv[1]);
+		if (!fout.good()) {
+			std::cerr << "Error: Open file " << argv[1] << " failed.\n";
+			return -1;
+		}
+	}
+	std::ostream &os = argc == 2 ? fout : std::cout;
+
+	os << "// This file is generated by generate_action_table, "
+		<< "don't edit it manually.\n"
+		<< "// Run `make update_action_table` after changing any grammar.\n\n"
+		<< "#ifndef __GENERATED_ACTION_TABLE_H__\n"
+		<< "#define __GENERATED_ACTION_TABLE_H__\n\n"
+		<< "#include \"syntax/parser/grammar.h\"\n\n"
+		<< "namespace ecl {\n\n";
+
+	ecl::LogicalGrammar logical_grammar;
+	if (WriteTable(&logical_grammar, "LogicalGrammar", os)) return -1;
+	ecl::LogicDownscaleGrammar logic_downscale_grammar;
+	if (WriteTable(&logic_downscale_grammar, "LogicDownscaleGrammar", os)) {
+		return -1;
+	}
+	ecl::ArithmeticGrammar arithmetic_grammar;
+	if (WriteTable(&arithmetic_grammar, "ArithmeticGrammar", os)) return -1;
+
+	os << "}\t\t\t\t// namespace ecl\n\n"
+		<< "#endif\t\t\t// __GENERATED_ACTION_TABLE_H__\n";
+
+	return 0;
+}
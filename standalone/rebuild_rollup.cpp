@@ -0,0 +1,49 @@
+#include <iostream>
+#include <string>
+
+#include "scaler/scaler_file.h"
+#include "scaler/scaler_rollup.h"
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		std::cerr << "Error: " << argv[0] << " needs at least 1 parameter." << std::endl;
+		std::cout << "Usage: " << argv[0] << " [file] ..." << std::endl;
+		std::cout << "  file              -- scaler day file, e.g. 20230307-dev.bin" << std::endl;
+		return -1;
+	}
+
+	int failed = 0;
+	for (int i = 1; i < argc; ++i) {
+		std::string name = argv[i];
+		if (name.length() < 4 || name.substr(name.length()-4) != ".bin") {
+			std::cerr << "Error: " << name << " is not a scaler day file." << std::endl;
+			++failed;
+			continue;
+		}
+		std::string rollup_name = name.substr(0, name.length()-4) + ".rollup";
+
+		ecl::ScalerFile day;
+		if (day.Open(name, false, false) != 0) {
+			std::cerr << "Error: Open scaler file " << name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		ecl::ScalerRollup rollup;
+		// create if not exists, rebuild if dirty
+		if (rollup.Open(rollup_name, &day, true) != 0) {
+			std::cerr << "Error: Open rollup file " << rollup_name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		// always rebuild, in case the day file was changed
+		if (rollup.Build(day) != 0) {
+			std::cerr << "Error: Build rollup file " << rollup_name << " failed." << std::endl;
+			++failed;
+			continue;
+		}
+		rollup.Close();
+		std::cout << "Rebuilt " << rollup_name << std::endl;
+	}
+
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "scaler/scaler_kernel.h"
+
+// rows of one day file
+const size_t kRows = 86400;
+
+template<typename Function>
+double Measure(int rounds, Function &&function) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i) function();
+	auto stop = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(stop - start).count();
+	return double(kRows) * rounds / seconds;
+}
+
+
+int main(int argc, char **argv) {
+	int rounds = 100;
+	if (argc > 2) {
+		std::cout << "Usage: " << argv[0] << " [rounds]" << std::endl;
+		std::cout << "  rounds            -- rounds of reducing one day, default 100" << std::endl;
+		return -1;
+	}
+	if (argc == 2) {
+		rounds = atoi(argv[1]);
+		if (rounds <= 0) {
+			std::cerr << "Error: Invalid rounds " << argv[1] << std::endl;
+			return -1;
+		}
+	}
+
+	std::mt19937 engine(0);
+	std::uniform_int_distribution<uint32_t> distribution;
+	std::vector<uint32_t> rows(kRows * ecl::kMaxScalers);
+	for (uint32_t &value : rows) value = distribution(engine);
+
+	// keep results alive so loops are not optimized out
+	uint64_t check = 0;
+	uint64_t sums[ecl::kMaxScalers];
+	ecl::ScalerReduction reduction;
+
+	double sum_scalar = Measure(rounds, [&]() {
+		for (size_t i = 0; i < ecl::kMaxScalers; ++i) sums[i] = 0;
+		ecl::SumRowsScalar(rows.data(), kRows, sums);
+		check += sums[0];
+	});
+	double sum_kernel = Measure(rounds, [&]() {
+		for (size_t i = 0; i < ecl::kMaxScalers; ++i) sums[i] = 0;
+		ecl::SumRows(rows.data(), kRows, sums);
+		check += sums[0];
+	});
+	double reduce_scalar = Measure(rounds, [&]() {
+		reduction.Reset();
+		ecl::ReduceRowsScalar(rows.data(), kRows, reduction);
+		check += reduction.min[0];
+	});
+	double reduce_kernel = Measure(rounds, [&]() {
+		reduction.Reset();
+		ecl::ReduceRows(rows.data(), kRows, reduction);
+		check += reduction.min[0];
+	});
+	// one scaler of a column major day
+	double reduce_column = Measure(rounds, [&]() {
+		reduction.Reset();
+		ecl::ReduceColumn(rows.data(), kRows, 0, reduction);
+		check += reduction.min[0];
+	});
+
+	std::cout << "kernel: " << ecl::ScalerKernelName() << "\n"
+		<< "rows: " << kRows << " x " << ecl::kMaxScalers
+		<< ", rounds: " << rounds << "\n"
+		<< "sum scalar:    " << sum_scalar / 1e6 << " Mrows/s\n"
+		<< "sum kernel:    " << sum_kernel / 1e6 << " Mrows/s ("
+		<< sum_kernel / sum_scalar << "x)\n"
+		<< "reduce scalar: " << reduce_scalar / 1e6 << " Mrows/s\n"
+		<< "reduce kernel: " << reduce_kernel / 1e6 << " Mrows/s ("
+		<< reduce_kernel / reduce_scalar << "x)\n"
+		<< "reduce column: " << reduce_column / 1e6 << " Mrows/s (one scaler)\n"
+		<< "check: " << check << std::endl;
+	return 0;
+}
@@ -1,6 +1,9 @@
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string_view>
+#include <thread>
+#include <vector>
 
 #include "service.h"
 #include "external/cxxopts.hpp"
@@ -23,6 +26,8 @@ int main(int argc, char **argv) {
 	int test = 0;
 	// show flag
 	bool show = false;
+	// show front IO and gates flag
+	bool analyze = false;
 	// service port
 	int port = 2233;
 	// config file
@@ -33,11 +38,52 @@ int main(int argc, char **argv) {
 	std::string device_name;
 	// log level
 	LogLevel log_level = kWarn;
+	// seconds between two flushes of scaler file
+	int sync_interval = 10;
+	// reserve disk blocks of new scaler file
+	// seconds before midnight to create the next scaler file
+	int prepare_ahead = 600;
+	// maximum queued samples of each subscriber
+	int subscription_queue = 16;
+	// layout version of new scaler file
+	int file_version = 1;
+	// keep prefix sums of scaler files
+	bool prefix_index = false;
+	// maintenance of old scaler files, 0 disables
+	int archive_days = 0;
+	int retention_days = 0;
+	int disk_budget_mb = 0;
+	int maintenance_interval = 3600;
+	int maintenance_io_rate = 2048;
+	// real time sampling, 0 priority keeps normal scheduling
+	int sampler_priority = 0;
+	int sampler_cpu = -1;
+	// sample on interrupts of device
+	bool sampler_irq = false;
+	int sampler_irq_timeout = 3000;
+	// capture of front IO and gate values, 0 rate disables
+	int capture_rate = 1000;
+	int capture_cpu = -1;
+	// backend of registers, and input rates of the simulated device
+	std::string device = "uio";
+	std::string device_path = "/dev/uio0";
+	std::vector<double> simulated_rates;
+	double simulated_width = 100.0;
+	// load generator and number of loaded devices
+	double load_rate = 0.0;
+	std::vector<std::string> load_models;
+	int load_seed = 0;
+	int load_devices = 1;
+	// workers and queue of queries reading files
+	int query_threads = 2;
+	int query_queue = 16;
+	int query_cache_kb = 1024;
 
 	cxxopts::Options args("server", "server for easy-config-logic");
 	args.add_options()
 		("h,help", "Print usage")
 		("s,show", "Show scaler on screen")
+		("a,analyze", "Show front IO and gate activities on screen")
 		(
 			"c,config", "Config from file",
 			cxxopts::value<std::string>(), "file"
@@ -74,6 +120,7 @@ int main(int argc, char **argv) {
 		}
 		test = result["test"].as<int>();
 		show = result["show"].as<bool>();
+		analyze = result["analyze"].as<bool>();
 		port = result["port"].as<int>();
 		path = result["path"].as<std::string>();
 		device_name = result["name"].as<std::string>();
@@ -94,6 +141,43 @@ int main(int argc, char **argv) {
 		std::string level_name =
 			toml::find_or<std::string>(toml_data, "log_level", "warn");
 		log_level = ParseLogLevel(level_name.c_str());
+		sync_interval = toml::find_or<int>(toml_data, "sync_interval", 10);
+		prepare_ahead = toml::find_or<int>(toml_data, "prepare_ahead", 600);
+		subscription_queue =
+			toml::find_or<int>(toml_data, "subscription_queue", 16);
+		file_version = toml::find_or<int>(toml_data, "file_version", 1);
+		prefix_index = toml::find_or<bool>(toml_data, "prefix_index", false);
+		archive_days = toml::find_or<int>(toml_data, "archive_days", 0);
+		retention_days = toml::find_or<int>(toml_data, "retention_days", 0);
+		disk_budget_mb = toml::find_or<int>(toml_data, "disk_budget_mb", 0);
+		maintenance_interval =
+			toml::find_or<int>(toml_data, "maintenance_interval", 3600);
+		maintenance_io_rate =
+			toml::find_or<int>(toml_data, "maintenance_io_rate", 2048);
+		sampler_priority = toml::find_or<int>(toml_data, "sampler_priority", 0);
+		sampler_cpu = toml::find_or<int>(toml_data, "sampler_cpu", -1);
+		sampler_irq = toml::find_or<bool>(toml_data, "sampler_irq", false);
+		sampler_irq_timeout =
+			toml::find_or<int>(toml_data, "sampler_irq_timeout", 3000);
+		capture_rate = toml::find_or<int>(toml_data, "capture_rate", 1000);
+		capture_cpu = toml::find_or<int>(toml_data, "capture_cpu", -1);
+		device = toml::find_or<std::string>(toml_data, "device", "uio");
+		device_path =
+			toml::find_or<std::string>(toml_data, "device_path", "/dev/uio0");
+		simulated_rates = toml::find_or<std::vector<double>>(
+			toml_data, "simulated_rates", std::vector<double>()
+		);
+		simulated_width =
+			toml::find_or<double>(toml_data, "simulated_width", 100.0);
+		load_rate = toml::find_or<double>(toml_data, "load_rate", 0.0);
+		load_models = toml::find_or<std::vector<std::string>>(
+			toml_data, "load_models", std::vector<std::string>()
+		);
+		load_seed = toml::find_or<int>(toml_data, "load_seed", 0);
+		load_devices = toml::find_or<int>(toml_data, "load_devices", 1);
+		query_threads = toml::find_or<int>(toml_data, "query_threads", 2);
+		query_queue = toml::find_or<int>(toml_data, "query_queue", 16);
+		query_cache_kb = toml::find_or<int>(toml_data, "query_cache_kb", 1024);
 	}
 
 	ServiceOption option;
@@ -101,11 +185,71 @@ int main(int argc, char **argv) {
 	option.log_level = log_level;
 	option.data_path = path;
 	option.device_name = device_name;
+	option.sync_interval = sync_interval;
+	option.prepare_ahead = prepare_ahead;
+	option.subscription_queue = subscription_queue;
+	option.file_version = file_version;
+	option.prefix_index = prefix_index;
+	option.archive_days = archive_days;
+	option.retention_days = retention_days;
+	option.disk_budget_mb = disk_budget_mb;
+	option.maintenance_interval = maintenance_interval;
+	option.maintenance_io_rate = maintenance_io_rate;
+	option.sampler_priority = sampler_priority;
+	option.sampler_cpu = sampler_cpu;
+	option.sampler_irq = sampler_irq;
+	option.sampler_irq_timeout = sampler_irq_timeout;
+	option.capture_rate = capture_rate;
+	option.capture_cpu = capture_cpu;
+	if (ParseDeviceKind(device, option.device)) {
+		std::cout << "[Error] Invalid device " << device
+			<< ", expect uio, file or simulated.\n";
+		return -1;
+	}
+	option.device_path = device_path;
+	option.simulated_rates = simulated_rates;
+	option.simulated_width = simulated_width;
+	option.load_rate = load_rate;
+	for (const std::string &text : load_models) {
+		LoadModel model;
+		if (ParseLoadModel(text, model)) {
+			std::cout << "[Error] Invalid load model " << text << "\n";
+			return -1;
+		}
+		option.load_models.push_back(model);
+	}
+	option.load_seed = uint32_t(load_seed);
+	option.query_threads = query_threads;
+	option.query_queue = query_queue;
+	option.query_cache_kb = query_cache_kb;
+	if (load_devices < 1 || (load_devices > 1 && load_rate <= 0.0)) {
+		std::cout << "[Error] Multiple devices require the load generator.\n";
+		return -1;
+	}
 
 	if (show) {
 		option.port = -1;
 		Service service(option);
 		service.PrintScaler();
+	} else if (analyze) {
+		option.port = -1;
+		Service service(option);
+		service.PrintCapture();
+	} else if (load_devices > 1) {
+		// simulated devices in one process, each serves on its own port
+		std::vector<std::unique_ptr<Service>> services;
+		for (int i = 0; i < load_devices; ++i) {
+			ServiceOption device_option = option;
+			device_option.port = port + i;
+			device_option.device_name = device_name + std::to_string(i);
+			if (load_seed) device_option.load_seed = uint32_t(load_seed + i);
+			services.push_back(std::make_unique<Service>(device_option));
+		}
+		std::vector<std::thread> threads;
+		for (auto &service : services) {
+			threads.emplace_back([&service]() { service->Serve(); });
+		}
+		for (auto &thread : threads) thread.join();
 	} else {
 		option.port = port;
 		Service service(option);
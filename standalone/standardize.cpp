@@ -18,10 +18,10 @@ int main() {
 	// lexer parse and get tokens
 	lexer.Analyse(line, tokens);
 
-	// grammar
-	ecl::LogicDownscaleGrammar grammar;
 	// syntax parser
-	ecl::SLRSyntaxParser<int> parser(&grammar);
+	ecl::SLRSyntaxParser<int> parser(
+		ecl::SharedGrammar<int, ecl::LogicDownscaleGrammar>()
+	);
 
 	if (tokens.size() < 3 || tokens[1]->Name() != "=") {
 		std::vector<ecl::TokenPtr> full_tokens;
@@ -47,20 +47,20 @@ int main(int argc, char **argv) {
 	}
 
 	if (language == "logic-downscale") {
-		// grammar
-		ecl::LogicDownscaleGrammar grammar;
 		// syntax parser parse
-		ecl::SLRSyntaxParser<int> parser(&grammar);
+		ecl::SLRSyntaxParser<int> parser(
+			ecl::SharedGrammar<int, ecl::LogicDownscaleGrammar>()
+		);
 		// parse tokens
 		parser.Parse(tokens);
 		// print tree
 		parser.PrintTree(parser.Root());
 		std::cout << "Layers: " << parser.Root()->Eval() << "\n";
 	} else {
-		// grammar
-		ecl::LogicalGrammar grammar;
 		// syntax parser parse
-		ecl::SLRSyntaxParser<bool> parser(&grammar);
+		ecl::SLRSyntaxParser<bool> parser(
+			ecl::SharedGrammar<bool, ecl::LogicalGrammar>()
+		);
 		// parse tokens
 		parser.Parse(tokens);
 		// print tree
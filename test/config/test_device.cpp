@@ -0,0 +1,193 @@
+#include "config/device.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+TEST(DeviceTest, SimulateRates) {
+	MemoryConfig config;
+	config.Clear();
+	Memory memory;
+	memcpy(&memory, config.GetMemory(), sizeof(Memory));
+	// or gate 0 of inputs 0 and 1, and gate 0 of inputs 0 and 2
+	memory.or_gates[0].front[0] = 0x0003;
+	memory.and_gates[0].front[0] = 0x0005;
+	// and gate 1 of or gate 0 alone
+	memory.and_gates[1].or_gates = 0x0001;
+	// multi gate 0, at least 2 of inputs 0, 1 and 2
+	memory.multi_gates[0].front[0] = 0x0007;
+	memory.multi_gates[0].threshold = 2;
+	// divider 0 divides or gate 0 by 4
+	memory.divider_source[0] = uint8_t(kSelectOrGate);
+	memory.divisor[0] = 4;
+	// 1 kHz clock
+	memory.clock_divisor[0] = 100000;
+	// divider-or of input 3 and divider 0
+	memory.divider_or[0].front[0] = 0x0008;
+	memory.divider_or[0].divider = 0x01;
+
+	const double inputs[4] = {1000.0, 3000.0, 2000.0, 500.0};
+	const double width = 100e-9;
+	double rates[kSelections];
+	SimulateRates(memory, inputs, 4, width, rates);
+
+	EXPECT_DOUBLE_EQ(rates[kSelectFront + 1], 3000.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectFront + 4], 0.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectOrGate], 4000.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectOrGate + 1], 0.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectAndGate], 2.0 * width * 1000.0 * 2000.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectAndGate + 1], 4000.0);
+	EXPECT_DOUBLE_EQ(
+		rates[kSelectMultiGate],
+		2.0 * width * (1000.0*3000.0 + 1000.0*2000.0 + 3000.0*2000.0)
+	);
+	EXPECT_DOUBLE_EQ(rates[kSelectDivider], 1000.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectClock], 1000.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectDividerOr], 1500.0);
+	EXPECT_DOUBLE_EQ(rates[kSelectZero], 0.0);
+}
+
+
+TEST(DeviceTest, SimulatedScalers) {
+	DeviceOption option;
+	option.kind = kSimulatedDevice;
+	option.seed = 42;
+	for (size_t i = 0; i < kFrontIoNum; ++i) option.rates.push_back(i * 100.0);
+	SimulatedDevice device(option);
+	volatile Memory *memory = device.Registers();
+	ASSERT_NE(memory, nullptr);
+	EXPECT_EQ(device.IrqFd(), -1);
+
+	// scaler 3 counts the clock, scaler 4 counts nothing
+	memory->clock_divisor[1] = 1000;
+	memory->scaler[3].source = uint8_t(kSelectClock + 1);
+	memory->scaler[4].source = uint8_t(kSelectZero);
+	device.Update();
+	EXPECT_EQ(device.Updates(), 1u);
+
+	ScalerSnapshot snapshot;
+	ASSERT_EQ(device.ReadSnapshot(snapshot), 0);
+	EXPECT_EQ(snapshot.values[0], 0u);
+	EXPECT_EQ(snapshot.values[3], 100000u);
+	EXPECT_EQ(snapshot.values[4], 0u);
+	for (size_t i = 5; i < kMaxScalers; ++i) {
+		// Poisson counts, far within 6 standard deviations
+		double mean = i * 100.0;
+		EXPECT_NEAR(double(snapshot.values[i]), mean, 6.0 * std::sqrt(mean))
+			<< "scaler " << i;
+		EXPECT_EQ(memory->scaler[i].source, i);
+	}
+}
+
+
+TEST(DeviceTest, SimulatedUpdateKeepsSources) {
+	DeviceOption option;
+	option.kind = kSimulatedDevice;
+	option.seed = 7;
+	option.rates.assign(kFrontIoNum, 1000.0);
+	SimulatedDevice device(option);
+	volatile Memory *memory = device.Registers();
+
+	// sources written meanwhile are never reverted by updating
+	std::atomic<bool> stop(false);
+	std::thread updater([&]() {
+		while (!stop) device.Update();
+	});
+	int reverted = 0;
+	for (int n = 0; device.Updates() < 1000; ++n) {
+		uint8_t source = uint8_t(kSelectFront + n % kFrontIoNum);
+		memory->scaler[n % kMaxScalers].source = source;
+		if (memory->scaler[n % kMaxScalers].source != source) ++reverted;
+	}
+	stop = true;
+	updater.join();
+	EXPECT_EQ(reverted, 0);
+}
+
+
+TEST(DeviceTest, SimulatedConfig) {
+	DeviceOption option;
+	option.kind = kSimulatedDevice;
+	SimulatedDevice device(option);
+	MemoryConfig config;
+	ASSERT_EQ(config.Read((kTestDataDir + "register_config_1.txt").c_str()), 0)
+		<< "Error: config read failed.";
+
+	// the simulated registers read back as written
+	MapResult result;
+	ASSERT_EQ(device.WriteConfig(config, false, &result), 0);
+	EXPECT_GT(result.words, 0u);
+	EXPECT_FALSE(result.full);
+	ASSERT_EQ(device.WriteConfig(config, false, &result), 0);
+	EXPECT_EQ(result.words, 0u);
+	EXPECT_EQ(result.rj45_groups, 0u);
+	volatile Memory *memory = device.Registers();
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(memory->scaler[i].source, config.GetMemory()->scaler[i].source);
+	}
+}
+
+
+TEST(DeviceTest, File) {
+	char path[] = "/tmp/test_device_XXXXXX";
+	int temp = mkstemp(path);
+	ASSERT_GE(temp, 0);
+	close(temp);
+
+	FileDevice device(path);
+	ASSERT_EQ(device.Open(), 0);
+	EXPECT_EQ(device.IrqFd(), -1);
+	// locked like the UIO device
+	FileDevice other(path);
+	EXPECT_EQ(other.Open(), -1);
+
+	// another process plays FPGA through the same file
+	int fd = open(path, O_RDWR);
+	ASSERT_GE(fd, 0);
+	void *map_addr = mmap(
+		NULL, sizeof(Memory), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+	);
+	ASSERT_NE(map_addr, MAP_FAILED);
+	volatile Memory *fpga = (volatile Memory*)map_addr;
+	fpga->scaler[7].value = 12345;
+
+	ScalerSnapshot snapshot;
+	ASSERT_EQ(device.ReadSnapshot(snapshot), 0);
+	EXPECT_EQ(snapshot.values[7], 12345u);
+	EXPECT_EQ(snapshot.values[6], 0u);
+	device.Registers()->divisor[2] = 9;
+	EXPECT_EQ(fpga->divisor[2], 9);
+
+	munmap(map_addr, sizeof(Memory));
+	close(fd);
+	unlink(path);
+}
+
+
+TEST(DeviceTest, ParseKind) {
+	DeviceKind kind = kUioDevice;
+	EXPECT_EQ(ParseDeviceKind("file", kind), 0);
+	EXPECT_EQ(kind, kFileDevice);
+	EXPECT_EQ(ParseDeviceKind("simulated", kind), 0);
+	EXPECT_EQ(kind, kSimulatedDevice);
+	EXPECT_EQ(ParseDeviceKind("fpga", kind), -1);
+	EXPECT_EQ(kind, kSimulatedDevice);
+}
@@ -0,0 +1,203 @@
+#include "config/front_capture.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace ecl;
+
+class FrontCaptureTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		memset(&memory_, 0, sizeof(memory_));
+	}
+
+	// set level of the trigger channel and take one sample
+	void Sample(FrontCapture &capture, bool level) {
+		memory_.or_gate_value = level ? 0x0004 : 0;
+		capture.SampleOnce();
+	}
+
+	Memory memory_;
+};
+
+
+TEST_F(FrontCaptureTest, Channels) {
+	memory_.front_value[0] = 0x0001;
+	memory_.front_value[2] = 0x8000;
+	memory_.multi_gate_value = 0x0002;
+	memory_.or_gate_value = 0x0004;
+	memory_.and_gate_value = 0x0008;
+	FrontSample sample;
+	ReadFrontSample(&memory_, sample);
+	for (size_t i = 0; i < kFrontChannels; ++i) {
+		bool expected = i == kFrontInputChannel
+			|| i == kFrontInputChannel + 47
+			|| i == kMultiGateChannel + 1
+			|| i == kOrGateChannel + 2
+			|| i == kAndGateChannel + 3;
+		EXPECT_EQ(FrontLevel(sample, i), expected) << "channel " << i;
+	}
+}
+
+
+TEST_F(FrontCaptureTest, Statistics) {
+	// channel 0 toggles, channel 17 is always high
+	FrontSample samples[8];
+	for (size_t i = 0; i < 8; ++i) {
+		memset(&samples[i], 0, sizeof(FrontSample));
+		samples[i].words[0] = i % 2;
+		samples[i].words[1] = 0x0002;
+	}
+	FrontStatistics statistics;
+	AccumulateFront(samples, 4, statistics, false);
+	AccumulateFront(samples + 4, 4, statistics, true);
+	EXPECT_EQ(statistics.samples, 8u);
+	EXPECT_EQ(statistics.high[0], 4u);
+	EXPECT_EQ(statistics.transitions[0], 7u);
+	EXPECT_EQ(statistics.high[17], 8u);
+	EXPECT_EQ(statistics.transitions[17], 0u);
+	EXPECT_EQ(statistics.high[1], 0u);
+
+	// transitions from the last sample are not counted if not continued
+	statistics.Clear();
+	AccumulateFront(samples + 1, 2, statistics, false);
+	EXPECT_EQ(statistics.samples, 2u);
+	EXPECT_EQ(statistics.transitions[0], 1u);
+}
+
+
+TEST_F(FrontCaptureTest, FreeRunning) {
+	FrontCaptureOption option;
+	option.rate = 0;
+	option.capacity = 16;
+	FrontCapture capture(&memory_, option);
+	auto reader = capture.Subscribe(FrontTrigger());
+	ASSERT_NE(reader, nullptr);
+
+	std::vector<FrontSample> samples;
+	int trigger = 0;
+	EXPECT_EQ(reader->Next(samples, trigger), 0u);
+	for (int i = 0; i < 10; ++i) Sample(capture, i % 2);
+	ASSERT_EQ(reader->Next(samples, trigger), 10u);
+	EXPECT_EQ(trigger, -1);
+	for (size_t i = 0; i < 10; ++i) {
+		EXPECT_EQ(FrontLevel(samples[i], kOrGateChannel + 2), i % 2 == 1);
+	}
+	EXPECT_LE(samples[0].time, samples[9].time);
+
+	// the reader is too slow and samples are overwritten
+	for (int i = 0; i < 40; ++i) Sample(capture, false);
+	ASSERT_EQ(reader->Next(samples, trigger), 16u);
+	EXPECT_EQ(reader->Dropped(), 24u);
+	EXPECT_EQ(capture.Metrics().dropped, 24u);
+	EXPECT_EQ(capture.Metrics().samples, 50u);
+	EXPECT_EQ(capture.Metrics().readers, 1u);
+	capture.Unsubscribe(reader);
+	EXPECT_EQ(capture.Metrics().readers, 0u);
+}
+
+
+TEST_F(FrontCaptureTest, Trigger) {
+	FrontCaptureOption option;
+	option.rate = 0;
+	option.capacity = 64;
+	FrontCapture capture(&memory_, option);
+	FrontTrigger trigger;
+	trigger.enable = true;
+	trigger.channel = kOrGateChannel + 2;
+	trigger.edge = kFrontRising;
+	trigger.pre = 3;
+	trigger.post = 4;
+	auto reader = capture.Subscribe(trigger);
+	ASSERT_NE(reader, nullptr);
+
+	std::vector<FrontSample> samples;
+	int index = 0;
+	// high at the beginning is not an edge
+	for (int i = 0; i < 2; ++i) Sample(capture, true);
+	for (int i = 0; i < 8; ++i) Sample(capture, false);
+	EXPECT_EQ(reader->Next(samples, index), 0u);
+	// rising edge at sample 10, but the window is not complete
+	for (int i = 0; i < 3; ++i) Sample(capture, true);
+	EXPECT_EQ(reader->Next(samples, index), 0u);
+	for (int i = 0; i < 2; ++i) Sample(capture, true);
+	ASSERT_EQ(reader->Next(samples, index), 8u);
+	ASSERT_EQ(index, 3);
+	for (size_t i = 0; i < 8; ++i) {
+		EXPECT_EQ(FrontLevel(samples[i], trigger.channel), i >= 3);
+	}
+
+	// rearmed, falling edges are ignored
+	for (int i = 0; i < 4; ++i) Sample(capture, false);
+	for (int i = 0; i < 6; ++i) Sample(capture, true);
+	ASSERT_EQ(reader->Next(samples, index), 8u);
+	EXPECT_EQ(index, 3);
+	EXPECT_FALSE(FrontLevel(samples[2], trigger.channel));
+	EXPECT_TRUE(FrontLevel(samples[3], trigger.channel));
+	EXPECT_EQ(reader->Dropped(), 0u);
+
+	// invalid channel
+	trigger.channel = kFrontChannels;
+	EXPECT_EQ(capture.Subscribe(trigger), nullptr);
+	capture.Unsubscribe(reader);
+}
+
+
+TEST_F(FrontCaptureTest, PreTriggerBeforeSubscribe) {
+	FrontCaptureOption option;
+	option.rate = 0;
+	option.capacity = 64;
+	FrontCapture capture(&memory_, option);
+	// samples before subscribing are not in the window
+	for (int i = 0; i < 10; ++i) Sample(capture, false);
+	FrontTrigger trigger;
+	trigger.enable = true;
+	trigger.channel = kOrGateChannel + 2;
+	trigger.edge = kFrontAnyEdge;
+	trigger.pre = 5;
+	trigger.post = 1;
+	auto reader = capture.Subscribe(trigger);
+	Sample(capture, false);
+	Sample(capture, true);
+	Sample(capture, true);
+	std::vector<FrontSample> samples;
+	int index = 0;
+	ASSERT_EQ(reader->Next(samples, index), 3u);
+	EXPECT_EQ(index, 1);
+	capture.Unsubscribe(reader);
+}
+
+
+TEST_F(FrontCaptureTest, PollingThread) {
+	FrontCaptureOption option;
+	option.rate = 2000;
+	option.capacity = 8192;
+	FrontCapture capture(&memory_, option);
+	std::atomic<int> notified(0);
+	auto reader = capture.Subscribe(FrontTrigger(), [&]() { ++notified; });
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		(capture.Metrics().samples < 200 || notified < 2)
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	EXPECT_GE(capture.Metrics().samples, 200u);
+	EXPECT_GE(notified.load(), 2);
+	std::vector<FrontSample> samples;
+	int trigger = 0;
+	EXPECT_GT(reader->Next(samples, trigger), 0u);
+	for (size_t i = 1; i < samples.size(); ++i) {
+		EXPECT_LT(samples[i-1].time, samples[i].time);
+	}
+
+	// the thread stops after the last reader
+	capture.Unsubscribe(reader);
+	uint64_t stopped = capture.Metrics().samples;
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(capture.Metrics().samples, stopped);
+}
@@ -0,0 +1,141 @@
+#include "i2c_engine.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "config/memory_config.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+// Decode the bus from writes of control register, like a slave.
+class SimulatedI2cPort final : public I2cPort {
+public:
+	SimulatedI2cPort()
+	: value_(kI2cControl | kI2cScl | kI2cSda)
+	, bits_(0)
+	, byte_(0)
+	, nack_byte_(-1)
+	, bytes_(0) {
+	}
+
+	void Write(uint32_t value) noexcept override {
+		const bool scl = value & kI2cScl;
+		const bool was_scl = value_ & kI2cScl;
+		const bool control = value & kI2cControl;
+		if (scl && was_scl && control && (value_ & kI2cControl)) {
+			// SDA changes while SCL is high
+			if ((value_ & kI2cSda) && !(value & kI2cSda)) {
+				transactions.push_back(std::vector<uint8_t>());
+				bits_ = 0;
+				bytes_ = 0;
+			} else if (!(value_ & kI2cSda) && (value & kI2cSda)) {
+				++stops;
+				bits_ = 0;
+			}
+		} else if (scl && !was_scl && control && !transactions.empty()) {
+			// data bit from master
+			byte_ = uint8_t(byte_ << 1 | (value & kI2cSda ? 1 : 0));
+			if (++bits_ == 8) {
+				transactions.back().push_back(byte_);
+				bits_ = 0;
+			}
+		}
+		value_ = value;
+	}
+
+	uint32_t Read() noexcept override {
+		// acknowledge slot after the byte, SDA low to acknowledge
+		if (!(value_ & kI2cScl) || (value_ & kI2cControl)) return kI2cSdaIn;
+		return bytes_++ == nack_byte_ ? kI2cSdaIn : 0;
+	}
+
+	// do not acknowledge the byte at this index in transaction
+	void Nack(int index) {
+		nack_byte_ = index;
+	}
+
+	std::vector<std::vector<uint8_t>> transactions;
+	int stops = 0;
+
+private:
+	uint32_t value_;
+	int bits_;
+	uint8_t byte_;
+	int nack_byte_;
+	int bytes_;
+};
+
+
+TEST(I2cEngineTest, Write) {
+	SimulatedI2cPort port;
+	I2cEngine engine(port, 1000);
+	EXPECT_GT(engine.MinEdgeNs(), 0u);
+	EXPECT_GE(engine.EdgeNs(), 1000u);
+
+	const uint8_t data[2] = {0x5a, 0x81};
+	I2cTiming timing;
+	ASSERT_EQ(engine.Write(0x24, data, 2, &timing), 0);
+	ASSERT_EQ(port.transactions.size(), 1u);
+	ASSERT_EQ(port.transactions[0].size(), 3u);
+	EXPECT_EQ(port.transactions[0][0], 0x48);
+	EXPECT_EQ(port.transactions[0][1], 0x5a);
+	EXPECT_EQ(port.transactions[0][2], 0x81);
+	EXPECT_EQ(port.stops, 1);
+
+	// start 2, each byte 25 and acknowledge 3, stop 3
+	EXPECT_EQ(timing.edges, 2u + 3u * 28u + 3u);
+	EXPECT_EQ(timing.nacks, 0u);
+	// edges are never closer than the edge time
+	EXPECT_GE(timing.duration_ns, (timing.edges - 1) * uint64_t(engine.EdgeNs()));
+
+	I2cEngineMetrics metrics = engine.Metrics();
+	EXPECT_EQ(metrics.transactions, 1u);
+	EXPECT_EQ(metrics.last_ns, timing.duration_ns);
+	EXPECT_EQ(metrics.max_ns, timing.duration_ns);
+}
+
+
+TEST(I2cEngineTest, Nack) {
+	SimulatedI2cPort port;
+	I2cEngine engine(port, 100);
+	port.Nack(1);
+	const uint8_t data = 0x0f;
+	I2cTiming timing;
+	EXPECT_EQ(engine.Write(0x20, &data, 1, &timing), -1);
+	EXPECT_EQ(timing.nacks, 1u);
+	// the transaction is still finished
+	EXPECT_EQ(port.stops, 1);
+	EXPECT_EQ(engine.Metrics().nacks, 1u);
+}
+
+
+TEST(I2cEngineTest, EnableRj45) {
+	MemoryConfig config;
+	ASSERT_EQ(config.Read((kTestDataDir + "register_config_1.txt").c_str()), 0)
+		<< "Error: config read failed.";
+	SimulatedI2cPort port;
+	I2cEngine engine(port);
+	for (uint32_t i = 0; i < 6; ++i) {
+		EXPECT_EQ(config.EnableRj45(engine, i), 0);
+	}
+	EXPECT_EQ(config.EnableRj45(engine, 6), -1);
+	// address bytes of I/O expanders
+	const uint8_t addresses[6] = {
+		0b01001000, 0b01000000, 0b01001010, 0b01000010, 0b01001100, 0b01000100
+	};
+	ASSERT_EQ(port.transactions.size(), 6u);
+	for (size_t i = 0; i < 6; ++i) {
+		ASSERT_EQ(port.transactions[i].size(), 2u);
+		EXPECT_EQ(port.transactions[i][0], addresses[i]);
+		EXPECT_EQ(port.transactions[i][1], config.Rj45Enable(i));
+	}
+}
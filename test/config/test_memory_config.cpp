@@ -54,4 +54,77 @@ TEST(MemoryConfigTest, ReadLogicExpression) {
 	const Memory *memory1 = config1.GetMemory();
 
 	EXPECT_EQ(memcmp(memory0, memory1, sizeof(Memory)), 0);
-}
\ No newline at end of file
+}
+
+TEST(MemoryConfigTest, MapMemoryDifferential) {
+	MemoryConfig config;
+	ASSERT_EQ(config.Read((kTestDataDir + "register_config_1.txt").c_str()), 0)
+		<< "Error: config read failed.";
+	const Memory *expected = config.GetMemory();
+	// device simulated in memory
+	Memory device;
+	memset(&device, 0, sizeof(device));
+	volatile uint32_t *map = (volatile uint32_t*)&device;
+
+	// the first apply writes all changed words
+	MapResult result;
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_FALSE(result.full);
+	EXPECT_GT(result.words, 0u);
+	EXPECT_TRUE(result.reset);
+	EXPECT_EQ(device.i2c.reset, 0u);
+	EXPECT_EQ(memcmp(device.multi_gates, expected->multi_gates, sizeof(device.multi_gates)), 0);
+	EXPECT_EQ(memcmp(device.divisor, expected->divisor, sizeof(device.divisor)), 0);
+	EXPECT_EQ(memcmp(device.rj45_enable, expected->rj45_enable, sizeof(device.rj45_enable)), 0);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(device.scaler[i].source, expected->scaler[i].source);
+	}
+
+	// nothing changed
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_EQ(result.words, 0u);
+	EXPECT_EQ(result.rj45_groups, 0u);
+	EXPECT_FALSE(result.reset);
+
+	// live values are not configuration
+	device.front_value[1] = 0x1234;
+	device.or_gate_value = 0x5678;
+	device.scaler[3].value = 1000;
+	device.addends[1] = 7;
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_EQ(result.words, 0u);
+	EXPECT_EQ(device.scaler[3].value, 1000u);
+
+	// one scaler source costs one word, without reset
+	device.scaler[5].source = uint8_t(expected->scaler[5].source + 1);
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_EQ(result.words, 1u);
+	EXPECT_EQ(result.rj45_groups, 0u);
+	EXPECT_FALSE(result.reset);
+	EXPECT_EQ(device.scaler[5].source, expected->scaler[5].source);
+
+	// dividers need reset
+	device.divisor[2] = uint16_t(expected->divisor[2] + 1);
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_EQ(result.words, 1u);
+	EXPECT_TRUE(result.reset);
+
+	// only the changed RJ45 port group goes through I2C
+	device.rj45_enable[1] ^= 0x0100;
+	ASSERT_EQ(config.MapMemoryDifferential(map, &result), 0);
+	EXPECT_EQ(result.words, 1u);
+	EXPECT_EQ(result.rj45_groups, 1u);
+	EXPECT_FALSE(result.reset);
+	EXPECT_EQ(device.rj45_enable[1], expected->rj45_enable[1]);
+
+	// the expander never acknowledges
+	map[1] = kI2cSdaIn;
+	device.rj45_enable[0] ^= 0x0001;
+	EXPECT_EQ(config.MapMemoryDifferential(map, &result), -1);
+	EXPECT_EQ(result.rj45_groups, 1u);
+	EXPECT_EQ(result.rj45_failures, 1u);
+	map[1] = 0;
+	EXPECT_EQ(config.MapMemory(map, &result), 0);
+	EXPECT_TRUE(result.full);
+	EXPECT_EQ(result.rj45_failures, 0u);
+}
@@ -0,0 +1,63 @@
+#include "config/scaler_snapshot.h"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace ecl;
+
+TEST(ScalerSnapshotTest, Decode) {
+	Memory memory;
+	memset(&memory, 0, sizeof(memory));
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		memory.scaler[i].source = uint8_t(0xff - i);
+		memory.scaler[i].clock_source = i % 16;
+		memory.scaler[i].value = i % 2 ? 0xfffff : i * 1000;
+	}
+	ScalerSnapshot snapshot;
+	ASSERT_EQ(ReadScalerSnapshot(&memory, snapshot), 0);
+	EXPECT_EQ(snapshot.bursts, 2);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(snapshot.values[i], i % 2 ? 0xfffffu : i * 1000);
+	}
+	// at least two bursts are read
+	ASSERT_EQ(ReadScalerSnapshot(&memory, snapshot, 1), 0);
+	EXPECT_EQ(snapshot.bursts, 2);
+}
+
+
+TEST(ScalerSnapshotTest, ChangingRegisters) {
+	volatile Memory memory;
+	for (size_t i = 0; i < kMaxScalers; ++i) memory.scaler[i].value = 0;
+	// registers keep changing while reading
+	std::atomic<bool> stop(false);
+	std::atomic<bool> started(false);
+	std::thread latch([&]() {
+		for (uint32_t value = 1; !stop; ++value) {
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				memory.scaler[i].value = value & 0xfffff;
+			}
+			started = true;
+		}
+	});
+	while (!started) std::this_thread::yield();
+	ScalerSnapshot snapshot;
+	for (int i = 0; i < 1000; ++i) {
+		int result = ReadScalerSnapshot(&memory, snapshot);
+		ASSERT_TRUE(result == 0 || result == -1);
+		EXPECT_GE(snapshot.bursts, 2);
+		EXPECT_LE(snapshot.bursts, kMaxSnapshotBursts);
+		// give up only after all bursts
+		if (result) {
+			EXPECT_EQ(snapshot.bursts, kMaxSnapshotBursts);
+		}
+	}
+	stop = true;
+	latch.join();
+	// agreed or not, the values are all from the register block
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_LE(snapshot.values[i], 0xfffffu);
+	}
+}
@@ -0,0 +1,134 @@
+#include "scaler/scaler_archive.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+/// @brief fill day file with scalers of different patterns
+void FillDay(ScalerFile &day, std::vector<uint32_t> &expect) {
+	std::mt19937 engine(17);
+	std::uniform_int_distribution<uint32_t> random;
+	std::poisson_distribution<uint32_t> rate(1000);
+	expect.assign(kDaySeconds * kMaxScalers, 0);
+	for (size_t second = 0; second < kDaySeconds; ++second) {
+		uint32_t *row = expect.data() + second * kMaxScalers;
+		// scaler 0 is always zero
+		row[1] = 12345;
+		row[2] = rate(engine);
+		row[3] = random(engine);
+		row[4] = second % 2 ? 0xffffffffu : 0;
+		row[5] = second >= 40000 && second < 50000 ? rate(engine) : 0;
+		day.WriteRow(second, row);
+	}
+}
+
+
+TEST(ScalerArchiveTest, FileName) {
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = 7;
+	EXPECT_EQ(
+		ScalerArchiveFileName("data/", "dev", &date),
+		"data/20230307-dev.sca"
+	);
+}
+
+
+TEST(ScalerArchiveTest, CreateRead) {
+	const std::string name = kTestDataDir + "scaler-archive-test.bin";
+	const std::string archive_name = kTestDataDir + "scaler-archive-test.sca";
+	remove(name.c_str());
+	remove(archive_name.c_str());
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true), 0);
+	std::vector<uint32_t> expect;
+	FillDay(day, expect);
+	ASSERT_EQ(ScalerArchive::Create(day, archive_name), 0);
+	day.Close();
+
+	ScalerArchive archive;
+	ASSERT_EQ(archive.Open(archive_name), 0);
+	// random data takes a little more than raw, others much less
+	EXPECT_LT(archive.Size(), kScalerFileSize / 4);
+
+	// random ranges, including block and frame boundaries
+	std::mt19937 engine(19);
+	std::uniform_int_distribution<size_t> second_distribution(0, kDaySeconds-1);
+	std::vector<uint32_t> values(kDaySeconds);
+	for (int n = 0; n < 100; ++n) {
+		size_t second = second_distribution(engine);
+		size_t size = 1 + second_distribution(engine) % (kDaySeconds - second);
+		size_t index = n % 8;
+		archive.ReadColumn(second, size, index, values.data());
+		for (size_t i = 0; i < size; ++i) {
+			ASSERT_EQ(values[i], expect[(second + i) * kMaxScalers + index])
+				<< "scaler " << index << ", second " << second + i;
+		}
+	}
+	std::vector<uint32_t> rows(300 * kMaxScalers);
+	archive.ReadRows(kScalerBlockSeconds - 100, 300, rows.data());
+	for (size_t i = 0; i < rows.size(); ++i) {
+		ASSERT_EQ(rows[i], expect[(kScalerBlockSeconds - 100) * kMaxScalers + i]);
+	}
+	archive.Close();
+	remove(name.c_str());
+	remove(archive_name.c_str());
+}
+
+
+TEST(ScalerArchiveTest, Extract) {
+	const std::string name = kTestDataDir + "scaler-archive-extract.bin";
+	const std::string archive_name = kTestDataDir + "scaler-archive-extract.sca";
+	remove(name.c_str());
+	remove(archive_name.c_str());
+	EXPECT_EQ(ScalerArchive::Extract(archive_name, name), -2);
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true, kScalerFileColumnMajor), 0);
+	std::vector<uint32_t> expect;
+	FillDay(day, expect);
+	ASSERT_EQ(ScalerArchive::Create(day, archive_name), 0);
+	day.Close();
+	remove(name.c_str());
+
+	ASSERT_EQ(ScalerArchive::Extract(archive_name, name), 0);
+	ASSERT_EQ(day.Open(name, false, false), 0);
+	EXPECT_EQ(day.Version(), kScalerFileRowMajor);
+	for (size_t second = 0; second < kDaySeconds; ++second) {
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			ASSERT_EQ(day.Row(second)[i], expect[second * kMaxScalers + i]);
+		}
+	}
+	day.Close();
+	remove(name.c_str());
+	remove(archive_name.c_str());
+}
+
+
+TEST(ScalerArchiveTest, InvalidFile) {
+	const std::string name = kTestDataDir + "scaler-archive-invalid.sca";
+	FILE *fp = fopen(name.c_str(), "w");
+	ASSERT_NE(fp, nullptr);
+	fputs("invalid", fp);
+	fclose(fp);
+
+	ScalerArchive archive;
+	EXPECT_EQ(archive.Open(name), -1);
+	EXPECT_FALSE(archive.IsOpen());
+	remove(name.c_str());
+	EXPECT_EQ(archive.Open(name), -2);
+}
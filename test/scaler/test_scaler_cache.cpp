@@ -0,0 +1,145 @@
+#include "scaler/scaler_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+
+ScalerCacheKey MakeKey(
+	int seconds,
+	int average,
+	time_t time,
+	uint64_t version = 0
+) {
+	ScalerCacheKey key;
+	key.seconds = seconds;
+	key.average = average;
+	key.time = time;
+	key.version = version;
+	return key;
+}
+
+
+TEST(ScalerCacheTest, HitAndExpire) {
+	ScalerCache cache(1024 * 1024);
+	int computed = 0;
+	auto compute = [&](ScalerCacheValue &value) {
+		++computed;
+		value.start_time = 100;
+		value.size = 2;
+		value.values.assign(4, uint32_t(computed));
+		return 0;
+	};
+	std::shared_ptr<const ScalerCacheValue> value;
+	ASSERT_EQ(cache.Get(MakeKey(120, 1, 1000), compute, value), 0);
+	ASSERT_NE(value, nullptr);
+	EXPECT_EQ(value->values[0], 1u);
+	ASSERT_EQ(cache.Get(MakeKey(120, 1, 1000), compute, value), 0);
+	EXPECT_EQ(value->values[0], 1u);
+	// other range
+	ASSERT_EQ(cache.Get(MakeKey(1200, 10, 1000), compute, value), 0);
+	EXPECT_EQ(computed, 2);
+	ScalerCacheMetrics metrics = cache.Metrics();
+	EXPECT_EQ(metrics.hits, 1u);
+	EXPECT_EQ(metrics.misses, 2u);
+	EXPECT_EQ(metrics.entries, 2u);
+
+	// the next second expires both
+	ASSERT_EQ(cache.Get(MakeKey(120, 1, 1001), compute, value), 0);
+	EXPECT_EQ(value->values[0], 3u);
+	metrics = cache.Metrics();
+	EXPECT_EQ(metrics.expired, 2u);
+	EXPECT_EQ(metrics.entries, 1u);
+	// so does a new sample in the same second
+	ASSERT_EQ(cache.Get(MakeKey(120, 1, 1001, 1), compute, value), 0);
+	EXPECT_EQ(value->values[0], 4u);
+	EXPECT_EQ(cache.Metrics().expired, 3u);
+
+	// failures are not kept
+	auto fail = [](ScalerCacheValue&) { return -1; };
+	EXPECT_EQ(cache.Get(MakeKey(60, 1, 1001, 1), fail, value), -1);
+	EXPECT_EQ(value, nullptr);
+	ASSERT_EQ(cache.Get(MakeKey(60, 1, 1001, 1), compute, value), 0);
+	EXPECT_EQ(computed, 5);
+}
+
+
+TEST(ScalerCacheTest, Evict) {
+	// room for about two results
+	const size_t values = 1000;
+	ScalerCache cache(values * sizeof(uint32_t) * 2 + 512);
+	auto compute = [&](ScalerCacheValue &value) {
+		value.start_time = 0;
+		value.size = values;
+		value.values.assign(values, 0);
+		return 0;
+	};
+	std::shared_ptr<const ScalerCacheValue> value;
+	cache.Get(MakeKey(1, 1, 10), compute, value);
+	cache.Get(MakeKey(2, 1, 10), compute, value);
+	// use the first one, so the second one is evicted
+	cache.Get(MakeKey(1, 1, 10), compute, value);
+	cache.Get(MakeKey(3, 1, 10), compute, value);
+	ScalerCacheMetrics metrics = cache.Metrics();
+	EXPECT_EQ(metrics.evicted, 1u);
+	EXPECT_EQ(metrics.entries, 2u);
+	EXPECT_LE(metrics.bytes, values * sizeof(uint32_t) * 2 + 512);
+	cache.Get(MakeKey(1, 1, 10), compute, value);
+	EXPECT_EQ(cache.Metrics().hits, 2u);
+	cache.Get(MakeKey(2, 1, 10), compute, value);
+	EXPECT_EQ(cache.Metrics().misses, 4u);
+}
+
+
+TEST(ScalerCacheTest, Coalesce) {
+	ScalerCache cache(0);
+	std::atomic<int> computed(0);
+	std::atomic<bool> release(false);
+	auto compute = [&](ScalerCacheValue &value) {
+		++computed;
+		while (!release) std::this_thread::yield();
+		value.start_time = 0;
+		value.size = 1;
+		value.values.assign(1, 7);
+		return 0;
+	};
+
+	const int clients = 8;
+	std::atomic<int> correct(0);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < clients; ++i) {
+		threads.emplace_back([&]() {
+			std::shared_ptr<const ScalerCacheValue> value;
+			if (
+				cache.Get(MakeKey(120, 1, 10), compute, value) == 0
+				&& value->values[0] == 7
+			) {
+				++correct;
+			}
+		});
+	}
+	// wait until all others are waiting for the computation
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		cache.Metrics().coalesced < uint64_t(clients - 1)
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	release = true;
+	for (auto &thread : threads) thread.join();
+
+	EXPECT_EQ(computed.load(), 1);
+	EXPECT_EQ(correct.load(), clients);
+	ScalerCacheMetrics metrics = cache.Metrics();
+	EXPECT_EQ(metrics.misses, 1u);
+	EXPECT_EQ(metrics.coalesced, uint64_t(clients - 1));
+	// nothing is kept without memory
+	EXPECT_EQ(metrics.entries, 0u);
+	EXPECT_EQ(metrics.bytes, 0u);
+}
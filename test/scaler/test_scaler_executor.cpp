@@ -0,0 +1,152 @@
+#include "scaler/scaler_executor.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+// blocks the workers until released
+class Gate {
+public:
+	void Wait() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		++waiting_;
+		condition_.notify_all();
+		condition_.wait(lock, [this]() { return open_; });
+	}
+
+	void WaitFor(int waiting) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [&]() { return waiting_ >= waiting; });
+	}
+
+	void Open() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		open_ = true;
+		condition_.notify_all();
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	int waiting_ = 0;
+	bool open_ = false;
+};
+
+
+TEST(ScalerExecutorTest, RejectFullQueue) {
+	ScalerExecutorOption option;
+	option.threads = 2;
+	option.queue = 3;
+	ScalerExecutor executor(option);
+	Gate gate;
+	std::atomic<int> done(0);
+	// occupy both workers
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(executor.Submit([&](bool) { gate.Wait(); ++done; }), 0);
+	}
+	gate.WaitFor(2);
+	for (int i = 0; i < 3; ++i) {
+		EXPECT_EQ(executor.Submit([&](bool) { ++done; }), 0);
+	}
+	// the queue is full
+	EXPECT_EQ(executor.Submit([&](bool) { ++done; }), -1);
+	ScalerExecutorMetrics metrics = executor.Metrics();
+	EXPECT_EQ(metrics.queued, 3u);
+	EXPECT_EQ(metrics.running, 2u);
+	EXPECT_EQ(metrics.rejected, 1u);
+
+	gate.Open();
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (done < 5 && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	EXPECT_EQ(done.load(), 5);
+	executor.Stop();
+	metrics = executor.Metrics();
+	EXPECT_EQ(metrics.submitted, 5u);
+	EXPECT_EQ(metrics.completed, 5u);
+	EXPECT_EQ(metrics.cancelled, 0u);
+	EXPECT_EQ(metrics.queued, 0u);
+}
+
+
+TEST(ScalerExecutorTest, NoQueue) {
+	ScalerExecutorOption option;
+	option.threads = 2;
+	option.queue = 0;
+	ScalerExecutor executor(option);
+	Gate gate;
+	std::atomic<int> done(0);
+	// idle workers take tasks without queue
+	for (int i = 0; i < 2; ++i) {
+		ASSERT_EQ(executor.Submit([&](bool) { gate.Wait(); ++done; }), 0);
+	}
+	EXPECT_EQ(executor.Submit([&](bool) { ++done; }), -1);
+	gate.WaitFor(2);
+	EXPECT_EQ(executor.Submit([&](bool) { ++done; }), -1);
+	EXPECT_EQ(executor.Metrics().rejected, 2u);
+
+	gate.Open();
+	executor.Stop();
+	EXPECT_EQ(done.load(), 2);
+	ScalerExecutorMetrics metrics = executor.Metrics();
+	EXPECT_EQ(metrics.completed, 2u);
+	EXPECT_EQ(metrics.cancelled, 0u);
+}
+
+
+TEST(ScalerExecutorTest, Cancel) {
+	ScalerExecutorOption option;
+	option.threads = 1;
+	ScalerExecutor executor(option);
+	Gate gate;
+	ASSERT_EQ(executor.Submit([&](bool) { gate.Wait(); }), 0);
+	gate.WaitFor(1);
+
+	// the client goes away while the task is waiting
+	std::atomic<bool> client_cancelled(false);
+	std::atomic<int> result(-1);
+	ASSERT_EQ(executor.Submit(
+		[&](bool cancelled) { result = cancelled ? 1 : 0; },
+		[&]() { return client_cancelled.load(); }
+	), 0);
+	client_cancelled = true;
+	gate.Open();
+	executor.Stop();
+	EXPECT_EQ(result.load(), 1);
+	EXPECT_EQ(executor.Metrics().cancelled, 1u);
+}
+
+
+TEST(ScalerExecutorTest, StopCallsQueuedTasks) {
+	ScalerExecutorOption option;
+	option.threads = 1;
+	option.queue = 1000;
+	ScalerExecutor executor(option);
+	Gate gate;
+	ASSERT_EQ(executor.Submit([&](bool) { gate.Wait(); }), 0);
+	gate.WaitFor(1);
+	std::atomic<int> cancelled_tasks(0);
+	for (int i = 0; i < 4; ++i) {
+		ASSERT_EQ(executor.Submit([&](bool cancelled) {
+			if (cancelled) ++cancelled_tasks;
+		}), 0);
+	}
+	std::thread stopper([&]() { executor.Stop(); });
+	// stopped executor rejects new tasks
+	while (executor.Submit([](bool) {}) == 0) {
+		std::this_thread::yield();
+	}
+	gate.Open();
+	stopper.join();
+	// every accepted task is called once
+	EXPECT_EQ(cancelled_tasks.load(), 4);
+	ScalerExecutorMetrics metrics = executor.Metrics();
+	EXPECT_EQ(metrics.completed, metrics.submitted);
+}
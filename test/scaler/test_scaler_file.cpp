@@ -0,0 +1,213 @@
+#include "scaler/scaler_file.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+TEST(ScalerFileTest, FileName) {
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = 7;
+	EXPECT_EQ(ScalerFileName("data/", "", &date), "data/20230307.bin");
+	EXPECT_EQ(ScalerFileName("data/", "dev", &date), "data/20230307-dev.bin");
+	EXPECT_EQ(DateKey(&date), 20230307);
+
+	date.tm_hour = 1;
+	date.tm_min = 2;
+	date.tm_sec = 3;
+	EXPECT_EQ(DaySecond(&date), 3723u);
+}
+
+
+TEST(ScalerFileTest, CreateReadWrite) {
+	const std::string name = kTestDataDir + "scaler-file-test.bin";
+	remove(name.c_str());
+
+	ScalerFile file;
+	// not exists
+	EXPECT_EQ(file.Open(name, false, false), -2);
+	EXPECT_EQ(file.Open(name, true, false), -2);
+	// create
+	ASSERT_EQ(file.Open(name, true, true), 0);
+	ASSERT_TRUE(file.IsOpen());
+	ASSERT_TRUE(file.Writable());
+	// unwritten rows read as zero
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(file.Row(0)[i], 0u);
+		EXPECT_EQ(file.Row(kDaySeconds-1)[i], 0u);
+	}
+	// write
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		file.MutableRow(100)[i] = i + 1;
+		file.MutableRow(kDaySeconds-1)[i] = i * 2;
+	}
+	EXPECT_EQ(file.Sync(100, kDaySeconds-1, true), 0);
+	file.Close();
+	EXPECT_FALSE(file.IsOpen());
+
+	// read again
+	ASSERT_EQ(file.Open(name, false, false), 0);
+	EXPECT_FALSE(file.Writable());
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(file.Row(100)[i], i + 1);
+		EXPECT_EQ(file.Row(101)[i], 0u);
+		EXPECT_EQ(file.Row(kDaySeconds-1)[i], i * 2);
+	}
+	EXPECT_EQ(file.Sync(0, 0, true), -1);
+
+	// create existing file keeps the content
+	EXPECT_EQ(ScalerFile::Create(name), 0);
+	EXPECT_EQ(file.Row(100)[0], 1u);
+	file.Close();
+	remove(name.c_str());
+}
+
+
+TEST(ScalerFileTest, Allocated) {
+	const std::string name = kTestDataDir + "scaler-file-allocated.bin";
+	remove(name.c_str());
+
+	ASSERT_EQ(ScalerFile::Create(name), 0);
+	struct stat file_stat;
+	ASSERT_EQ(stat(name.c_str(), &file_stat), 0);
+	EXPECT_EQ(size_t(file_stat.st_size), kScalerFileSize);
+	// not sparse, every block is on disk
+	EXPECT_GE(size_t(file_stat.st_blocks) * 512, kScalerFileSize);
+
+	ScalerFile file;
+	ASSERT_EQ(file.Open(name, false, false), 0);
+	EXPECT_EQ(file.Row(kDaySeconds-1)[kMaxScalers-1], 0u);
+	file.Close();
+	remove(name.c_str());
+}
+
+
+TEST(ScalerFileTest, CreateFailure) {
+	const std::string name = kTestDataDir + "scaler-file-failure.bin";
+	const std::string temporary = name + ".tmp";
+	remove(name.c_str());
+	// stale temporary file of last failure
+	FILE *fp = fopen(temporary.c_str(), "w");
+	ASSERT_NE(fp, nullptr);
+	fclose(fp);
+
+	// extending beyond the limit fails like a full disk
+	rlimit limit;
+	ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &limit), 0);
+	rlimit small = limit;
+	small.rlim_cur = 4096;
+	signal(SIGXFSZ, SIG_IGN);
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &small), 0);
+	EXPECT_EQ(ScalerFile::Create(name), -1);
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+	signal(SIGXFSZ, SIG_DFL);
+	// nothing left to block the next creation
+	EXPECT_NE(access(name.c_str(), F_OK), 0);
+	EXPECT_NE(access(temporary.c_str(), F_OK), 0);
+
+	ScalerFile file;
+	ASSERT_EQ(file.Open(name, true, true), 0);
+	file.Close();
+	EXPECT_NE(access(temporary.c_str(), F_OK), 0);
+	remove(name.c_str());
+}
+
+
+TEST(ScalerFileTest, InvalidFile) {
+	const std::string name = kTestDataDir + "scaler-file-invalid.bin";
+	FILE *fp = fopen(name.c_str(), "w");
+	ASSERT_NE(fp, nullptr);
+	fputs("invalid", fp);
+	fclose(fp);
+
+	ScalerFile file;
+	EXPECT_EQ(file.Open(name, false, false), -1);
+	EXPECT_FALSE(file.IsOpen());
+	remove(name.c_str());
+}
+
+
+TEST(ScalerFileTest, ColumnMajor) {
+	const std::string name = kTestDataDir + "scaler-file-column.bin";
+	remove(name.c_str());
+
+	ScalerFile file;
+	ASSERT_EQ(file.Open(name, true, true, kScalerFileColumnMajor), 0);
+	EXPECT_EQ(file.Version(), kScalerFileColumnMajor);
+	uint32_t values[kMaxScalers];
+	// write the seconds around the block boundary
+	for (size_t second = kScalerBlockSeconds - 2; second < kScalerBlockSeconds + 2; ++second) {
+		for (size_t i = 0; i < kMaxScalers; ++i) values[i] = second * 100 + i;
+		file.WriteRow(second, values);
+	}
+	EXPECT_EQ(file.Sync(kScalerBlockSeconds - 2, kScalerBlockSeconds + 1, true), 0);
+	file.Close();
+
+	// existing file keeps its version
+	ASSERT_EQ(file.Open(name, false, false, kScalerFileRowMajor), 0);
+	EXPECT_EQ(file.Version(), kScalerFileColumnMajor);
+	file.ReadRow(kScalerBlockSeconds, values);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(values[i], kScalerBlockSeconds * 100 + i);
+	}
+	// values of one scaler are continuous in block
+	const uint32_t *column = file.Column(kScalerBlockSeconds - 2, 3);
+	EXPECT_EQ(column[0], (kScalerBlockSeconds - 2) * 100 + 3);
+	EXPECT_EQ(column[1], (kScalerBlockSeconds - 1) * 100 + 3);
+	column = file.Column(kScalerBlockSeconds, 3);
+	EXPECT_EQ(column[0], kScalerBlockSeconds * 100 + 3);
+	EXPECT_EQ(column[1], (kScalerBlockSeconds + 1) * 100 + 3);
+	EXPECT_EQ(column[2], 0u);
+	file.Close();
+	remove(name.c_str());
+}
+
+
+TEST(ScalerFileTest, Convert) {
+	const std::string name = kTestDataDir + "scaler-file-convert.bin";
+	remove(name.c_str());
+	EXPECT_EQ(ScalerFile::Convert(name, kScalerFileColumnMajor), -2);
+
+	ScalerFile file;
+	ASSERT_EQ(file.Open(name, true, true), 0);
+	for (size_t second = 0; second < kDaySeconds; second += 997) {
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			file.MutableRow(second)[i] = uint32_t(second * kMaxScalers + i);
+		}
+	}
+	file.Close();
+
+	// to column major and back
+	for (uint8_t version : {kScalerFileColumnMajor, kScalerFileRowMajor}) {
+		ASSERT_EQ(ScalerFile::Convert(name, version), 0);
+		ASSERT_EQ(file.Open(name, false, false), 0);
+		EXPECT_EQ(file.Version(), version);
+		uint32_t values[kMaxScalers];
+		for (size_t second = 0; second < kDaySeconds; second += 997) {
+			file.ReadRow(second, values);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				ASSERT_EQ(values[i], uint32_t(second * kMaxScalers + i));
+			}
+			file.ReadRow(second + 1, values);
+			ASSERT_EQ(values[0], 0u);
+		}
+		file.Close();
+	}
+	remove(name.c_str());
+}
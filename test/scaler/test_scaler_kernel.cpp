@@ -0,0 +1,99 @@
+#include "scaler/scaler_kernel.h"
+
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+const size_t kTestRows = 1000;
+
+
+// random rows with values near the limits
+std::vector<uint32_t> RandomRows(size_t rows) {
+	std::mt19937 engine(20230307);
+	std::uniform_int_distribution<uint32_t> distribution;
+	std::vector<uint32_t> result(rows * kMaxScalers + 1);
+	for (size_t i = 0; i < result.size(); ++i) {
+		result[i] = distribution(engine);
+		if (i % 7 == 0) result[i] |= 0x80000000u;
+		if (i % 11 == 0) result[i] = 0;
+		if (i % 13 == 0) result[i] = 0xffffffffu;
+	}
+	return result;
+}
+
+
+TEST(ScalerKernelTest, SumRows) {
+	std::vector<uint32_t> rows = RandomRows(kTestRows);
+	// unaligned rows starts from the second value
+	for (size_t offset = 0; offset < 2; ++offset) {
+		for (size_t count : {size_t(0), size_t(1), size_t(3), kTestRows}) {
+			uint64_t sums[kMaxScalers];
+			uint64_t expected[kMaxScalers];
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				sums[i] = expected[i] = i;
+			}
+			SumRows(rows.data() + offset, count, sums);
+			SumRowsScalar(rows.data() + offset, count, expected);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				EXPECT_EQ(sums[i], expected[i]) << "scaler " << i << ", count " << count;
+			}
+		}
+	}
+}
+
+
+TEST(ScalerKernelTest, ReduceRows) {
+	std::vector<uint32_t> rows = RandomRows(kTestRows);
+	for (size_t offset = 0; offset < 2; ++offset) {
+		ScalerReduction reduction;
+		ScalerReduction expected;
+		// reduce in two parts to check accumulating
+		ReduceRows(rows.data() + offset, 5, reduction);
+		ReduceRows(rows.data() + offset + 5*kMaxScalers, kTestRows - 5, reduction);
+		ReduceRowsScalar(rows.data() + offset, kTestRows, expected);
+		EXPECT_EQ(reduction.count, kTestRows);
+		EXPECT_EQ(expected.count, kTestRows);
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			EXPECT_EQ(reduction.sum[i], expected.sum[i]);
+			EXPECT_EQ(reduction.min[i], expected.min[i]);
+			EXPECT_EQ(reduction.max[i], expected.max[i]);
+			EXPECT_EQ(reduction.last[i], expected.last[i]);
+		}
+	}
+}
+
+
+TEST(ScalerKernelTest, ReduceEmpty) {
+	ScalerReduction reduction;
+	uint32_t row[kMaxScalers] = {0};
+	ReduceRows(row, 0, reduction);
+	EXPECT_EQ(reduction.count, 0u);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(reduction.sum[i], 0u);
+		EXPECT_EQ(reduction.min[i], 0xffffffffu);
+		EXPECT_EQ(reduction.max[i], 0u);
+	}
+}
+
+
+TEST(ScalerKernelTest, ReduceColumn) {
+	std::vector<uint32_t> values = RandomRows(1);
+	for (size_t offset = 0; offset < 2; ++offset) {
+		for (size_t count : {size_t(1), size_t(3), size_t(4), size_t(29)}) {
+			ScalerReduction reduction;
+			ScalerReduction expected;
+			ReduceColumn(values.data() + offset, count, 7, reduction);
+			ReduceColumnScalar(values.data() + offset, count, 7, expected);
+			EXPECT_EQ(reduction.sum[7], expected.sum[7]);
+			EXPECT_EQ(reduction.min[7], expected.min[7]);
+			EXPECT_EQ(reduction.max[7], expected.max[7]);
+			EXPECT_EQ(reduction.last[7], values[offset + count - 1]);
+			// other scalers unchanged
+			EXPECT_EQ(reduction.sum[6], 0u);
+			EXPECT_EQ(reduction.count, 0u);
+		}
+	}
+}
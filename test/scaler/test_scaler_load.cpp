@@ -0,0 +1,143 @@
+#include "scaler/scaler_load.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+
+TEST(ScalerLoadTest, ParseModel) {
+	LoadModel model;
+	ASSERT_EQ(ParseLoadModel("burst:rate=100,peak=5000,period=30", model), 0);
+	EXPECT_EQ(model.kind, kBurstLoad);
+	EXPECT_DOUBLE_EQ(model.rate, 100.0);
+	EXPECT_DOUBLE_EQ(model.peak, 5000.0);
+	EXPECT_EQ(model.period, 30u);
+	EXPECT_EQ(model.length, 5u);
+	ASSERT_EQ(ParseLoadModel("constant", model), 0);
+	EXPECT_EQ(model.kind, kConstantLoad);
+	EXPECT_DOUBLE_EQ(model.rate, 1000.0);
+
+	// invalid texts keep the model
+	EXPECT_EQ(ParseLoadModel("square:rate=1", model), -1);
+	EXPECT_EQ(ParseLoadModel("ramp:rate", model), -1);
+	EXPECT_EQ(ParseLoadModel("ramp:speed=1", model), -1);
+	EXPECT_EQ(ParseLoadModel("ramp:rate=-1", model), -1);
+	EXPECT_EQ(ParseLoadModel("ramp:period=0", model), -1);
+	EXPECT_EQ(model.kind, kConstantLoad);
+}
+
+
+TEST(ScalerLoadTest, Models) {
+	ScalerLoadOption option;
+	option.start = 1000;
+	option.seed = 7;
+	const char *texts[5] = {
+		"constant:rate=123",
+		"poisson:rate=400",
+		"burst:rate=10,peak=100000,period=10,length=2",
+		"ramp:rate=0,peak=1000,period=10",
+		"dropout:rate=100000,period=10,length=3"
+	};
+	for (const char *text : texts) {
+		LoadModel model;
+		ASSERT_EQ(ParseLoadModel(text, model), 0) << text;
+		option.models.push_back(model);
+	}
+	ScalerLoad load(option, [](time_t, const uint32_t*) {});
+
+	uint32_t values[kMaxScalers];
+	for (time_t second = 1000; second < 1020; ++second) {
+		load.Generate(second, values);
+		const int phase = int(second - 1000) % 10;
+		// channels repeat the five models
+		EXPECT_EQ(values[0], 123u);
+		EXPECT_EQ(values[5], 123u);
+		EXPECT_NEAR(values[1], 400.0, 6.0 * std::sqrt(400.0));
+		if (phase < 2) {
+			EXPECT_GT(values[2], 90000u) << second;
+		} else {
+			EXPECT_LT(values[2], 100u) << second;
+		}
+		const double ramp = 100.0 * phase;
+		EXPECT_NEAR(values[3], ramp, 6.0 * std::sqrt(ramp) + 1.0) << second;
+		if (phase < 3) {
+			EXPECT_EQ(values[4], 0u) << second;
+		} else {
+			EXPECT_GT(values[4], 90000u) << second;
+		}
+	}
+}
+
+
+TEST(ScalerLoadTest, VirtualSeconds) {
+	std::mutex mutex;
+	std::vector<time_t> seconds;
+	ScalerLoadOption option;
+	option.rate = 2000.0;
+	option.start = 5000;
+	ScalerLoad load(option, [&](time_t second, const uint32_t*) {
+		std::lock_guard<std::mutex> lock(mutex);
+		seconds.push_back(second);
+	});
+	ASSERT_EQ(load.Start(), 0);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		load.Metrics().samples < 200
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	load.Stop();
+
+	ScalerLoadMetrics metrics = load.Metrics();
+	EXPECT_GE(metrics.samples, 200u);
+	std::lock_guard<std::mutex> lock(mutex);
+	ASSERT_EQ(seconds.size(), metrics.samples);
+	// one virtual second after another, without gaps
+	for (size_t i = 0; i < seconds.size(); ++i) {
+		EXPECT_EQ(seconds[i], time_t(5000 + i));
+	}
+	// stopped
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	EXPECT_EQ(load.Metrics().samples, metrics.samples);
+
+	// the rate must be positive
+	option.rate = 0.0;
+	ScalerLoad invalid(option, [](time_t, const uint32_t*) {});
+	EXPECT_EQ(invalid.Start(), -1);
+}
+
+
+TEST(ScalerLoadTest, Late) {
+	ScalerLoadOption option;
+	option.rate = 100.0;
+	option.start = 5000;
+	// the sample after a slow one starts more than one interval late
+	ScalerLoad load(option, [](time_t second, const uint32_t*) {
+		if (second == 5005) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(25));
+		}
+	});
+	ASSERT_EQ(load.Start(), 0);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		load.Metrics().samples < 20
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	load.Stop();
+
+	// samples woken a little after deadline are not late
+	ScalerLoadMetrics metrics = load.Metrics();
+	EXPECT_GE(metrics.late, 1u);
+	EXPECT_LT(metrics.late, metrics.samples / 2);
+	EXPECT_GE(metrics.max_lateness_us, 10000u);
+}
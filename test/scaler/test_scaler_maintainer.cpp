@@ -0,0 +1,182 @@
+#include "scaler/scaler_maintainer.h"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "scaler/scaler_storage.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+/// @brief get c style date of day in March 2023
+tm MarchDay(int day, int hour = 0) {
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = day;
+	date.tm_hour = hour;
+	date.tm_isdst = -1;
+	mktime(&date);
+	return date;
+}
+
+
+/// @brief check whether the file exists
+bool Exists(const std::string &name) {
+	return access(name.c_str(), F_OK) == 0;
+}
+
+
+/// @brief create day file and rollup of days in March 2023, remove others
+void CreateDays(const std::string &device, int first, int last) {
+	for (int i = 1; i <= 31; ++i) {
+		tm date = MarchDay(i);
+		std::string name = ScalerFileName(kTestDataDir, device, &date);
+		std::string rollup_name = ScalerRollupFileName(kTestDataDir, device, &date);
+		remove(name.c_str());
+		remove(rollup_name.c_str());
+		remove(ScalerArchiveFileName(kTestDataDir, device, &date).c_str());
+		remove(ScalerPrefixFileName(kTestDataDir, device, &date).c_str());
+		if (i < first || i > last) continue;
+
+		ScalerFile day;
+		ASSERT_EQ(day.Open(name, true, true), 0);
+		for (size_t second = 0; second < kDaySeconds; second += 7) {
+			for (size_t j = 0; j < kMaxScalers; ++j) {
+				day.MutableRow(second)[j] = uint32_t(i * 100 + j);
+			}
+		}
+		ScalerRollup rollup;
+		ASSERT_EQ(rollup.Open(rollup_name, &day, true), 0);
+	}
+}
+
+
+TEST(ScalerMaintainerTest, RetentionAndArchive) {
+	const std::string device = "maintainer";
+	CreateDays(device, 1, 10);
+
+	ScalerMaintainerOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.retention_days = 7;
+	option.archive_days = 3;
+	option.interval = 0;
+	option.io_rate = 200 * 1024 * 1024;
+	ScalerMaintainer maintainer(option);
+	tm now = MarchDay(10, 12);
+	ASSERT_EQ(maintainer.RunOnce(mktime(&now)), 0);
+
+	for (int i = 1; i <= 10; ++i) {
+		tm date = MarchDay(i);
+		std::string name = ScalerFileName(kTestDataDir, device, &date);
+		std::string archive_name =
+			ScalerArchiveFileName(kTestDataDir, device, &date);
+		// rollups are always kept
+		EXPECT_TRUE(Exists(ScalerRollupFileName(kTestDataDir, device, &date)));
+		EXPECT_EQ(Exists(name), i >= 7) << "day " << i;
+		EXPECT_EQ(Exists(archive_name), i >= 3 && i < 7) << "day " << i;
+	}
+	ScalerMaintainerMetrics metrics = maintainer.Metrics();
+	EXPECT_EQ(metrics.passes, 1u);
+	EXPECT_EQ(metrics.dropped_days, 2u);
+	EXPECT_EQ(metrics.archived_files, 4u);
+	EXPECT_EQ(metrics.failures, 0u);
+	EXPECT_GT(metrics.freed_bytes, 0u);
+	EXPECT_GT(metrics.used_bytes, 0u);
+	// four day files take about 200 ms
+	EXPECT_GT(metrics.throttled_us, 0u);
+
+	// nothing to do in the next pass
+	ASSERT_EQ(maintainer.RunOnce(mktime(&now)), 0);
+	metrics = maintainer.Metrics();
+	EXPECT_EQ(metrics.passes, 2u);
+	EXPECT_EQ(metrics.dropped_days, 2u);
+	EXPECT_EQ(metrics.archived_files, 4u);
+
+	// read the archived and the dropped days
+	ScalerStorageOption storage_option;
+	storage_option.data_path = kTestDataDir;
+	storage_option.device_name = device;
+	storage_option.prepare_ahead = 0;
+	ScalerStorage storage(storage_option);
+	tm date = MarchDay(4);
+	uint64_t sums[kMaxScalers] = {};
+	ASSERT_EQ(storage.Sum(&date, 7, 5, sums), 0);
+	EXPECT_EQ(sums[3], 403u);
+	size_t rows = 0;
+	EXPECT_EQ(storage.Scan(&date, 0, 14, [&](const uint32_t*) { ++rows; }), 0);
+	EXPECT_EQ(rows, 14u);
+	// only whole buckets of rollup are kept
+	date = MarchDay(2);
+	for (size_t i = 0; i < kMaxScalers; ++i) sums[i] = 0;
+	ASSERT_EQ(storage.Sum(&date, 3600, 7200, sums), 0);
+	// multiples of 7 in [3600, 10800)
+	EXPECT_EQ(sums[5], 1028u * 205);
+	EXPECT_EQ(storage.Sum(&date, 3600, 7, sums), -2);
+	EXPECT_EQ(storage.Scan(&date, 0, 14, [](const uint32_t*) {}), -2);
+	ScalerReduction reduction;
+	EXPECT_EQ(storage.Reduce(&date, 0, 3600, reduction), -2);
+	CreateDays(device, 0, 0);
+}
+
+
+TEST(ScalerMaintainerTest, DiskBudget) {
+	const std::string device = "maintainer-budget";
+	CreateDays(device, 1, 5);
+
+	ScalerMaintainerOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.disk_budget = 1;
+	option.interval = 0;
+	ScalerMaintainer maintainer(option);
+	tm now = MarchDay(5, 1);
+	ASSERT_EQ(maintainer.RunOnce(mktime(&now)), 0);
+
+	// today and yesterday are never removed
+	for (int i = 1; i <= 5; ++i) {
+		tm date = MarchDay(i);
+		EXPECT_EQ(Exists(ScalerFileName(kTestDataDir, device, &date)), i >= 4);
+		EXPECT_EQ(
+			Exists(ScalerRollupFileName(kTestDataDir, device, &date)), i >= 4
+		);
+	}
+	ScalerMaintainerMetrics metrics = maintainer.Metrics();
+	EXPECT_EQ(metrics.budget_removed_files, 6u);
+	EXPECT_GT(metrics.used_bytes, option.disk_budget);
+	CreateDays(device, 0, 0);
+}
+
+
+TEST(ScalerMaintainerTest, StopWhileThrottled) {
+	const std::string device = "maintainer-stop";
+	CreateDays(device, 1, 5);
+
+	ScalerMaintainerOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.archive_days = 1;
+	option.io_rate = 1024 * 1024;
+	auto start = std::chrono::steady_clock::now();
+	{
+		ScalerMaintainer maintainer(option);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	// archiving all files takes about 40 seconds without stopping
+	EXPECT_LT(
+		std::chrono::steady_clock::now() - start, std::chrono::seconds(5)
+	);
+	CreateDays(device, 0, 0);
+}
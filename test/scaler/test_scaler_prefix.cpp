@@ -0,0 +1,107 @@
+#include "scaler/scaler_prefix.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+/// @brief check prefix sums with rows of day file
+void CheckPrefix(const ScalerPrefix &prefix, const ScalerFile &day) {
+	uint64_t expect[kMaxScalers] = {};
+	uint64_t sums[kMaxScalers];
+	uint32_t row[kMaxScalers];
+	for (size_t second = 0; second <= kDaySeconds; ++second) {
+		if (second % 997 == 0 || second == kDaySeconds) {
+			prefix.Before(second, sums);
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				ASSERT_EQ(sums[i], expect[i]) << "second " << second;
+			}
+		}
+		if (second == kDaySeconds) break;
+		day.ReadRow(second, row);
+		for (size_t i = 0; i < kMaxScalers; ++i) expect[i] += row[i];
+	}
+}
+
+
+TEST(ScalerPrefixTest, FileName) {
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = 7;
+	EXPECT_EQ(
+		ScalerPrefixFileName("data/", "dev", &date),
+		"data/20230307-dev.prefix"
+	);
+}
+
+
+TEST(ScalerPrefixTest, UpdateAndBuild) {
+	const std::string name = kTestDataDir + "scaler-prefix-test.bin";
+	const std::string prefix_name = kTestDataDir + "scaler-prefix-test.prefix";
+	remove(name.c_str());
+	remove(prefix_name.c_str());
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true), 0);
+	ScalerPrefix prefix;
+	// read only prefix not exists
+	EXPECT_EQ(prefix.Open(prefix_name, nullptr, false), -2);
+	ASSERT_EQ(prefix.Open(prefix_name, &day, true), 0);
+	ASSERT_TRUE(prefix.Valid());
+
+	// write forward with gaps, then rewrite some seconds
+	std::mt19937 engine(29);
+	std::uniform_int_distribution<uint32_t> distribution;
+	uint32_t old_row[kMaxScalers];
+	uint32_t values[kMaxScalers];
+	for (size_t second = 100; second < 50000; second += 1 + second % 3) {
+		for (size_t i = 0; i < kMaxScalers; ++i) values[i] = distribution(engine);
+		day.ReadRow(second, old_row);
+		prefix.Update(second, old_row, values);
+		day.WriteRow(second, values);
+	}
+	for (size_t second : {size_t(0), size_t(101), size_t(40000)}) {
+		for (size_t i = 0; i < kMaxScalers; ++i) values[i] = i;
+		day.ReadRow(second, old_row);
+		prefix.Update(second, old_row, values);
+		day.WriteRow(second, values);
+	}
+	CheckPrefix(prefix, day);
+	EXPECT_EQ(prefix.Sync(true), 0);
+	prefix.Close();
+
+	// pretend the writer stopped without closing
+	FILE *fp = fopen(prefix_name.c_str(), "r+b");
+	ASSERT_NE(fp, nullptr);
+	fseek(fp, 2, SEEK_SET);
+	fputc(1, fp);
+	fclose(fp);
+	day.MutableRow(60000)[3] = 7;
+
+	ASSERT_EQ(prefix.Open(prefix_name, nullptr, false), 0);
+	EXPECT_FALSE(prefix.Valid());
+	// rebuilt when opened for writing
+	ASSERT_EQ(prefix.Open(prefix_name, &day, true), 0);
+	CheckPrefix(prefix, day);
+	// continue writing after the rebuilt seconds
+	for (size_t i = 0; i < kMaxScalers; ++i) values[i] = 5;
+	day.ReadRow(70000, old_row);
+	prefix.Update(70000, old_row, values);
+	day.WriteRow(70000, values);
+	CheckPrefix(prefix, day);
+	prefix.Close();
+	day.Close();
+	remove(name.c_str());
+	remove(prefix_name.c_str());
+}
@@ -0,0 +1,158 @@
+#include "scaler/scaler_publisher.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+
+TEST(ScalerPublisherTest, FullAndDelta) {
+	ScalerPublisher publisher(8);
+	auto full = publisher.Subscribe(0x5, 1, false);
+	auto delta = publisher.Subscribe(0x5, 1, true);
+	EXPECT_EQ(publisher.Subscribers(), 2u);
+
+	uint32_t scalers[kMaxScalers] = {};
+	scalers[0] = 10;
+	scalers[2] = 20;
+	publisher.Publish(100, scalers);
+	scalers[2] = 21;
+	publisher.Publish(101, scalers);
+
+	ScalerUpdate update;
+	// full encoding always includes all subscribed scalers
+	ASSERT_TRUE(full->Pop(update));
+	EXPECT_EQ(update.time, 100);
+	EXPECT_EQ(update.mask, 0x5u);
+	ASSERT_EQ(update.size, 2u);
+	EXPECT_EQ(update.values[0], 10u);
+	EXPECT_EQ(update.values[1], 20u);
+	ASSERT_TRUE(full->Pop(update));
+	EXPECT_EQ(update.mask, 0x5u);
+	EXPECT_EQ(update.values[1], 21u);
+	EXPECT_FALSE(full->Pop(update));
+
+	// delta encoding starts with all, then only changed ones
+	ASSERT_TRUE(delta->Pop(update));
+	EXPECT_EQ(update.mask, 0x5u);
+	ASSERT_TRUE(delta->Pop(update));
+	EXPECT_EQ(update.time, 101);
+	EXPECT_EQ(update.mask, 0x4u);
+	ASSERT_EQ(update.size, 1u);
+	EXPECT_EQ(update.values[0], 21u);
+
+	publisher.Unsubscribe(full);
+	publisher.Unsubscribe(delta);
+	EXPECT_EQ(publisher.Subscribers(), 0u);
+}
+
+
+TEST(ScalerPublisherTest, Period) {
+	ScalerPublisher publisher;
+	auto subscription = publisher.Subscribe(0x1, 3, false);
+	uint32_t scalers[kMaxScalers] = {};
+	for (int t = 0; t < 7; ++t) publisher.Publish(t, scalers);
+
+	ScalerUpdate update;
+	ASSERT_TRUE(subscription->Pop(update));
+	EXPECT_EQ(update.time, 0);
+	ASSERT_TRUE(subscription->Pop(update));
+	EXPECT_EQ(update.time, 3);
+	ASSERT_TRUE(subscription->Pop(update));
+	EXPECT_EQ(update.time, 6);
+	EXPECT_FALSE(subscription->Pop(update));
+}
+
+
+TEST(ScalerPublisherTest, DropSlowSubscriber) {
+	ScalerPublisher publisher(2);
+	std::atomic<int> notified(0);
+	auto slow = publisher.Subscribe(0x3, 1, true, [&]() { ++notified; });
+	uint32_t scalers[kMaxScalers] = {};
+	for (int t = 0; t < 5; ++t) {
+		scalers[0] = t;
+		publisher.Publish(t, scalers);
+	}
+	EXPECT_EQ(notified, 2);
+	EXPECT_EQ(slow->Dropped(), 3u);
+	EXPECT_EQ(publisher.Dropped(), 3u);
+
+	ScalerUpdate update;
+	ASSERT_TRUE(slow->Pop(update));
+	ASSERT_TRUE(slow->Pop(update));
+	EXPECT_EQ(update.time, 1);
+	EXPECT_EQ(update.mask, 0x1u);
+
+	// the update after dropping includes all scalers
+	scalers[0] = 5;
+	publisher.Publish(5, scalers);
+	ASSERT_TRUE(slow->Pop(update));
+	EXPECT_EQ(update.mask, 0x3u);
+	EXPECT_EQ(update.dropped, 3u);
+	EXPECT_EQ(notified, 3);
+
+	// dropped updates are kept after unsubscribing
+	publisher.Unsubscribe(slow);
+	EXPECT_EQ(publisher.Dropped(), 3u);
+	publisher.Publish(6, scalers);
+	EXPECT_EQ(notified, 3);
+}
+
+
+// reads updates like the gRPC writer, which is notified before it gets the
+// subscription from Subscribe
+class NotifiedReader {
+public:
+	void Subscribe(ScalerPublisher &publisher) {
+		auto subscription = publisher.Subscribe(
+			0x1, 1, false, [this]() { ++notified_; Read(); }
+		);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			subscription_ = subscription;
+		}
+		Read();
+	}
+
+	void Read() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		// published before the subscription is set, read it later
+		if (!subscription_) return;
+		ScalerUpdate update;
+		while (subscription_->Pop(update)) ++read_;
+	}
+
+	std::shared_ptr<ScalerSubscription> subscription_;
+	std::mutex mutex_;
+	std::atomic<int> notified_{0};
+	int read_ = 0;
+};
+
+
+TEST(ScalerPublisherTest, PublishWhileSubscribing) {
+	ScalerPublisher publisher(1024);
+	std::atomic<bool> stop(false);
+	std::thread sampler([&]() {
+		uint32_t scalers[kMaxScalers] = {};
+		for (time_t t = 0; !stop; ++t) {
+			publisher.Publish(t, scalers);
+			std::this_thread::yield();
+		}
+	});
+	for (int i = 0; i < 200; ++i) {
+		NotifiedReader reader;
+		reader.Subscribe(publisher);
+		std::this_thread::yield();
+		publisher.Unsubscribe(reader.subscription_);
+		reader.Read();
+		// every notified update is read, also those before subscribed
+		EXPECT_EQ(reader.read_, reader.notified_.load());
+	}
+	stop = true;
+	sampler.join();
+	EXPECT_EQ(publisher.Subscribers(), 0u);
+}
@@ -0,0 +1,245 @@
+#include "scaler/scaler_query.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+class ScalerQueryTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		tm date = {};
+		date.tm_year = 2023 - 1900;
+		date.tm_mon = 2;
+		date.tm_mday = 16;
+		date.tm_isdst = -1;
+		midnight_ = mktime(&date);
+		RemoveFiles(midnight_ - 1);
+		RemoveFiles(midnight_);
+
+		ScalerStorageOption option;
+		option.data_path = kTestDataDir;
+		option.device_name = "query";
+		option.prepare_ahead = 0;
+		storage_ = std::make_unique<ScalerStorage>(option);
+		// two hours across midnight, scaler 1 is the second from start
+		uint32_t scalers[kMaxScalers] = {};
+		for (time_t t = midnight_ - 3600; t < midnight_ + 3600; ++t) {
+			scalers[1] = uint32_t(t - midnight_ + 3600);
+			scalers[2] = 5;
+			ASSERT_EQ(storage_->Write(t, scalers), 0);
+		}
+	}
+
+	void TearDown() override {
+		storage_.reset();
+		RemoveFiles(midnight_ - 1);
+		RemoveFiles(midnight_);
+	}
+
+	void RemoveFiles(time_t time) {
+		tm date;
+		localtime_r(&time, &date);
+		remove(ScalerFileName(kTestDataDir, "query", &date).c_str());
+		remove(ScalerRollupFileName(kTestDataDir, "query", &date).c_str());
+	}
+
+	time_t midnight_;
+	std::unique_ptr<ScalerStorage> storage_;
+};
+
+
+TEST_F(ScalerQueryTest, AcrossDays) {
+	for (int step : {10, 600}) {
+		ScalerQueryOption option;
+		option.start_time = midnight_ - 1800;
+		option.end_time = midnight_ + 1800;
+		option.step = step;
+		option.flag = 0x6;
+		option.aggregations = {
+			kAggregateMean, kAggregateMin, kAggregateMax,
+			kAggregateSum, kAggregateLast
+		};
+		std::vector<ScalerQuerySeries> series;
+		ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+		ASSERT_EQ(series.size(), 10u);
+		const size_t buckets = 3600 / step;
+		for (const auto &s : series) ASSERT_EQ(s.values.size(), buckets);
+
+		// scaler 1
+		EXPECT_EQ(series[0].index, 1);
+		for (size_t b = 0; b < buckets; ++b) {
+			double first = 1800.0 + b * step;
+			double last = first + step - 1;
+			EXPECT_DOUBLE_EQ(series[0].values[b], (first + last) / 2.0);
+			EXPECT_DOUBLE_EQ(series[1].values[b], first);
+			EXPECT_DOUBLE_EQ(series[2].values[b], last);
+			EXPECT_DOUBLE_EQ(series[3].values[b], (first + last) * step / 2.0);
+			EXPECT_DOUBLE_EQ(series[4].values[b], last);
+		}
+		// scaler 2
+		EXPECT_EQ(series[5].index, 2);
+		EXPECT_EQ(series[5].aggregation, kAggregateMean);
+		EXPECT_DOUBLE_EQ(series[5].values[0], 5.0);
+		EXPECT_DOUBLE_EQ(series[8].values[buckets-1], 5.0 * step);
+	}
+}
+
+
+TEST_F(ScalerQueryTest, PartialAndMissing) {
+	ScalerQueryOption option;
+	// the day before is missing, and the last bucket is shorter
+	option.start_time = midnight_ - kDaySeconds;
+	option.end_time = midnight_ + 100;
+	option.step = 3600;
+	option.flag = 0x2;
+	option.aggregations = {kAggregateMean, kAggregateSum};
+	std::vector<ScalerQuerySeries> series;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+	ASSERT_EQ(series.size(), 2u);
+	ASSERT_EQ(series[0].values.size(), 25u);
+	// written hour
+	EXPECT_DOUBLE_EQ(series[0].values[23], 1799.5);
+	// unwritten hours in existing file are zero
+	EXPECT_DOUBLE_EQ(series[0].values[0], 0.0);
+	// short bucket
+	EXPECT_DOUBLE_EQ(series[1].values[24], (3600.0 + 3699.0) * 100 / 2.0);
+
+	// missing file has no data
+	option.start_time = midnight_ - 2 * kDaySeconds;
+	option.end_time = midnight_ - kDaySeconds;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+	EXPECT_TRUE(std::isnan(series[0].values[0]));
+}
+
+
+TEST_F(ScalerQueryTest, NotWritten) {
+	ScalerQueryOption option;
+	// written until midnight_ + 3600
+	option.start_time = midnight_ + 3000;
+	option.end_time = midnight_ + 4800;
+	option.step = 600;
+	option.flag = 0x2;
+	option.aggregations = {kAggregateMean, kAggregateMin};
+	std::vector<ScalerQuerySeries> series;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+	ASSERT_EQ(series[0].values.size(), 3u);
+	EXPECT_DOUBLE_EQ(series[0].values[0], (6600.0 + 7199.0) / 2.0);
+	EXPECT_DOUBLE_EQ(series[1].values[0], 6600.0);
+	// future seconds are not zero counts
+	EXPECT_TRUE(std::isnan(series[0].values[1]));
+	EXPECT_TRUE(std::isnan(series[1].values[2]));
+}
+
+
+TEST_F(ScalerQueryTest, Executor) {
+	ScalerQueryOption option;
+	option.start_time = midnight_ - 3 * kDaySeconds;
+	option.end_time = midnight_ + 3600;
+	option.step = 600;
+	option.flag = 0x6;
+	option.aggregations = {kAggregateMean, kAggregateMax};
+	std::vector<ScalerQuerySeries> expected;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, expected), 0);
+
+	ScalerExecutor executor(ScalerExecutorOption{});
+	std::vector<ScalerQuerySeries> series;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series, &executor), 0);
+	ASSERT_EQ(series.size(), expected.size());
+	for (size_t i = 0; i < series.size(); ++i) {
+		ASSERT_EQ(series[i].values.size(), expected[i].values.size());
+		for (size_t b = 0; b < series[i].values.size(); ++b) {
+			if (std::isnan(expected[i].values[b])) {
+				EXPECT_TRUE(std::isnan(series[i].values[b]));
+			} else {
+				EXPECT_DOUBLE_EQ(series[i].values[b], expected[i].values[b]);
+			}
+		}
+	}
+
+	// helpers stop with the query
+	EXPECT_EQ(
+		QueryScalers(*storage_, option, []() { return true; }, series, &executor),
+		-3
+	);
+	executor.Stop();
+	ScalerExecutorMetrics metrics = executor.Metrics();
+	EXPECT_EQ(metrics.running, 0u);
+	EXPECT_EQ(metrics.queued, 0u);
+}
+
+
+TEST_F(ScalerQueryTest, Cancel) {
+	ScalerQueryOption option;
+	option.start_time = midnight_ - 10 * kDaySeconds;
+	option.end_time = midnight_ + 3600;
+	option.step = 60;
+	option.flag = 0x2;
+	option.aggregations = {kAggregateMax};
+	std::vector<ScalerQuerySeries> series;
+	EXPECT_EQ(QueryScalers(*storage_, option, []() { return true; }, series), -3);
+	EXPECT_TRUE(series.empty());
+}
+
+
+TEST_F(ScalerQueryTest, InvalidOption) {
+	ScalerQueryOption option;
+	option.start_time = midnight_;
+	option.end_time = midnight_ + 3600;
+	option.step = 60;
+	option.flag = 0x2;
+	std::vector<ScalerQuerySeries> series;
+	// no aggregation
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	option.aggregations = {ScalerAggregation(9)};
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	option.aggregations = {kAggregateMean};
+	option.step = 0;
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	option.step = 1;
+	option.end_time = option.start_time;
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	// too many points
+	option.flag = 0xffffffff;
+	option.end_time = option.start_time + kDaySeconds;
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	// aggregations count in points, 3 scalers of one day fit with one
+	option.flag = 0x7;
+	option.step = 1;
+	option.end_time = option.start_time + kDaySeconds;
+	option.aggregations = {
+		kAggregateMean, kAggregateMin, kAggregateMax, kAggregateSum,
+		kAggregateLast, kAggregateMean
+	};
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), -1);
+	option.aggregations = {kAggregateMean};
+	EXPECT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+}
+
+
+TEST_F(ScalerQueryTest, DuplicateAggregations) {
+	ScalerQueryOption option;
+	option.start_time = midnight_;
+	option.end_time = midnight_ + 3600;
+	option.step = 600;
+	option.flag = 0x2;
+	// repeated ones are queried once
+	option.aggregations.assign(10000, kAggregateMean);
+	option.aggregations.push_back(kAggregateSum);
+	option.aggregations.push_back(kAggregateMean);
+	std::vector<ScalerQuerySeries> series;
+	ASSERT_EQ(QueryScalers(*storage_, option, nullptr, series), 0);
+	ASSERT_EQ(series.size(), 2u);
+	EXPECT_EQ(series[0].aggregation, kAggregateMean);
+	EXPECT_EQ(series[1].aggregation, kAggregateSum);
+}
@@ -0,0 +1,138 @@
+#include "scaler/scaler_ring.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+TEST(ScalerRingTest, PushRead) {
+	ScalerRing ring;
+	uint32_t scalers[kMaxScalers];
+	uint32_t values[kMaxScalers];
+	for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = i + 1;
+	const time_t now = 1678000000;
+	ring.Push(now, scalers);
+
+	ASSERT_TRUE(ring.Read(now, values));
+	for (size_t i = 0; i < kMaxScalers; ++i) EXPECT_EQ(values[i], i + 1);
+	// not written
+	EXPECT_FALSE(ring.Read(now - 1, values));
+	for (size_t i = 0; i < kMaxScalers; ++i) EXPECT_EQ(values[i], 0u);
+	// the same slot one day later
+	EXPECT_FALSE(ring.Read(now + kDaySeconds, values));
+
+	// overwritten one day later
+	for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = 7;
+	ring.Push(now + kDaySeconds, scalers);
+	EXPECT_FALSE(ring.Read(now, values));
+	ASSERT_TRUE(ring.Read(now + kDaySeconds, values));
+	EXPECT_EQ(values[0], 7u);
+}
+
+
+TEST(ScalerRingTest, Sum) {
+	ScalerRing ring;
+	uint32_t scalers[kMaxScalers] = {};
+	const time_t now = 1678000000;
+	for (time_t t = now; t < now + 100; ++t) {
+		scalers[3] = uint32_t(t - now);
+		ring.Push(t, scalers);
+	}
+	uint64_t sums[kMaxScalers] = {};
+	// include 10 seconds not written
+	ring.Sum(now + 90, 20, sums);
+	EXPECT_EQ(sums[3], 90u + 91 + 92 + 93 + 94 + 95 + 96 + 97 + 98 + 99);
+	EXPECT_EQ(sums[0], 0u);
+}
+
+
+TEST(ScalerRingTest, ConcurrentReadWrite) {
+	ScalerRing ring;
+	const time_t start = 1678000000;
+	const int kWrites = 200000;
+	std::thread writer([&]() {
+		uint32_t values[kMaxScalers];
+		for (int t = 0; t < kWrites; ++t) {
+			for (size_t i = 0; i < kMaxScalers; ++i) values[i] = t;
+			ring.Push(start + t, values);
+		}
+	});
+
+	int torn = 0;
+	uint32_t values[kMaxScalers];
+	for (int n = 0; n < 200000; ++n) {
+		time_t time = start + n % kWrites;
+		if (!ring.Read(time, values)) continue;
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			if (values[i] != uint32_t(time - start)) ++torn;
+		}
+	}
+	writer.join();
+	EXPECT_EQ(torn, 0);
+}
+
+
+TEST(ScalerRingTest, Load) {
+	const std::string device = "ring-load";
+	// write the last hour of yesterday and first hour of today
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = 14;
+	date.tm_hour = 1;
+	date.tm_isdst = -1;
+	const time_t now = mktime(&date);
+	tm yesterday;
+	const time_t yesterday_time = now - 7200;
+	localtime_r(&yesterday_time, &yesterday);
+	remove(ScalerFileName(kTestDataDir, device, &date).c_str());
+	remove(ScalerRollupFileName(kTestDataDir, device, &date).c_str());
+	remove(ScalerFileName(kTestDataDir, device, &yesterday).c_str());
+	remove(ScalerRollupFileName(kTestDataDir, device, &yesterday).c_str());
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 0;
+	ScalerStorage storage(option);
+	uint32_t scalers[kMaxScalers] = {};
+	for (time_t t = now - 7200; t < now; ++t) {
+		scalers[0] = uint32_t(t - now + 7200);
+		ASSERT_EQ(storage.Write(t, scalers), 0);
+	}
+
+	ScalerRing ring;
+	EXPECT_EQ(ring.Load(storage, now), kDaySeconds - 1);
+	uint32_t values[kMaxScalers];
+	ASSERT_TRUE(ring.Read(now - 7200, values));
+	EXPECT_EQ(values[0], 0u);
+	ASSERT_TRUE(ring.Read(now - 1, values));
+	EXPECT_EQ(values[0], 7199u);
+	ASSERT_TRUE(ring.Read(now - 3600, values));
+	EXPECT_EQ(values[0], 3600u);
+	// unwritten rows in file
+	ASSERT_TRUE(ring.Read(now - kDaySeconds + 100, values));
+	EXPECT_EQ(values[0], 0u);
+	// out of range
+	EXPECT_FALSE(ring.Read(now, values));
+	EXPECT_FALSE(ring.Read(now - kDaySeconds, values));
+
+	// yesterday is missing
+	ScalerStorage today_storage(option);
+	remove(ScalerFileName(kTestDataDir, device, &yesterday).c_str());
+	ScalerRing today_ring;
+	EXPECT_EQ(today_ring.Load(today_storage, now), 3600u);
+	EXPECT_FALSE(today_ring.Read(now - 7200, values));
+	ASSERT_TRUE(today_ring.Read(now - 1, values));
+	EXPECT_EQ(values[0], 7199u);
+}
@@ -0,0 +1,160 @@
+#include "scaler/scaler_rollup.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+TEST(ScalerRollupTest, FileName) {
+	tm date = {};
+	date.tm_year = 2023 - 1900;
+	date.tm_mon = 2;
+	date.tm_mday = 7;
+	EXPECT_EQ(
+		ScalerRollupFileName("data/", "dev", &date),
+		"data/20230307-dev.rollup"
+	);
+}
+
+
+TEST(ScalerRollupTest, UpdateAndBuild) {
+	const std::string name = kTestDataDir + "scaler-rollup-test.bin";
+	const std::string rollup_name = kTestDataDir + "scaler-rollup-test.rollup";
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true), 0);
+	ScalerRollup rollup;
+	// read only rollup not exists
+	EXPECT_EQ(rollup.Open(rollup_name, nullptr, false), -2);
+	ASSERT_EQ(rollup.Open(rollup_name, &day, true), 0);
+	ASSERT_TRUE(rollup.Valid());
+
+	// write some rows and update rollup
+	std::mt19937 engine(7);
+	std::uniform_int_distribution<uint32_t> distribution(0, 1u << 20);
+	std::uniform_int_distribution<size_t> second_distribution(0, kDaySeconds-1);
+	uint32_t values[kMaxScalers];
+	for (int n = 0; n < 2000; ++n) {
+		size_t second = second_distribution(engine);
+		for (size_t i = 0; i < kMaxScalers; ++i) values[i] = distribution(engine);
+		rollup.Update(second, day.Row(second), values);
+		for (size_t i = 0; i < kMaxScalers; ++i) day.MutableRow(second)[i] = values[i];
+	}
+
+	// check with sums from rows
+	for (size_t tier = 0; tier < kRollupTiers; ++tier) {
+		const size_t width = kRollupTierSeconds[tier];
+		for (size_t bucket = 0; bucket < kDaySeconds / width; ++bucket) {
+			uint64_t sums[kMaxScalers] = {};
+			for (size_t second = bucket*width; second < (bucket+1)*width; ++second) {
+				for (size_t i = 0; i < kMaxScalers; ++i) sums[i] += day.Row(second)[i];
+			}
+			for (size_t i = 0; i < kMaxScalers; ++i) {
+				ASSERT_EQ(rollup.Bucket(tier, bucket)[i], sums[i])
+					<< "tier " << tier << ", bucket " << bucket << ", scaler " << i;
+			}
+		}
+	}
+
+	// rebuild gets the same sums
+	uint64_t daily[kMaxScalers];
+	for (size_t i = 0; i < kMaxScalers; ++i) daily[i] = rollup.Bucket(kRollupTiers-1, 0)[i];
+	ASSERT_EQ(rollup.Build(day), 0);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(rollup.Bucket(kRollupTiers-1, 0)[i], daily[i]);
+	}
+
+	// closed rollup is clean
+	rollup.Close();
+	ASSERT_EQ(rollup.Open(rollup_name, nullptr, false), 0);
+	EXPECT_TRUE(rollup.Valid());
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(rollup.Bucket(kRollupTiers-1, 0)[i], daily[i]);
+	}
+	rollup.Close();
+	day.Close();
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+}
+
+
+TEST(ScalerRollupTest, RebuildMissingAndDirty) {
+	const std::string name = kTestDataDir + "scaler-rollup-dirty.bin";
+	const std::string rollup_name = kTestDataDir + "scaler-rollup-dirty.rollup";
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true), 0);
+	for (size_t second = 0; second < kDaySeconds; second += 100) {
+		day.MutableRow(second)[0] = 3;
+	}
+
+	// rollup created for existing day file is built from it
+	{
+		ScalerRollup rollup;
+		ASSERT_EQ(rollup.Open(rollup_name, &day, true), 0);
+		EXPECT_EQ(rollup.Bucket(kRollupTiers-1, 0)[0], 3u * 864);
+		EXPECT_EQ(rollup.Bucket(0, 10)[0], 3u);
+		EXPECT_EQ(rollup.Bucket(0, 11)[0], 0u);
+	}
+
+	// pretend the writer stopped without closing
+	day.MutableRow(1)[0] = 1000;
+	FILE *fp = fopen(rollup_name.c_str(), "r+b");
+	ASSERT_NE(fp, nullptr);
+	fseek(fp, 3, SEEK_SET);
+	fputc(1, fp);
+	fclose(fp);
+
+	ScalerRollup rollup;
+	ASSERT_EQ(rollup.Open(rollup_name, nullptr, false), 0);
+	EXPECT_FALSE(rollup.Valid());
+	ASSERT_EQ(rollup.Open(rollup_name, &day, true), 0);
+	EXPECT_TRUE(rollup.Valid());
+	EXPECT_EQ(rollup.Bucket(kRollupTiers-1, 0)[0], 3u * 864 + 1000);
+	rollup.Close();
+	day.Close();
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+}
+
+
+TEST(ScalerRollupTest, BuildColumnMajor) {
+	const std::string name = kTestDataDir + "scaler-rollup-column.bin";
+	const std::string rollup_name = kTestDataDir + "scaler-rollup-column.rollup";
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, true, true, kScalerFileColumnMajor), 0);
+	uint32_t values[kMaxScalers];
+	for (size_t second = 0; second < kDaySeconds; second += 100) {
+		for (size_t i = 0; i < kMaxScalers; ++i) values[i] = i;
+		day.WriteRow(second, values);
+	}
+
+	ScalerRollup rollup;
+	ASSERT_EQ(rollup.Open(rollup_name, &day, true), 0);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(rollup.Bucket(kRollupTiers-1, 0)[i], i * 864);
+		EXPECT_EQ(rollup.Bucket(0, 10)[i], i);
+		EXPECT_EQ(rollup.Bucket(0, 11)[i], 0u);
+	}
+	rollup.Close();
+	day.Close();
+	remove(name.c_str());
+	remove(rollup_name.c_str());
+}
@@ -0,0 +1,149 @@
+#include "scaler/scaler_sampler.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace ecl;
+
+
+TEST(ScalerSamplerTest, SecondBoundaries) {
+	std::mutex mutex;
+	std::vector<time_t> seconds;
+	std::atomic<int> wrong_time(0);
+	ScalerSampler sampler(ScalerSamplerOption(), [&](time_t second) {
+		// called after the second boundary
+		timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+		if (now.tv_sec < second) ++wrong_time;
+		std::lock_guard<std::mutex> lock(mutex);
+		seconds.push_back(second);
+		// the first sample takes more than two seconds
+		if (seconds.size() == 1) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(2200));
+		}
+	});
+	ASSERT_EQ(sampler.Start(), 0);
+	for (int i = 0; i < 60; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::lock_guard<std::mutex> lock(mutex);
+		if (seconds.size() >= 3) break;
+	}
+	auto start = std::chrono::steady_clock::now();
+	sampler.Stop();
+	// stop without waiting for the next second
+	EXPECT_LT(
+		std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500)
+	);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	ASSERT_GE(seconds.size(), 3u);
+	EXPECT_EQ(wrong_time, 0);
+	// one second is missed after the slow sample
+	EXPECT_EQ(seconds[1], seconds[0] + 2);
+	EXPECT_EQ(seconds[2], seconds[1] + 1);
+
+	ScalerSamplerMetrics metrics = sampler.Metrics();
+	EXPECT_EQ(metrics.samples, seconds.size());
+	EXPECT_EQ(metrics.missed, 1u);
+	uint64_t histogram = 0;
+	for (size_t i = 0; i <= kLatenessBounds; ++i) histogram += metrics.lateness[i];
+	EXPECT_EQ(histogram, metrics.samples);
+	// the sample after the slow one is late
+	EXPECT_GT(metrics.max_lateness_us, 100000u);
+	EXPECT_GT(metrics.lateness[kLatenessBounds], 0u);
+}
+
+
+/// @brief read the value written by sampler to enable interrupt
+/// @returns value written, 0 if nothing written in one second
+uint32_t ReadEnable(int device) {
+	pollfd fd;
+	fd.fd = device;
+	fd.events = POLLIN;
+	if (poll(&fd, 1, 1000) != 1) return 0;
+	uint32_t value = 0;
+	if (read(device, &value, sizeof(value)) != sizeof(value)) return 0;
+	return value;
+}
+
+
+/// @brief raise interrupt with total count
+void Interrupt(int device, uint32_t count) {
+	ASSERT_EQ(write(device, &count, sizeof(count)), ssize_t(sizeof(count)));
+}
+
+
+TEST(ScalerSamplerTest, Interrupt) {
+	// socket pair plays the UIO device in both directions
+	int fds[2];
+	ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+	const int device = fds[0];
+	std::mutex mutex;
+	std::vector<time_t> seconds;
+	ScalerSamplerOption option;
+	option.irq_fd = fds[1];
+	option.irq_timeout = 300;
+	ScalerSampler sampler(option, [&](time_t second) {
+		std::lock_guard<std::mutex> lock(mutex);
+		seconds.push_back(second);
+	});
+	ASSERT_EQ(sampler.Start(), 0);
+	EXPECT_EQ(ReadEnable(device), 1u);
+
+	// sample on every interrupt, and enable it again
+	Interrupt(device, 10);
+	EXPECT_EQ(ReadEnable(device), 1u);
+	Interrupt(device, 11);
+	EXPECT_EQ(ReadEnable(device), 1u);
+	// one interrupt missed
+	Interrupt(device, 13);
+	EXPECT_EQ(ReadEnable(device), 1u);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ASSERT_EQ(seconds.size(), 3u);
+		EXPECT_EQ(seconds[1], seconds[0] + 1);
+		EXPECT_GT(seconds[2], seconds[1]);
+	}
+	ScalerSamplerMetrics metrics = sampler.Metrics();
+	EXPECT_EQ(metrics.irq_samples, 3u);
+	EXPECT_EQ(metrics.samples, 3u);
+	EXPECT_EQ(metrics.missed, 1u);
+	EXPECT_EQ(metrics.irq_fallbacks, 0u);
+
+	// no more interrupts, fall back to timer
+	for (int i = 0; i < 30; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		if (sampler.Metrics().samples > 3) break;
+	}
+	metrics = sampler.Metrics();
+	EXPECT_EQ(metrics.irq_fallbacks, 1u);
+	EXPECT_EQ(metrics.irq_samples, 3u);
+	EXPECT_GT(metrics.samples, 3u);
+	sampler.Stop();
+	close(fds[0]);
+	close(fds[1]);
+}
+
+
+TEST(ScalerSamplerTest, NoInterruptControl) {
+	// interrupt could not be enabled on read only end of pipe
+	int fds[2];
+	ASSERT_EQ(pipe(fds), 0);
+	ScalerSamplerOption option;
+	option.irq_fd = fds[0];
+	ScalerSampler sampler(option, [](time_t) {});
+	ASSERT_EQ(sampler.Start(), 0);
+	EXPECT_EQ(sampler.Metrics().irq_fallbacks, 1u);
+	sampler.Stop();
+	close(fds[0]);
+	close(fds[1]);
+}
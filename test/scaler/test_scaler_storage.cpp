@@ -0,0 +1,552 @@
+#include "scaler/scaler_storage.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csignal>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#ifndef TEST_DATA_DIRECTORY
+#define TEST_DATA_DIRECTORY ""
+#endif
+
+using namespace ecl;
+
+const std::string kTestDataDir = TEST_DATA_DIRECTORY;
+
+
+/// @brief get local time of specific date and second
+time_t LocalTime(int year, int month, int day, int second) {
+	tm date = {};
+	date.tm_year = year - 1900;
+	date.tm_mon = month - 1;
+	date.tm_mday = day;
+	date.tm_sec = second;
+	date.tm_isdst = -1;
+	return mktime(&date);
+}
+
+
+/// @brief remove the day file and rollup file
+void RemoveFile(const std::string &device, time_t time) {
+	tm date;
+	localtime_r(&time, &date);
+	remove(ScalerFileName(kTestDataDir, device, &date).c_str());
+	remove(ScalerRollupFileName(kTestDataDir, device, &date).c_str());
+}
+
+
+TEST(ScalerStorageTest, WriteScan) {
+	const std::string device = "storage-write-scan";
+	time_t start = LocalTime(2023, 3, 7, 86390);
+	RemoveFile(device, start);
+	RemoveFile(device, start+20);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.sync_interval = 3;
+	ScalerStorage storage(option);
+
+	// write across midnight
+	uint32_t scalers[kMaxScalers];
+	for (int t = 0; t < 20; ++t) {
+		for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = t * 100 + i;
+		ASSERT_EQ(storage.Write(start + t, scalers), 0);
+	}
+
+	// read the first day
+	tm date;
+	localtime_r(&start, &date);
+	std::vector<uint32_t> values;
+	ASSERT_EQ(storage.Scan(&date, 86385, 15, [&](const uint32_t *row) {
+		values.push_back(row[3]);
+	}), 0);
+	ASSERT_EQ(values.size(), 15u);
+	for (int i = 0; i < 5; ++i) EXPECT_EQ(values[i], 0u);
+	for (int i = 5; i < 15; ++i) EXPECT_EQ(values[i], uint32_t((i-5)*100+3));
+
+	// read the second day
+	time_t next = start + 10;
+	localtime_r(&next, &date);
+	values.clear();
+	ASSERT_EQ(storage.Scan(&date, 0, 11, [&](const uint32_t *row) {
+		values.push_back(row[0]);
+	}), 0);
+	ASSERT_EQ(values.size(), 11u);
+	for (int i = 0; i < 10; ++i) EXPECT_EQ(values[i], uint32_t((i+10)*100));
+	EXPECT_EQ(values[10], 0u);
+
+	// invalid range
+	EXPECT_EQ(storage.Scan(&date, 86400, 1, [](const uint32_t*) {}), -1);
+	// missing file
+	date.tm_year -= 10;
+	EXPECT_EQ(storage.Scan(&date, 0, 1, [](const uint32_t*) {}), -2);
+}
+
+
+TEST(ScalerStorageTest, Reopen) {
+	const std::string device = "storage-reopen";
+	time_t start = LocalTime(2023, 3, 8, 1000);
+	RemoveFile(device, start);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	{
+		ScalerStorage storage(option);
+		uint32_t scalers[kMaxScalers];
+		for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = i + 7;
+		ASSERT_EQ(storage.Write(start, scalers), 0);
+	}
+
+	ScalerStorage storage(option);
+	tm date;
+	localtime_r(&start, &date);
+	uint32_t sum = 0;
+	ASSERT_EQ(storage.Scan(&date, 1000, 1, [&](const uint32_t *row) {
+		sum += row[0] + row[kMaxScalers-1];
+	}), 0);
+	EXPECT_EQ(sum, 7u + kMaxScalers - 1 + 7u);
+}
+
+
+TEST(ScalerStorageTest, ConcurrentReadWrite) {
+	const std::string device = "storage-concurrent";
+	time_t start = LocalTime(2023, 3, 9, 0);
+	RemoveFile(device, start);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	ScalerStorage storage(option);
+	uint32_t scalers[kMaxScalers] = {};
+	ASSERT_EQ(storage.Write(start, scalers), 0);
+
+	const int kWrites = 20000;
+	std::thread writer([&]() {
+		uint32_t values[kMaxScalers];
+		for (int t = 1; t <= kWrites; ++t) {
+			for (size_t i = 0; i < kMaxScalers; ++i) values[i] = t;
+			storage.Write(start + t, values);
+		}
+	});
+
+	// every row read should be consistent
+	tm date;
+	localtime_r(&start, &date);
+	int torn = 0;
+	for (int n = 0; n < 2000; ++n) {
+		storage.Scan(&date, n * 10, 64, [&](const uint32_t *row) {
+			for (size_t i = 1; i < kMaxScalers; ++i) {
+				if (row[i] != row[0]) ++torn;
+			}
+		});
+	}
+	writer.join();
+	EXPECT_EQ(torn, 0);
+}
+
+
+TEST(ScalerStorageTest, ConcurrentOpen) {
+	const std::string device = "storage-concurrent-open";
+	const int kDays = 4;
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.cache_days = 1;
+	option.prepare_ahead = 0;
+	{
+		ScalerStorage storage(option);
+		uint32_t scalers[kMaxScalers] = {};
+		for (int day = 0; day < kDays; ++day) {
+			time_t time = LocalTime(2023, 3, 20 + day, 100);
+			RemoveFile(device, time);
+			scalers[0] = day + 1;
+			ASSERT_EQ(storage.Write(time, scalers), 0);
+		}
+	}
+
+	// past days are opened and evicted by readers while writing
+	ScalerStorage storage(option);
+	std::atomic<bool> stop(false);
+	std::thread writer([&]() {
+		uint32_t values[kMaxScalers] = {};
+		time_t time = LocalTime(2023, 3, 20 + kDays, 0);
+		time_t end = time + kDaySeconds;
+		while (!stop && time < end) storage.Write(time++, values);
+	});
+	std::atomic<int> wrong(0);
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; ++r) {
+		readers.emplace_back([&, r]() {
+			for (int n = 0; n < 200; ++n) {
+				int day = (n + r) % kDays;
+				time_t time = LocalTime(2023, 3, 20 + day, 100);
+				tm date;
+				localtime_r(&time, &date);
+				uint32_t value = 0;
+				int result = storage.Scan(&date, 100, 1, [&](const uint32_t *row) {
+					value = row[0];
+				});
+				if (result || value != uint32_t(day + 1)) ++wrong;
+			}
+		});
+	}
+	for (auto &reader : readers) reader.join();
+	stop = true;
+	writer.join();
+	EXPECT_EQ(wrong, 0);
+	for (int day = 0; day <= kDays; ++day) {
+		RemoveFile(device, LocalTime(2023, 3, 20 + day, 0));
+	}
+}
+
+
+TEST(ScalerStorageTest, PrepareNextDay) {
+	const std::string device = "storage-prepare";
+	time_t start = LocalTime(2023, 3, 10, 86000);
+	time_t next = LocalTime(2023, 3, 11, 0);
+	RemoveFile(device, start);
+	RemoveFile(device, next);
+	tm next_date;
+	localtime_r(&next, &next_date);
+	std::string next_name = ScalerFileName(kTestDataDir, device, &next_date);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 300;
+	ScalerStorage storage(option);
+	uint32_t scalers[kMaxScalers] = {};
+
+	// too early to prepare
+	ASSERT_EQ(storage.Write(start, scalers), 0);
+	usleep(50000);
+	EXPECT_NE(access(next_name.c_str(), F_OK), 0);
+
+	// prepare in background
+	ASSERT_EQ(storage.Write(start + 200, scalers), 0);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		storage.Metrics().prepared_files == 0
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		usleep(1000);
+	}
+	EXPECT_EQ(access(next_name.c_str(), F_OK), 0);
+	EXPECT_EQ(storage.Metrics().prepared_files, 1u);
+	EXPECT_EQ(storage.Metrics().rollovers, 0u);
+
+	// switch to next day
+	scalers[0] = 5;
+	ASSERT_EQ(storage.Write(next, scalers), 0);
+	ScalerStorageMetrics metrics = storage.Metrics();
+	EXPECT_EQ(metrics.rollovers, 1u);
+	EXPECT_EQ(metrics.total_rollover_us, metrics.last_rollover_us);
+	EXPECT_EQ(metrics.max_rollover_us, metrics.last_rollover_us);
+
+	uint32_t value = 0;
+	ASSERT_EQ(storage.Scan(&next_date, 0, 1, [&](const uint32_t *row) {
+		value = row[0];
+	}), 0);
+	EXPECT_EQ(value, 5u);
+}
+
+
+TEST(ScalerStorageTest, PrepareAllocate) {
+	const std::string device = "storage-allocate";
+	time_t start = LocalTime(2023, 3, 10, 86000);
+	time_t next = LocalTime(2023, 3, 11, 0);
+	RemoveFile(device, start);
+	RemoveFile(device, next);
+	tm next_date;
+	localtime_r(&next, &next_date);
+	std::string next_name = ScalerFileName(kTestDataDir, device, &next_date);
+	// sparse file left by older versions
+	ScalerFileHeader header = {};
+	header.version = kScalerFileRowMajor;
+	header.number = kMaxScalers;
+	FILE *fp = fopen(next_name.c_str(), "w");
+	ASSERT_NE(fp, nullptr);
+	ASSERT_EQ(fwrite(&header, sizeof(header), 1, fp), 1u);
+	ASSERT_EQ(ftruncate(fileno(fp), kScalerFileSize), 0);
+	fclose(fp);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 300;
+	ScalerStorage storage(option);
+	uint32_t scalers[kMaxScalers] = {};
+	ASSERT_EQ(storage.Write(start + 200, scalers), 0);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	struct stat file_stat;
+	do {
+		usleep(1000);
+		ASSERT_EQ(stat(next_name.c_str(), &file_stat), 0);
+	} while (
+		size_t(file_stat.st_blocks) * 512 < kScalerFileSize
+		&& std::chrono::steady_clock::now() < deadline
+	);
+	EXPECT_GE(size_t(file_stat.st_blocks) * 512, kScalerFileSize);
+	EXPECT_EQ(storage.Metrics().prepare_failures, 0u);
+	EXPECT_EQ(storage.Metrics().prepared_files, 0u);
+}
+
+
+TEST(ScalerStorageTest, PrepareFailure) {
+	const std::string device = "storage-prepare-failure";
+	time_t start = LocalTime(2023, 3, 10, 86000);
+	time_t next = LocalTime(2023, 3, 11, 0);
+	RemoveFile(device, start);
+	RemoveFile(device, next);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 300;
+	ScalerStorage storage(option);
+	uint32_t scalers[kMaxScalers] = {};
+	ASSERT_EQ(storage.Write(start, scalers), 0);
+
+	// allocating beyond the limit fails like a full disk
+	rlimit limit;
+	ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &limit), 0);
+	rlimit small = limit;
+	small.rlim_cur = 4096;
+	signal(SIGXFSZ, SIG_IGN);
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &small), 0);
+	ASSERT_EQ(storage.Write(start + 200, scalers), 0);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while (
+		storage.Metrics().prepare_failures == 0
+		&& std::chrono::steady_clock::now() < deadline
+	) {
+		usleep(1000);
+	}
+	ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+	signal(SIGXFSZ, SIG_DFL);
+	// reported before the day begins
+	EXPECT_EQ(storage.Metrics().prepare_failures, 1u);
+	EXPECT_EQ(storage.Metrics().prepared_files, 0u);
+	RemoveFile(device, start);
+	RemoveFile(device, next);
+}
+
+
+TEST(ScalerStorageTest, Sum) {
+	const std::string device = "storage-sum";
+	time_t start = LocalTime(2023, 3, 12, 0);
+	RemoveFile(device, start);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 0;
+	ScalerStorage storage(option);
+	std::mt19937 engine(11);
+	std::uniform_int_distribution<uint32_t> distribution(0, 1000000);
+	uint32_t scalers[kMaxScalers];
+	// write the first 4 hours, and some seconds twice
+	for (int t = 0; t < 4 * 3600; ++t) {
+		for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = distribution(engine);
+		ASSERT_EQ(storage.Write(start + t, scalers), 0);
+	}
+	for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = 1;
+	ASSERT_EQ(storage.Write(start + 4*3600 - 1, scalers), 0);
+
+	tm date;
+	localtime_r(&start, &date);
+	std::uniform_int_distribution<size_t> second_distribution(0, 5 * 3600);
+	for (int n = 0; n < 200; ++n) {
+		size_t second = second_distribution(engine);
+		size_t size = second_distribution(engine) % (kDaySeconds - second);
+		uint64_t sums[kMaxScalers] = {};
+		uint64_t expect[kMaxScalers] = {};
+		ASSERT_EQ(storage.Sum(&date, second, size, sums), 0);
+		ASSERT_EQ(storage.Scan(&date, second, size, [&](const uint32_t *row) {
+			for (size_t i = 0; i < kMaxScalers; ++i) expect[i] += row[i];
+		}), 0);
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			ASSERT_EQ(sums[i], expect[i]) << "range " << second << " + " << size;
+		}
+	}
+
+	// invalid range
+	uint64_t sums[kMaxScalers] = {};
+	EXPECT_EQ(storage.Sum(&date, 86000, 401, sums), -1);
+}
+
+
+TEST(ScalerStorageTest, ColumnMajor) {
+	const std::string device = "storage-column";
+	time_t start = LocalTime(2023, 3, 13, 0);
+	RemoveFile(device, start);
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 0;
+	option.file_version = kScalerFileColumnMajor;
+	ScalerStorage storage(option);
+	std::mt19937 engine(13);
+	std::uniform_int_distribution<uint32_t> distribution;
+	uint32_t scalers[kMaxScalers];
+	// write across the first block
+	for (int t = 0; t < 2 * 3600 + 100; ++t) {
+		for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = distribution(engine);
+		ASSERT_EQ(storage.Write(start + t, scalers), 0);
+	}
+
+	tm date;
+	localtime_r(&start, &date);
+	ScalerFile file;
+	ASSERT_EQ(file.Open(ScalerFileName(kTestDataDir, device, &date), false, false), 0);
+	EXPECT_EQ(file.Version(), kScalerFileColumnMajor);
+	file.Close();
+
+	// the range includes rows under writing
+	const uint32_t flag = 0x80000005;
+	for (size_t second : {size_t(0), size_t(3590), size_t(7190)}) {
+		const size_t size = 3 * 3600 - second;
+		uint64_t sums[kMaxScalers] = {};
+		ScalerReduction reduction;
+		ScalerReduction expect;
+		ASSERT_EQ(storage.Sum(&date, second, size, sums), 0);
+		ASSERT_EQ(storage.Reduce(&date, second, size, reduction, flag), 0);
+		ASSERT_EQ(storage.Scan(&date, second, size, [&](const uint32_t *row) {
+			ReduceRowsScalar(row, 1, expect);
+		}), 0);
+		EXPECT_EQ(reduction.count, size);
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			ASSERT_EQ(sums[i], expect.sum[i]);
+			if (!(flag & (1u << i))) continue;
+			EXPECT_EQ(reduction.sum[i], expect.sum[i]);
+			EXPECT_EQ(reduction.min[i], expect.min[i]);
+			EXPECT_EQ(reduction.max[i], expect.max[i]);
+			EXPECT_EQ(reduction.last[i], expect.last[i]);
+		}
+	}
+}
+
+
+TEST(ScalerStorageTest, Archived) {
+	const std::string device = "storage-archived";
+	time_t start = LocalTime(2023, 3, 14, 0);
+	RemoveFile(device, start);
+	tm date;
+	localtime_r(&start, &date);
+	const std::string name = ScalerFileName(kTestDataDir, device, &date);
+	const std::string archive_name = ScalerArchiveFileName(kTestDataDir, device, &date);
+	remove(archive_name.c_str());
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 0;
+	std::mt19937 engine(23);
+	std::uniform_int_distribution<uint32_t> distribution(0, 1000);
+	uint32_t scalers[kMaxScalers];
+	{
+		ScalerStorage storage(option);
+		for (int t = 0; t < 5000; ++t) {
+			for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = distribution(engine);
+			ASSERT_EQ(storage.Write(start + t, scalers), 0);
+		}
+	}
+	// expected values from day file
+	ScalerReduction expect;
+	std::vector<uint32_t> rows;
+	{
+		ScalerStorage storage(option);
+		ASSERT_EQ(storage.Scan(&date, 0, 6000, [&](const uint32_t *row) {
+			ReduceRowsScalar(row, 1, expect);
+			rows.insert(rows.end(), row, row + kMaxScalers);
+		}), 0);
+	}
+	ScalerFile day;
+	ASSERT_EQ(day.Open(name, false, false), 0);
+	ASSERT_EQ(ScalerArchive::Create(day, archive_name), 0);
+	day.Close();
+	remove(name.c_str());
+
+	ScalerStorage storage(option);
+	uint64_t sums[kMaxScalers] = {};
+	ScalerReduction reduction;
+	size_t row = 0;
+	ASSERT_EQ(storage.Sum(&date, 0, 6000, sums), 0);
+	ASSERT_EQ(storage.Reduce(&date, 0, 6000, reduction, 0x3), 0);
+	ASSERT_EQ(storage.Scan(&date, 0, 6000, [&](const uint32_t *values) {
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			EXPECT_EQ(values[i], rows[row * kMaxScalers + i]);
+		}
+		++row;
+	}), 0);
+	EXPECT_EQ(row, 6000u);
+	EXPECT_EQ(reduction.count, 6000u);
+	for (size_t i = 0; i < kMaxScalers; ++i) {
+		EXPECT_EQ(sums[i], expect.sum[i]);
+		if (i >= 2) continue;
+		EXPECT_EQ(reduction.sum[i], expect.sum[i]);
+		EXPECT_EQ(reduction.min[i], expect.min[i]);
+		EXPECT_EQ(reduction.max[i], expect.max[i]);
+		EXPECT_EQ(reduction.last[i], expect.last[i]);
+	}
+	// archived day is not written again
+	EXPECT_EQ(storage.Write(start, scalers), -1);
+	EXPECT_NE(access(name.c_str(), F_OK), 0);
+	remove(archive_name.c_str());
+}
+
+
+TEST(ScalerStorageTest, PrefixIndex) {
+	const std::string device = "storage-prefix";
+	time_t start = LocalTime(2023, 3, 15, 0);
+	RemoveFile(device, start);
+	tm date;
+	localtime_r(&start, &date);
+	const std::string prefix_name = ScalerPrefixFileName(kTestDataDir, device, &date);
+	remove(prefix_name.c_str());
+
+	ScalerStorageOption option;
+	option.data_path = kTestDataDir;
+	option.device_name = device;
+	option.prepare_ahead = 0;
+	option.prefix_index = true;
+	ScalerStorage storage(option);
+	std::mt19937 engine(31);
+	std::uniform_int_distribution<uint32_t> distribution;
+	uint32_t scalers[kMaxScalers];
+	for (int t = 0; t < 3 * 3600; t += 1 + t % 2) {
+		for (size_t i = 0; i < kMaxScalers; ++i) scalers[i] = distribution(engine);
+		ASSERT_EQ(storage.Write(start + t, scalers), 0);
+	}
+	EXPECT_EQ(access(prefix_name.c_str(), F_OK), 0);
+
+	// ranges including the writing row and seconds never written
+	std::uniform_int_distribution<size_t> second_distribution(0, 4 * 3600);
+	for (int n = 0; n < 100; ++n) {
+		size_t second = second_distribution(engine);
+		size_t size = second_distribution(engine);
+		uint64_t sums[kMaxScalers] = {};
+		uint64_t expect[kMaxScalers] = {};
+		ASSERT_EQ(storage.Sum(&date, second, size, sums), 0);
+		ASSERT_EQ(storage.Scan(&date, second, size, [&](const uint32_t *row) {
+			for (size_t i = 0; i < kMaxScalers; ++i) expect[i] += row[i];
+		}), 0);
+		for (size_t i = 0; i < kMaxScalers; ++i) {
+			ASSERT_EQ(sums[i], expect[i]) << "range " << second << " + " << size;
+		}
+	}
+}
@@ -1,10 +1,13 @@
 #include "syntax/parser/syntax_parser.h"
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include "syntax/parser/token.h"
 #include "syntax/logical_grammar.h"
 #include "syntax/arithmetic_grammar.h"
+#include "syntax/logic_downscale_grammar.h"
 
 using namespace ecl;
 
@@ -324,4 +327,88 @@ TEST(SLRSyntaxParserTest, Parse) {
 			++index;
 		}
 	}
-}
\ No newline at end of file
+}
+
+
+TEST(SLRSyntaxParserTest, SharedGrammar) {
+	// shared grammar is built only once
+	const CompiledGrammar<bool> *compiled =
+		SharedGrammar<bool, LogicalGrammar>();
+	ASSERT_EQ(compiled, (SharedGrammar<bool, LogicalGrammar>()));
+
+	// check action table of shared grammar
+	const std::vector<std::vector<int>> &action_type = logical_action_type;
+	const ActionTable *table = compiled->GetActionTable();
+	for (size_t c = 0; c < action_type.size(); ++c) {
+		for (size_t s = 0; s < action_type[0].size(); ++s) {
+			EXPECT_EQ(table->GetAction(c, s)->type, action_type[c][s])
+				<< "error action type collection " << c
+				<< ", symbol " << s;
+		}
+	}
+
+	// parse concurrently with the shared grammar
+	const std::vector<std::vector<TokenPtr>> &tokens_list = kLogicalTokens;
+	const std::vector<std::vector<int>> &value = kLogicalValue;
+	const std::vector<bool> &result = kLogicalResult;
+	std::vector<int> evaluated(tokens_list.size(), -1);
+	std::vector<std::thread> threads;
+	for (size_t index = 0; index < tokens_list.size(); ++index) {
+		threads.emplace_back([&, index]() {
+			SLRSyntaxParser<bool> parser(compiled);
+			if (!parser.Parse(tokens_list[index]).Ok()) return;
+			for (size_t i = 0; i < value[index].size(); ++i) {
+				parser.AttachIdentifier(i, (void*)&(value[index][i]));
+			}
+			evaluated[index] = parser.Eval();
+		});
+	}
+	for (auto &thread : threads) thread.join();
+	for (size_t index = 0; index < tokens_list.size(); ++index) {
+		EXPECT_EQ(int(result[index]), evaluated[index])
+			<< "error evaluated value, index " << index;
+	}
+}
+
+
+
+template<typename VarType>
+void CheckGeneratedTable(Grammar<VarType> *grammar, Grammar<VarType> *runtime) {
+	CompiledGrammar<VarType> generated_compiled(grammar);
+	CompiledGrammar<VarType> runtime_compiled(runtime, false);
+	ASSERT_TRUE(generated_compiled.IsGenerated())
+		<< "generated table doesn't match the grammar, "
+		<< "run `make update_action_table`";
+	ASSERT_FALSE(runtime_compiled.IsGenerated());
+	ASSERT_EQ(
+		generated_compiled.CollectionSize(), runtime_compiled.CollectionSize()
+	);
+	ASSERT_EQ(generated_compiled.SymbolSize(), runtime_compiled.SymbolSize());
+	for (int c = 0; c < runtime_compiled.CollectionSize(); ++c) {
+		for (int s = 0; s < runtime_compiled.SymbolSize(); ++s) {
+			EXPECT_EQ(generated_compiled.Cell(c, s), runtime_compiled.Cell(c, s))
+				<< "generated table is out of date, collection " << c
+				<< ", symbol " << s << ", run `make update_action_table`";
+		}
+	}
+}
+
+
+TEST(SLRSyntaxParserTest, GeneratedActionTable) {
+	{
+		LogicalGrammar grammar, runtime;
+		CheckGeneratedTable(&grammar, &runtime);
+	}
+	{
+		LogicDownscaleGrammar grammar, runtime;
+		CheckGeneratedTable(&grammar, &runtime);
+	}
+	{
+		ArithmeticGrammar grammar, runtime;
+		CheckGeneratedTable(&grammar, &runtime);
+	}
+	// grammar without generated table
+	AddMultiGrammar grammar;
+	CompiledGrammar<double> compiled(&grammar);
+	EXPECT_FALSE(compiled.IsGenerated());
+}